@@ -0,0 +1,338 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The server of the RPC benchmark. It binds a target object at
+// device/rpcBench and starts the rpcBenchClient processes, which measure
+// the calls to it:
+//
+//   latency     null call latency percentiles
+//   throughput  null calls per second with 1, 2, 4, ... clients at once
+//   size        write and read of 0 to 16 MiB, where the sizes too large
+//               to be passed are reported as skipped
+//   object      export and import of the objects passed as arguments and
+//               results
+//   ref         remote addRef() and release() pairs
+//
+// Each result is reported as a line of a JSON object, e.g.,
+//
+//   {"benchmark":"throughput","clients":4,"calls":40000,"ns":...,"callsPerSec":...}
+//   {"benchmark":"size","direction":"write","bytes":16777216,"skipped":true,"error":...}
+//
+// usage: rpcBench [-n maxClients] [-c calls]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <es.h>
+#include <es/handle.h>
+#include <es/interfaceTable.h>
+#include <es/ref.h>
+#include <es/synchronized.h>
+#include <es/timeSpan.h>
+#include <es/base/IMonitor.h>
+#include <es/base/IProcess.h>
+#include <es/base/IStream.h>
+#include <es/naming/IBinding.h>
+#include <es/naming/IContext.h>
+#include "rpcBench.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+es::CurrentProcess* System();
+
+namespace
+{
+    const int MAX_CLIENTS = 16;
+    const int CALLS = 10000;
+    const int LATENCY_CALLS = 10000;
+    const int OBJECT_CALLS = 1000;
+    const int REF_CALLS = 10000;
+}
+
+// The object called by the clients. es::Stream carries the null calls and
+// the sequences, es::Binding the objects. A round of the throughput
+// benchmark is run as follows:
+//
+//   1. each client calls setPosition() once it is ready,
+//   2. the clients poll getSize() until the server starts the round,
+//   3. each client calls setSize() with the time it has finished its calls.
+class Target : public es::Stream, public es::Binding
+{
+    Ref             ref;
+    es::Monitor*    monitor;
+    Element         element;
+    int             round;      // the current round, or zero until started
+    int             arrived;
+    int             done;
+    long long       end;        // when the last client has finished [tick]
+
+public:
+    Target() :
+        monitor(System()->createMonitor()),
+        round(0),
+        arrived(0),
+        done(0),
+        end(0)
+    {
+    }
+
+    ~Target()
+    {
+        monitor->release();
+    }
+
+    // Prepares a new round, which is not started yet.
+    void reset()
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        round = 0;
+        arrived = 0;
+        done = 0;
+        end = 0;
+    }
+
+    // Waits for count clients to get ready, and then starts the round.
+    long long start(int count, int number)
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        while (arrived < count)
+        {
+            monitor->wait();
+        }
+        round = number;
+        return System()->getNow();
+    }
+
+    // Waits for count clients to finish the round.
+    long long wait(int count)
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        while (done < count)
+        {
+            monitor->wait();
+        }
+        return end;
+    }
+
+    //
+    // IStream
+    //
+    long long getPosition()
+    {
+        return 0;
+    }
+
+    void setPosition(long long pos)
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        ++arrived;
+        monitor->notifyAll();
+    }
+
+    long long getSize()
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        return round;
+    }
+
+    void setSize(long long size)
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        ++done;
+        if (end < size)
+        {
+            end = size;
+        }
+        monitor->notifyAll();
+    }
+
+    int read(void* dst, int count)
+    {
+        return count;
+    }
+
+    int read(void* dst, int count, long long offset)
+    {
+        return count;
+    }
+
+    int write(const void* src, int count)
+    {
+        return count;
+    }
+
+    int write(const void* src, int count, long long offset)
+    {
+        return count;
+    }
+
+    void flush()
+    {
+    }
+
+    //
+    // IBinding
+    //
+    Object* getObject()
+    {
+        element.addRef();
+        return &element;
+    }
+
+    void setObject(Object* object)
+    {
+    }
+
+    const char* getName(void* name, int len)
+    {
+        if (len < 1)
+        {
+            return 0;
+        }
+        strncpy(static_cast<char*>(name), "rpcBench", len);
+        static_cast<char*>(name)[len - 1] = '\0';
+        return static_cast<char*>(name);
+    }
+
+    //
+    // IInterface
+    //
+    Object* queryInterface(const char* riid)
+    {
+        return es::InterfaceTable<Target, es::Stream, es::Binding>::query(this, riid);
+    }
+
+    unsigned int addRef()
+    {
+        return ref.addRef();
+    }
+
+    unsigned int release()
+    {
+        unsigned int count = ref.release();
+        if (count == 0)
+        {
+            delete this;
+            return 0;
+        }
+        return count;
+    }
+};
+
+// Starts a client process running the benchmark with the arguments.
+static es::Process* launch(es::File* file, const char* arguments)
+{
+    es::Process* client = es::Process::createInstance();
+    TEST(client);
+    client->start(file, arguments);
+    return client;
+}
+
+static void run(es::File* file, const char* arguments)
+{
+    Handle<es::Process> client(launch(file, arguments));
+    client->wait();
+}
+
+// Measures the calls per second of count clients calling at once.
+static void throughput(Target* target, es::File* file, int count, int calls, int number)
+{
+    char arguments[64];
+    sprintf(arguments, "rpcBenchClient throughput %d", calls);
+
+    target->reset();
+    es::Process* clients[MAX_CLIENTS];
+    for (int i = 0; i < count; ++i)
+    {
+        clients[i] = launch(file, arguments);
+    }
+    long long start = target->start(count, number);
+    long long end = target->wait(count);
+    for (int i = 0; i < count; ++i)
+    {
+        clients[i]->wait();
+        clients[i]->release();
+    }
+
+    long long ns = (end - start) * (1000 / TimeSpan::TICKS_PER_MICROSECOND);
+    if (ns <= 0)
+    {
+        ns = 1;
+    }
+    long long total = static_cast<long long>(count) * calls;
+    esReport("{\"benchmark\":\"throughput\",\"clients\":%d,\"calls\":%lld,\"ns\":%lld,\"callsPerSec\":%lld}\n",
+             count, total, ns, total * 1000000000LL / ns);
+}
+
+int main(int argc, char* argv[])
+{
+    int maxClients = 8;
+    int calls = CALLS;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+        {
+            maxClients = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-c") == 0)
+        {
+            calls = atoi(argv[i + 1]);
+        }
+    }
+    if (maxClients < 1)
+    {
+        maxClients = 1;
+    }
+    else if (MAX_CLIENTS < maxClients)
+    {
+        maxClients = MAX_CLIENTS;
+    }
+
+    Handle<es::Context> nameSpace = System()->getRoot();
+    Handle<es::File> file = nameSpace->lookup("file/rpcBenchClient.elf");
+    TEST(file);
+
+    Target* target = new Target;
+    Handle<es::Context> device = nameSpace->lookup("device");
+    TEST(device);
+    es::Binding* binding = device->bind("rpcBench", static_cast<es::Stream*>(target));
+    TEST(binding);
+    binding->release();
+
+    char arguments[64];
+    sprintf(arguments, "rpcBenchClient latency %d", LATENCY_CALLS);
+    run(file, arguments);
+
+    int number = 0;
+    for (int count = 1; count <= maxClients; count *= 2)
+    {
+        throughput(target, file, count, calls, ++number);
+    }
+
+    run(file, "rpcBenchClient size");
+
+    sprintf(arguments, "rpcBenchClient object %d", OBJECT_CALLS);
+    run(file, arguments);
+
+    sprintf(arguments, "rpcBenchClient ref %d", REF_CALLS);
+    run(file, arguments);
+
+    nameSpace->unbind("device/rpcBench");
+    target->release();
+}
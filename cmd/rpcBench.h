@@ -0,0 +1,54 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RPCBENCH_H_INCLUDED
+#define RPCBENCH_H_INCLUDED
+
+#include <es.h>
+#include <es/interfaceTable.h>
+#include <es/ref.h>
+
+// An object passed between rpcBench and rpcBenchClient by the object
+// benchmark, as returned by Target::getObject() and passed to
+// Target::setObject().
+class Element : public Object
+{
+    Ref ref;
+
+public:
+    Object* queryInterface(const char* riid)
+    {
+        if (!es::isInterface<Object>(riid))
+        {
+            return 0;
+        }
+        addRef();
+        return this;
+    }
+
+    unsigned int addRef()
+    {
+        return ref.addRef();
+    }
+
+    unsigned int release()
+    {
+        return ref.release();
+    }
+};
+
+#endif  // RPCBENCH_H_INCLUDED
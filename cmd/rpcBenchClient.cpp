@@ -0,0 +1,224 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The client of the RPC benchmark started by rpcBench, which calls the
+// target object bound at device/rpcBench.
+//
+// usage: rpcBenchClient latency calls
+//        rpcBenchClient throughput calls
+//        rpcBenchClient size
+//        rpcBenchClient object calls
+//        rpcBenchClient ref calls
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <es.h>
+#include <es/exception.h>
+#include <es/handle.h>
+#include <es/timeSpan.h>
+#include <es/base/IProcess.h>
+#include <es/base/IStream.h>
+#include <es/naming/IBinding.h>
+#include <es/naming/IContext.h>
+#include "rpcBench.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+es::CurrentProcess* System();
+
+namespace
+{
+    const int MAX_SIZE = 16 * 1024 * 1024;
+    const long long SIZE_BYTES = 64 * 1024 * 1024;  // transferred for each size at most
+    const int SIZE_CALLS = 10;                      // made for each size at least
+    const long long POLL_INTERVAL = 1000;           // [tick]
+}
+
+static long long now()
+{
+    return System()->getNow();
+}
+
+// Converts ticks to nanoseconds.
+static long long ns(long long ticks)
+{
+    return ticks * (1000 / TimeSpan::TICKS_PER_MICROSECOND);
+}
+
+static long long perSecond(long long count, long long ticks)
+{
+    return (0 < ticks) ? count * TimeSpan::TICKS_PER_SECOND / ticks : 0;
+}
+
+static void latency(es::Stream* target, int calls)
+{
+    long long* latency = new long long[calls];
+    for (int i = 0; i < calls; ++i)
+    {
+        long long start = now();
+        target->flush();
+        latency[i] = now() - start;
+    }
+    std::sort(latency, latency + calls);
+    esReport("{\"benchmark\":\"latency\",\"calls\":%d,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld}\n",
+             calls,
+             ns(latency[calls * 50 / 100]),
+             ns(latency[calls * 90 / 100]),
+             ns(latency[calls * 99 / 100]),
+             ns(latency[calls * 999 / 1000]),
+             ns(latency[calls - 1]));
+    delete[] latency;
+}
+
+// Runs a round of the throughput benchmark set up by rpcBench.
+static void throughput(es::Stream* target, int calls)
+{
+    Handle<es::CurrentThread> currentThread = System()->currentThread();
+    target->setPosition(0);
+    while (target->getSize() == 0)
+    {
+        currentThread->sleep(POLL_INTERVAL);
+    }
+    for (int i = 0; i < calls; ++i)
+    {
+        target->flush();
+    }
+    target->setSize(now());
+}
+
+static void size(es::Stream* target)
+{
+    u8* buffer = new u8[MAX_SIZE];
+    memset(buffer, 0, MAX_SIZE);
+    for (int size = 0; size <= MAX_SIZE; size = size ? size * 4 : 64)
+    {
+        int calls = std::max(static_cast<long long>(SIZE_CALLS), SIZE_BYTES / std::max(size, 1));
+        const char* direction = "write";
+        try
+        {
+            long long start = now();
+            for (int i = 0; i < calls; ++i)
+            {
+                TEST(target->write(buffer, size) == size);
+            }
+            long long ticks = now() - start;
+            esReport("{\"benchmark\":\"size\",\"direction\":\"write\",\"bytes\":%d,\"calls\":%d,\"ns\":%lld,\"bytesPerSec\":%lld}\n",
+                     size, calls, ns(ticks) / calls, perSecond(static_cast<long long>(size) * calls, ticks));
+
+            direction = "read";
+            start = now();
+            for (int i = 0; i < calls; ++i)
+            {
+                TEST(target->read(buffer, size) == size);
+            }
+            ticks = now() - start;
+            esReport("{\"benchmark\":\"size\",\"direction\":\"read\",\"bytes\":%d,\"calls\":%d,\"ns\":%lld,\"bytesPerSec\":%lld}\n",
+                     size, calls, ns(ticks) / calls, perSecond(static_cast<long long>(size) * calls, ticks));
+        }
+        catch (Exception& error)
+        {
+            // A sequence passed by an upcall has to fit in the stack of the
+            // upcall, and the larger one fails with E2BIG.
+            esReport("{\"benchmark\":\"size\",\"direction\":\"%s\",\"bytes\":%d,\"skipped\":true,\"error\":%d}\n",
+                     direction, size, error.getResult());
+        }
+    }
+    delete[] buffer;
+}
+
+// Measures the objects exported by this process to the server and the ones
+// imported from the server, each of which is released right after.
+static void object(es::Binding* target, int calls)
+{
+    Element element;
+
+    long long start = now();
+    for (int i = 0; i < calls; ++i)
+    {
+        target->setObject(&element);
+    }
+    long long ticks = now() - start;
+    esReport("{\"benchmark\":\"object\",\"direction\":\"export\",\"calls\":%d,\"ns\":%lld,\"callsPerSec\":%lld}\n",
+             calls, ns(ticks) / calls, perSecond(calls, ticks));
+
+    start = now();
+    for (int i = 0; i < calls; ++i)
+    {
+        Object* object = target->getObject();
+        TEST(object);
+        object->release();
+    }
+    ticks = now() - start;
+    esReport("{\"benchmark\":\"object\",\"direction\":\"import\",\"calls\":%d,\"ns\":%lld,\"callsPerSec\":%lld}\n",
+             calls, ns(ticks) / calls, perSecond(calls, ticks));
+}
+
+static void ref(es::Stream* target, int calls)
+{
+    long long start = now();
+    for (int i = 0; i < calls; ++i)
+    {
+        target->addRef();
+        target->release();
+    }
+    long long ticks = now() - start;
+    esReport("{\"benchmark\":\"ref\",\"calls\":%d,\"ns\":%lld,\"callsPerSec\":%lld}\n",
+             calls, ns(ticks) / calls, perSecond(calls, ticks));
+}
+
+int main(int argc, char* argv[])
+{
+    TEST(2 <= argc);
+    int calls = (3 <= argc) ? atoi(argv[2]) : 0;
+
+    Handle<es::Context> nameSpace = System()->getRoot();
+    Handle<es::Stream> target = nameSpace->lookup("device/rpcBench");
+    TEST(target);
+
+    if (strcmp(argv[1], "latency") == 0)
+    {
+        TEST(0 < calls);
+        latency(target, calls);
+    }
+    else if (strcmp(argv[1], "throughput") == 0)
+    {
+        throughput(target, calls);
+    }
+    else if (strcmp(argv[1], "size") == 0)
+    {
+        size(target);
+    }
+    else if (strcmp(argv[1], "object") == 0)
+    {
+        TEST(0 < calls);
+        Handle<es::Binding> binding(target);
+        TEST(binding);
+        object(binding, calls);
+    }
+    else if (strcmp(argv[1], "ref") == 0)
+    {
+        TEST(0 < calls);
+        ref(target, calls);
+    }
+    else
+    {
+        esReport("rpcBenchClient: unknown benchmark '%s'\n", argv[1]);
+    }
+}
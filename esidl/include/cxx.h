@@ -124,7 +124,13 @@ public:
             {
                 name = resolved->getQualifiedName();
                 name = getInterfaceName(name);
-                name = getScopedName(moduleName, name);
+                // Keep the name qualified if the name shortened refers to
+                // a constant or an operation of the same name in the scope.
+                Node* found = resolve(currentNode, getScopedName(moduleName, name));
+                if (!dynamic_cast<ConstDcl*>(found) && !dynamic_cast<OpDcl*>(found))
+                {
+                    name = getScopedName(moduleName, name);
+                }
             }
             write("%s", name.c_str());
         }
@@ -174,6 +174,10 @@ public:
     // [ReplaceableNamedProperties]
     // cf. http://www.w3.org/Bugs/Public/show_bug.cgi?id=8241
     static const uint32_t ReplaceableNamedProperties=0x04000000;  // TODO: Update meta
+    // [Oneway] on operations
+    static const uint32_t Oneway =                   0x08000000;
+    // [Ordered] on interfaces
+    static const uint32_t Ordered =                  0x08000000;
 
     // misc. bits
     static const uint32_t HasCovariant =             0x10000000;
@@ -1206,6 +1210,12 @@ public:
         return (getAttr() & CallbackMask);
     }
 
+    // true if the calls to an object are to be served in the order.
+    bool isOrdered() const
+    {
+        return getAttr() & Ordered;
+    }
+
     virtual void accept(Visitor* visitor);
 
     void implements(Interface* mixin, bool importImplements)
@@ -1851,6 +1861,12 @@ public:
         return raises->getSize();
     }
 
+    // true if the caller does not wait for the operation to complete.
+    bool isOneway() const
+    {
+        return getAttr() & Oneway;
+    }
+
     // Adjust methodCount for [Callback] and [Optional].
     // Need to be called after the source file is completely read.
     void adjustMethodCount();
@@ -2342,6 +2358,8 @@ void printCxx(const char* source, const char* stringTypeName, const char* object
 void printSkeleton(const char* source, bool isystem, const char* indent);
 void printTemplate(const char* source, const char* stringTypeName, const char* objectTypeName,
                    bool useExceptions, bool isystem, const char* indent);
+void printStub(const char* source, const char* stringTypeName, const char* objectTypeName,
+               bool useExceptions, bool isystem, const char* indent);
 
 std::string getOutputFilename(std::string, const char* suffix);
 std::string getIncludedName(const std::string& header);
@@ -2357,6 +2375,7 @@ int output(const char* filename,
            bool isystem, bool useExceptions, bool useMultipleInheritance,
            const char* stringTypeName, const char* objectTypeName, const char* indent,
            bool skeleton,
-           bool generic);
+           bool generic,
+           bool stub);
 
 #endif  // ESIDL_H_INCLUDED
@@ -30,6 +30,14 @@ class Info : public Visitor, public Formatter
     const Node* currentNode;
     bool constructorMode;
     unsigned offset;
+    std::string info;
+
+    void writeMeta(const std::string& meta)
+    {
+        write("\"%s\"", meta.c_str());
+        offset += meta.length();
+        info += meta;
+    }
 
     void visitInterfaceElement(const Interface* interface, Node* element)
     {
@@ -56,6 +64,14 @@ public:
         flush();
     }
 
+    /**
+     * Gets the string-encoded interface information written last.
+     */
+    const std::string& getInfo() const
+    {
+        return info;
+    }
+
     virtual void at(const Module* node)
     {
         // Info{} visiter should be applied for interfaces.
@@ -63,15 +79,13 @@ public:
 
     virtual void at(const Attribute* node)
     {
-        write("\"%s\"", node->getMetaGetter().c_str());
-        offset += node->getMetaGetter().length();
+        writeMeta(node->getMetaGetter());
         if (!node->isReadonly() || node->isPutForwards() || node->isReplaceable())
         {
             writeln("");
             writetab();
             write("/* %u */ ", offset);
-            write("\"%s\"", node->getMetaSetter().c_str());
-            offset += node->getMetaSetter().length();
+            writeMeta(node->getMetaSetter());
         }
     }
 
@@ -85,15 +99,9 @@ public:
                 writetab();
                 write("/* %u */ ", offset);
             }
-            if (constructorMode)
-            {
-                write("\"%c%s\"", Reflect::kConstructor, node->getMetaOp(i).c_str() + 1);
-            }
-            else
-            {
-                write("\"%c%s\"", Reflect::kOperation, node->getMetaOp(i).c_str() + 1);
-            }
-            offset += node->getMetaOp(i).length();
+            std::string meta = node->getMetaOp(i);
+            meta[0] = constructorMode ? Reflect::kConstructor : Reflect::kOperation;
+            writeMeta(meta);
         }
     }
 
@@ -106,13 +114,12 @@ public:
 
         currentNode = node;
         offset = 0;
+        info.clear();
 
         writeln("");
         writetab();
         write("/* %u */ ", offset);
-        write("\"%s\"", node->getMeta().c_str());
-
-        offset += node->getMeta().length();
+        writeMeta(node->getMeta());
 
         // Expand supplementals
         std::list<const Interface*> interfaceList;
@@ -148,8 +155,7 @@ public:
 
     virtual void at(const ConstDcl* node)
     {
-        write("\"%s\"", node->getMeta().c_str());
-        offset += node->getMeta().length();
+        writeMeta(node->getMeta());
     }
 
     virtual void at(const Member* node)
@@ -283,6 +283,16 @@ public:
         spec->accept(this);
     }
 
+    // Marks the methods of an [Ordered] interface.
+    void writeOrdered(const Node* node)
+    {
+        const Interface* interface = dynamic_cast<const Interface*>(node->getParent());
+        if (interface && interface->isOrdered())
+        {
+            output << Reflect::kOrdered;
+        }
+    }
+
     void getter(const Attribute* node)
     {
         output.str("");
@@ -300,6 +310,7 @@ public:
         {
             output << Reflect::kSpecialStringifier;
         }
+        writeOrdered(node);
         output << '0';
 
         if (seq)
@@ -355,7 +366,9 @@ public:
         }
         SequenceType* seq = const_cast<SequenceType*>(spec->isSequence(node->getParent()));
 
-        output << Reflect::kSetter << '1' << Reflect::kVoid;
+        output << Reflect::kSetter;
+        writeOrdered(node);
+        output << '1' << Reflect::kVoid;
         writeName(node);
         if (seq)
         {
@@ -431,6 +444,11 @@ public:
         {
             output << Reflect::kSpecialStringifier;
         }
+        if (node->getAttr() & OpDcl::Oneway)
+        {
+            output << Reflect::kOneway;
+        }
+        writeOrdered(node);
 
         output << node->getParamCount(optionalStage);
 
@@ -53,6 +53,8 @@
  *    t: stringifier
  *    o: omittable
  *    V: variadic
+ *    w: oneway
+ *    q: ordered
  *
  *  type ->
  *    A: any
@@ -81,6 +83,19 @@
  *    R name
  *
  *  TODO: embed other extended attributes in the meta-data.
+ *
+ * esidl also generates an index of the meta-data as an array of unsigned
+ * words for the random access to the methods and the parameters:
+ *
+ *  index ->
+ *    methodCount constantCount constructorCount
+ *    record* // the index of the record of each method, then of each constructor
+ *    offset* // the offset to each constant
+ *    (offset paramCount entry entry*)*  // the record of each method and constructor
+ *
+ *  entry -> typeOffset nameOffset nameLength  // of the return value and then of each parameter
+ *
+ *  where the offsets are in characters from the head of the meta-data.
  */
 class Reflect
 {
@@ -124,6 +139,8 @@ public:
     static const char kSpecialStringifier = 't';
     static const char kSpecialOmittable = 'o';
     static const char kVariadic = 'V';
+    static const char kOneway = 'w';
+    static const char kOrdered = 'q';
 
     static const char kNullable = '?';
 
@@ -453,12 +470,18 @@ public:
     class Parameter
     {
         const char* info;
+        const char* base;       // the head of the meta-data
+        const unsigned* entry;  // in the index, or zero
+        unsigned count;         // the number of the entries after this one
 
     public:
         /** Default constructor
          */
         Parameter() :
-            info("")
+            info(""),
+            base(0),
+            entry(0),
+            count(0)
         {
         }
 
@@ -467,7 +490,24 @@ public:
          * @param info the string encoded reflection data generated by esidl.
          */
         Parameter(const char* info) :
-            info(info)
+            info(info),
+            base(0),
+            entry(0),
+            count(0)
+        {
+        }
+
+        /**
+         * Constructs an object which represents the specified parameter.
+         * @param base the head of the string encoded reflection data.
+         * @param entry the entry of the parameter in the index.
+         * @param count the number of the entries following entry.
+         */
+        Parameter(const char* base, const unsigned* entry, unsigned count) :
+            info(base + entry[0]),
+            base(base),
+            entry(entry),
+            count(count)
         {
         }
 
@@ -484,6 +524,10 @@ public:
          */
         const std::string getName() const
         {
+            if (entry)
+            {
+                return std::string(base + entry[1], entry[2]);
+            }
             const char* name = skipType(info);
             unsigned length;
             name = skipDigits(name, &length);
@@ -492,6 +536,23 @@ public:
 
         bool next()
         {
+            if (entry)
+            {
+                if (count == 0)
+                {
+                    info = "";
+                    entry = 0;
+                    return false;
+                }
+                entry += 3;
+                --count;
+                info = base + entry[0];
+                return true;
+            }
+            if (!*info)
+            {
+                return false;
+            }
             info = skipType(info);
             info = skipName(info);
             if (!isParam(info))
@@ -509,21 +570,30 @@ public:
     class Method
     {
         const char* info;
+        const unsigned* record;  // in the index, or zero
+
+        const char* getBase() const
+        {
+            return info - record[0];
+        }
 
     public:
         /** Default constructor
          */
         Method() :
-            info(0)
+            info(0),
+            record(0)
         {
         }
 
         /**
          * Constructs an object which represents the specified operation.
          * @param info the string encoded reflection data generated by esidl.
+         * @param record the record of the operation in the index, if any.
          */
-        Method(const char* info) :
-            info(info)
+        Method(const char* info, const unsigned* record = 0) :
+            info(info),
+            record(record)
         {
         }
 
@@ -531,7 +601,8 @@ public:
          * Copy-constructor.
          */
         Method(const Method& operation) :
-            info(operation.info)
+            info(operation.info),
+            record(operation.record)
         {
         }
 
@@ -568,6 +639,10 @@ public:
          */
         const std::string getName() const
         {
+            if (record)
+            {
+                return std::string(getBase() + record[3], record[4]);
+            }
             const char* name = skipType(skipDigits(skipSpecial(info + 1)));
             unsigned length;
             name = skipDigits(name, &length);
@@ -579,6 +654,10 @@ public:
          */
         Type getReturnType() const
         {
+            if (record)
+            {
+                return Type(getBase() + record[2]);
+            }
             return Type(skipDigits(skipSpecial(info + 1)));
         }
 
@@ -587,6 +666,10 @@ public:
          */
         unsigned getParameterCount() const
         {
+            if (record)
+            {
+                return record[1];
+            }
             unsigned paramCount;
             skipDigits(skipSpecial(info + 1), &paramCount);
             return paramCount;
@@ -597,9 +680,39 @@ public:
          */
         Parameter listParameter() const
         {
+            if (record)
+            {
+                return Parameter(getBase(), record + 2, record[1]);
+            }
             return Parameter(skipDigits(skipSpecial(info + 1)));
         }
 
+        /**
+         * Gets the specified argument.
+         * @param n the argument number.
+         * @return an empty parameter if n is not less than the number of
+         * arguments.
+         */
+        Parameter getParameter(unsigned n) const
+        {
+            if (getParameterCount() <= n)
+            {
+                return Parameter();
+            }
+            if (record)
+            {
+                return Parameter(getBase(), record + 2 + 3 * (n + 1), record[1] - n - 1);
+            }
+            Parameter param = listParameter();
+            do {
+                if (!param.next())
+                {
+                    break;
+                }
+            } while (n-- != 0);
+            return param;
+        }
+
         static const char* skip(const char* info)
         {
             const char* p = skipSpecial(info + 1);
@@ -678,6 +791,16 @@ public:
         {
             return hasSpecial(kVariadic);
         }
+
+        bool isOneway() const
+        {
+            return hasSpecial(kOneway);
+        }
+
+        bool isOrdered() const
+        {
+            return hasSpecial(kOrdered);
+        }
     };
 
     /**
@@ -746,6 +869,7 @@ public:
     {
         const char* info;
         const char* qualifiedName;
+        const unsigned* index;
         int methodCount;
         int constantCount;
         int constructorCount;
@@ -774,6 +898,7 @@ public:
                 info = Method::skip(info);
                 break;
             }
+            return info;
         }
 
     public:
@@ -783,6 +908,7 @@ public:
         Interface() :
             info(0),
             qualifiedName(0),
+            index(0),
             methodCount(0),
             constantCount(0),
             constructorCount(0),
@@ -794,15 +920,24 @@ public:
          * Constructs a new object which represents the specified interface.
          * @param info the string encoded reflection data generated by esidl.
          * @param qualifiedName the qualified name of this interface.
+         * @param index the index of info generated by esidl, if any.
          */
-        Interface(const char* info, const char* qualifiedName = 0) :
+        Interface(const char* info, const char* qualifiedName = 0, const unsigned* index = 0) :
             info(info),
             qualifiedName(qualifiedName),
+            index(index),
             methodCount(0),
             constantCount(0),
             constructorCount(0),
             inheritedMethodCount(0)
         {
+            if (index)
+            {
+                methodCount = index[0];
+                constantCount = index[1];
+                constructorCount = index[2];
+                return;
+            }
             // TODO: Validate info and qualifiedName
             const char* p = info;
             // skip I
@@ -852,6 +987,7 @@ public:
         Interface(const Interface& interface) :
             info(interface.info),
             qualifiedName(interface.qualifiedName),
+            index(interface.index),
             methodCount(interface.methodCount),
             constantCount(interface.constantCount),
             constructorCount(interface.constructorCount),
@@ -937,6 +1073,15 @@ public:
          */
         Method getMethod(unsigned n) const
         {
+            if (index)
+            {
+                if (getMethodCount() <= n)
+                {
+                    return Method();
+                }
+                const unsigned* record = index + index[3 + n];
+                return Method(info + record[0], record);
+            }
             const char* p = info;
             while (p)
             {
@@ -970,6 +1115,14 @@ public:
          */
         Constant getConstant(unsigned n) const
         {
+            if (index)
+            {
+                if (getConstantCount() <= n)
+                {
+                    return Constant();
+                }
+                return Constant(info + index[3 + methodCount + constructorCount + n]);
+            }
             const char* p = info;
             while (p)
             {
@@ -1002,6 +1155,15 @@ public:
          */
         Method getConstructor(unsigned n) const
         {
+            if (index)
+            {
+                if (getConstructorCount() <= n)
+                {
+                    return Method();
+                }
+                const unsigned* record = index + index[3 + methodCount + n];
+                return Method(info + record[0], record);
+            }
             const char* p = info;
             while (p)
             {
@@ -1032,6 +1194,15 @@ public:
             inheritedMethodCount = count;
         }
 
+        /**
+         * Gets the index of the meta-data.
+         * @return zero if this interface is not indexed.
+         */
+        const unsigned* getIndex() const
+        {
+            return index;
+        }
+
         const char* getMetaData() const
         {
             return qualifiedName ? qualifiedName : info;  // TODO: should return info, but qualifiedName is still used in the interfaceStore classes
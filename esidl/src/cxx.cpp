@@ -15,9 +15,104 @@
  * limitations under the License.
  */
 
+#include <vector>
 #include "cxx.h"
 #include "info.h"
 
+namespace
+{
+
+// Hashes the interface identifier in the same way as es::hashIid() does.
+unsigned hashIid(const char* iid)
+{
+    unsigned hash = 2166136261u;
+    while (*iid)
+    {
+        hash ^= static_cast<unsigned char>(*iid++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Appends the record of the method at p to the index of info.
+void indexMethod(const char* info, const char* p, std::vector<unsigned>* record)
+{
+    unsigned count;
+    const char* q = Reflect::skipDigits(Reflect::Method::skipSpecial(p + 1), &count);
+    record->push_back(p - info);
+    record->push_back(count);
+    for (unsigned i = 0; i <= count; ++i)  // the return value, then the parameters
+    {
+        unsigned length;
+        const char* name = Reflect::skipDigits(Reflect::skipType(q), &length);
+        record->push_back(q - info);
+        record->push_back(name - info);
+        record->push_back(length);
+        q = name + length;
+    }
+}
+
+// Builds the index of the string-encoded interface information described in
+// reflect.h as the rows to write, i.e., the counts, the records of the methods
+// and the constructors, the offsets of the constants, and each record.
+void indexInfo(const char* info, std::vector<std::vector<unsigned> >* rows)
+{
+    std::vector<const char*> methods;
+    std::vector<const char*> constructors;
+    std::vector<unsigned> constants;
+    const char* p = Reflect::skipName(info + 1);
+    while (*p == Reflect::kExtends || *p == Reflect::kImplements)
+    {
+        p = Reflect::skipName(p + 1);
+    }
+    while (p && *p)
+    {
+        const char* next;
+        switch (*p)
+        {
+        case Reflect::kConstant:
+            next = Reflect::Constant::skip(p);
+            if (next)
+            {
+                constants.push_back(p - info);
+            }
+            break;
+        case Reflect::kOperation:
+        case Reflect::kSetter:
+        case Reflect::kGetter:
+            next = Reflect::Method::skip(p);
+            methods.push_back(p);
+            break;
+        case Reflect::kConstructor:
+            next = Reflect::Method::skip(p);
+            constructors.push_back(p);
+            break;
+        default:
+            next = 0;
+            break;
+        }
+        p = next;
+    }
+    methods.insert(methods.end(), constructors.begin(), constructors.end());
+
+    rows->clear();
+    rows->resize(3);
+    (*rows)[0].push_back(methods.size() - constructors.size());
+    (*rows)[0].push_back(constants.size());
+    (*rows)[0].push_back(constructors.size());
+    (*rows)[2] = constants;
+    unsigned offset = 3 + methods.size() + constants.size();
+    for (std::vector<const char*>::iterator i = methods.begin(); i != methods.end(); ++i)
+    {
+        (*rows)[1].push_back(offset);
+        rows->push_back(std::vector<unsigned>());
+        indexMethod(info, *i, &rows->back());
+        offset += rows->back().size();
+    }
+}
+
+}  // namespace
+
 class CxxInterface : public Cxx
 {
     bool useVirtualBase;
@@ -129,6 +224,7 @@ public:
                         name.c_str());
                 writeln("return name;");
             writeln("}");
+            writeln("static const unsigned iidHash = 0x%08xu;", hashIid(name.c_str()));
 
             writeln("static const char* info() {");
                 writetab();
@@ -143,6 +239,29 @@ public:
                 writeln("return info;");
             writeln("}");
 
+            std::vector<std::vector<unsigned> > rows;
+            indexInfo(info.getInfo().c_str(), &rows);
+            writeln("static const unsigned* infoIndex() {");
+                writeln("static const unsigned index[] = {");
+                for (std::vector<std::vector<unsigned> >::iterator i = rows.begin();
+                     i != rows.end();
+                     ++i)
+                {
+                    if (i->empty())
+                    {
+                        continue;
+                    }
+                    writetab();
+                    for (std::vector<unsigned>::iterator j = i->begin(); j != i->end(); ++j)
+                    {
+                        write((j == i->begin()) ? "%u" : ", %u", *j);
+                    }
+                    write(",\n");
+                }
+                writeln("};");
+                writeln("return index;");
+            writeln("}");
+
             if (Interface* constructor = node->getConstructor())
             {
                 // Process constructors.
@@ -89,6 +89,7 @@ int main(int argc, char* argv[])
     bool version = false;
     bool skeleton = false;
     bool generic = false;
+    bool stub = false;
     bool isystem = false;
     bool useExceptions = true;
     bool useVirtualBase = false;
@@ -226,6 +227,10 @@ int main(int argc, char* argv[])
                 ++i;
                 stringTypeName = argv[i];
             }
+            else if (strcmp(argv[i], "-stub") == 0)
+            {
+                stub = true;
+            }
             else if (strcmp(argv[i], "--version") == 0)
             {
                 version = true;
@@ -443,7 +448,7 @@ int main(int argc, char* argv[])
             }
             result = output(argv[i], isystem, useExceptions, useVirtualBase,
                             stringTypeName, objectTypeName, indent,
-                            skeleton, generic);
+                            skeleton, generic, stub);
         }
     }
     return result;
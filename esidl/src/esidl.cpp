@@ -495,6 +495,10 @@ void Interface::processExtendedAttributes()
         {
             attr |= OverrideBuiltins;
         }
+        else if (ext->getName() == "Ordered")
+        {
+            attr |= Ordered;
+        }
         else if (ext->getName() == "Supplemental")
         {
             attr |= Supplemental;
@@ -637,16 +641,23 @@ void OpDcl::processExtendedAttributes()
     {
         ExtendedAttribute* ext = dynamic_cast<ExtendedAttribute*>(*i);
         assert(ext);
-        if (ext->getName() == "Null" ||
-            ext->getName() == "Undefined" ||
-            ext->getName() == "IndexCreator" ||
-            ext->getName() == "IndexDeleter" ||
-            ext->getName() == "IndexGetter" ||
-            ext->getName() == "IndexSetter" ||
-            ext->getName() == "NameCreator" ||
-            ext->getName() == "NameDeleter" ||
-            ext->getName() == "NameGetter" ||
-            ext->getName() == "NameSetter")
+        if (ext->getName() == "Oneway")
+        {
+            // Nothing can be returned to the caller that does not wait.
+            ext->check(getSpec()->isVoid(getParent()) && !getRaises(),
+                       "[Oneway] operation '%s' must return void and raise no exceptions.", getName().c_str());
+            attr |= Oneway;
+        }
+        else if (ext->getName() == "Null" ||
+                 ext->getName() == "Undefined" ||
+                 ext->getName() == "IndexCreator" ||
+                 ext->getName() == "IndexDeleter" ||
+                 ext->getName() == "IndexGetter" ||
+                 ext->getName() == "IndexSetter" ||
+                 ext->getName() == "NameCreator" ||
+                 ext->getName() == "NameDeleter" ||
+                 ext->getName() == "NameGetter" ||
+                 ext->getName() == "NameSetter")
         {
             ext->report("Warning: '%s' has been deprecated.", ext->getName().c_str());
         }
@@ -1093,7 +1104,8 @@ int output(const char* filename,
            const char* objectTypeName,
            const char* indent,
            bool skeleton,
-           bool generic)
+           bool generic,
+           bool stub)
 {
     Forward forward(filename);
     getSpecification()->accept(&forward);
@@ -1108,5 +1120,9 @@ int output(const char* filename,
     {
         printTemplate(filename, stringTypeName, objectTypeName, useExceptions, isystem, indent);
     }
+    if (stub)
+    {
+        printStub(filename, stringTypeName, objectTypeName, useExceptions, isystem, indent);
+    }
     return EXIT_SUCCESS;
 }
@@ -1557,14 +1557,11 @@ AbsoluteScopedName :
             }
             else
             {
-                if ($3)
-                {
-                    $$ = $3;
-                }
-                else
-                {
-                    $$ = new ScopedName($2);
-                }
+                // Keep the name absolute in the flat namespace so that it is
+                // not taken for a member of the same name in the scope.
+                ScopedName* name = $3 ? static_cast<ScopedName*>($3) : new ScopedName($2);
+                name->getName() = std::string("::") + Node::getFlatNamespace() + "::" + name->getName();
+                $$ = name;
             }
             free($2);
         }
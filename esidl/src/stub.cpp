@@ -0,0 +1,690 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Generates the typed RPC proxies and skeletons used with es/rpcStub.h.
+// A method is marshaled by the generated code if its parameters are the
+// scalars or the strings and it returns a scalar or nothing. The other
+// methods are left to the reflective path. A marshaled method also gets an
+// overload taking an RpcFuture* to be called asynchronously unless it is
+// [Oneway], which is never waited on.
+
+#include "cxx.h"
+
+#include <vector>
+
+namespace
+{
+
+// Gets the fixed-width type of the value an Any holds for spec, or zero if
+// spec is not a scalar type.
+const char* getAnyType(const Node* spec, const Node* scope)
+{
+    if (spec->isBoolean(scope))
+    {
+        return "bool";
+    }
+    if (spec->isOctet(scope))
+    {
+        return "uint8_t";
+    }
+    if (spec->isShort(scope))
+    {
+        return "int16_t";
+    }
+    if (spec->isUnsignedShort(scope))
+    {
+        return "uint16_t";
+    }
+    if (spec->isLong(scope))
+    {
+        return "int32_t";
+    }
+    if (spec->isUnsignedLong(scope))
+    {
+        return "uint32_t";
+    }
+    if (spec->isLongLong(scope))
+    {
+        return "int64_t";
+    }
+    if (spec->isUnsignedLongLong(scope))
+    {
+        return "uint64_t";
+    }
+    if (spec->isFloat(scope))
+    {
+        return "float";
+    }
+    if (spec->isDouble(scope))
+    {
+        return "double";
+    }
+    return 0;
+}
+
+}  // namespace
+
+class StubImport : public Visitor
+{
+    const char* source;
+    FILE* file;
+
+public:
+    StubImport(const char* source, FILE* file) :
+        source(source),
+        file(file)
+    {
+    }
+
+    virtual void at(const Node* node)
+    {
+        visitChildren(node);
+    }
+
+    virtual void at(const Include* node)
+    {
+        if (!node->isDefinedIn(source))
+        {
+            return;
+        }
+        if (node->isSystem())
+        {
+            fprintf(file, "#include <%s>\n", getOutputFilename(node->getName().c_str(), "stub.h").c_str());
+        }
+        else
+        {
+            fprintf(file, "#include \"%s\"\n", getOutputFilename(node->getName().c_str(), "stub.h").c_str());
+        }
+    }
+};
+
+class StubVisitor : public Cxx
+{
+    // A method in the vtable of the interface.
+    struct Method
+    {
+        std::string name;               // C++ method name
+        Node* spec;                     // result
+        const Node* scope;              // to resolve spec
+        std::vector<std::string> names; // parameter names
+        std::vector<Node*> specs;       // parameter types
+        std::vector<const Node*> scopes;
+        bool variadic;
+        bool oneway;
+        std::string arguments;          // C++ arguments, for the reflective path
+
+        Method(const std::string& name, Node* spec, const Node* scope) :
+            name(name),
+            spec(spec),
+            scope(scope),
+            variadic(false),
+            oneway(false)
+        {
+        }
+
+        void addParam(const std::string& name, Node* spec, const Node* scope)
+        {
+            names.push_back(name);
+            specs.push_back(spec);
+            scopes.push_back(scope);
+        }
+
+        void addArgument(const std::string& name)
+        {
+            if (!arguments.empty())
+            {
+                arguments += ", ";
+            }
+            arguments += name;
+        }
+    };
+
+    bool skeleton;          // true while generating the skeleton
+    unsigned methodNumber;  // from BASE
+    std::string interfaceName;
+
+    bool isString(const Node* spec, const Node* scope)
+    {
+        return !hasCustomStringType() && spec->isString(scope);
+    }
+
+    // true if the generated code marshals the method
+    bool isTyped(const Method& method)
+    {
+        if (method.variadic)
+        {
+            return false;
+        }
+        if (!method.spec->isVoid(method.scope) && !getAnyType(method.spec, method.scope))
+        {
+            return false;
+        }
+        for (unsigned i = 0; i < method.specs.size(); ++i)
+        {
+            if (!getAnyType(method.specs[i], method.scopes[i]) &&
+                !isString(method.specs[i], method.scopes[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Adds the buffer arguments for the result.
+    void addResultArguments(Method& method, const std::string& name)
+    {
+        Node* spec = method.spec;
+        if (SequenceType* seq = const_cast<SequenceType*>(spec->isSequence(method.scope)))
+        {
+            method.addArgument(name);
+            if (!seq->getMax())
+            {
+                method.addArgument(name + "Length");
+            }
+        }
+        else if (isString(spec, method.scope) || spec->isAny(method.scope))
+        {
+            method.addArgument(name);
+            method.addArgument(name + "Length");
+        }
+        else if (spec->isArray(method.scope))
+        {
+            method.addArgument(name);
+        }
+    }
+
+    void addParamArguments(Method& method, const std::string& name, Node* spec, const Node* scope)
+    {
+        method.addArgument(name);
+        if (SequenceType* seq = const_cast<SequenceType*>(spec->isSequence(scope)))
+        {
+            if (!seq->getMax())
+            {
+                method.addArgument(name + "Length");
+            }
+        }
+    }
+
+    // Marshals the arguments into _msg and _iov.
+    void writeMarshal(const Method& method)
+    {
+        unsigned argc = 1 + method.specs.size();   // +1 for 'this'
+        unsigned iovcnt = 1;
+        writeln("::es::RpcMessage<%u> _msg;", argc);
+        writeln("_msg.req.methodNumber = BASE + %u;", methodNumber);
+        writeln("_msg.req.paramCount = %u;", argc);
+        writeln("_msg.argv[0] = Any(static_cast<intptr_t>(0));");
+        for (unsigned i = 0; i < method.specs.size(); ++i)
+        {
+            if (const char* type = getAnyType(method.specs[i], method.scopes[i]))
+            {
+                writeln("_msg.argv[%u] = Any(static_cast<%s>(%s));", i + 1, type, method.names[i].c_str());
+            }
+            else
+            {
+                writeln("_msg.argv[%u] = Any(%s);", i + 1, method.names[i].c_str());
+                ++iovcnt;
+            }
+        }
+        writeln("struct iovec _iov[%u];", iovcnt);
+        writeln("int _iovcnt = 1;");
+        for (unsigned i = 0; i < method.specs.size(); ++i)
+        {
+            if (getAnyType(method.specs[i], method.scopes[i]))
+            {
+                continue;
+            }
+            const char* name = method.names[i].c_str();
+            writeln("if (%s) {", name);
+                writeln("_iov[_iovcnt].iov_base = const_cast<char*>(%s);", name);
+                writeln("_iov[_iovcnt].iov_len = strlen(%s) + 1;", name);
+                writeln("++_iovcnt;");
+            writeln("}");
+        }
+    }
+
+    void writeTypedProxy(const Method& method)
+    {
+        writeMarshal(method);
+        if (method.oneway)
+        {
+            writeln("this->sendTyped(&_msg.req, _iov, _iovcnt, 0);");
+        }
+        else if (method.spec->isVoid(method.scope))
+        {
+            writeln("this->callTyped(&_msg.req, _iov, _iovcnt);");
+        }
+        else
+        {
+            writeln("return static_cast<%s>(this->callTyped(&_msg.req, _iov, _iovcnt));",
+                    getAnyType(method.spec, method.scope));
+        }
+    }
+
+    // Writes the overload that sends the request and returns at once.
+    void writeAsyncProxy(const Method& method)
+    {
+        std::string params = "::es::RpcFuture* _future";
+        for (unsigned i = 0; i < method.specs.size(); ++i)
+        {
+            const char* type = getAnyType(method.specs[i], method.scopes[i]);
+            params += ", ";
+            params += type ? type : "const char*";
+            params += " " + method.names[i];
+        }
+        writeln("void %s(%s) {", method.name.c_str(), params.c_str());
+            writeMarshal(method);
+            writeln("this->sendTyped(&_msg.req, _iov, _iovcnt, _future);");
+        writeln("}");
+    }
+
+    void writeReflectiveProxy(const Method& method)
+    {
+        Node* spec = method.spec;
+        const Node* scope = method.scope;
+        std::string arguments = method.arguments.empty() ? "" : ", " + method.arguments;
+        const char* args = arguments.c_str();
+
+        if (spec->isVoid(scope) || spec->isArray(scope))
+        {
+            writeln("this->callReflect(0, BASE + %u%s);", methodNumber, args);
+        }
+        else if (spec->isAny(scope))
+        {
+            writeln("Any _result;");
+            writeln("this->callReflect(&_result, BASE + %u%s);", methodNumber, args);
+            writeln("return _result;");
+        }
+        else if (spec->isSequence(scope))
+        {
+            writeln("return static_cast<int>(this->callReflect(0, BASE + %u%s));", methodNumber, args);
+        }
+        else if (isString(spec, scope))
+        {
+            writeln("return reinterpret_cast<const char*>(static_cast<intptr_t>(this->callReflect(0, BASE + %u%s)));",
+                    methodNumber, args);
+        }
+        else if (spec->isInterface(scope))
+        {
+            writetab();
+            write("return reinterpret_cast<");
+            spec->accept(this);
+            write("*>(static_cast<intptr_t>(this->callReflect(0, BASE + %u%s)));\n", methodNumber, args);
+        }
+        else if (NativeType* nativeType = spec->isNative(scope))
+        {
+            writetab();
+            write("return reinterpret_cast<");
+            nativeType->accept(this);
+            write(">(static_cast<intptr_t>(this->callReflect(0, BASE + %u%s)));\n", methodNumber, args);
+        }
+        else if (const char* type = getAnyType(spec, scope))
+        {
+            writeln("return static_cast<%s>(this->callReflect(0, BASE + %u%s));", type, methodNumber, args);
+        }
+        else
+        {
+            writetab();
+            write("return static_cast<");
+            spec->accept(this);
+            write(">(this->callReflect(0, BASE + %u%s));\n", methodNumber, args);
+        }
+    }
+
+    void writeSkeleton(const Method& method)
+    {
+        if (!isTyped(method))
+        {
+            return;
+        }
+
+        writeln("case BASE + %u: {", methodNumber);
+        std::string call = "static_cast<" + interfaceName + "*>(self)->" + method.name + "(";
+        for (unsigned i = 0; i < method.specs.size(); ++i)
+        {
+            char arg[64];
+            if (const char* type = getAnyType(method.specs[i], method.scopes[i]))
+            {
+                snprintf(arg, sizeof arg, "static_cast<%s>(argv[%u])", type, i + 1);
+            }
+            else
+            {
+                // Take the strings in order from the data, leaving the
+                // request to the reflective path to reject if one is not
+                // terminated.
+                writeln("const char* arg%u;", i + 1);
+                writeln("if (!::es::RpcSkeleton<Self>::getString(argv[%u], data, size, arg%u)) {", i + 1, i + 1);
+                writeln("return false;");
+                writeln("}");
+                snprintf(arg, sizeof arg, "arg%u", i + 1);
+            }
+            if (i)
+            {
+                call += ", ";
+            }
+            call += arg;
+        }
+        call += ")";
+        if (method.spec->isVoid(method.scope))
+        {
+            writeln("%s;", call.c_str());
+        }
+        else
+        {
+            writeln("*result = Any(static_cast<%s>(%s));", getAnyType(method.spec, method.scope), call.c_str());
+        }
+        writeln("return true;");
+        writeln("}");
+    }
+
+    void writeMethod(const Method& method)
+    {
+        if (skeleton)
+        {
+            writeSkeleton(method);
+        }
+        else
+        {
+            write(" {\n");
+                if (isTyped(method))
+                {
+                    writeTypedProxy(method);
+                }
+                else
+                {
+                    writeReflectiveProxy(method);
+                }
+            writeln("}");
+            if (isTyped(method) && !method.oneway)
+            {
+                writeAsyncProxy(method);
+            }
+        }
+        ++methodNumber;
+    }
+
+    void visitInterfaceElements(const Interface* node)
+    {
+        std::list<const Interface*> interfaceList;
+        node->collectSupplementals(&interfaceList);
+        methodNumber = 0;
+        for (std::list<const Interface*>::const_iterator i = interfaceList.begin();
+             i != interfaceList.end();
+             ++i)
+        {
+            for (NodeList::iterator j = (*i)->begin(); j != (*i)->end(); ++j)
+            {
+                if (Attribute* attr = dynamic_cast<Attribute*>(*j))
+                {
+                    attr->accept(this);
+                }
+                else if (OpDcl* op = dynamic_cast<OpDcl*>(*j))
+                {
+                    optionalStage = 0;
+                    do
+                    {
+                        optionalCount = 0;
+                        op->accept(this);
+                        ++optionalStage;
+                    } while (optionalStage <= optionalCount);
+                }
+            }
+        }
+    }
+
+    std::string getSuperName(const Interface* node, const char* suffix, const char* root)
+    {
+        const Interface* super = node->getSuper();
+        if (!super || super->isBaseObject())
+        {
+            return root;
+        }
+        std::string name = getInterfaceName(super->getQualifiedName());
+        name = getScopedName(moduleName, name);
+        return name + suffix;
+    }
+
+public:
+    StubVisitor(const char* source, FILE* file, const char* stringTypeName = "char*", const char* objectTypeName = "object",
+                bool useExceptions = true, const char* indent = "es") :
+        Cxx(source, file, stringTypeName, objectTypeName, useExceptions, indent),
+        skeleton(false),
+        methodNumber(0)
+    {
+    }
+
+    virtual void at(const Module* node)
+    {
+        if (0 < node->getName().size())
+        {
+            write("namespace %s {\n", node->getName().c_str());
+                moduleName += "::";
+                moduleName += node->getName();
+        }
+        for (NodeList::iterator i = node->begin(); i != node->end(); ++i)
+        {
+            if (!(*i)->isDefinedIn(source))
+            {
+                continue;
+            }
+            if (dynamic_cast<Module*>(*i) || dynamic_cast<Interface*>(*i))
+            {
+                (*i)->accept(this);
+            }
+        }
+        if (0 < node->getName().size())
+        {
+                moduleName.erase(moduleName.size() - node->getName().size() - 2);
+            writeln("}");
+        }
+    }
+
+    virtual void at(const Interface* node)
+    {
+        if (node->getAttr() & Interface::Supplemental)
+        {
+            return;
+        }
+        if (!node->isDefinedIn(source) || node->isLeaf() || node->isBaseObject())
+        {
+            return;
+        }
+
+        interfaceName = node->getName();
+        const Node* saved = currentNode;
+        currentNode = node;
+
+        // Proxy
+        std::string super = getSuperName(node, "_Proxy<ProxyBase>", "ProxyBase");
+        skeleton = false;
+        writeln("template<class ProxyBase>");
+        writetab();
+        write("class %s_Proxy : public %s {\n", interfaceName.c_str(), super.c_str());
+        unindent();
+        writeln("public:");
+        indent();
+        writeln("static const unsigned BASE = %s::METHOD_COUNT;", super.c_str());
+        writeln("%s_Proxy(unsigned interfaceNumber) : %s(interfaceNumber) {", interfaceName.c_str(), super.c_str());
+        writeln("}");
+        visitInterfaceElements(node);
+        writeln("static const unsigned METHOD_COUNT = BASE + %u;", methodNumber);
+        writeln("};");
+
+        // Skeleton
+        super = getSuperName(node, "_Skeleton<Self>", "::es::RpcSkeleton<Self>");
+        skeleton = true;
+        writeln("template<class Self = %s>", interfaceName.c_str());
+        writetab();
+        write("class %s_Skeleton : public %s {\n", interfaceName.c_str(), super.c_str());
+        unindent();
+        writeln("public:");
+        indent();
+        writeln("static const unsigned BASE = %s::METHOD_COUNT;", super.c_str());
+        writeln("static bool dispatch(Self* self, unsigned methodNumber, Any* argv, u8* data, size_t size, Any* result) {");
+        writeln("switch (methodNumber) {");
+        unindent();     // Put the labels at the level of the switch.
+        visitInterfaceElements(node);
+        writeln("default:");
+        indent();
+        writeln("return %s::dispatch(self, methodNumber, argv, data, size, result);", super.c_str());
+        writeln("}");
+        writeln("}");
+        writeln("static const unsigned METHOD_COUNT = BASE + %u;", methodNumber);
+        writeln("};");
+
+        currentNode = saved;
+    }
+
+    virtual void at(const Attribute* node)
+    {
+        static Type replaceable("any");
+        static Type voidType("void");
+        static Type longType("long");
+        Node* spec = node->getSpec();
+        const Node* scope = node->getParent();
+        if (node->isReplaceable())
+        {
+            spec = &replaceable;
+        }
+        std::string cap = node->getName();
+        cap[0] = toupper(cap[0]);   // XXX
+        std::string name = getBufferName(node);
+
+        // getter
+        {
+            Method method("get" + cap, spec, scope);
+            addResultArguments(method, name);
+            if (!skeleton)
+            {
+                writetab();
+                Cxx::getter(node);
+            }
+            writeMethod(method);
+        }
+
+        // setter
+        if (node->isReadonly() && !node->isPutForwards() && !node->isReplaceable())
+        {
+            return;
+        }
+        if (node->isPutForwards())
+        {
+            Interface* target = dynamic_cast<Interface*>(dynamic_cast<ScopedName*>(spec)->search(scope));
+            assert(target);
+            Attribute* forwards = dynamic_cast<Attribute*>(target->search(node->getPutForwards()));
+            assert(forwards);
+            spec = forwards->getSpec();
+            scope = target;
+        }
+        {
+            // A setter of a sequence returns the number of the elements set.
+            Method method("set" + cap, spec->isSequence(scope) ? &longType : &voidType, scope);
+            method.addParam(name, spec, scope);
+            addParamArguments(method, name, spec, scope);
+            if (!skeleton)
+            {
+                writetab();
+                Cxx::setter(node);
+            }
+            writeMethod(method);
+        }
+    }
+
+    virtual void at(const OpDcl* node)
+    {
+        Method method(node->getName(), node->getSpec(), node->getParent());
+        method.oneway = node->isOneway();
+        addResultArguments(method, getBufferName(node->getSpec()));
+
+        // Count the parameters of this optional stage as Cxx::at() does.
+        int optional = 0;
+        for (NodeList::iterator i = node->begin(); i != node->end(); ++i)
+        {
+            ParamDcl* param = dynamic_cast<ParamDcl*>(*i);
+            assert(param);
+            if (param->isOptional())
+            {
+                ++optional;
+                if (optionalStage < optional)
+                {
+                    break;
+                }
+            }
+            if (param->isVariadic())
+            {
+                method.variadic = true;
+                method.addArgument(param->getName());
+                method.addArgument(param->getName() + "Length");
+            }
+            else
+            {
+                addParamArguments(method, param->getName(), param->getSpec(), param->getParent());
+            }
+            method.addParam(param->getName(), param->getSpec(), param->getParent());
+        }
+
+        if (skeleton)
+        {
+            optionalCount = optional;
+        }
+        else
+        {
+            writetab();
+            Cxx::at(node);
+        }
+        writeMethod(method);
+    }
+};
+
+void printStub(const char* source, const char* stringTypeName, const char* objectTypeName,
+               bool useExceptions, bool isystem, const char* indent)
+{
+    std::string filename = getOutputFilename(source, "stub.h");
+    printf("# %s\n", filename.c_str());
+
+    FILE* file = fopen(filename.c_str(), "w");
+    if (!file)
+    {
+        return;
+    }
+
+    std::string included = Cxx::getIncludedName(filename, indent);
+    fprintf(file, "// Generated by esidl %s.\n\n", PACKAGE_VERSION);
+    fprintf(file, "#ifndef %s\n", included.c_str());
+    fprintf(file, "#define %s\n\n", included.c_str());
+
+    fprintf(file, "#include <es/rpcStub.h>\n");
+    std::string header = getOutputFilename(source, "h");
+    if (isystem)
+    {
+        fprintf(file, "#include <%s>\n", header.c_str());
+    }
+    else
+    {
+        fprintf(file, "#include \"%s\"\n", header.c_str());
+    }
+    StubImport import(source, file);
+    getSpecification()->accept(&import);
+    fprintf(file, "\n");
+
+    StubVisitor visitor(source, file, stringTypeName, objectTypeName, useExceptions, indent);
+    getSpecification()->accept(&visitor);
+
+    fprintf(file, "#endif  // %s\n", included.c_str());
+
+    fclose(file);
+}
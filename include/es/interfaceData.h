@@ -23,6 +23,7 @@ namespace es
     {
         const char* (*iid)();
         const char* (*info)();
+        const unsigned* (*infoIndex)();
     };
 
     extern InterfaceData interfaceData[];
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_INTERFACE_TABLE_H_INCLUDED
+#define GOOGLE_ES_INTERFACE_TABLE_H_INCLUDED
+
+#include <string.h>
+#include <es/object.h>
+
+namespace es
+{
+
+/** Hashes an interface identifier. esidl generates I::iidHash with the
+ *  same function for each interface I.
+ */
+inline unsigned hashIid(const char* iid)
+{
+    unsigned hash = 2166136261u;    // FNV-1a
+    while (*iid)
+    {
+        hash ^= static_cast<unsigned char>(*iid++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/** Fills the unused slots of an InterfaceTable.
+ */
+struct NoInterface
+{
+};
+
+template<class C, class I>
+struct InterfaceCast
+{
+    static Object* cast(C* self)
+    {
+        return static_cast<I*>(self);
+    }
+};
+
+template<class C>
+struct InterfaceCast<C, NoInterface>
+{
+    static Object* cast(C* self)
+    {
+        return 0;
+    }
+};
+
+template<class I>
+struct InterfaceName
+{
+    static const unsigned iidHash = I::iidHash;
+
+    static const char* iid()
+    {
+        return I::iid();
+    }
+};
+
+template<>
+struct InterfaceName<NoInterface>
+{
+    static const unsigned iidHash = 0;
+
+    static const char* iid()
+    {
+        return 0;
+    }
+};
+
+/** The interfaces implemented by the class C, which implements
+ *  queryInterface() as
+ *
+ *    return InterfaceTable<C, I0, I1, ...>::query(this, riid);
+ *
+ *  The table is built at compile time from the precomputed identifiers
+ *  and hashes. I0 is returned for Object. As the identifiers are unique
+ *  in a program, the identifier asked for is first looked up by the
+ *  pointer, and then by the hash for the ones from elsewhere, e.g., the
+ *  ones received over RPC.
+ */
+template<class C,
+         class I0,
+         class I1 = NoInterface, class I2 = NoInterface, class I3 = NoInterface,
+         class I4 = NoInterface, class I5 = NoInterface, class I6 = NoInterface,
+         class I7 = NoInterface>
+class InterfaceTable
+{
+    struct Entry
+    {
+        const char* (*iid)();
+        unsigned    hash;
+        Object*     (*cast)(C* self);
+    };
+
+    static const Entry* getEntries()
+    {
+        static const Entry entries[] =
+        {
+            { InterfaceName<I0>::iid, InterfaceName<I0>::iidHash, InterfaceCast<C, I0>::cast },
+            { Object::iid, Object::iidHash, InterfaceCast<C, I0>::cast },
+            { InterfaceName<I1>::iid, InterfaceName<I1>::iidHash, InterfaceCast<C, I1>::cast },
+            { InterfaceName<I2>::iid, InterfaceName<I2>::iidHash, InterfaceCast<C, I2>::cast },
+            { InterfaceName<I3>::iid, InterfaceName<I3>::iidHash, InterfaceCast<C, I3>::cast },
+            { InterfaceName<I4>::iid, InterfaceName<I4>::iidHash, InterfaceCast<C, I4>::cast },
+            { InterfaceName<I5>::iid, InterfaceName<I5>::iidHash, InterfaceCast<C, I5>::cast },
+            { InterfaceName<I6>::iid, InterfaceName<I6>::iidHash, InterfaceCast<C, I6>::cast },
+            { InterfaceName<I7>::iid, InterfaceName<I7>::iidHash, InterfaceCast<C, I7>::cast },
+            { InterfaceName<NoInterface>::iid, 0, InterfaceCast<C, NoInterface>::cast }
+        };
+        return entries;
+    }
+
+public:
+    /** Gets the interface riid of self without adding a reference.
+     *  @return zero if C does not implement riid.
+     */
+    static Object* find(C* self, const char* riid)
+    {
+        const Entry* entries = getEntries();
+        const Entry* entry;
+        for (entry = entries; entry->iid(); ++entry)
+        {
+            if (entry->iid() == riid)
+            {
+                return entry->cast(self);
+            }
+        }
+        unsigned hash = hashIid(riid);
+        for (entry = entries; entry->iid(); ++entry)
+        {
+            if (entry->hash == hash && strcmp(entry->iid(), riid) == 0)
+            {
+                return entry->cast(self);
+            }
+        }
+        return 0;
+    }
+
+    /** Implements queryInterface() of C.
+     */
+    static Object* query(C* self, const char* riid)
+    {
+        Object* object = find(self, riid);
+        if (object)
+        {
+            object->addRef();
+        }
+        return object;
+    }
+};
+
+/** Checks if riid identifies the interface I. Used for the interfaces a
+ *  class implements only in some states, which are not in its table.
+ */
+template<class I>
+inline bool isInterface(const char* riid)
+{
+    return riid == I::iid() || strcmp(riid, I::iid()) == 0;
+}
+
+}   // namespace es
+
+#endif  // GOOGLE_ES_INTERFACE_TABLE_H_INCLUDED
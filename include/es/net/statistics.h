@@ -0,0 +1,84 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_NET_STATISTICS_H_INCLUDED
+#define GOOGLE_ES_NET_STATISTICS_H_INCLUDED
+
+#include <es/types.h>
+
+// The statistics filled in by es::Socket::getStatistics() and
+// es::InternetConfig::getStatistics(). esidl does not take structures, so
+// the interfaces pass them as void_pointer.
+
+namespace es
+{
+
+/** The statistics of a socket. The members for the round trip time,
+ * the retransmissions and the congestion control are zero unless
+ * the socket is a stream socket. The times are in 100 nanosecond
+ * units.
+ */
+struct SocketStatistics
+{
+    s64 roundTripTime;          // The smoothed round trip time.
+    s64 roundTripTimeVariance;  // The mean deviation of the round trip time.
+    s64 retransmissionTimeout;  // The current retransmission timeout.
+    s32 congestionWindow;       // The congestion window in octets.
+    s32 slowStartThreshold;     // The slow start threshold in octets.
+    s32 maxSegmentSize;         // The maximum segment size in octets.
+    u32 retransmits;            // The number of segments retransmitted.
+    u32 recoveries;             // The number of losses recovered by fast retransmit and SACK.
+    u32 timeouts;               // The number of retransmission timeouts.
+    u64 inOctets;               // The total number of octets received in order.
+    u64 outOctets;              // The total number of octets acknowledged, or sent by a datagram socket.
+    u32 inDiscards;             // The number of datagrams discarded as the receive buffer was full.
+    s32 receiveQueued;          // The number of octets in the receive buffer.
+    s32 sendQueued;             // The number of octets in the send buffer.
+};
+
+/** The statistics of the TCP/IP network subsystem, as defined in
+ * the IP-MIB [RFC 4293], the TCP-MIB [RFC 4022] and the UDP-MIB
+ * [RFC 4113].
+ */
+struct InternetStatistics
+{
+    u64 ipInReceives;     // The number of IPv4 datagrams received.
+    u64 ipInHdrErrors;    // The number of datagrams discarded due to errors in their headers.
+    u64 ipInDiscards;     // The number of datagrams discarded for other reasons.
+    u64 ipInDelivers;     // The number of datagrams delivered to the upper layers.
+    u64 ipOutRequests;    // The number of datagrams passed down from the upper layers.
+    u64 ipOutDiscards;    // The number of outbound datagrams discarded.
+    u64 ipReasmReqds;     // The number of fragments received.
+    u64 ipReasmOKs;       // The number of datagrams reassembled.
+    u64 ipReasmFails;     // The number of datagrams that failed to be reassembled.
+    u64 ipFragOKs;        // The number of datagrams fragmented.
+    u64 ipFragCreates;    // The number of fragments created.
+    u64 tcpActiveOpens;   // The number of connections initiated.
+    u64 tcpPassiveOpens;  // The number of connections accepted.
+    u64 tcpInSegs;        // The number of segments received.
+    u64 tcpInErrs;        // The number of segments discarded due to errors.
+    u64 tcpOutSegs;       // The number of segments sent, excluding retransmissions.
+    u64 tcpRetransSegs;   // The number of segments retransmitted.
+    u64 tcpOutRsts;       // The number of segments sent with RST.
+    u64 udpInDatagrams;   // The number of datagrams delivered to sockets.
+    u64 udpNoPorts;       // The number of datagrams without a socket for the port.
+    u64 udpInErrors;      // The number of datagrams discarded due to errors or full buffers.
+    u64 udpOutDatagrams;  // The number of datagrams sent.
+};
+
+}   // namespace es
+
+#endif  // GOOGLE_ES_NET_STATISTICS_H_INCLUDED
@@ -20,7 +20,6 @@
 
 #include <es.h>
 #include <es/endian.h>
-#include <es/ring.h>
 
 //
 // TCP RFC 793
@@ -195,34 +194,25 @@ struct TCPOptSack
         s32 right;
     }   edge[1];
 
-    TCPOptSack(u8* head, long size, Ring::Vec* asb, s32 offset) :
-        kind(TCPHdr::OPT_SACK)
+    TCPOptSack() :
+        kind(TCPHdr::OPT_SACK),
+        len(2)
+    {
+    }
+
+    int getCount() const
+    {
+        return (len - 2) / 8;
+    }
+
+    // Appends a block. The option must be placed in a buffer large
+    // enough for the blocks added.
+    void add(TCPSeq left, TCPSeq right)
     {
-        Ring::Vec* block;
-        int i;
-        for (block = &asb[TCPHdr::ASB_MAX - 1], i = 0; asb <= block; --block, ++i)
-        {
-            if (block->data)
-            {
-                s32 left;
-                s32 right;
-
-                if (head <= block->data)
-                {
-                    left = (u8*) block->data - head;
-                }
-                else
-                {
-                    left = (u8*) block->data + size - head;
-                }
-                left += offset;
-                right = left + block->count;
-
-                edge[i].left = htonl(left);
-                edge[i].right = htonl(right);
-            }
-        }
-        len = 8 * i + 2;
+        int i = getCount();
+        edge[i].left = htonl(left);
+        edge[i].right = htonl(right);
+        len += 8;
     }
 };
 
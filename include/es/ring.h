@@ -124,6 +124,22 @@ public:
      */
     long write(const void* src, long count, long offset, Vec* blocks, long maxblock);
 
+    /** Writes data beyond the filled bytes in this ring buffer. The data
+     * is not filled until fill() is called.
+     * @param src       the data to be written.
+     * @param count     the length of the data in bytes.
+     * @param offset    the position from the tail of the filled bytes.
+     * @return          the length of the data written
+     */
+    long poke(const void* src, long count, long offset);
+
+    /** Fills the bytes after the tail of the filled bytes that have been
+     * written by poke().
+     * @param count     the number of bytes to be filled.
+     * @return          the number of bytes filled
+     */
+    long fill(long count);
+
     /**
      * Gets the number of filled bytes in this ring buffer.
      * @return the number of filled bytes.
@@ -62,6 +62,7 @@ struct CmdChanReq
     int                 cmd;     // CMD_CHAN_REQ
     int                 pid;
     int                 sockfd;
+    int                 ringfd;  // memfd of the shared memory rings, or -1
     Capability          cap;
     ThreadCredential    tc;
 };
@@ -71,6 +72,7 @@ struct CmdChanRes
     int                 cmd;     // CMD_CHAN_RES
     int                 pid;
     ThreadCredential    tc;
+    int                 ring;    // non-zero if the rings are mapped
 };
 
 struct CmdForkReq
@@ -114,6 +116,8 @@ union CmdUnion
 
 static const int RPC_REQ = 0;
 static const int RPC_RES = 1;
+static const int RPC_ONEWAY = 2;    // a request not to be replied
+static const int RPC_RELEASE = 3;   // the references released in a batch
 
 // RPC request header
 
@@ -146,6 +150,27 @@ struct RpcReq
     }
 };
 
+// The references to the objects exported by the receiver, which have been
+// released by the sender. A capability appears once per reference.
+struct RpcRelease
+{
+    int         cmd;    // RPC_RELEASE
+    int         tag;    // unused
+    int         pid;
+    unsigned    count;
+    // Capability capabilities[count];
+
+    Capability* getCapabilities()
+    {
+        return reinterpret_cast<Capability*>(this + 1);
+    }
+
+    size_t getSize() const
+    {
+        return sizeof(RpcRelease) + sizeof(Capability) * count;
+    }
+};
+
 // RPC response header
 struct RpcRes
 {
@@ -162,6 +187,20 @@ struct RpcRes
     }
 };
 
+// The statistics of the pool of the servant threads, which serves the
+// requests if the environment variable ES_RPC_POOL is set to the number of
+// the threads. The latency is the time a request waits in the pool before
+// a thread starts serving it.
+struct RpcPoolStats
+{
+    unsigned    threads;
+    unsigned    queued;         // the requests waiting now
+    u64         served;
+    u64         stolen;         // served by a thread other than the one it was queued to
+    u64         totalLatency;   // [ns]
+    u64         maxLatency;     // [ns]
+};
+
 class RpcStack
 {
     static const int RPC_STACK_SIZE = 1024 * 1024;
@@ -223,10 +262,89 @@ public:
     }
 };
 
+// The sequences of RPC_BULK_SIZE bytes or more, which would not fit in the
+// ring of an RpcChannel, are passed out of line. The sender puts the data in
+// a memfd and passes its file descriptor with the message in place of the
+// data, in the order of the arguments, and the receiver maps it. A result
+// of a method is written directly into a region shared the same way, whose
+// file descriptor is passed with the reply. Both sides tell an out of line
+// sequence by its size, which is known to both of them.
+static const size_t RPC_BULK_SIZE = 64 * 1024;
+
+class RpcBulk
+{
+    void*   data;
+    size_t  size;
+    int     fd;
+
+    RpcBulk(const RpcBulk&);
+    RpcBulk& operator=(const RpcBulk&);
+
+public:
+    RpcBulk() :
+        data(0),
+        size(0),
+        fd(-1)
+    {
+    }
+
+    ~RpcBulk()
+    {
+        unmap();
+    }
+
+    /** Maps the region of size bytes passed by the peer as fd, which is
+     *  closed. The region is private to this process.
+     *  @return zero if fd is not a region of size bytes or more sealed
+     *  against shrinking.
+     */
+    void* map(int fd, size_t size);
+
+    /** Creates a shared region of size bytes to be passed to the peer.
+     *  @return zero on failure.
+     */
+    void* allocate(size_t size);
+
+    /** Unmaps the region and closes its file descriptor.
+     */
+    void unmap();
+
+    /** Gets the file descriptor of the region created by allocate().
+     */
+    int getFd() const
+    {
+        return fd;
+    }
+
+    /** Creates a region holding a copy of data.
+     *  @return the file descriptor to be passed to the peer, or -1.
+     */
+    static int create(const void* data, size_t size);
+
+    /** Copies the first size bytes of the region passed by the peer as fd.
+     *  @return false if the region is shorter than size bytes or is not
+     *  sealed against shrinking.
+     */
+    static bool read(int fd, void* data, size_t size);
+};
+
 struct sockaddr* getSocketAddress(int pid, struct sockaddr_un* sa);
 ssize_t receiveCommand(int s, CmdUnion* cmd, int flags = 0);
+
+// Reads a message into the RpcStack. Returns zero if no valid message has
+// been read, with errno set to ECONNRESET if the peer has closed the
+// connection.
+RpcHdr* readMessage(int s, int* fdv, int*& fdmax, size_t* size = 0);
+
+// Checks the message of size bytes beginning with hdr is long enough for
+// its header.
+bool isValidMessage(const RpcHdr* hdr, size_t size);
 RpcHdr* receiveMessage(int epfd, int* fdv, int*& fdmax, int* s);
 
+// Gets the statistics of the pool of this process.
+// @return false if this process does not use the pool.
+bool getRpcPoolStats(RpcPoolStats* stats);
+
 void dump(const void* ptr, s32 len);
 
 }   // namespace es
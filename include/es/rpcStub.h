@@ -0,0 +1,321 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_RPC_STUB_H_INCLUDED
+#define GOOGLE_ES_RPC_STUB_H_INCLUDED
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <es.h>
+#include <es/any.h>
+#include <es/object.h>
+#include <es/rpc.h>
+#include <es/types.h>
+
+// The runtime of the typed proxies and skeletons generated by esidl -stub.
+//
+// For each interface Foo, esidl -stub generates
+//
+//   template<class ProxyBase> class Foo_Proxy;
+//   template<class Self = Foo> class Foo_Skeleton;
+//
+// Foo_Proxy<RpcProxy<Foo> > implements Foo by marshaling the arguments of
+// each method directly into an RpcMessage, and Foo_Skeleton<>::dispatch()
+// invokes the method of Foo with the arguments taken from the request. The
+// messages are the same as the ones built from the reflection data, so a
+// proxy can talk to an object exported without a skeleton and vice versa.
+// The methods taking or returning the objects, sequences, arrays or any are
+// left to the reflective path.
+//
+// The proxy does not wait for a method declared with [Oneway] to complete.
+// For the other methods it marshals, the proxy also has an overload taking
+// an RpcFuture* before the arguments, which sends the request and returns
+// at once, e.g., proxy->add(&future, 1, 2) for long add(in long x, in long y).
+
+namespace es
+{
+
+class RpcChannel;
+
+/** The reply to a request sent by a typed proxy without waiting for it.
+ *  A thread can keep any number of requests in flight and the replies are
+ *  matched to the futures by the tag as they arrive on the channel, while
+ *  the thread waits for any one of them or makes another call. The requests
+ *  sent by a thread to a process are served in the order they are sent,
+ *  so are the one-way requests, unless the process serves them with a pool
+ *  of threads (ES_RPC_POOL), which keeps the order only for the objects of
+ *  the interfaces declared with [Ordered]. A future must be waited on by
+ *  the thread that sent the request.
+ */
+class RpcFuture
+{
+    friend class RpcChannel;
+
+    RpcFuture*  next;       // in the futures pending on the channel
+    RpcChannel* channel;    // zero until the request is sent
+    int         tag;
+    bool        ready;
+    RpcRes      res;
+
+    RpcFuture(const RpcFuture&);
+    RpcFuture& operator=(const RpcFuture&);
+
+    /** Receives the messages on the channel until the reply arrives,
+     *  serving the requests received meanwhile.
+     */
+    void wait();
+
+    /** Waits for the reply to be dropped with this future. An error while
+     *  waiting is not thrown, as this future may be destroyed during the
+     *  unwinding, and the reply arriving later is discarded.
+     */
+    void abandon();
+
+public:
+    RpcFuture() :
+        next(0),
+        channel(0),
+        tag(0),
+        ready(false)
+    {
+    }
+
+    /** Waits for the reply if the request is still in flight, so that the
+     *  reply does not arrive after this future is gone.
+     */
+    ~RpcFuture()
+    {
+        if (channel && !ready)
+        {
+            abandon();
+        }
+    }
+
+    bool isReady() const
+    {
+        return ready;
+    }
+
+    /** Waits for the reply and gets the result.
+     *  The exception raised by the method is thrown from here.
+     */
+    Any get()
+    {
+        if (!ready)
+        {
+            wait();
+        }
+        if (res.exceptionCode)
+        {
+            esThrow(res.exceptionCode);
+        }
+        return res.result;
+    }
+};
+
+/** A request marshaled by a typed proxy, with the header and the arguments
+ *  at the offsets known at compile time.
+ */
+template<unsigned N>
+struct RpcMessage
+{
+    RpcReq  req;
+    Any     argv[N];
+};
+
+/** Sends the request marshaled by a typed proxy and waits for the result.
+ *  @param iov      iov[0] is filled with the request itself, and the rest
+ *                  holds the strings passed with the request.
+ */
+Any invokeRemote(unsigned interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt);
+
+/** Sends the request marshaled by a typed proxy without waiting for the
+ *  result.
+ *  @param future   receives the result, or zero to send a one-way request,
+ *                  which is not replied.
+ */
+void invokeRemote(unsigned interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future);
+
+/** Marshals the call from the reflection data.
+ *  @param variant  receives the result of a method returning any.
+ */
+long long invokeRemote(unsigned interfaceNumber, unsigned methodNumber, va_list ap, Any* variant);
+
+/** The root of the typed proxies of the interface O.
+ */
+template<class O>
+class RpcProxy : public O
+{
+    unsigned interfaceNumber;   // in the import table
+
+protected:
+    Any callTyped(RpcReq* req, struct iovec* iov, int iovcnt)
+    {
+        return invokeRemote(interfaceNumber, req, iov, iovcnt);
+    }
+
+    void sendTyped(RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future)
+    {
+        invokeRemote(interfaceNumber, req, iov, iovcnt, future);
+    }
+
+    long long callReflect(Any* variant, unsigned methodNumber, ...)
+    {
+        va_list ap;
+
+        va_start(ap, methodNumber);
+        long long rc = invokeRemote(interfaceNumber, methodNumber, ap, variant);
+        va_end(ap);
+        return rc;
+    }
+
+public:
+    typedef O Interface;
+
+    // queryInterface, addRef and release
+    static const unsigned METHOD_COUNT = 3;
+
+    RpcProxy(unsigned interfaceNumber) :
+        interfaceNumber(interfaceNumber)
+    {
+    }
+
+    virtual ~RpcProxy()
+    {
+    }
+
+    Object* queryInterface(const char* riid)
+    {
+        return reinterpret_cast<Object*>(static_cast<intptr_t>(callReflect(0, 0, riid)));
+    }
+
+    unsigned int addRef()
+    {
+        return static_cast<unsigned int>(callReflect(0, 1));
+    }
+
+    unsigned int release()
+    {
+        return static_cast<unsigned int>(callReflect(0, 2));
+    }
+};
+
+/** The root of the typed skeletons of the interface I.
+ */
+template<class I>
+class RpcSkeleton
+{
+public:
+    static const unsigned METHOD_COUNT = 3;
+
+    /** Invokes the method specified by the request.
+     *  @param argv     the arguments of the request, argv[0] for this.
+     *  @param data     the data following the arguments.
+     *  @param size     the size of the data in bytes.
+     *  @param result   receives the result.
+     *  @return false if the method is left to the reflective path, as
+     *  the methods of Object are to keep the reference counts, and the
+     *  malformed requests are to be rejected.
+     */
+    static bool dispatch(I* self, unsigned methodNumber, Any* argv, u8* data, size_t size, Any* result)
+    {
+        return false;
+    }
+
+    /** Gets the string passed in the data of size bytes for the argument
+     *  arg, and advances the data past it.
+     *  @return false if the string is not terminated within the data.
+     */
+    static bool getString(const Any& arg, u8*& data, size_t& size, const char*& s)
+    {
+        if (!static_cast<const char*>(arg))
+        {
+            s = 0;
+            return true;
+        }
+        const u8* end = static_cast<const u8*>(memchr(data, '\0', size));
+        if (!end)
+        {
+            return false;
+        }
+        s = reinterpret_cast<const char*>(data);
+        size -= end + 1 - data;
+        data += end + 1 - data;
+        return true;
+    }
+};
+
+/** The typed proxy and skeleton of an interface.
+ */
+struct RpcStub
+{
+    Object* (*createProxy)(unsigned interfaceNumber);
+    void (*destroyProxy)(Object* proxy);
+    bool (*dispatch)(Object* self, unsigned methodNumber, Any* argv, void* data, size_t size, Any* result);
+};
+
+template<class I, class P>
+Object* createProxy(unsigned interfaceNumber)
+{
+    return static_cast<I*>(new P(interfaceNumber));
+}
+
+template<class I, class P>
+void destroyProxy(Object* proxy)
+{
+    delete static_cast<P*>(static_cast<I*>(proxy));
+}
+
+template<class I, class S>
+bool dispatchStub(Object* self, unsigned methodNumber, Any* argv, void* data, size_t size, Any* result)
+{
+    // self points to I as the object has been exported as I.
+    return S::dispatch(reinterpret_cast<I*>(self), methodNumber, argv, static_cast<u8*>(data), size, result);
+}
+
+/** Registers the typed proxy and skeleton of the interface iid. The objects
+ *  of the interfaces without them go through the reflective path.
+ */
+void registerStub(const char* iid, const RpcStub* stub);
+
+/** Registers Foo_Proxy and Foo_Skeleton generated for the interface Foo as
+ *  registerStub<Foo, Foo_Proxy, Foo_Skeleton>().
+ */
+template<class I, template<class> class P, template<class> class S>
+void registerStub()
+{
+    static const RpcStub stub =
+    {
+        createProxy<I, P<RpcProxy<I> > >,
+        destroyProxy<I, P<RpcProxy<I> > >,
+        dispatchStub<I, S<I> >
+    };
+    registerStub(I::iid(), &stub);
+}
+
+/** Registers the typed proxies and skeletons generated for the interfaces
+ *  of es listed in stub.list. A process registers them at startup unless
+ *  the ES_RPC_STUB environment variable is set to "0".
+ */
+void registerStubs();
+
+}   // namespace es
+
+#endif  // GOOGLE_ES_RPC_STUB_H_INCLUDED
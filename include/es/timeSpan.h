@@ -28,6 +28,7 @@ class TimeSpan
 {
     s64 ticks;
 
+public:
     static const s64 TICKS_PER_MICROSECOND = 10;
     static const s64 TICKS_PER_MILLISECOND = TICKS_PER_MICROSECOND * 1000;
     static const s64 TICKS_PER_SECOND = TICKS_PER_MILLISECOND * 1000;
@@ -35,6 +36,7 @@ class TimeSpan
     static const s64 TICKS_PER_HOUR = TICKS_PER_MINUTE * 60;
     static const s64 TICKS_PER_DAY = TICKS_PER_HOUR * 24;
 
+private:
     static const s64 MAX_VALUE = 9223372036854775807LL;
     static const s64 MIN_VALUE = (-MAX_VALUE - 1LL);
 
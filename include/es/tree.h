@@ -83,6 +83,7 @@ public:
                     parent = root;
                 }
                 root->right = root->right->skew();
+                root->right->parent = root;
             }
             return root;
         }
@@ -101,6 +102,7 @@ public:
                 parent = root;
                 ++root->level;
                 root->right = root->right->split();
+                root->right->parent = root;
             }
             return root;
         }
@@ -357,6 +359,58 @@ public:
         return (node != &nil) ? node : 0;
     }
 
+    // Gets the node of the greatest key that is not greater than key.
+    Node* getFloor(const K& key) const
+    {
+        Node* found = 0;
+        Node* node = root;
+        while (node != &nil)
+        {
+            if (le(key, node->key))
+            {
+                node = node->left;
+            }
+            else
+            {
+                found = node;
+                node = node->right;
+            }
+        }
+        return found;
+    }
+
+    // Gets the node of the least key that is not less than key.
+    Node* getCeiling(const K& key) const
+    {
+        Node* found = 0;
+        Node* node = root;
+        while (node != &nil)
+        {
+            if (le(node->key, key))
+            {
+                node = node->right;
+            }
+            else
+            {
+                found = node;
+                node = node->left;
+            }
+        }
+        return found;
+    }
+
+    Node* getNext(const Node* node) const
+    {
+        node = node->getNext();
+        return (node != &nil) ? const_cast<Node*>(node) : 0;
+    }
+
+    Node* getPrevious(const Node* node) const
+    {
+        node = node->getPrevious();
+        return (node != &nil) ? const_cast<Node*>(node) : 0;
+    }
+
     bool contains(const K& key) const
     {
         Node* node = root;
@@ -408,7 +462,12 @@ public:
 
     bool remove(const K& key)
     {
+        if (!contains(key))
+        {
+            return false;
+        }
         root = root->remove(key, le);
+        return true;
     }
 
     Iterator begin()
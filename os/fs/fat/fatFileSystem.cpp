@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "fatStream.h"
 
 u8* FatFileSystem::zero;
@@ -657,25 +658,7 @@ defrag()
 Object* FatFileSystem::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::FatFileSystem::iid()) == 0)
-    {
-        objectPtr = static_cast<es::FatFileSystem*>(this);
-    }
-    if (strcmp(riid, es::FileSystem::iid()) == 0)
-    {
-        objectPtr = static_cast<es::FatFileSystem*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::FatFileSystem*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<FatFileSystem, es::FatFileSystem, es::FileSystem>::query(this, riid);
 }
 
 unsigned int FatFileSystem::
@@ -705,21 +688,7 @@ createInstance()
 Object* FatFileSystem::Constructor::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::FatFileSystem::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::FatFileSystem::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::FatFileSystem::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<FatFileSystem::Constructor, es::FatFileSystem::Constructor>::query(this, riid);
 }
 
 unsigned int FatFileSystem::Constructor::
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <es.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "fatStream.h"
 
 FatIterator::
@@ -114,21 +115,7 @@ remove(void)
 Object* FatIterator::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Iterator::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iterator*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iterator*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<FatIterator, es::Iterator>::query(this, riid);
 }
 
 unsigned int FatIterator::
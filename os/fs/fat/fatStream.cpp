@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include <es/exception.h>
 #include <es/handle.h>
 #include "fatStream.h"
@@ -392,24 +393,12 @@ FatStream::
 Object* FatStream::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (isDirectory() && strcmp(riid, es::Context::iid()) == 0)
+    Object* objectPtr = es::InterfaceTable<FatStream, es::Binding, es::File>::find(this, riid);
+    if (!objectPtr && isDirectory() && es::isInterface<es::Context>(riid))
     {
         objectPtr = static_cast<es::Context*>(this);
     }
-    else if (strcmp(riid, es::File::iid()) == 0)
-    {
-        objectPtr = static_cast<es::File*>(this);
-    }
-    else if (strcmp(riid, es::Binding::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Binding*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Binding*>(this);
-    }
-    else
+    if (!objectPtr)
     {
         return NULL;
     }
@@ -19,6 +19,7 @@
 #include <string.h>
 #include <es.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "iso9660Stream.h"
 
 const DateTime Iso9660FileSystem::
@@ -322,25 +323,7 @@ defrag()
 Object* Iso9660FileSystem::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Iso9660FileSystem::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iso9660FileSystem*>(this);
-    }
-    if (strcmp(riid, es::FileSystem::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iso9660FileSystem*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iso9660FileSystem*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;;
+    return es::InterfaceTable<Iso9660FileSystem, es::Iso9660FileSystem, es::FileSystem>::query(this, riid);
 }
 
 unsigned int Iso9660FileSystem::
@@ -371,21 +354,7 @@ createInstance()
 Object* Iso9660FileSystem::Constructor::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Iso9660FileSystem::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iso9660FileSystem::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iso9660FileSystem::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Iso9660FileSystem::Constructor, es::Iso9660FileSystem::Constructor>::query(this, riid);
 }
 
 unsigned int Iso9660FileSystem::Constructor::
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <es.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "iso9660Stream.h"
 
 Iso9660Iterator::
@@ -80,21 +81,7 @@ remove()
 Object* Iso9660Iterator::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Iterator::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iterator*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iterator*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Iso9660Iterator, es::Iterator>::query(this, riid);
 }
 
 unsigned int Iso9660Iterator::
@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include <es/formatter.h>
 #include "iso9660Stream.h"
 
@@ -181,24 +182,12 @@ findNext(es::Stream* dir, u8* record)
 Object* Iso9660Stream::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (isDirectory() && strcmp(riid, es::Context::iid()) == 0)
+    Object* objectPtr = es::InterfaceTable<Iso9660Stream, es::Stream, es::File, es::Binding>::find(this, riid);
+    if (!objectPtr && isDirectory() && es::isInterface<es::Context>(riid))
     {
         objectPtr = static_cast<es::Context*>(this);
     }
-    else if (strcmp(riid, es::File::iid()) == 0)
-    {
-        objectPtr = static_cast<es::File*>(this);
-    }
-    else if (strcmp(riid, es::Binding::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Binding*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
+    if (!objectPtr)
     {
         return NULL;
     }
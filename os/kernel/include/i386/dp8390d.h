@@ -263,6 +263,10 @@ public:
     {
         return es::NetworkInterface::Ethernet;
     }
+    int getCapabilities()
+    {
+        return 0;
+    }
     int start();
     int stop();
 
@@ -50,8 +50,8 @@ class InterfaceStore : public es::InterfaceStore
         {
         }
 
-        MetaData(const char* info, const char* iid) :
-            meta(info, iid),
+        MetaData(const char* info, const char* iid, const unsigned* index = 0) :
+            meta(info, iid, index),
             constructorGetter(0),
             constructorSetter(0),
             constructor(0)
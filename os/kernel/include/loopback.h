@@ -115,6 +115,10 @@ public:
     {
         return es::NetworkInterface::Loopback;
     }
+    int getCapabilities()
+    {
+        return 0;
+    }
     int removeMulticastAddress(const unsigned char* mac)
     {
         return 0;
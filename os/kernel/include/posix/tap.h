@@ -65,6 +65,10 @@ public:
     {
         return es::NetworkInterface::Ethernet;
     }
+    int getCapabilities()
+    {
+        return 0;
+    }
 
     int start();
     int stop();
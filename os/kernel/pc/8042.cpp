@@ -21,6 +21,7 @@
 #include <es.h>
 #include <es/exception.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include <es/usage.h>
 #include "core.h"
 #include "io.h"
@@ -618,21 +619,7 @@ Keyboard::
 Object* Keyboard::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Keyboard, es::Callback>::query(this, riid);
 }
 
 unsigned int Keyboard::
@@ -831,21 +818,7 @@ Stream::flush()
 Object* Keyboard::
 Stream::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Keyboard::Stream, es::Stream>::query(this, riid);
 }
 
 unsigned int Keyboard::
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include <es/usage.h>
 #include <es/handle.h>
 #include "io.h"
@@ -109,21 +110,7 @@ Chan::getCount()
 Object* Dmac::
 Chan::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Dmac::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Dmac*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Dmac*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Dmac::Chan, es::Dmac>::query(this, riid);
 }
 
 unsigned int Dmac::
@@ -18,6 +18,7 @@
 // 8254 programmable interval timer
 
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "cpu.h"
 #include "io.h"
 #include "8254.h"
@@ -122,25 +123,7 @@ beep()
 Object* Pit::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, es::Beep::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Beep*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Pit, es::Callback, es::Beep>::query(this, riid);
 }
 
 unsigned int Pit::
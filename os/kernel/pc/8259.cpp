@@ -18,6 +18,7 @@
 // 8259 interrupt controllers
 
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "io.h"
 #include "8259.h"
 
@@ -203,21 +204,7 @@ splX(unsigned x)
 Object* Pic::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Pic::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Pic*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Pic*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Pic, es::Pic>::query(this, riid);
 }
 
 unsigned int Pic::
@@ -15,6 +15,7 @@
  * limitations under the License.
  */
 
+#include <es/interfaceTable.h>
 #include "apic.h"
 #include "core.h"
 #include "io.h"
@@ -383,21 +384,7 @@ splX(unsigned x)
 Object* Apic::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Pic::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Pic*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Pic*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Apic, es::Pic>::query(this, riid);
 }
 
 unsigned int Apic::
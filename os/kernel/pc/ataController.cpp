@@ -19,6 +19,7 @@
 #include <string.h>
 #include <es.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 #include "io.h"
 #include "ataController.h"
@@ -625,21 +626,7 @@ AtaController::
 Object* AtaController::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<AtaController, es::Callback>::query(this, riid);
 }
 
 unsigned int AtaController::
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <es.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "io.h"
 #include "ataController.h"
 
@@ -281,25 +282,7 @@ getDiskSize()
 Object* AtaDevice::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::Disk::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Disk*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<AtaDevice, es::Stream, es::Disk>::query(this, riid);
 }
 
 unsigned int AtaDevice::
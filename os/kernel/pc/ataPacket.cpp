@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include <es/endian.h>
 #include "io.h"
 #include "ataController.h"
@@ -251,24 +252,12 @@ unlock()
 Object* AtaPacketDevice::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::Disk::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Disk*>(this);
-    }
-    else if (strcmp(riid, es::RemovableMedia::iid()) == 0 && removal)
+    Object* objectPtr = es::InterfaceTable<AtaPacketDevice, es::Stream, es::Disk>::find(this, riid);
+    if (!objectPtr && removal && es::isInterface<es::RemovableMedia>(riid))
     {
         objectPtr = static_cast<es::RemovableMedia*>(this);
     }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
+    if (!objectPtr)
     {
         return NULL;
     }
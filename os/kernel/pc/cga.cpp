@@ -19,6 +19,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "io.h"
 #include "cga.h"
 
@@ -157,22 +158,7 @@ flush()
 Object* Cga::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
-
+    return es::InterfaceTable<Cga, es::Stream>::query(this, riid);
 }
 
 unsigned int Cga::
@@ -28,6 +28,7 @@
 
 #include <string.h>
 #include <errno.h>
+#include <es/interfaceTable.h>
 #include <es/types.h>
 #include <es/formatter.h>
 #include <es/exception.h>
@@ -807,26 +808,7 @@ invoke(int irq)
 Object* Dp8390d::
 queryInterface(const char* riid)
 {
-    Object* object;
-
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        object = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::NetworkInterface::iid()) == 0)
-    {
-        object = static_cast<es::NetworkInterface*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        object = static_cast<es::NetworkInterface*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    object->addRef();
-    return object;
+    return es::InterfaceTable<Dp8390d, es::NetworkInterface, es::Stream>::query(this, riid);
 }
 
 unsigned int Dp8390d::
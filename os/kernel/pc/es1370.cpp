@@ -32,6 +32,7 @@
 #include <es.h>
 #include <es/exception.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 #include "io.h"
 #include "es1370.h"
@@ -462,21 +463,7 @@ invoke(int irq)
 Object* Es1370::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Es1370, es::Callback>::query(this, riid);
 }
 
 unsigned int Es1370::
@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 #include "fdc.h"
 #include "io.h"
@@ -176,21 +177,7 @@ result(void)
 Object* FloppyController::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<FloppyController, es::Callback>::query(this, riid);
 }
 
 unsigned int FloppyController::
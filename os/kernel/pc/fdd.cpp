@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <es.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include "fdc.h"
 #include "io.h"
 
@@ -405,25 +406,7 @@ getDiskSize()
 Object* FloppyDrive::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Disk::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Disk*>(this);
-    }
-    else if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Disk*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<FloppyDrive, es::Disk, es::Stream>::query(this, riid);
 }
 
 unsigned int FloppyDrive::
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <es.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include "apic.h"
 #include "core.h"
 #include "8254.h"
@@ -72,21 +73,7 @@ namespace
         void splX(unsigned int x) {}
         Object* queryInterface(const char* riid)
         {
-            Object* objectPtr;
-            if (strcmp(riid, es::Pic::iid()) == 0)
-            {
-                objectPtr = static_cast<es::Pic*>(this);
-            }
-            else if (strcmp(riid, Object::iid()) == 0)
-            {
-                objectPtr = static_cast<es::Pic*>(this);
-            }
-            else
-            {
-                return NULL;
-            }
-            objectPtr->addRef();
-            return objectPtr;
+            return es::InterfaceTable<NullPic, es::Pic>::query(this, riid);
         }
         unsigned int addRef()
         {
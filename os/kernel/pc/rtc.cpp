@@ -18,6 +18,7 @@
 // Real Time Clock (MC146818A)
 
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "alarm.h"
 #include "io.h"
 #include "rtc.h"
@@ -114,21 +115,7 @@ getTime()
 Object* Rtc::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Rtc::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Rtc*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Rtc*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Rtc, es::Rtc>::query(this, riid);
 }
 
 unsigned int Rtc::
@@ -21,6 +21,7 @@
 #include <es.h>
 #include <es/exception.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "8237a.h"
 #include "core.h"
 #include "io.h"
@@ -432,21 +433,7 @@ stop(Line* line)
 Object* SoundBlaster16::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<SoundBlaster16, es::Callback>::query(this, riid);
 }
 
 unsigned int SoundBlaster16::
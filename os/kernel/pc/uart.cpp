@@ -16,6 +16,7 @@
  */
 
 #include <es.h>
+#include <es/interfaceTable.h>
 #include <es/synchronized.h>
 #include "io.h"
 #include "core.h"
@@ -207,21 +208,7 @@ invoke(int irq)
 Object* Uart::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Uart, es::Stream>::query(this, riid);
 }
 
 unsigned int Uart::
@@ -19,6 +19,7 @@
 #include <es.h>
 #include <es/endian.h>
 #include <es/naming/IContext.h>
+#include <es/interfaceTable.h>
 #include "vesa.h"
 #include "cache.h"
 
@@ -472,29 +473,7 @@ put(long long offset, unsigned long long pte)
 Object* Vesa::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Cursor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Cursor*>(this);
-    }
-    else if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Cursor*>(this);
-    }
-    else if (strcmp(riid, es::Pageable::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Pageable*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Vesa, es::Cursor, es::Stream, es::Pageable>::query(this, riid);
 }
 
 unsigned int Vesa::
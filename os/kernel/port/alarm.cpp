@@ -17,6 +17,7 @@
 
 #include <es.h>
 #include <es/dateTime.h>
+#include <es/interfaceTable.h>
 #include "alarm.h"
 
 #ifndef LLONG_MAX
@@ -168,17 +169,7 @@ cancel()
 Object* Alarm::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Alarm::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Alarm*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Alarm, es::Alarm>::query(this, riid);
 }
 
 unsigned int Alarm::
@@ -387,21 +378,7 @@ Constructor::createInstance()
 Object* Alarm::
 Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Alarm::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Alarm::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Alarm::Constructor*>(this);
-    }
-    else
-    {
-        return 0;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Alarm::Constructor, es::Alarm::Constructor>::query(this, riid);
 }
 
 unsigned int Alarm::
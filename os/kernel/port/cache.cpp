@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <es.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include "cache.h"
 
 Page* Cache::
@@ -453,25 +454,7 @@ getPageCount()
 Object* Cache::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Cache::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Cache*>(this);
-    }
-    else if (strcmp(riid, es::Pageable::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Pageable*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Cache*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Cache, es::Cache, es::Pageable>::query(this, riid);
 }
 
 unsigned int Cache::
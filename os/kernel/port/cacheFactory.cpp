@@ -17,6 +17,7 @@
 
 #include <new>
 #include <errno.h>
+#include <es/interfaceTable.h>
 #include "cache.h"
 
 void Cache::Constructor::
@@ -153,21 +154,7 @@ Constructor::createInstance(es::Stream* backingStore, es::PageSet* pageSet)
 Object* Cache::
 Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Cache::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Cache::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Cache::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Cache::Constructor, es::Cache::Constructor>::query(this, riid);
 }
 
 unsigned int Cache::
@@ -17,6 +17,7 @@
 
 #include "interfaceStore.h"
 #include <es/interfaceData.h>
+#include <es/interfaceTable.h>
 
 struct ConstructorAccessors
 {
@@ -52,6 +53,11 @@ ConstructorAccessors defaultConstructorInfo[] =
         reinterpret_cast<Object* (*)()>(es::Process::getConstructor),
         reinterpret_cast<void (*)(Object*)>(es::Process::setConstructor)
     },
+    {
+        es::Selector::iid(),
+        reinterpret_cast<Object* (*)()>(es::Selector::getConstructor),
+        reinterpret_cast<void (*)(Object*)>(es::Selector::setConstructor)
+    },
     {
         es::FatFileSystem::iid(),
         reinterpret_cast<Object* (*)()>(es::FatFileSystem::getConstructor),
@@ -101,7 +107,7 @@ InterfaceStore()
 {
     for (es::InterfaceData* data = es::interfaceData; data->iid; ++data)
     {
-        MetaData metaData(data->info(), data->iid());
+        MetaData metaData(data->info(), data->iid(), data->infoIndex());
         hashtable.add(data->iid(), metaData);
     }
 
@@ -150,21 +156,7 @@ remove(const char* iid)
 Object* InterfaceStore::
 queryInterface(const char* iid)
 {
-    Object* objectPtr;
-    if (strcmp(iid, es::InterfaceStore::iid()) == 0)
-    {
-        objectPtr = static_cast<es::InterfaceStore*>(this);
-    }
-    else if (strcmp(iid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::InterfaceStore*>(this);
-    }
-    else
-    {
-        return 0;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<InterfaceStore, es::InterfaceStore>::query(this, iid);
 }
 
 unsigned int InterfaceStore::
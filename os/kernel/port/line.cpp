@@ -17,6 +17,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <es/interfaceTable.h>
 #include <es/object.h>
 #include <es/exception.h>
 #include <es/synchronized.h>
@@ -128,29 +129,7 @@ write(const void* src, int count, long long offset)
 Object* Line::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::AudioFormat::iid()) == 0)
-    {
-        objectPtr = static_cast<es::AudioFormat*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Line, es::Callback, es::Stream, es::AudioFormat>::query(this, riid);
 }
 
 unsigned int Line::
@@ -18,6 +18,7 @@
 #include <errno.h>
 #include <string.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include <es/synchronized.h>
 #include "loopback.h"
 
@@ -135,25 +136,7 @@ void Loopback::flush()
 Object* Loopback::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::NetworkInterface::iid()) == 0)
-    {
-        objectPtr = static_cast<es::NetworkInterface*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Loopback, es::Stream, es::NetworkInterface>::query(this, riid);
 }
 
 unsigned int Loopback::
@@ -16,6 +16,7 @@
  */
 
 #include <new>
+#include <es/interfaceTable.h>
 #include "core.h"
 #include "thread.h"
 
@@ -343,25 +344,7 @@ notifyAll()
 Object* Thread::Monitor::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Monitor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor*>(this);
-    }
-    else if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Thread::Monitor, es::Monitor, es::Callback>::query(this, riid);
 }
 
 unsigned int Thread::Monitor::
@@ -391,21 +374,7 @@ Constructor::createInstance()
 Object* Thread::Monitor::
 Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Monitor::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Thread::Monitor::Constructor, es::Monitor::Constructor>::query(this, riid);
 }
 
 unsigned int Thread::Monitor::
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <es.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include "cache.h"
 
 PageSet::
@@ -258,21 +259,7 @@ fork()
 Object* PageSet::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::PageSet::iid()) == 0)
-    {
-        objectPtr = static_cast<es::PageSet*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::PageSet*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<PageSet, es::PageSet>::query(this, riid);
 }
 
 unsigned int PageSet::
@@ -336,21 +323,7 @@ Constructor::createInstance()
 Object* PageSet::
 Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::PageSet::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::PageSet::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::PageSet::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<PageSet::Constructor, es::PageSet::Constructor>::query(this, riid);
 }
 
 unsigned int PageSet::
@@ -25,6 +25,7 @@
 #include <es.h>
 #include <es/exception.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "partition.h"
 
 using namespace LittleEndian;
@@ -967,25 +968,7 @@ list(const char* name)
 Object* PartitionContext::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Context::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Context*>(this);
-    }
-    else if (strcmp(riid, es::Partition::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Partition*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Context*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<PartitionContext, es::Context, es::Partition>::query(this, riid);
 }
 
 unsigned int PartitionContext::
@@ -1016,21 +999,7 @@ Constructor::createInstance()
 Object* PartitionContext::
 Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Partition::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Partition::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Partition::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<PartitionContext::Constructor, es::Partition::Constructor>::query(this, riid);
 }
 
 unsigned int PartitionContext::
@@ -26,6 +26,7 @@
 #include <es.h>
 #include <es/exception.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "partition.h"
 
 using namespace LittleEndian;
@@ -194,25 +195,7 @@ getName(void* name, int len)
 Object* PartitionIterator::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Iterator::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iterator*>(this);
-    }
-    else if (strcmp(riid, es::Binding::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Binding*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Iterator*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<PartitionIterator, es::Iterator, es::Binding>::query(this, riid);
 }
 
 unsigned int PartitionIterator::
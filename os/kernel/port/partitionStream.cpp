@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <es.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include "partition.h"
 
 using namespace LittleEndian;
@@ -484,25 +485,7 @@ setLayout(const Partition* constPartition)
 Object* PartitionStream::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::DiskManagement::iid()) == 0)
-    {
-        objectPtr = static_cast<es::DiskManagement*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<PartitionStream, es::Stream, es::DiskManagement>::query(this, riid);
 }
 
 unsigned int PartitionStream::
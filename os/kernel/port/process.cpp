@@ -18,6 +18,7 @@
 
 #include <string.h>
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 #include "elfFile.h"
 #include "process.h"
@@ -1100,21 +1101,7 @@ setError(es::Stream* error)
 Object* Process::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Process*>(this);
-    }
-    else if (strcmp(riid, es::Process::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Process*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Process, es::Process>::query(this, riid);
 }
 
 unsigned int Process::
@@ -1228,21 +1215,7 @@ es::Process* Process::Constructor::createInstance()
 
 Object* Process::Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Process::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Process::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Process::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Process::Constructor, es::Process::Constructor>::query(this, riid);
 }
 
 unsigned int Process::Constructor::addRef()
@@ -16,6 +16,7 @@
  */
 
 #include <string.h> // ffs()
+#include <es/interfaceTable.h>
 #include "apic.h"
 #include "core.h"
 #include "thread.h"
@@ -305,33 +306,8 @@ invoke(int result)
 Object* Sched::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::CurrentThread::iid()) == 0)
-    {
-        objectPtr = static_cast<es::CurrentThread*>(this);
-    }
-    else if (strcmp(riid, es::CurrentProcess::iid()) == 0)
-    {
-        objectPtr = static_cast<es::CurrentProcess*>(this);
-    }
-    else if (strcmp(riid, es::Runtime::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Runtime*>(this);
-    }
-    else if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::CurrentThread*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Sched, es::CurrentThread, es::CurrentProcess, es::Runtime,
+                              es::Callback>::query(this, riid);
 }
 
 unsigned int Sched::
@@ -17,6 +17,7 @@
 
 #include <new>
 #include <errno.h>
+#include <es/interfaceTable.h>
 #include "cache.h"
 
 Stream::
@@ -110,20 +111,12 @@ flush()
 Object* Stream::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::File::iid()) == 0 && cache->file)
+    Object* objectPtr = es::InterfaceTable<Stream, es::Stream>::find(this, riid);
+    if (!objectPtr && cache->file && es::isInterface<es::File>(riid))
     {
         objectPtr = static_cast<es::File*>(this);
     }
-    else
+    if (!objectPtr)
     {
         return NULL;
     }
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <es.h>
 #include <es/dateTime.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 #include "thread.h"
 #include "process.h"
@@ -507,25 +508,7 @@ checkStack()
 Object* Thread::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Thread::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Thread*>(this);
-    }
-    else if (strcmp(riid, es::Callback::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Callback*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Thread*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Thread, es::Thread, es::Callback>::query(this, riid);
 }
 
 unsigned int Thread::
@@ -456,6 +456,30 @@ putUpcallRecord(UpcallRecord* record)
     upcallList.addLast(record);
 }
 
+namespace
+{
+    // The room left on the user stack of an upcall below the parameters
+    // for the frames of the method invoked.
+    const unsigned UPCALL_STACK_RESERVE = 64 * 1024;
+}
+
+// Makes the room for size bytes copied in on the user stack of the upcall,
+// which begins at bottom. Returns zero if the size is invalid or leaves the
+// method less than UPCALL_STACK_RESERVE bytes.
+static u8* reserve(u8* esp, long long size, const void* bottom)
+{
+    if (size < 0)
+    {
+        return 0;
+    }
+    size = (size + sizeof(int) - 1) & ~static_cast<long long>(sizeof(int) - 1);
+    if (esp - static_cast<const u8*>(bottom) < size + UPCALL_STACK_RESERVE)
+    {
+        return 0;
+    }
+    return esp - size;
+}
+
 u8* Process::
 copyInString(const char* string, u8* esp)
 {
@@ -550,8 +574,12 @@ copyIn(UpcallRecord* record)
         // Any op(void* buf, int len);
     case Reflect::kString:
         // const char* op(char* buf, int len, ...);
-        count = paramp[1];                          // XXX check count
-        esp -= (count + sizeof(int) - 1) & ~(sizeof(int) - 1);
+        count = paramp[1];
+        esp = reserve(esp, count, record->userStack);
+        if (!esp)
+        {
+            return E2BIG;
+        }
         *argp++ = (int) esp;
         *argp++ = count;
         paramp += 2;
@@ -561,8 +589,11 @@ copyIn(UpcallRecord* record)
         if ((count = returnType.getSize()) == 0)
         {
             Reflect::Sequence seq(returnType);
-            count = seq.getType().getSize() * paramp[1];   // XXX check count
-            esp -= (count + sizeof(int) - 1) & ~(sizeof(int) - 1);
+            esp = reserve(esp, static_cast<long long>(seq.getType().getSize()) * paramp[1], record->userStack);
+            if (!esp)
+            {
+                return E2BIG;
+            }
             *argp++ = (int) esp;
             *argp++ = paramp[1];
             paramp += 2;
@@ -651,8 +682,12 @@ copyIn(UpcallRecord* record)
             if ((count = type.getSize()) == 0)
             {
                 Reflect::Sequence seq(type);
-                count = seq.getType().getSize() * paramp[1]; // XXX check count
-                esp -= (count + sizeof(int) - 1) & ~(sizeof(int) - 1);
+                count = seq.getType().getSize() * paramp[1];
+                esp = reserve(esp, static_cast<long long>(seq.getType().getSize()) * paramp[1], record->userStack);
+                if (!esp)
+                {
+                    return E2BIG;
+                }
                 write(*reinterpret_cast<void**>(paramp), count, reinterpret_cast<long long>(esp));
                 *argp++ = (int) esp;
                 *argp++ = paramp[1];
@@ -765,7 +800,7 @@ copyOut(UpcallRecord* record, const char*& iid, bool stringIsInterfaceName)
         if ((count = returnType.getSize()) == 0)
         {
             Reflect::Sequence seq(returnType);
-            count = seq.getType().getSize() * paramp[1];   // XXX check count
+            count = seq.getType().getSize() * paramp[1];   // checked by copyIn()
             esp -= (count + sizeof(int) - 1) & ~(sizeof(int) - 1);
             if (0 < rc && rc <= paramp[1])
             {
@@ -845,7 +880,7 @@ copyOut(UpcallRecord* record, const char*& iid, bool stringIsInterfaceName)
             if ((count = type.getSize()) == 0)
             {
                 Reflect::Sequence seq(type);
-                count = seq.getType().getSize() * paramp[1]; // XXX check count
+                count = seq.getType().getSize() * paramp[1]; // checked by copyIn()
                 esp -= (count + sizeof(int) - 1) & ~(sizeof(int) - 1);
                 paramp += 2;
             }
@@ -16,6 +16,7 @@
  */
 
 #include <es.h>
+#include <es/interfaceTable.h>
 #include "zero.h"
 
 Zero::Zero()
@@ -71,21 +72,7 @@ void Zero::flush()
 
 Object* Zero::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Zero, es::Stream>::query(this, riid);
 }
 
 unsigned int Zero::addRef()
@@ -26,6 +26,7 @@
 #include <sys/time.h>
 #include <es.h>
 #include <es/dateTime.h>
+#include <es/interfaceTable.h>
 #include <es/timeSpan.h>
 #include <es/exception.h>
 #include "core.h"
@@ -218,25 +219,7 @@ testCancel()
 Object* Core::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::CurrentThread::iid()) == 0)
-    {
-        objectPtr = static_cast<es::CurrentThread*>(this);
-    }
-    else if (strcmp(riid, es::CurrentProcess::iid()) == 0)
-    {
-        objectPtr = static_cast<es::CurrentProcess*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::CurrentThread*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Core, es::CurrentThread, es::CurrentProcess>::query(this, riid);
 }
 
 unsigned int Core::
@@ -35,6 +35,7 @@
 #include <linux/if_ether.h>
 
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include <es/synchronized.h>
 
 namespace
@@ -332,25 +333,7 @@ getLinkState()
 Object* Tap::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Stream::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Stream*>(this);
-    }
-    else if (strcmp(riid, es::NetworkInterface::iid()) == 0)
-    {
-        objectPtr = static_cast<es::NetworkInterface*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::NetworkInterface*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Tap, es::NetworkInterface, es::Stream>::query(this, riid);
 }
 
 unsigned int Tap::
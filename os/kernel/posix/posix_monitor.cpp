@@ -22,6 +22,7 @@
 #include <sys/time.h>
 #include <es.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 
 Monitor::
@@ -197,21 +198,7 @@ notifyAll()
 Object* Monitor::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Monitor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Monitor, es::Monitor>::query(this, riid);
 }
 
 unsigned int Monitor::
@@ -241,21 +228,7 @@ Constructor::createInstance()
 Object* Monitor::
 Constructor::queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Monitor::Constructor::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor::Constructor*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Monitor::Constructor*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Monitor::Constructor, es::Monitor::Constructor>::query(this, riid);
 }
 
 unsigned int Monitor::
@@ -24,6 +24,7 @@
 
 #include <es.h>
 #include <es/exception.h>
+#include <es/interfaceTable.h>
 #include "core.h"
 
 pthread_key_t Thread::cleanupKey;
@@ -212,21 +213,7 @@ cancel()
 Object* Thread::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Thread::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Thread*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Thread*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Thread, es::Thread>::query(this, riid);
 }
 
 unsigned int Thread::
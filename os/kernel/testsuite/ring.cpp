@@ -129,5 +129,15 @@ int main(void)
     ring.read(data, used);
     TEST(memcmp(data, "defgh", used) == 0);
 
+    TEST(ring.poke("34", 2, 3) == 2);
+    TEST(ring.getUsed() == 0);
+    TEST(ring.poke("0123", 4, 0) == 4);
+    TEST(ring.fill(5) == 5);
+    used = ring.getUsed();
+    TEST(used == 5);
+    ring.read(data, used);
+    TEST(memcmp(data, "01234", used) == 0);
+    TEST(ring.poke("x", 1, 5) == 0);
+
     esReport("done.\n");
 }
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_LIBES_CALL_DESCRIPTOR_H_INCLUDED
+#define GOOGLE_ES_LIBES_CALL_DESCRIPTOR_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include <es/reflect.h>
+
+namespace es
+{
+
+/** The type of a parameter or a return value decoded from the string
+ *  encoded reflection data, with the same accessors as Reflect::Type.
+ */
+class ParameterDescriptor
+{
+    char        type;
+    int         size;
+    int         elementSize;
+    std::string qualifiedName;
+
+public:
+    ParameterDescriptor(Reflect::Type type);
+
+    char getType() const
+    {
+        return type;
+    }
+
+    /** Gets the size of this type, or zero for a variable-length sequence.
+     */
+    int getSize() const
+    {
+        return size;
+    }
+
+    /** Gets the size of the element type of a sequence.
+     */
+    int getElementSize() const
+    {
+        return elementSize;
+    }
+
+    /** Gets the interface name of an object type.
+     */
+    const std::string& getQualifiedName() const
+    {
+        return qualifiedName;
+    }
+};
+
+/** What the RPC stubs need to know about a method to marshal a call.
+ */
+class CallDescriptor
+{
+public:
+    // The operations of Object handled specially by the stubs.
+    enum Kind
+    {
+        Operation,
+        QueryInterface,
+        AddRef,
+        Release
+    };
+
+private:
+    Kind                                kind;
+    bool                                oneway;
+    bool                                ordered;
+    std::string                         name;
+    ParameterDescriptor                 returnType;
+    std::vector<ParameterDescriptor>    params;
+
+public:
+    CallDescriptor(Reflect::Method method, bool root, unsigned number);
+
+    Kind getKind() const
+    {
+        return kind;
+    }
+
+    /** Returns true if the caller does not wait for the method to complete.
+     */
+    bool isOneway() const
+    {
+        return oneway;
+    }
+
+    /** Returns true if the calls to an object are served in the order.
+     */
+    bool isOrdered() const
+    {
+        return ordered;
+    }
+
+    const std::string& getName() const
+    {
+        return name;
+    }
+
+    const ParameterDescriptor& getReturnType() const
+    {
+        return returnType;
+    }
+
+    unsigned getParameterCount() const
+    {
+        return params.size();
+    }
+
+    const ParameterDescriptor& getParameter(unsigned n) const
+    {
+        return params[n];
+    }
+};
+
+/** The call descriptors of an interface indexed by the method number,
+ *  including the methods inherited from the super interfaces. The table of
+ *  an interface is built once when an object of the interface is first
+ *  imported or exported, so that no reflection data is parsed per call.
+ */
+class CallDescriptorTable
+{
+    std::vector<CallDescriptor> methods;
+
+    CallDescriptorTable(const char* iid);
+
+public:
+    unsigned getMethodCount() const
+    {
+        return methods.size();
+    }
+
+    /** Gets the descriptor of the specified method.
+     *  @return the descriptor, or zero if methodNumber is out of range.
+     */
+    const CallDescriptor* getMethod(unsigned methodNumber) const
+    {
+        return (methodNumber < methods.size()) ? &methods[methodNumber] : 0;
+    }
+
+    /** Gets the table of the specified interface, building it if necessary.
+     *  @return the table, or zero if the interface is not known.
+     */
+    static const CallDescriptorTable* get(const char* iid);
+};
+
+}   // namespace es
+
+#endif  // GOOGLE_ES_LIBES_CALL_DESCRIPTOR_H_INCLUDED
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_LIBES_RPC_CHANNEL_H_INCLUDED
+#define GOOGLE_ES_LIBES_RPC_CHANNEL_H_INCLUDED
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <es/rpc.h>
+#include <es/rpcStub.h>
+#include <es/types.h>
+
+namespace es
+{
+
+/** A single-producer single-consumer ring of the RPC messages placed in
+ *  the shared memory. The head is written only by the consumer and the
+ *  tail only by the producer, and they are kept in the separate cache
+ *  lines. The tail is also the futex word the consumer sleeps on.
+ */
+struct RpcRing
+{
+    static const u32 SIZE = 64 * 1024;  // must be a power of two
+
+    volatile u32    head;
+    u8              pad0[60];
+    volatile u32    tail;
+    volatile u32    waiting;            // non-zero while the consumer sleeps
+    u8              pad1[56];
+    u8              data[SIZE];
+};
+
+/** A connection between a pair of threads in the different processes.
+ *  The messages are exchanged over a SOCK_DGRAM socket, and optionally
+ *  over a pair of RpcRings in a memfd shared by the two processes. With
+ *  the rings, a small message is copied into the ring of the sending
+ *  direction, and the receiver picks it up spinning for a while before
+ *  it sleeps on the futex, so that a call does not enter the kernel while
+ *  both sides are busy. A message carrying file descriptors or too large
+ *  for the ring still goes over the socket, and a marker is put into the
+ *  ring in its place to keep the order of the messages.
+ *
+ *  The releases of the objects exported by the peer are queued in the
+ *  channel and sent together in an RpcRelease message ahead of the next
+ *  message sent over the channel, so that dropping a remote object does
+ *  not cost a round trip of its own. The ones left queued on an idle
+ *  channel are sent by flushAll().
+ */
+class RpcChannel
+{
+    static const int MIN_SPIN = 16;
+    static const int MAX_SPIN = 16 * 1024;
+
+public:
+    static const unsigned MAX_RELEASE = 32;     // releases sent at once at most
+    static const int RELEASE_INTERVAL = 100;    // [ms] to keep a release queued
+
+private:
+    int         s;          // socket
+    pid_t       peer;       // the process at the other end
+    void*       rings;      // mapped memfd, or 0
+    RpcRing*    in;
+    RpcRing*    out;
+    int         spin;       // current spin count before sleeping
+    RpcFuture*  pending;    // the futures waiting for the replies in order
+    unsigned    releaseCount;
+    long long   releaseTime;    // when the first release was queued [ms]
+    Capability  releases[MAX_RELEASE];
+    pthread_mutex_t lock;   // of the senders and the queued releases
+    RpcChannel* prev;       // in the list of all the channels
+    RpcChannel* next;
+
+    static int  maxSpin;    // zero on a uniprocessor
+
+    static pthread_mutex_t listLock;
+    static RpcChannel* list;
+
+    ssize_t push(const struct msghdr* msg, size_t len, int type);
+    void wait(u32 head);
+    ssize_t transmit(const struct msghdr* msg);
+    int sendReleases();
+
+public:
+    /** Constructs a channel over the socket s.
+     *  @param rings    the rings returned by createRings() or mapRings(),
+     *                  or zero to use the socket only.
+     *  @param client   true on the side that created the rings.
+     *  @param peer     the process at the other end, or zero to take the
+     *                  process that created the socket pair, as on the
+     *                  side given the socket by the peer.
+     */
+    RpcChannel(int s, void* rings = 0, bool client = true, pid_t peer = 0);
+    ~RpcChannel();
+
+    int getSocket() const
+    {
+        return s;
+    }
+
+    /** Gets the process at the other end as identified by the socket, not
+     *  by the messages, which tell any pid the sender likes.
+     */
+    pid_t getPeer() const
+    {
+        return peer;
+    }
+
+    bool hasRings() const
+    {
+        return rings ? true : false;
+    }
+
+    unsigned getReleaseCount() const
+    {
+        return releaseCount;
+    }
+
+    /** Lets many threads use this channel at the same time, as the servant
+     *  threads of an RpcPool do. The sends are serialized by the channel,
+     *  but the channel must not use the rings, which are received from by
+     *  one thread.
+     */
+    void share();
+
+    /** Sends a message like sendmsg() with no flags. The queued releases
+     *  are sent ahead of it.
+     */
+    ssize_t send(const struct msghdr* msg);
+
+    /** Queues the release of a reference to the object cap exported by the
+     *  peer. The queued releases are sent at once when MAX_RELEASE of them
+     *  are queued, or the first one has been queued for RELEASE_INTERVAL.
+     *  @return -1 if the queued releases could not be sent.
+     */
+    int release(const Capability& cap);
+
+    /** Sends the queued releases, if any.
+     *  @return -1 if they could not be sent.
+     */
+    int flush();
+
+    /** Sends the queued releases of all the channels but the ones being
+     *  sent over by other threads, which send them ahead of their messages.
+     *  Called every RELEASE_INTERVAL so that the releases queued by an
+     *  idle or exited thread do not pin the objects of the peer.
+     */
+    static void flushAll();
+
+    /** Receives the next message into the RpcStack, waiting for it.
+     *  @param fdv      receives the file descriptors passed with the message.
+     *  @param fdmax    set to the end of the received file descriptors.
+     *  @param size     receives the size of the message if not zero.
+     *  @return zero if the peer has closed the socket.
+     */
+    RpcHdr* receive(int* fdv, int*& fdmax, size_t* size = 0);
+
+    /** Makes future wait for the reply to the request tagged tag, which
+     *  has been sent over this channel.
+     */
+    void expect(RpcFuture* future, int tag);
+
+    /** Passes the reply to the future waiting for it.
+     *  @return true if the reply has been taken by a future.
+     */
+    bool deliver(RpcRes* res);
+
+    /** Stops future from waiting for the reply, which is discarded when it
+     *  arrives.
+     */
+    void forget(RpcFuture* future);
+
+    /** Creates a memfd holding a pair of rings and maps it. The rings are
+     *  not created if the ES_RPC_RING environment variable is set to "0".
+     *  @param fd       receives the memfd to be passed to the peer.
+     *  @return the mapped rings, or zero if not available.
+     */
+    static void* createRings(int* fd);
+
+    /** Maps the rings created by the peer.
+     *  @return the mapped rings, or zero if fd is not a memfd of the size of
+     *  the rings sealed against resizing.
+     */
+    static void* mapRings(int fd);
+
+    static void unmapRings(void* rings);
+};
+
+}   // namespace es
+
+#endif  // GOOGLE_ES_LIBES_RPC_CHANNEL_H_INCLUDED
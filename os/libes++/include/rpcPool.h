@@ -0,0 +1,197 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_LIBES_RPC_POOL_H_INCLUDED
+#define GOOGLE_ES_LIBES_RPC_POOL_H_INCLUDED
+
+#include <deque>
+#include <map>
+
+#include <pthread.h>
+
+#include <es/rpc.h>
+#include <es/types.h>
+
+#include "rpcChannel.h"
+
+namespace es
+{
+
+/** A bounded pool of the servant threads serving the requests received over
+ *  any number of channels. A dispatcher thread waits for the messages on all
+ *  the channels in an epoll set and queues each request as a task to one of
+ *  the servant threads in turn. A servant thread takes the tasks from the
+ *  front of its own queue, and steals from the back of the other queues when
+ *  its own is empty. The tasks of the same order key are served one at a
+ *  time in the order received, and the others are served concurrently.
+ *
+ *  While a servant thread waits for the reply to a call back over the
+ *  channel of the request it serves, the messages received on the channel
+ *  are passed to it rather than queued, so the nested calls between the two
+ *  threads are served as they are without the pool.
+ */
+class RpcPool
+{
+    struct Task;
+    struct Queue;
+    struct Entry;
+
+public:
+    static const unsigned MAX_THREADS = 64;
+
+    /** Serves the requests queued in the pool.
+     */
+    class Servant
+    {
+    public:
+        virtual ~Servant()
+        {
+        }
+
+        /** Called by the dispatcher thread as a message is queued.
+         *  @param key      set to the order key of the message, or zero to
+         *                  serve it concurrently with the others.
+         *  @return the cookie passed to serve().
+         */
+        virtual void* accept(RpcChannel* channel, RpcHdr* hdr, unsigned long* key) = 0;
+
+        /** Called by a servant thread to serve the message of size bytes.
+         */
+        virtual void serve(RpcChannel* channel, RpcHdr* hdr, size_t size, int* fdv, int* fdmax, void* cookie) = 0;
+
+        /** Starts a thread of the pool running run(param). Overridden to
+         *  start the threads the way the process starts its own, so that
+         *  they can use its monitors.
+         *  @return false if the thread could not be started.
+         */
+        virtual bool start(void* (*run)(void*), void* param)
+        {
+            pthread_t thread;
+            if (pthread_create(&thread, 0, run, param) != 0)
+            {
+                return false;
+            }
+            pthread_detach(thread);
+            return true;
+        }
+    };
+
+    /** Passes the messages received on the channel to this thread while the
+     *  object lives, if the thread is serving a request received on the
+     *  channel. Construct it before sending the request to wait for.
+     */
+    class Wait
+    {
+        Entry*  entry;
+
+        Wait(const Wait&);
+        Wait& operator=(const Wait&);
+
+    public:
+        Wait(RpcChannel* channel);
+        ~Wait();
+    };
+
+private:
+    Servant*    servant;
+    int         epfd;
+    unsigned    size;       // the number of the servant threads
+    Queue*      queues;
+    unsigned    next;       // the queue to take the next task
+
+    pthread_mutex_t idleLock;
+    pthread_cond_t  idleCond;
+    unsigned    idle;       // the number of the idle servant threads
+    unsigned    queued;     // the number of the tasks in the queues
+
+    pthread_mutex_t lock;   // of the entries
+
+    pthread_mutex_t orderLock;
+    std::map<unsigned long, std::deque<Task*> > orders;    // the tasks waiting for their turn
+
+    // statistics
+    u64         served;
+    u64         stolen;
+    u64         totalLatency;   // [ns]
+    u64         maxLatency;     // [ns]
+
+    static __thread Entry* owned;   // of the channel this thread may call back over
+    static __thread Queue* local;   // of this servant thread
+
+    RpcPool(const RpcPool&);
+    RpcPool& operator=(const RpcPool&);
+
+    static void* dispatch(void* param);
+    static void* work(void* param);
+
+    void post(Task* task);
+    void schedule(Task* task, Queue* queue);
+    void push(Task* task, Queue* queue);
+    Task* take(Queue* queue);
+    void run(Task* task, Queue* queue);
+    void settle(Entry* entry);
+    void record(long long latency, bool steal);
+    void hangUp(Entry* entry);
+
+    static void discard(Task* task);
+    static void finish(Task* task);
+
+public:
+    /** Starts the dispatcher and size servant threads.
+     */
+    RpcPool(Servant* servant, unsigned size);
+
+    /** Creates a pool of as many servant threads as the environment
+     *  variable ES_RPC_POOL specifies, or as many as the processors if it
+     *  is not a positive number.
+     *  @return zero if ES_RPC_POOL is not set.
+     */
+    static RpcPool* create(Servant* servant);
+
+    /** Serves the requests received on the channel from now on. The channel
+     *  must not use the rings, which the dispatcher cannot wait for. The pool
+     *  takes the channel, and deletes it once the client has hung up and the
+     *  requests received on it have been served.
+     */
+    void add(RpcChannel* channel);
+
+    void getStats(RpcPoolStats* stats);
+
+    /** Checks if this thread may call back to the client over the channel.
+     *  One servant thread at a time may do so for each channel; the other
+     *  servant threads use their own channels to the client.
+     */
+    static bool owns(RpcChannel* channel);
+
+    /** Gives up the channel this thread owns, if any, unless the thread
+     *  waits on it. A servant calls this before it sends the reply to the
+     *  request it serves, so that the next request of the client may be
+     *  served by a thread owning the channel.
+     */
+    static void disown();
+
+    /** Receives the next message on the channel, which has been passed to
+     *  this thread if it waits on the channel of its request.
+     *  @param size     receives the size of the message if not zero.
+     *  @return zero if the client has gone.
+     */
+    static RpcHdr* receive(RpcChannel* channel, int* fdv, int*& fdmax, size_t* size = 0);
+};
+
+}   // namespace es
+
+#endif  // GOOGLE_ES_LIBES_RPC_POOL_H_INCLUDED
@@ -12,11 +12,11 @@ BEGIN {
 }
 
 {
-    print "    { " $0 "::iid, " $0 "::info },"
+    print "    { " $0 "::iid, " $0 "::info, " $0 "::infoIndex },"
 }
 
 END {
-    print "    { 0, 0 }"
+    print "    { 0, 0, 0 }"
     print "};"
     print ""
     print "}  // namespace es"
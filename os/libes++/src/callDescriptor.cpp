@@ -0,0 +1,140 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include <map>
+
+#include "callDescriptor.h"
+
+namespace es
+{
+    Reflect::Interface& getInterface(const char* iid);
+    const char* getUniqueIdentifier(const char* iid);
+}
+
+using namespace es;
+
+namespace
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    // Keyed by the unique identifier of the interface. System imports the
+    // objects passed by the parent process as it is constructed.
+    std::map<const char*, CallDescriptorTable*> tableMap __attribute__((init_priority(1000)));    // Before System
+}
+
+ParameterDescriptor::
+ParameterDescriptor(Reflect::Type type) :
+    type(type.getType()),
+    size(type.getSize()),
+    elementSize(0),
+    qualifiedName(type.getQualifiedName())
+{
+    if (this->type == Reflect::kSequence)
+    {
+        Reflect::Sequence seq(type);
+        elementSize = seq.getType().getSize();
+    }
+}
+
+CallDescriptor::
+CallDescriptor(Reflect::Method method, bool root, unsigned number) :
+    kind(Operation),
+    oneway(method.isOneway()),
+    ordered(method.isOrdered()),
+    name(method.getName()),
+    returnType(method.getReturnType())
+{
+    if (root)
+    {
+        switch (number)
+        {
+        case 0:
+            kind = QueryInterface;
+            break;
+        case 1:
+            kind = AddRef;
+            break;
+        case 2:
+            kind = Release;
+            break;
+        }
+    }
+    for (Reflect::Parameter param = method.listParameter(); param.next(); )
+    {
+        params.push_back(ParameterDescriptor(param.getType()));
+    }
+}
+
+CallDescriptorTable::
+CallDescriptorTable(const char* iid)
+{
+    Reflect::Interface interface = getInterface(iid);
+    unsigned count = interface.getInheritedMethodCount() + interface.getMethodCount();
+    methods.reserve(count);
+    for (unsigned methodNumber = 0; methodNumber < count; ++methodNumber)
+    {
+        // Find the interface that declares the method.
+        unsigned baseMethodCount;
+        Reflect::Interface super(interface);
+        for (;;)
+        {
+            baseMethodCount = super.getInheritedMethodCount();
+            if (baseMethodCount <= methodNumber)
+            {
+                break;
+            }
+            super = getInterface(super.getQualifiedSuperName().c_str());
+        }
+        methods.push_back(CallDescriptor(super.getMethod(methodNumber - baseMethodCount),
+                                         super.getQualifiedSuperName() == "",
+                                         methodNumber - baseMethodCount));
+    }
+}
+
+const CallDescriptorTable* CallDescriptorTable::
+get(const char* iid)
+{
+    iid = getUniqueIdentifier(iid);
+    if (!iid)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&lock);
+    CallDescriptorTable* table = 0;
+    std::map<const char*, CallDescriptorTable*>::iterator it = tableMap.find(iid);
+    if (it != tableMap.end())
+    {
+        table = (*it).second;
+    }
+    else
+    {
+        try
+        {
+            table = new CallDescriptorTable(iid);
+        }
+        catch (...)
+        {
+            // A super interface is missing.
+        }
+        tableMap[iid] = table;
+    }
+    pthread_mutex_unlock(&lock);
+    return table;
+}
@@ -50,8 +50,8 @@ class InterfaceDataStore
         {
         }
 
-        MetaData(const char* info, const char* iid) :
-            meta(info, iid),
+        MetaData(const char* info, const char* iid, const unsigned* index = 0) :
+            meta(info, iid, index),
             constructorGetter(0),
             constructorSetter(0),
             constructor(0)
@@ -151,7 +151,7 @@ InterfaceDataStore()
 {
     for (es::InterfaceData* data = es::interfaceData; data->iid; ++data)
     {
-        MetaData metaData(data->info(), data->iid());
+        MetaData metaData(data->info(), data->iid(), data->infoIndex());
         hashtable.add(data->iid(), metaData);
     }
 
@@ -190,6 +190,8 @@ InterfaceDataStore()
                         reinterpret_cast<Object* (*)()>(PageSet::getConstructor), reinterpret_cast<void (*)(Object*)>(PageSet::setConstructor));
     registerConstructor(Process::iid(),
                         reinterpret_cast<Object* (*)()>(Process::getConstructor), reinterpret_cast<void (*)(Object*)>(Process::setConstructor));
+    registerConstructor(Selector::iid(),
+                        reinterpret_cast<Object* (*)()>(Selector::getConstructor), reinterpret_cast<void (*)(Object*)>(Selector::setConstructor));
     registerConstructor(FatFileSystem::iid(),
                         reinterpret_cast<Object* (*)()>(FatFileSystem::getConstructor), reinterpret_cast<void (*)(Object*)>(FatFileSystem::setConstructor));
     registerConstructor(Iso9660FileSystem::iid(),
@@ -15,12 +15,17 @@
  * limitations under the License.
  */
 
+#include <deque>
 #include <map>
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -45,6 +50,7 @@
 #include <es/ref.h>
 #include <es/reflect.h>
 #include <es/rpc.h>
+#include <es/rpcStub.h>
 #include <es/timeSpan.h>
 
 #include <es/base/IAlarm.h>
@@ -53,15 +59,17 @@
 
 #include <sys/mman.h>
 
+#include "callDescriptor.h"
 #include "core.h"
 #include "posix_system.h"
 #include "posix_video.h"
+#include "rpcChannel.h"
+#include "rpcPool.h"
 
 // #define VERBOSE
 
 namespace es
 {
-    Reflect::Interface& getInterface(const char* iid);
     void registerConstructor(const char* iid, Object* (*getter)(), void (*setter)(Object*));
     const char* getUniqueIdentifier(const char* iid);
 }
@@ -74,11 +82,29 @@ namespace
 
 static const int MAX_EXPORT = 100;
 static const int MAX_IMPORT = 100;
+static const int LEASE_PERIOD = 10000;  // [ms]
 
 // for RPC
-__thread int epfd = -1;
 __thread int rpctag;
-__thread std::map<pid_t, int>* socketMap;
+__thread std::map<pid_t, RpcChannel*>* channelMap;
+
+// Serves the channels accepted if ES_RPC_POOL is set
+RpcPool* pool;
+
+// The typed stubs keyed by the unique identifier of the interface
+pthread_mutex_t stubLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<const char*, const RpcStub*> stubMap __attribute__((init_priority(1000)));   // Before System
+
+// The references exported to each process by the index in the exportedTable.
+// A process holds them on lease, which is renewed every LEASE_PERIOD as long
+// as the process exists.
+pthread_mutex_t leaseLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<pid_t, std::map<int, unsigned> > leaseMap;
+
+// The releases queued by the threads with no channel to the exporter, which
+// are sent by the focus thread.
+pthread_mutex_t deferredLock = PTHREAD_MUTEX_INITIALIZER;
+std::deque<std::pair<Capability, unsigned> > deferredReleases;
 
 //
 // Misc.
@@ -86,9 +112,17 @@ __thread std::map<pid_t, int>* socketMap;
 
 void initializeConstructors();
 
-long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, Reflect::Method& method,
+long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, const CallDescriptor& method,
                      bool stringIsInterfaceName, Any* variant);
+Any callRemote(const Capability& cap, RpcReq* req, struct iovec* iov, int iovcnt);
+void sendRemote(const Capability& cap, RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future);
+void releaseRemote(const Capability& cap, unsigned count);
+void queueRelease(const Capability& cap, unsigned count);
+void flushReleases();
+std::map<pid_t, RpcChannel*>* getChannelMap();
+const RpcStub* getStub(const char* iid);
 u64 getRandom();
+long long getMilliseconds();
 
 typedef long long (*Method)(void* self, ...);
 
@@ -143,6 +177,8 @@ class System : public es::CurrentProcess
         Ref         ref;
         Object* object;
         const char* iid;
+        const CallDescriptorTable* descriptors;
+        const RpcStub* stub;
         u64         check;
         bool        doRelease;
 
@@ -150,6 +186,8 @@ class System : public es::CurrentProcess
         Exported(const ExportKey& key) :
             object(key.object),
             iid(key.iid),
+            descriptors(CallDescriptorTable::get(key.iid)),
+            stub(::getStub(key.iid)),
             check(::getRandom()),
             doRelease(false)
         {
@@ -213,23 +251,47 @@ class System : public es::CurrentProcess
         Ref         ref;
         Capability  capability;
         const char* iid;
-        bool        doRelease;
+        const CallDescriptorTable* descriptors;
+        const RpcStub* stub;
+        Object*     proxy;  // the typed proxy, or zero to use the broker
+        unsigned    exports;    // the references exported to this process
 
     public:
         Imported(const ImportKey& key) :
             ref(0),
             iid(key.iid),
-            doRelease(false)
+            descriptors(CallDescriptorTable::get(key.iid)),
+            stub(::getStub(key.iid)),
+            proxy(0),
+            exports(0)
         {
             capability.copy(*key.capability);
         }
 
         ~Imported()
         {
-            if (doRelease)
+            if (exports)
+            {
+                ::queueRelease(capability, exports);
+            }
+            if (proxy)
+            {
+                stub->destroyProxy(proxy);
+            }
+        }
+
+        // Gets the typed proxy of this object, creating it at the first import.
+        Object* getProxy(unsigned interfaceNumber)
+        {
+            if (!proxy && stub)
             {
-                // Make a release RPC request
+                Object* created = stub->createProxy(interfaceNumber);
+                if (__sync_val_compare_and_swap(&proxy, static_cast<Object*>(0), created))
+                {
+                    stub->destroyProxy(created);
+                }
             }
+            return proxy;
         }
 
         bool isMatch(const ImportKey& key) const
@@ -242,9 +304,15 @@ class System : public es::CurrentProcess
             return capability.hash();
         }
 
+        // Takes a reference exported to this process.
+        unsigned int import()
+        {
+            __sync_add_and_fetch(&exports, 1);
+            return ref.addRef();
+        }
+
         unsigned int addRef()
         {
-            doRelease = true;
             return ref.addRef();
         }
 
@@ -310,7 +378,7 @@ public:
         if (0 <= cmd.forkRes.root.object)
         {
             esInitThread();
-            root = static_cast<es::Context*>(importObject(cmd.forkRes.root, es::Context::iid(), false));
+            root = static_cast<es::Context*>(importObject(cmd.forkRes.root, es::Context::iid()));
         }
         else
         {
@@ -336,10 +404,18 @@ public:
         }
         initializeConstructors();
 
+        // Register the typed proxies and skeletons before importing any
+        // object, unless ES_RPC_STUB is set to "0" to use the reflective path.
+        const char* stub = getenv("ES_RPC_STUB");
+        if (!stub || strcmp(stub, "0") != 0)
+        {
+            registerStubs();
+        }
+
         // Import in, out, error
         if (0 <= cmd.forkRes.in.object)
         {
-            in = static_cast<es::Stream*>(importObject(cmd.forkRes.in, es::Stream::iid(), false));
+            in = static_cast<es::Stream*>(importObject(cmd.forkRes.in, es::Stream::iid()));
         }
         else
         {
@@ -353,7 +429,7 @@ public:
         }
         if (0 <= cmd.forkRes.out.object)
         {
-            out = static_cast<es::Stream*>(importObject(cmd.forkRes.out, es::Stream::iid(), false));
+            out = static_cast<es::Stream*>(importObject(cmd.forkRes.out, es::Stream::iid()));
         }
         else
         {
@@ -361,7 +437,7 @@ public:
         }
         if (0 <= cmd.forkRes.error.object)
         {
-            error = static_cast<es::Stream*>(importObject(cmd.forkRes.error, es::Stream::iid(), false));
+            error = static_cast<es::Stream*>(importObject(cmd.forkRes.error, es::Stream::iid()));
         }
         else
         {
@@ -370,7 +446,7 @@ public:
 
         if (0 <= cmd.forkRes.current.object)
         {
-            current = static_cast<es::Context*>(importObject(cmd.forkRes.current, es::Context::iid(), false));
+            current = static_cast<es::Context*>(importObject(cmd.forkRes.current, es::Context::iid()));
         }
         else
         {
@@ -382,7 +458,7 @@ public:
         {
             try
             {
-                es::CanvasRenderingContext2D* canvas = static_cast<es::CanvasRenderingContext2D*>(importObject(cmd.forkRes.document, es::CanvasRenderingContext2D::iid(), false));
+                es::CanvasRenderingContext2D* canvas = static_cast<es::CanvasRenderingContext2D*>(importObject(cmd.forkRes.document, es::CanvasRenderingContext2D::iid()));
                 Handle<es::Context> device = root->lookup("device");
                 device->bind("canvas", canvas);
             }
@@ -692,10 +768,13 @@ public:
         return i;
     }
 
-    Object* importObject(const Capability& cap, const char* iid, bool param)
+    // Imports the object exported to this process with a reference, which
+    // the caller must release. The objects passed as the parameters are
+    // released by callLocal() after the call.
+    Object* importObject(const Capability& cap, const char* iid)
     {
 #ifdef VERBOSE
-        printf("importObject: %s : %d\n", iid, param);
+        printf("importObject: %s\n", iid);
 #endif
 
         if (cap.object < 0)
@@ -728,25 +807,210 @@ public:
         int i = importedTable.add(key);
         if (0 <= i)
         {
-            if (!param)
+            Imported* imported = importedTable.get(i);
+            ASSERT(imported);
+            imported->import();
+            Object* object = imported->getProxy(i);
+            importedTable.put(i);
+            if (!object)
             {
-                Imported* imported = importedTable.get(i);
-                ASSERT(imported);
-                imported->addRef();
-                importedTable.put(i);
+                object = reinterpret_cast<Object*>(&(importer.getInterfaceTable())[i]);
             }
-            Object* object = reinterpret_cast<Object*>(&(importer.getInterfaceTable())[i]);
             return object;
         }
         else
         {
-            if (!param)
+            // Return the reference as the table is full.
+            ::releaseRemote(cap, 1);
+            return 0;
+        }
+    }
+
+    // Records the reference exported to the process client by cap.
+    void lease(pid_t client, const Capability& cap)
+    {
+        if (cap.object < 0 || cap.check == 0)
+        {
+            return;
+        }
+        pthread_mutex_lock(&leaseLock);
+        ++leaseMap[client][cap.object];
+        pthread_mutex_unlock(&leaseLock);
+    }
+
+    // Drops count references of the client to the entry i if it holds them.
+    bool revoke(pid_t client, int i, unsigned count)
+    {
+        bool revoked = false;
+        pthread_mutex_lock(&leaseLock);
+        std::map<pid_t, std::map<int, unsigned> >::iterator it = leaseMap.find(client);
+        if (it != leaseMap.end())
+        {
+            std::map<int, unsigned>::iterator ref = (*it).second.find(i);
+            if (ref != (*it).second.end() && count <= (*ref).second)
+            {
+                if (((*ref).second -= count) == 0)
+                {
+                    (*it).second.erase(ref);
+                }
+                if ((*it).second.empty())
+                {
+                    leaseMap.erase(it);
+                }
+                revoked = true;
+            }
+        }
+        pthread_mutex_unlock(&leaseLock);
+        return revoked;
+    }
+
+    // Drops count references to the exported entry i taken by exportObject().
+    void unexport(int i, unsigned count)
+    {
+        Exported* exported = exportedTable.get(i);
+        if (!exported)
+        {
+            return;
+        }
+        Object* object = exported->object;
+        while (count--)
+        {
+            object->release();
+            exportedTable.put(i);
+        }
+        exportedTable.put(i);
+    }
+
+    // Processes the references released by a client in a batch.
+    void releaseExported(RpcRelease* release, RpcChannel* channel)
+    {
+        Capability* cap = release->getCapabilities();
+        for (unsigned n = 0; n < release->count; ++n, ++cap)
+        {
+            Exported* exported = getExported(*cap);
+            if (!exported)
+            {
+                continue;
+            }
+            exportedTable.put(cap->object);
+            // Only the references held by the sender itself are dropped,
+            // whatever pid the message claims.
+            if (revoke(channel->getPeer(), cap->object, 1))
+            {
+                unexport(cap->object, 1);
+            }
+        }
+    }
+
+    // Renews the leases of the live clients, and reclaims the references
+    // held by the clients that have gone. Note a child process is seen
+    // alive until it is waited for.
+    void renewLeases()
+    {
+        std::map<pid_t, std::map<int, unsigned> > expired;
+
+        pthread_mutex_lock(&leaseLock);
+        std::map<pid_t, std::map<int, unsigned> >::iterator it = leaseMap.begin();
+        while (it != leaseMap.end())
+        {
+            if (kill((*it).first, 0) == -1 && errno == ESRCH)
+            {
+                expired[(*it).first].swap((*it).second);
+                leaseMap.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        pthread_mutex_unlock(&leaseLock);
+
+        for (it = expired.begin(); it != expired.end(); ++it)
+        {
+            std::map<int, unsigned>::iterator ref;
+            for (ref = (*it).second.begin(); ref != (*it).second.end(); ++ref)
             {
-                // TODO call release
-                // callRemote(cap, method, ap);
+                unexport((*ref).first, (*ref).second);
             }
+        }
+    }
+
+    // Keeps the object of the request alive until a servant thread of the
+    // pool serves it, as a release received meanwhile could free it.
+    // @return the entry pinned, or zero.
+    void* pin(RpcHdr* hdr, unsigned long* key)
+    {
+        *key = 0;
+        if (hdr->cmd != RPC_REQ && hdr->cmd != RPC_ONEWAY)
+        {
+            return 0;
+        }
+        RpcReq* req = reinterpret_cast<RpcReq*>(hdr);
+        Exported* exported = getExported(req->capability);
+        if (!exported)
+        {
             return 0;
         }
+        exported->object->addRef();
+        const CallDescriptor* method = exported->descriptors ? exported->descriptors->getMethod(req->methodNumber) : 0;
+        if (method && method->isOrdered())
+        {
+            // The calls to an object of an [Ordered] interface are served in order.
+            *key = static_cast<unsigned long>(req->capability.object) + 1;
+        }
+        return exported;
+    }
+
+    void unpin(RpcHdr* hdr, void* pinned)
+    {
+        Exported* exported = static_cast<Exported*>(pinned);
+        exported->object->release();
+        exportedTable.put(reinterpret_cast<RpcReq*>(hdr)->capability.object);
+    }
+
+    // Serves the message taken by a servant thread of the pool. The thread
+    // calls back to the client over the channel only if it owns the
+    // channel, and over its own channel otherwise.
+    void serve(RpcChannel* channel, RpcHdr* hdr, size_t size, int* fdv, int* fdmax, void* pinned)
+    {
+        if (hdr->cmd == RPC_REQ || hdr->cmd == RPC_ONEWAY)
+        {
+            std::map<pid_t, RpcChannel*>* map = getChannelMap();
+            std::map<pid_t, RpcChannel*>::iterator it = map->find(hdr->pid);
+            RpcChannel* own = (it != map->end()) ? (*it).second : 0;
+            bool owner = RpcPool::owns(channel);
+            if (owner)
+            {
+                (*map)[hdr->pid] = channel;
+            }
+            callLocal(reinterpret_cast<RpcReq*>(hdr), size, fdv, fdmax, channel);
+            if (owner)
+            {
+                if (own)
+                {
+                    (*map)[hdr->pid] = own;
+                }
+                else
+                {
+                    map->erase(hdr->pid);
+                }
+            }
+        }
+        else if (hdr->cmd == RPC_RELEASE)
+        {
+            releaseExported(reinterpret_cast<RpcRelease*>(hdr), channel);
+        }
+        else
+        {
+            for (int* fdp = fdv; fdp < fdmax; ++fdp)
+            {
+                close(*fdp);
+            }
+        }
+        if (pinned)
+        {
+            unpin(hdr, pinned);
+        }
     }
 
     void addChild(pid_t pid, Process* child);
@@ -773,8 +1037,55 @@ public:
         return exported;
     }
 
-    // RpcRes res = ;
-    int callLocal(RpcReq* hdr, int* fdv, int s)
+    // Gets the size of the string at data including the terminator, or zero
+    // if the string is not terminated before end.
+    static size_t getStringSize(const u8* data, const u8* end)
+    {
+        const u8* p = static_cast<const u8*>(memchr(data, '\0', end - data));
+        return p ? p + 1 - data : 0;
+    }
+
+    // Gets the length passed as a long after a buffer, or -1 if arg is not
+    // a long or is negative.
+    static int32_t getLength(const Any& arg)
+    {
+        if (arg.getType() != Any::TypeLong)
+        {
+            return -1;
+        }
+        return std::max(-1, static_cast<int32_t>(arg));
+    }
+
+    // Imports the object passed as a parameter by cap, whose file descriptor
+    // if any is taken from [fdv, fdmax). The object is appended to the
+    // imports [imports, importp), which can hold eight of them at most.
+    Object* importParameter(Capability* cap, const char* iid, int*& fdv, int* fdmax,
+                            Object** imports, Object**& importp, RpcRes* res)
+    {
+        if (imports + 8 <= importp)
+        {
+            res->exceptionCode = EMSGSIZE;
+            return 0;
+        }
+        if (cap->check == 0)
+        {
+            if (fdmax <= fdv)
+            {
+                res->exceptionCode = EBADMSG;
+                return 0;
+            }
+            cap->object = *fdv++;
+        }
+        Object* object = importObject(*cap, iid);
+        if (object)
+        {
+            *importp++ = object;
+        }
+        return object;
+    }
+
+    // Serves the request hdr of size bytes.
+    int callLocal(RpcReq* hdr, size_t size, int* fdv, int* fdmax, RpcChannel* channel)
     {
         RpcRes res = { RPC_RES, hdr->tag, getpid(), 0 };
         size_t resultSize = 0;
@@ -788,28 +1099,19 @@ public:
 
         unsigned methodNumber = hdr->methodNumber;
 
-        // Determine the type of interface and which method is being invoked.
-        Reflect::Interface interface = getInterface(exported->iid);
+        // The data following the arguments, whose length has been checked
+        // against paramCount on receipt.
+        u8* data = static_cast<u8*>(hdr->getData());
+        u8* end = reinterpret_cast<u8*>(hdr) + size;
 
-        // If this interface inherits another interface,
-        // methodNumber is checked accordingly.
-        if (interface.getInheritedMethodCount() + interface.getMethodCount() <= methodNumber)
+        // Look up the method being invoked in the descriptors built at export time.
+        const CallDescriptor* descriptor = exported->descriptors ? exported->descriptors->getMethod(methodNumber) : 0;
+        if (!descriptor)
         {
             res.exceptionCode = ENOSYS;
             return 0;   // TODO goto
         }
-        unsigned baseMethodCount;
-        Reflect::Interface super(interface);
-        for (;;)
-        {
-            baseMethodCount = super.getInheritedMethodCount();
-            if (baseMethodCount <= methodNumber)
-            {
-                break;
-            }
-            super = getInterface(super.getQualifiedSuperName().c_str());
-        }
-        Reflect::Method method(Reflect::Method(super.getMethod(methodNumber - baseMethodCount)));
+        const CallDescriptor& method(*descriptor);
 
 #ifdef VERBOSE
         printf("%s\n", method.getName().c_str());
@@ -817,16 +1119,16 @@ public:
 
         bool stringIsInterfaceName = false;
         // TODO Review later. Probably wrong...
-        if (super.getQualifiedSuperName() == "")
+        if (method.getKind() != CallDescriptor::Operation)
         {
             unsigned int count;
 
-            switch (methodNumber - baseMethodCount)
+            switch (method.getKind())
             {
-            case 0:  // queryInterface
+            case CallDescriptor::QueryInterface:
                 stringIsInterfaceName = true;
                 break;
-            case 1:  // addRef
+            case CallDescriptor::AddRef:
                 count = exported->addRef();
                 if (1 != count)
                 {
@@ -835,7 +1137,7 @@ public:
                 }
                 exportedTable.get(hdr->capability.object);
                 break;
-            case 2:  // release
+            case CallDescriptor::Release:
                 count = exported->release();
                 exportedTable.put(hdr->capability.object);
                 if (0 <= count) // TODO: ==?
@@ -845,6 +1147,27 @@ public:
                 res.result = Any(static_cast<uint32_t>(count));
                 // TODO should return?
                 break;
+            default:
+                break;
+            }
+        }
+        else if (exported->stub)
+        {
+            bool dispatched;
+            try
+            {
+                dispatched = exported->stub->dispatch(exported->object, methodNumber, hdr->getArgv(), data, end - data, &res.result);
+            }
+            catch (Exception& error)
+            {
+                // Raised by the method, to be thrown by the caller.
+                res.exceptionCode = error.getResult();
+                dispatched = true;
+            }
+            if (dispatched)
+            {
+                // Invoked through the typed skeleton.
+                return sendResult(hdr, &res, 0, 0, 0, 0, channel);
             }
         }
 
@@ -858,37 +1181,77 @@ public:
         *argp++ = Any(exported->object);
 
         // Reserve space from rpcStack to store result
-        int count;
+        int count = 0;
         void* resultPtr = 0;
-        Reflect::Type returnType = method.getReturnType();
+        RpcBulk resultBulk;
+        const ParameterDescriptor& returnType = method.getReturnType();
+        switch (returnType.getType())
+        {
+        case Reflect::kAny:
+        case Reflect::kString:
+        case Reflect::kSequence:
+            // The length of the buffer for the result follows it.
+            if (returnType.getType() != Reflect::kSequence || returnType.getSize() == 0)
+            {
+                if ((count = getLength(argp[1])) < 0)
+                {
+                    res.exceptionCode = EBADMSG;
+                    for (int* fdp = fdv; fdp < fdmax; ++fdp)
+                    {
+                        close(*fdp);
+                    }
+                    return sendResult(hdr, &res, 0, 0, 0, 0, channel);
+                }
+            }
+            break;
+        }
         switch (returnType.getType())
         {
         case Reflect::kAny:
-            resultSize = std::max(static_cast<int32_t>(sizeof(Capability)), static_cast<int32_t>(argp[1]));
+            resultSize = std::max(static_cast<int32_t>(sizeof(Capability)), count);
             resultPtr = RpcStack::alloc(resultSize);
             *argp++ = Any(reinterpret_cast<intptr_t>(resultPtr));
             ++argp;
             break;
         case Reflect::kString:
             // int op(char* buf, int len, ...);
-            resultPtr = RpcStack::alloc(static_cast<int32_t>(argp[1]));
+            resultPtr = RpcStack::alloc(count);
             *argp++ = Any(reinterpret_cast<intptr_t>(resultPtr));
             ++argp;
             break;
         case Reflect::kSequence:
             // int op(xxx* buf, int len, ...);
-            if ((count = returnType.getSize()) == 0)
+            if (returnType.getSize() == 0)
             {
-                Reflect::Sequence seq(returnType);
-                count = seq.getType().getSize() * static_cast<int32_t>(argp[1]);
-                resultPtr = RpcStack::alloc(count);
-                *argp++ = Any(reinterpret_cast<intptr_t>(resultPtr));
-                ++argp;
+                count *= returnType.getElementSize();
+            }
+            else
+            {
+                count = returnType.getSize();
+            }
+            if (0 < count && RPC_BULK_SIZE <= static_cast<size_t>(count))
+            {
+                // Let the method write the result directly into a region
+                // to be passed to the caller.
+                resultPtr = resultBulk.allocate(count);
+                if (!resultPtr)
+                {
+                    res.exceptionCode = errno;
+                    for (int* fdp = fdv; fdp < fdmax; ++fdp)
+                    {
+                        close(*fdp);
+                    }
+                    return sendResult(hdr, &res, 0, 0, 0, 0, channel);
+                }
             }
             else
             {
                 resultPtr = RpcStack::alloc(count);
-                *argp++ = Any(reinterpret_cast<intptr_t>(resultPtr));
+            }
+            *argp++ = Any(reinterpret_cast<intptr_t>(resultPtr));
+            if (returnType.getSize() == 0)
+            {
+                ++argp;
             }
             break;
         case Reflect::kArray:
@@ -903,12 +1266,20 @@ public:
             break;
         }
 
-        // Convert argp->size to argp->ptr
-        u8* data = static_cast<u8*>(hdr->getData());    // TODO review alignment issues
-        size_t size;
-        for (Reflect::Parameter param = method.listParameter(); param.next(); ++argp)
+        // The objects imported from the parameters, to be released after the call
+        Object* imports[8];
+        Object** importp = imports;
+
+        // The sequences passed out of line, to be unmapped after the call
+        RpcBulk bulks[8];
+        RpcBulk* bulkp = bulks;
+
+        // Convert argp->size to argp->ptr, stopping at the first argument
+        // not within the data. TODO review alignment issues
+        size_t length;
+        for (unsigned i = 0; i < method.getParameterCount() && !res.exceptionCode; ++i, ++argp)
         {
-            Reflect::Type type(param.getType());
+            const ParameterDescriptor& type(method.getParameter(i));
 
             switch (type.getType())
             {
@@ -918,22 +1289,26 @@ public:
                 case Any::TypeString:
                     if (static_cast<const char*>(*argp))
                     {
+                        if ((length = getStringSize(data, end)) == 0)
+                        {
+                            res.exceptionCode = EBADMSG;
+                            break;
+                        }
                         *argp = Any(reinterpret_cast<const char*>(data));
-                        size = strlen(reinterpret_cast<const char*>(data)) + 1;
-                        data += size;
+                        data += length;
                     }
                     break;
                 case Any::TypeObject:
                     if (static_cast<Object*>(*argp))
                     {
-                        // Import object
-                        Capability* cap = reinterpret_cast<Capability*>(data);
-                        if (cap->check == 0)
+                        if (static_cast<size_t>(end - data) < sizeof(Capability))
                         {
-                            cap->object = *fdv++;   // TODO check range
+                            res.exceptionCode = EBADMSG;
+                            break;
                         }
-                        Object* object = importObject(*cap, iid, true); // TODO false?
-                        *argp = Any(object);
+                        // Import object
+                        Capability* cap = reinterpret_cast<Capability*>(data);
+                        *argp = Any(importParameter(cap, iid, fdv, fdmax, imports, importp, &res));
                         data += sizeof(Capability);
                     }
                     break;
@@ -941,47 +1316,93 @@ public:
                 argp->makeVariant();
                 break;
             case Reflect::kSequence:
+            {
                 // xxx* buf, int len, ...
-                if ((size = type.getSize()) == 0)
+                if ((length = type.getSize()) == 0)
+                {
+                    int32_t elements = getLength(argp[1]);
+                    if (elements < 0)
+                    {
+                        res.exceptionCode = EBADMSG;
+                        break;
+                    }
+                    length = type.getElementSize() * elements;
+                }
+                void* ptr = data;
+                if (RPC_BULK_SIZE <= length)
+                {
+                    // Passed out of line
+                    ptr = 0;
+                    if (fdv < fdmax && bulkp < bulks + 8)
+                    {
+                        ptr = bulkp->map(*fdv++, length);
+                    }
+                    if (ptr)
+                    {
+                        ++bulkp;
+                    }
+                    else
+                    {
+                        res.exceptionCode = EBADMSG;
+                    }
+                }
+                else if (static_cast<size_t>(end - data) < length)
+                {
+                    ptr = 0;
+                    res.exceptionCode = EBADMSG;
+                }
+                else
+                {
+                    data += length;
+                }
+                if (type.getSize() == 0)
                 {
-                    Reflect::Sequence seq(type);
-                    size = seq.getType().getSize() * static_cast<uint32_t>(argp[1]);
-                    *argp++ = Any(reinterpret_cast<intptr_t>(data));
+                    *argp++ = Any(reinterpret_cast<intptr_t>(ptr));
                 }
                 else
                 {
-                    *argp = Any(reinterpret_cast<intptr_t>(data));
+                    *argp = Any(reinterpret_cast<intptr_t>(ptr));
                 }
-                data += size;
                 break;
+            }
             case Reflect::kString:
                 if (static_cast<const char*>(*argp))
                 {
+                    if ((length = getStringSize(data, end)) == 0)
+                    {
+                        res.exceptionCode = EBADMSG;
+                        break;
+                    }
                     if (stringIsInterfaceName)
                     {
                         iid = reinterpret_cast<const char*>(data);
                     }
                     *argp = Any(reinterpret_cast<const char*>(data));
-                    size = strlen(reinterpret_cast<const char*>(data)) + 1;
-                    data += size;
+                    data += length;
                 }
                 break;
             case Reflect::kArray:
-                size = type.getSize();
+                length = type.getSize();
+                if (static_cast<size_t>(end - data) < length)
+                {
+                    res.exceptionCode = EBADMSG;
+                    break;
+                }
                 *argp = Any(reinterpret_cast<intptr_t>(data));
-                data += size;
+                data += length;
                 break;
             case Reflect::kObject:
                 if (static_cast<Object*>(*argp))
                 {
-                    // Import object
-                    Capability* cap = reinterpret_cast<Capability*>(data);
-                    if (cap->check == 0)
+                    if (static_cast<size_t>(end - data) < sizeof(Capability))
                     {
-                        cap->object = *fdv++;   // TODO check range
+                        res.exceptionCode = EBADMSG;
+                        break;
                     }
-                    Object* object = importObject(*cap, stringIsInterfaceName ? iid : type.getQualifiedName().c_str(), true); // TODO false?
-                    *argp = Any(object);
+                    // Import object
+                    Capability* cap = reinterpret_cast<Capability*>(data);
+                    *argp = Any(importParameter(cap, stringIsInterfaceName ? iid : type.getQualifiedName().c_str(),
+                                                fdv, fdmax, imports, importp, &res));
                     data += sizeof(Capability);
                 }
                 break;
@@ -990,6 +1411,19 @@ public:
             }
         }
 
+        if (res.exceptionCode)
+        {
+            while (imports < importp)
+            {
+                (*--importp)->release();
+            }
+            for (int* fdp = fdv; fdp < fdmax; ++fdp)
+            {
+                close(*fdp);
+            }
+            return sendResult(hdr, &res, 0, 0, 0, 0, channel);
+        }
+
         // TODO Close unused fdv
 
         int fd;
@@ -1047,8 +1481,14 @@ public:
         case Reflect::kSequence:
         {
             res.result = apply(argc, argv, (int32_t (*)()) ((*object)[methodNumber]));
-            Reflect::Sequence seq(returnType);
-            resultSize = seq.getType().getSize() * static_cast<int32_t>(res.result);  // TODO: maybe set just the # of elements
+            resultSize = returnType.getElementSize() * static_cast<int32_t>(res.result);  // TODO: maybe set just the # of elements
+            if (resultBulk.getFd() != -1)
+            {
+                // Pass the region in place of the data; the caller copies
+                // the first resultSize bytes.
+                *fdp++ = resultBulk.getFd();
+                resultSize = 0;
+            }
             break;
         }
         case Reflect::kObject:  // TODO check Object and others
@@ -1069,15 +1509,38 @@ public:
             {
                 *fdp++ = cap->object;
             }
+            lease(channel->getPeer(), *cap);
 #ifdef VERBOSE
             printf("<<(%s) ", stringIsInterfaceName ? iid : returnType.getQualifiedName().c_str());
             cap->report();
 #endif
         }
 
-        // Send response
+        // The releases of the imported objects go ahead of the result.
+        while (imports < importp)
+        {
+            (*--importp)->release();
+        }
+
+        return sendResult(hdr, &res, resultPtr, resultSize, fdv, fdp, channel);
+    }
+
+    // Sends the result of the request hdr with the file descriptors in [fdv, fdp).
+    int sendResult(RpcReq* hdr, RpcRes* res, void* resultPtr, size_t resultSize, int* fdv, int* fdp, RpcChannel* channel)
+    {
+        // Let the next request of the client be served by a thread owning
+        // the channel.
+        RpcPool::disown();
+
+        if (hdr->cmd == RPC_ONEWAY)
+        {
+            // The caller does not wait for the result.
+            exportedTable.put(hdr->capability.object);
+            return 0;
+        }
+
         struct iovec iov[2];
-        iov[0].iov_base = &res;
+        iov[0].iov_base = res;
         iov[0].iov_len = sizeof(RpcRes);
 
         // Invoke method
@@ -1122,10 +1585,10 @@ public:
 
 #ifdef VERBOSE
         printf("Send RpcRes: %p %zd\n", resultPtr, resultSize);
-        esDump(&res, sizeof(RpcRes));
+        esDump(res, sizeof(RpcRes));
 #endif
 
-        int rc = sendmsg(s, &msg, 0);
+        int rc = channel->send(&msg);
 
         exportedTable.put(hdr->capability.object);
         return rc;
@@ -1142,46 +1605,25 @@ public:
             throw SystemException<EBADF>();
         }
 
-        // Determine the type of interface and which method is being invoked.
-        Reflect::Interface interface;
-        try
-        {
-            interface = getInterface(imported->iid);
-        }
-        catch (...)
-        {
-        }
-
-        // If this interface inherits another interface,
-        // methodNumber is checked accordingly.
-        if (interface.getInheritedMethodCount() + interface.getMethodCount() <= methodNumber)
+        // Look up the method being invoked in the descriptors built at import time.
+        const CallDescriptor* descriptor = imported->descriptors ? imported->descriptors->getMethod(methodNumber) : 0;
+        if (!descriptor)
         {
             throw SystemException<ENOSYS>();
         }
-        unsigned baseMethodCount;
-        Reflect::Interface super(interface);
-        for (;;)
-        {
-            baseMethodCount = super.getInheritedMethodCount();
-            if (baseMethodCount <= methodNumber)
-            {
-                break;
-            }
-            super = getInterface(super.getQualifiedSuperName().c_str());
-        }
-        Reflect::Method method(Reflect::Method(super.getMethod(methodNumber - baseMethodCount)));
+        const CallDescriptor& method(*descriptor);
 
         bool stringIsInterfaceName = false;
-        if (super.getQualifiedSuperName() == "")
+        if (method.getKind() != CallDescriptor::Operation)
         {
             int count;
 
-            switch (methodNumber - baseMethodCount)
+            switch (method.getKind())
             {
-            case 0:  // queryInterface
+            case CallDescriptor::QueryInterface:
                 stringIsInterfaceName = true;
                 break;
-            case 1:  // addRef
+            case CallDescriptor::AddRef:
                 count = imported->addRef();
                 if (1 != count)
                 {
@@ -1189,7 +1631,7 @@ public:
                 }
                 importedTable.get(interfaceNumber);
                 break;
-            case 2:  // release
+            case CallDescriptor::Release:
                 count = imported->release();
                 importedTable.put(interfaceNumber);
                 if (0 <= count)
@@ -1198,6 +1640,8 @@ public:
                 }
                 return count;
                 break;
+            default:
+                break;
             }
         }
 
@@ -1213,15 +1657,46 @@ public:
         return result;
     }
 
-    int makeConnection(const Capability& cap)
+    // Sends the request marshaled by a typed proxy.
+    Any callRemote(int interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt)
     {
-        struct sockaddr_un  sa;
-        struct msghdr       msg;
+        Imported* imported = importedTable.get(interfaceNumber);
+        if (!imported)
+        {
+            throw SystemException<EBADF>();
+        }
+
+        Any result = ::callRemote(imported->capability, req, iov, iovcnt);
+
+        importedTable.put(interfaceNumber);
+        return result;
+    }
+
+    // Sends the request marshaled by a typed proxy without waiting for the result.
+    void callRemote(int interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future)
+    {
+        Imported* imported = importedTable.get(interfaceNumber);
+        if (!imported)
+        {
+            throw SystemException<EBADF>();
+        }
+
+        ::sendRemote(imported->capability, req, iov, iovcnt, future);
+
+        importedTable.put(interfaceNumber);
+    }
+
+    RpcChannel* makeConnection(const Capability& cap)
+    {
+        struct sockaddr_un  sa;
+        struct msghdr       msg;
         struct iovec        iov;
         struct cmsghdr*     cmsg;
         int                 pair[2];
 
-        if (socketpair(PF_UNIX, SOCK_DGRAM, 0, pair) == -1)
+        // SOCK_SEQPACKET rather than SOCK_DGRAM so that the server sees the
+        // client has gone.
+        if (socketpair(PF_UNIX, SOCK_SEQPACKET, 0, pair) == -1)
         {
             perror("socketpair");
             esThrow(errno);
@@ -1230,11 +1705,15 @@ public:
         msg.msg_name = getSocketAddress(cap.pid, &sa);
         msg.msg_namelen = sizeof sa;
 
+        int ringfd;
+        void* rings = RpcChannel::createRings(&ringfd);
+
         CmdChanReq cmd =
         {
             CMD_CHAN_REQ,
             getpid(),
-            pair[1]
+            pair[1],
+            ringfd
             // TODO - set ThreadCredential here
         };
         iov.iov_base = &cmd;
@@ -1243,39 +1722,47 @@ public:
         msg.msg_iov = &iov;
         msg.msg_iovlen = 1;
 
-        unsigned char buf[CMSG_SPACE(sizeof(int))];
+        int fdc = rings ? 2 : 1;
+        unsigned char buf[CMSG_SPACE(2 * sizeof(int))];
         msg.msg_control = buf;
         msg.msg_controllen = sizeof buf;
         cmsg = CMSG_FIRSTHDR(&msg);
         cmsg->cmsg_level = SOL_SOCKET;
         cmsg->cmsg_type = SCM_RIGHTS;
-        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
-        *(int*) CMSG_DATA(cmsg) = pair[1];
+        cmsg->cmsg_len = CMSG_LEN(fdc * sizeof(int));
+        memcpy((int*) CMSG_DATA(cmsg), &cmd.sockfd, fdc * sizeof(int));   // sockfd and ringfd
         msg.msg_controllen = cmsg->cmsg_len;
 
         msg.msg_flags = 0;
 
         ssize_t rc = sendmsg(sockfd, &msg, 0);
+        if (0 <= ringfd)
+        {
+            close(ringfd);
+        }
         if (rc == -1)
         {
+            RpcChannel::unmapRings(rings);
             close(pair[0]);
             close(pair[1]);
             esThrow(errno);
         }
-        // perhaps wait here by recvmsg(pair[1], ...)  // Note waiting not on sockfd
 
-        // add pair[0] to the poll list
-        struct epoll_event event;
-        event.events = EPOLLIN | EPOLLOUT;
-        event.data.fd = pair[0];
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, pair[0], &event) == -1)
+        // The rings are used only if the peer has mapped them.
+        if (rings)
         {
-            perror("epoll_ctl");
-            exit(EXIT_FAILURE);
+            CmdChanRes res;
+            rc = recv(pair[0], &res, sizeof res, 0);
+            if (rc != sizeof res || res.cmd != CMD_CHAN_RES || !res.ring)
+            {
+                RpcChannel::unmapRings(rings);
+                rings = 0;
+            }
         }
-        (*socketMap)[cap.pid] = pair[0];
 
-        return pair[0];
+        RpcChannel* channel = new RpcChannel(pair[0], rings, true, cap.pid);
+        (*channelMap)[cap.pid] = channel;
+        return channel;
     }
 
     int getControlSocket()
@@ -1378,6 +1865,11 @@ public:
 
             if (0 <= pid)
             {
+                ::current.lease(pid, cmd.in);
+                ::current.lease(pid, cmd.out);
+                ::current.lease(pid, cmd.error);
+                ::current.lease(pid, cmd.current);
+                ::current.lease(pid, cmd.root);
                 ::current.addChild(pid, this);
             }
 
@@ -1688,12 +2180,60 @@ unsigned int Process::Constructor::release()
     return 1;
 }
 
+// Passes the messages queued in the pool to the System.
+class PoolServant : public RpcPool::Servant
+{
+public:
+    void* accept(RpcChannel* channel, RpcHdr* hdr, unsigned long* key)
+    {
+        return ::current.pin(hdr, key);
+    }
+
+    void serve(RpcChannel* channel, RpcHdr* hdr, size_t size, int* fdv, int* fdmax, void* cookie)
+    {
+        ::current.serve(channel, hdr, size, fdv, fdmax, cookie);
+    }
+
+    // The threads of the pool lock the monitors of the System, which needs
+    // them to be es::Threads.
+    bool start(void* (*run)(void*), void* param)
+    {
+        es::Thread* thread = ::current.createThread((void*) run, param);
+        thread->start();
+        return true;
+    }
+};
+
 // Process system commands
 void* System::focus(void* param)
 {
     printf("front\n");
+    static PoolServant poolServant;
+    pool = RpcPool::create(&poolServant);
+    long long renewal = getMilliseconds() + LEASE_PERIOD;
+    long long flush = getMilliseconds() + RpcChannel::RELEASE_INTERVAL;
     for (;;)
     {
+        long long now = getMilliseconds();
+        if (flush <= now)
+        {
+            flushReleases();
+            flush = now + RpcChannel::RELEASE_INTERVAL;
+            continue;
+        }
+        if (renewal <= now)
+        {
+            ::current.renewLeases();
+            renewal = now + LEASE_PERIOD;
+            continue;
+        }
+        long long timeout = std::min(renewal, flush) - now;
+        struct pollfd pfd = { ::current.sockfd, POLLIN, 0 };
+        if (poll(&pfd, 1, static_cast<int>(timeout)) <= 0)
+        {
+            continue;
+        }
+
         CmdUnion cmd;
         ssize_t rc = receiveCommand(::current.sockfd, &cmd);
         if (rc == -1)
@@ -1705,23 +2245,29 @@ void* System::focus(void* param)
         switch (cmd.cmd)
         {
         case CMD_CHAN_REQ: {
-            int epfd = epoll_create(1);
-            if (epfd < 0)
+            void* rings = 0;
+            if (0 <= cmd.chanReq.ringfd)
             {
-                perror("epoll_create");
-                ::exit(EXIT_FAILURE);
+                // The client waits for CMD_CHAN_RES only when it offers the rings.
+                // The pool cannot wait for the rings.
+                rings = pool ? 0 : RpcChannel::mapRings(cmd.chanReq.ringfd);
+                close(cmd.chanReq.ringfd);
+                CmdChanRes res = { CMD_CHAN_RES, getpid(), cmd.chanReq.tc, rings ? 1 : 0 };
+                if (send(cmd.chanReq.sockfd, &res, sizeof res, MSG_NOSIGNAL) != sizeof res)
+                {
+                    RpcChannel::unmapRings(rings);
+                    close(cmd.chanReq.sockfd);
+                    break;
+                }
             }
-            struct epoll_event event;
-            event.events = EPOLLIN | EPOLLOUT;
-            event.data.fd = cmd.chanReq.sockfd;
-            if (epoll_ctl(epfd, EPOLL_CTL_ADD, cmd.chanReq.sockfd, &event) == -1)
+            RpcChannel* channel = new RpcChannel(cmd.chanReq.sockfd, rings, false);
+            if (pool)
             {
-                perror("epoll_ctl");
-                ::exit(EXIT_FAILURE);
+                pool->add(channel);
+                break;
             }
-            // TODO check ThreadCredential and if the thread is created already, just ad fd to its socketMap.
-            es::Thread* thread = ::current.createThread((void*) servant, (void*) epfd);
-            // client is not waited right now - sendmsg(fd, CMD_CHAN_RES);
+            // TODO check ThreadCredential and if the thread is created already, just ad fd to its channelMap.
+            es::Thread* thread = ::current.createThread((void*) servant, channel);
             thread->start();
             break;
         }
@@ -1785,6 +2331,26 @@ u64 getRandom()
     return current.getRandom();
 }
 
+long long getMilliseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+const RpcStub* getStub(const char* iid)
+{
+    const RpcStub* stub = 0;
+    pthread_mutex_lock(&stubLock);
+    std::map<const char*, const RpcStub*>::iterator it = stubMap.find(iid);
+    if (it != stubMap.end())
+    {
+        stub = (*it).second;
+    }
+    pthread_mutex_unlock(&stubLock);
+    return stub;
+}
+
 long long callRemote(void* self, void* base, int methodNumber, va_list ap)
 {
     unsigned interfaceNumber = static_cast<void**>(self) - static_cast<void**>(base);
@@ -1800,34 +2366,235 @@ long long callRemote(void* self, void* base, int methodNumber, va_list ap)
     return current.callRemote(interfaceNumber, methodNumber, ap, variant);
 }
 
-long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, Reflect::Method& method,
-                     bool stringIsInterfaceName, Any* variant)
+std::map<pid_t, RpcChannel*>* getChannelMap()
+{
+    if (!channelMap)
+    {
+        // TODO Register map<tid_t, channelMap> to system
+        channelMap = new std::map<pid_t, RpcChannel*>;  // TODO clean up after thread termination
+        RpcStack::init();
+    }
+    return channelMap;
+}
+
+// Gets the channel to the process of cap, connecting to it if necessary.
+RpcChannel* getChannel(const Capability& cap)
+{
+    getChannelMap();
+    std::map<pid_t, RpcChannel*>::iterator it = channelMap->find(cap.pid);
+    if (it != channelMap->end())
+    {
+        return (*it).second;
+    }
+    return current.makeConnection(cap);
+}
+
+// Queues the release of count references to the object exported by another
+// process. The releases are sent in a batch over the channel of this thread
+// to the process, which keeps them in order with the requests sent before.
+void releaseRemote(const Capability& cap, unsigned count)
 {
-    if (epfd < 0)
+    try
     {
-        epfd = epoll_create(1);
-        if (epfd < 0)
+        RpcChannel* channel = getChannel(cap);
+        while (count--)
         {
-            perror("epoll_create");
-            exit(EXIT_FAILURE);
+            channel->release(cap);
         }
+    }
+    catch (...)
+    {
+        // The process has gone with its objects.
+    }
+}
 
-        // TODO Register map<tid_t, int epfd> to system
-        socketMap = new std::map<pid_t, int>;   // TODO clean up after thread termination
-        RpcStack::init();
+// Queues the release of count references without connecting to the
+// exporter, as the imported objects are destroyed in any context. The
+// releases are queued in the channel of this thread if it has one, or
+// otherwise passed to the focus thread.
+void queueRelease(const Capability& cap, unsigned count)
+{
+    if (channelMap)
+    {
+        std::map<pid_t, RpcChannel*>::iterator it = channelMap->find(cap.pid);
+        if (it != channelMap->end())
+        {
+            while (count--)
+            {
+                (*it).second->release(cap);
+            }
+            return;
+        }
+    }
+    pthread_mutex_lock(&deferredLock);
+    deferredReleases.push_back(std::make_pair(cap, count));
+    pthread_mutex_unlock(&deferredLock);
+}
+
+// Sends the releases passed to the focus thread, and the ones left queued
+// in the channels of all the threads.
+void flushReleases()
+{
+    std::deque<std::pair<Capability, unsigned> > releases;
+    pthread_mutex_lock(&deferredLock);
+    releases.swap(deferredReleases);
+    pthread_mutex_unlock(&deferredLock);
+    while (!releases.empty())
+    {
+        releaseRemote(releases.front().first, releases.front().second);
+        releases.pop_front();
+    }
+    RpcChannel::flushAll();
+}
+
+// Waits for the reply to the request tagged tag, or for future to get its
+// reply if future is not zero. Note the thread might receive another
+// request by recursive call, etc. As the calls are synchronous, they come
+// only from the peer of this channel. The replies to the other requests in
+// flight are passed to their futures.
+RpcRes* receiveReply(RpcChannel* channel, int tag, int* fdv, int*& fdmax, RpcFuture* future = 0)
+{
+    for (;;)
+    {
+        RpcStack stackBase;
+
+        if (future && future->isReady())
+        {
+            // Delivered while serving a request.
+            fdmax = fdv;
+            return 0;
+        }
+
+        size_t size;
+        RpcHdr* hdr = RpcPool::receive(channel, fdv, fdmax, &size);
+        if (!hdr)
+        {
+            // The peer has gone.
+            esThrow(ECONNRESET);
+        }
+        std::map<pid_t, RpcChannel*>::iterator it = channelMap->find(hdr->pid);
+        if (it == channelMap->end())
+        {
+            (*channelMap)[hdr->pid] = channel;
+        }
+        if (hdr->cmd == RPC_REQ || hdr->cmd == RPC_ONEWAY)
+        {
+            current.callLocal(reinterpret_cast<RpcReq*>(hdr), size, fdv, fdmax, channel);
+            continue;
+        }
+        if (hdr->cmd == RPC_RELEASE)
+        {
+            current.releaseExported(reinterpret_cast<RpcRelease*>(hdr), channel);
+            continue;
+        }
+        if (hdr->cmd == RPC_RES)
+        {
+            RpcRes* res = reinterpret_cast<RpcRes*>(hdr);
+            if (!future && res->tag == tag)
+            {
+                return res;
+            }
+            channel->deliver(res);
+            for (int* fdp = fdv; fdp < fdmax; ++fdp)
+            {
+                close(*fdp);
+            }
+        }
     }
+}
+
+// Sends the request marshaled by a typed proxy.
+// @return the tag of the request.
+int sendRequest(RpcChannel* channel, const Capability& cap, int cmd, RpcReq* req, struct iovec* iov, int iovcnt)
+{
+    int tag = ++rpctag;
+    req->cmd = cmd;
+    req->tag = tag;
+    req->pid = getpid();
+    req->capability = cap;
+    iov[0].iov_base = req;
+    iov[0].iov_len = sizeof(RpcReq) + sizeof(Any) * req->paramCount;
 
-    int s;  // socket to be used
+    struct msghdr msg;
+
+    msg.msg_name = 0;
+    msg.msg_namelen = 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    msg.msg_control = 0;
+    msg.msg_controllen = 0;
+    msg.msg_flags = 0;
 
-    std::map<pid_t, int>::iterator it = socketMap->find(cap.pid);
-    if (it != socketMap->end())
+    if (channel->send(&msg) == -1)
     {
-        s = (*it).second;
+        esThrow(errno);
     }
-    else
+    return tag;
+}
+
+Any callRemote(const Capability& cap, RpcReq* req, struct iovec* iov, int iovcnt)
+{
+    RpcChannel* channel = getChannel(cap);
+    RpcPool::Wait wait(channel);
+    int tag = sendRequest(channel, cap, RPC_REQ, req, iov, iovcnt);
+
+    int fdv[8];
+    int* fdmax;
+    RpcRes* res = receiveReply(channel, tag, fdv, fdmax);
+    for (int* fdp = fdv; fdp < fdmax; ++fdp)
+    {
+        close(*fdp);
+    }
+    if (res->exceptionCode)
+    {
+        esThrow(res->exceptionCode);
+    }
+    return res->result;
+}
+
+void sendRemote(const Capability& cap, RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future)
+{
+    RpcChannel* channel = getChannel(cap);
+    int tag = sendRequest(channel, cap, future ? RPC_REQ : RPC_ONEWAY, req, iov, iovcnt);
+    if (future)
+    {
+        channel->expect(future, tag);
+    }
+}
+
+// Copies the string result src into the buffer dst of len bytes supplied by
+// the caller, truncating it if it does not fit.
+void copyString(char* dst, int len, const char* src)
+{
+    if (0 < len)
     {
-        s = current.makeConnection(cap);
+        strncpy(dst, src, len);
+        dst[len - 1] = '\0';
     }
+}
+
+// Appends fd to the file descriptors [fdv, fdp) to be passed in a request,
+// which can hold eight of them at most. Otherwise closes them all and fd.
+void passDescriptor(int* fdv, int*& fdp, int fd)
+{
+    if (fdp < fdv + 8)
+    {
+        *fdp++ = fd;
+        return;
+    }
+    close(fd);
+    while (fdv < fdp)
+    {
+        close(*--fdp);
+    }
+    esThrow(EMSGSIZE);  // TODO cancel export
+}
+
+long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, const CallDescriptor& method,
+                     bool stringIsInterfaceName, Any* variant)
+{
+    RpcChannel* channel = getChannel(cap);  // channel to be used
+    RpcPool::Wait wait(channel);
 
     // Pack arguments
     int tag = ++rpctag;
@@ -1835,7 +2602,7 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
     {
         RpcReq  req;
         Any argv[9];
-    } rpcmsg = { RPC_REQ, tag, getpid(), cap, methodNumber };
+    } rpcmsg = { method.isOneway() ? RPC_ONEWAY : RPC_REQ, tag, getpid(), cap, methodNumber };
     Any* argp = rpcmsg.argv;
     Capability caps[8];
     Capability* capp = caps;
@@ -1855,7 +2622,7 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
     // Set this
     *argp++ = Any(static_cast<intptr_t>(0));  // to be filled by the server
 
-    Reflect::Type returnType = method.getReturnType();
+    const ParameterDescriptor& returnType = method.getReturnType();
     switch (returnType.getType())
     {
     case Reflect::kAny:
@@ -1881,9 +2648,9 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
     }
 
     // TODO: padding
-    for (Reflect::Parameter param = method.listParameter(); param.next(); ++argp)
+    for (unsigned i = 0; i < method.getParameterCount(); ++i, ++argp)
     {
-        Reflect::Type type(param.getType());
+        const ParameterDescriptor& type(method.getParameter(i));
         switch (type.getType())
         {
         case Reflect::kAny:
@@ -1904,11 +2671,12 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
                 {
                     Object* object = static_cast<Object*>(*argp);
                     current.exportObject(object, iid, capp, true);  // TODO check error
+                    current.lease(cap.pid, *capp);
                     iop->iov_base = capp;
                     iop->iov_len = sizeof(Capability);
                     if (capp->check == 0)
                     {
-                        *fdp++ = capp->object;
+                        passDescriptor(fdv, fdp, capp->object);
                     }
                     ++capp;
                     ++iop;
@@ -1922,9 +2690,24 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
             *argp = Any(reinterpret_cast<intptr_t>(iop->iov_base));
             if ((count = type.getSize()) == 0)
             {
-                Reflect::Sequence seq(type);
                 *++argp = Any(va_arg(ap, int32_t));
-                count = seq.getType().getSize() * static_cast<int32_t>(*argp);
+                count = type.getElementSize() * static_cast<int32_t>(*argp);
+            }
+            if (0 < count && RPC_BULK_SIZE <= static_cast<size_t>(count))
+            {
+                // Pass the data out of line.
+                int fd = RpcBulk::create(iop->iov_base, count);
+                if (fd == -1)
+                {
+                    int error = errno;
+                    while (fdv < fdp)
+                    {
+                        close(*--fdp);
+                    }
+                    esThrow(error);    // TODO cancel export
+                }
+                passDescriptor(fdv, fdp, fd);
+                break;
             }
             iop->iov_len = count;
             ++iop;
@@ -1954,11 +2737,12 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
             if (object)
             {
                 current.exportObject(object, stringIsInterfaceName ? iid : type.getQualifiedName().c_str(), capp, true);  // TODO check error
+                current.lease(cap.pid, *capp);
                 iop->iov_base = capp;
                 iop->iov_len = sizeof(Capability);
                 if (capp->check == 0)
                 {
-                    *fdp++ = capp->object;
+                    passDescriptor(fdv, fdp, capp->object);
                 }
                 ++capp;
                 ++iop;
@@ -2013,7 +2797,7 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
     iov[0].iov_len = sizeof(RpcReq) + sizeof(Any) * argc;
 
 #ifdef VERBOSE
-    printf("Send RpcReq: %d %d\n", s, argc);
+    printf("Send RpcReq: %d %d\n", channel->getSocket(), argc);
     esDump(&rpcmsg, sizeof(RpcReq));
     for (int i = 0; i < argc; ++i) {
         esDump((char*) &rpcmsg + sizeof(RpcReq) + sizeof(Any) * i, sizeof(Any));
@@ -2051,7 +2835,7 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
 
     msg.msg_flags = 0;
 
-    if (sendmsg(s, &msg, 0) == -1)
+    if (channel->send(&msg) == -1)
     {
         // TODO cancel export
         esThrow(errno);
@@ -2063,31 +2847,100 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
         close(*p);
     }
 
-    // if the method doesn't return anything including exceptions, we could simply return here.
+    if (method.isOneway())
+    {
+        // The method doesn't return anything including exceptions.
+        return 0;
+    }
 
-    // wait for the reply. note the thread might receive another request by recursive call, etc.
-    RpcHdr* hdr;
     int* fdmax;
-    for (;;)
-    {
-        RpcStack stackBase;
+    RpcRes* res = receiveReply(channel, tag, fdv, fdmax);
 
-        hdr = receiveMessage(epfd, fdv, fdmax, &s);
-        std::map<pid_t, int>::iterator it = socketMap->find(hdr->pid);
-        if (it == socketMap->end())
+    // restore response
+    fdp = fdv;
+    if (res->exceptionCode)
+    {
+        while (fdp < fdmax)
         {
-            (*socketMap)[hdr->pid] = s;
+            close(*fdp++);
         }
-        if (hdr->cmd == RPC_REQ)
+        esThrow(res->exceptionCode);
+    }
+    long long rc;
+    switch (returnType.getType())
+    {
+    case Reflect::kAny:
+        switch (res->result.getType())
         {
-            current.callLocal(reinterpret_cast<RpcReq*>(hdr), fdv, s);
-            continue;
+        case Any::TypeString:
+            if (static_cast<const char*>(res->result))
+            {
+                res->result = Any(reinterpret_cast<const char*>(static_cast<intptr_t>(rpcmsg.argv[1])));
+                copyString(const_cast<char*>(static_cast<const char*>(res->result)), static_cast<int32_t>(rpcmsg.argv[2]),
+                           reinterpret_cast<const char*>(res->getData()));
+            }
+            break;
+        case Any::TypeObject:
+            if (static_cast<Object*>(res->result))
+            {
+                Capability* cap = static_cast<Capability*>(res->getData());
+                if (cap->check == 0 && (fdmax - fdp) == 1)
+                {
+                    // Set cap->object to received fd number
+                    cap->object = *fdp++;
+                    // TODO Set exec on close to cap->object
+                }
+#ifdef VERBOSE
+                printf(">>(%s) ", iid);
+                cap->report();
+#endif
+                res->result = current.importObject(*cap, iid);
+            }
+            else
+            {
+                res->result = Any(static_cast<Object*>(0));
+            }
+            break;
         }
-        if (hdr->cmd == RPC_RES && hdr->tag == tag)
+        assert(variant);
+        *variant = res->result;
+        res->result = Any(reinterpret_cast<intptr_t>(variant));
+        break;
+    case Reflect::kString:
+        if (static_cast<const char*>(res->result))
+        {
+            res->result = Any(reinterpret_cast<const char*>(static_cast<intptr_t>(rpcmsg.argv[1])));
+            copyString(const_cast<char*>(static_cast<const char*>(res->result)), static_cast<int32_t>(rpcmsg.argv[2]),
+                       reinterpret_cast<const char*>(res->getData()));
+        }
+        break;
+    case Reflect::kSequence:
+        rc = static_cast<int32_t>(res->result);
+        if ((count = returnType.getSize()) == 0)
+        {
+            count = returnType.getElementSize() * static_cast<int32_t>(rpcmsg.argv[2]);
+        }
+        if (0 < rc && std::max(count, 0) < returnType.getElementSize() * rc)
+        {
+            // Keep the peer from writing past the end of the buffer.
+            rc = std::max(count, 0) / returnType.getElementSize();
+            res->result = Any(static_cast<int32_t>(rc));
+        }
+        if (0 < count && RPC_BULK_SIZE <= static_cast<size_t>(count))
         {
-            // restore response
-            fdp = fdv;
-            RpcRes* res(reinterpret_cast<RpcRes*>(hdr));
+            // The result has been written out of line.
+            if (fdp == fdmax)
+            {
+                esThrow(EBADMSG);
+            }
+            int fd = *fdp++;
+            if (0 < rc && !RpcBulk::read(fd, reinterpret_cast<void*>(static_cast<intptr_t>(rpcmsg.argv[1])),
+                                         returnType.getElementSize() * rc))
+            {
+                rc = 0;
+                res->exceptionCode = EBADMSG;
+            }
+            close(fd);
             if (res->exceptionCode)
             {
                 while (fdp < fdmax)
@@ -2096,122 +2949,79 @@ long long callRemote(const Capability& cap, unsigned methodNumber, va_list ap, R
                 }
                 esThrow(res->exceptionCode);
             }
-            long long rc;
-            switch (returnType.getType())
+        }
+        else if (0 < rc)
+        {
+            memmove(reinterpret_cast<void*>(static_cast<intptr_t>(rpcmsg.argv[1])), res->getData(),
+                    returnType.getElementSize() * rc);
+        }
+        break;
+    case Reflect::kObject:
+        if (static_cast<Object*>(res->result))
+        {
+            Capability* cap = static_cast<Capability*>(res->getData());
+            if (cap->check == 0 && (fdmax - fdp) == 1)
             {
-            case Reflect::kAny:
-                switch (res->result.getType())
-                {
-                case Any::TypeString:
-                    if (static_cast<const char*>(res->result))
-                    {
-                        res->result = Any(reinterpret_cast<const char*>(static_cast<intptr_t>(rpcmsg.argv[1])));
-                        strcpy(const_cast<char*>(static_cast<const char*>(res->result)), reinterpret_cast<const char*>(res->getData()));  // TODO: Check length
-                    }
-                    break;
-                case Any::TypeObject:
-                    if (static_cast<Object*>(res->result))
-                    {
-                        Capability* cap = static_cast<Capability*>(res->getData());
-                        if (cap->check == 0 && (fdmax - fdp) == 1)
-                        {
-                            // Set cap->object to received fd number
-                            cap->object = *fdp++;
-                            // TODO Set exec on close to cap->object
-                        }
-#ifdef VERBOSE
-                        printf(">>(%s) ", iid);
-                        cap->report();
-#endif
-                        res->result = current.importObject(*cap, iid, false);
-                    }
-                    else
-                    {
-                        res->result = Any(static_cast<Object*>(0));
-                    }
-                    break;
-                }
-                assert(variant);
-                *variant = res->result;
-                res->result = Any(reinterpret_cast<intptr_t>(variant));
-                break;
-            case Reflect::kString:
-                if (static_cast<const char*>(res->result))
-                {
-                    res->result = Any(reinterpret_cast<const char*>(static_cast<intptr_t>(rpcmsg.argv[1])));
-                    strcpy(const_cast<char*>(static_cast<const char*>(res->result)), reinterpret_cast<const char*>(res->getData()));  // TODO: Check length
-                }
-                break;
-            case Reflect::kSequence:
-                rc = static_cast<int32_t>(res->result);
-                if (0 < rc)
-                {
-                    Reflect::Sequence seq(returnType);
-                    memmove(reinterpret_cast<void*>(static_cast<intptr_t>(rpcmsg.argv[1])), res->getData(),
-                            seq.getType().getSize() * rc);
-                }
-                break;
-            case Reflect::kObject:
-                if (static_cast<Object*>(res->result))
-                {
-                    Capability* cap = static_cast<Capability*>(res->getData());
-                    if (cap->check == 0 && (fdmax - fdp) == 1)
-                    {
-                        // Set cap->object to received fd number
-                        cap->object = *fdp++;
-                        // TODO Set exec on close to cap->object
-                    }
+                // Set cap->object to received fd number
+                cap->object = *fdp++;
+                // TODO Set exec on close to cap->object
+            }
 #ifdef VERBOSE
-                    printf(">>(%s:%d) ", stringIsInterfaceName ? iid : returnType.getQualifiedName().c_str(), stringIsInterfaceName);
-                    cap->report();
+            printf(">>(%s:%d) ", stringIsInterfaceName ? iid : returnType.getQualifiedName().c_str(), stringIsInterfaceName);
+            cap->report();
 #endif
-                    res->result = current.importObject(*cap, stringIsInterfaceName ? iid : returnType.getQualifiedName().c_str(), false);
-                }
-                else
-                {
-                    res->result = Any(static_cast<Object*>(0));
-                }
-                break;
-            case Reflect::kArray:
-                memcpy(reinterpret_cast<void*>(static_cast<intptr_t>(rpcmsg.argv[1])), res->getData(),
-                       returnType.getSize());
-                break;
-            case Reflect::kVoid:
-                break;
-            }
-            while (fdp < fdmax)
-            {
-                close(*fdp++);
-            }
-            return evaluate(res->result);
-            break;
+            res->result = current.importObject(*cap, stringIsInterfaceName ? iid : returnType.getQualifiedName().c_str());
+        }
+        else
+        {
+            res->result = Any(static_cast<Object*>(0));
         }
+        break;
+    case Reflect::kArray:
+        memcpy(reinterpret_cast<void*>(static_cast<intptr_t>(rpcmsg.argv[1])), res->getData(),
+               returnType.getSize());
+        break;
+    case Reflect::kVoid:
+        break;
+    }
+    while (fdp < fdmax)
+    {
+        close(*fdp++);
     }
+    return evaluate(res->result);
 }
 
 void* System::servant(void* param)
 {
-    struct msghdr msg;
     int fdv[8];
     int* fdmax;
-    int s;
 
-    epfd = reinterpret_cast<intptr_t>(param);
-    socketMap = new std::map<pid_t, int>;   // TODO clean up after thread termination
+    RpcChannel* channel = static_cast<RpcChannel*>(param);
+    channelMap = new std::map<pid_t, RpcChannel*>;  // TODO clean up after thread termination
     RpcStack::init();
     for (;;)
     {
         RpcStack stackBase;
-        RpcHdr* hdr = receiveMessage(epfd, fdv, fdmax, &s); // TODO check message length msg.msg_iov[0].iov_len
-        std::map<pid_t, int>::iterator it = socketMap->find(hdr->pid);
-        if (it == socketMap->end())
+        size_t size;
+        RpcHdr* hdr = channel->receive(fdv, fdmax, &size);
+        if (!hdr)
         {
-            (*socketMap)[hdr->pid] = s;
+            // The client has gone.
+            break;
+        }
+        std::map<pid_t, RpcChannel*>::iterator it = channelMap->find(hdr->pid);
+        if (it == channelMap->end())
+        {
+            (*channelMap)[hdr->pid] = channel;
         }
-        if (hdr->cmd == RPC_REQ)
+        if (hdr->cmd == RPC_REQ || hdr->cmd == RPC_ONEWAY)
         {
             // Look up the exportedTable and invoke method internally
-            ::current.callLocal(reinterpret_cast<RpcReq*>(hdr), fdv, s);
+            ::current.callLocal(reinterpret_cast<RpcReq*>(hdr), size, fdv, fdmax, channel);
+        }
+        else if (hdr->cmd == RPC_RELEASE)
+        {
+            ::current.releaseExported(reinterpret_cast<RpcRelease*>(hdr), channel);
         }
         else
         {
@@ -2221,6 +3031,8 @@ void* System::servant(void* param)
             }
         }
     }
+    delete channel;
+    return 0;
 }
 
 void initializeConstructors()
@@ -2235,3 +3047,70 @@ es::CurrentProcess* System()
 {
     return &current;
 }
+
+namespace es
+{
+
+void registerStub(const char* iid, const RpcStub* stub)
+{
+    iid = getUniqueIdentifier(iid);
+    if (!iid)
+    {
+        return;
+    }
+    pthread_mutex_lock(&stubLock);
+    stubMap[iid] = stub;
+    pthread_mutex_unlock(&stubLock);
+}
+
+bool getRpcPoolStats(RpcPoolStats* stats)
+{
+    if (!pool)
+    {
+        return false;
+    }
+    pool->getStats(stats);
+    return true;
+}
+
+Any invokeRemote(unsigned interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt)
+{
+    return current.callRemote(interfaceNumber, req, iov, iovcnt);
+}
+
+void invokeRemote(unsigned interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future)
+{
+    current.callRemote(interfaceNumber, req, iov, iovcnt, future);
+}
+
+long long invokeRemote(unsigned interfaceNumber, unsigned methodNumber, va_list ap, Any* variant)
+{
+    return current.callRemote(interfaceNumber, methodNumber, ap, variant);
+}
+
+void RpcFuture::wait()
+{
+    if (!channel)
+    {
+        esThrow(EINVAL);
+    }
+
+    RpcPool::Wait wait(channel);
+    int fdv[8];
+    int* fdmax;
+    receiveReply(channel, tag, fdv, fdmax, this);
+}
+
+void RpcFuture::abandon()
+{
+    try
+    {
+        wait();
+    }
+    catch (...)
+    {
+        channel->forget(this);
+    }
+}
+
+}   // namespace es
@@ -298,7 +298,7 @@ marge(u8* adv, long count, Vec* blocks, long maxblock, u8* tail)
 }
 
 long Ring::
-write(const void* src, long count, long offset, Vec* blocks, long maxblock)
+poke(const void* src, long count, long offset)
 {
     const u8* ptr(static_cast<const u8*>(src));
     u8* end;
@@ -354,6 +354,44 @@ write(const void* src, long count, long offset, Vec* blocks, long maxblock)
         //  XXXXOOOOO---------XXXXXXXXXXXXXXX
         memmove(adv, ptr, count);
     }
+    return count;
+}
+
+long Ring::
+fill(long count)
+{
+    if (size < used + count)
+    {
+        count = size - used;
+    }
+    if (count <= 0)
+    {
+        return 0;
+    }
+    used += count;
+    return count;
+}
 
+long Ring::
+write(const void* src, long count, long offset, Vec* blocks, long maxblock)
+{
+    u8* tail;
+    u8* adv;
+
+    count = poke(src, count, offset);
+    if (count <= 0)
+    {
+        return 0;
+    }
+    tail = head + used;
+    if (buf + size <= tail)
+    {
+        tail -= size;
+    }
+    adv = tail + offset;
+    if (buf + size <= adv)
+    {
+        adv -= size;
+    }
     return marge(adv, count, blocks, maxblock, tail);
 }
@@ -15,11 +15,15 @@
  */
 
 #include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/un.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +35,13 @@
 #include <es.h>
 #include <es/rpc.h>
 
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+
 namespace es
 {
 
@@ -74,8 +85,176 @@ int* getRights(struct msghdr* msg, int* fdv, int maxfds)
     return fdv;
 }
 
+// Opens an empty file to hold a bulk region, in a memfd where the seals
+// are available, or in an unlinked file under /dev/shm otherwise. As the
+// peer refuses an unsealed region, there is no fallback from the memfd.
+int openBulk()
+{
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+    return syscall(SYS_memfd_create, "es-rpc-bulk", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    char path[] = "/dev/shm/es-rpc-bulk-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd != -1)
+    {
+        unlink(path);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+// Keeps the peer from shrinking the region under the mapping of this
+// process, which would raise SIGBUS.
+bool sealBulk(int fd)
+{
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+    return fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) == 0;
+#else
+    return true;
+#endif
+}
+
+// Checks fd is a region of size bytes or more, which cannot be shrunk.
+bool checkBulk(int fd, size_t size)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || static_cast<size_t>(st.st_size) < size)
+    {
+        return false;
+    }
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals == -1 || !(seals & F_SEAL_SHRINK))
+    {
+        return false;
+    }
+#endif
+    return true;
+}
+
 }   // namespace
 
+void* RpcBulk::
+map(int fd, size_t size)
+{
+    unmap();
+    if (checkBulk(fd, size))
+    {
+        void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            data = p;
+            this->size = size;
+        }
+    }
+    close(fd);
+    return data;
+}
+
+void* RpcBulk::
+allocate(size_t size)
+{
+    unmap();
+    fd = openBulk();
+    if (fd == -1)
+    {
+        return 0;
+    }
+    if (ftruncate(fd, size) == 0 && sealBulk(fd))
+    {
+        void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            data = p;
+            this->size = size;
+            return data;
+        }
+    }
+    close(fd);
+    fd = -1;
+    return 0;
+}
+
+void RpcBulk::
+unmap()
+{
+    if (data)
+    {
+        munmap(data, size);
+        data = 0;
+        size = 0;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int RpcBulk::
+create(const void* data, size_t size)
+{
+    int fd = openBulk();
+    if (fd == -1)
+    {
+        return -1;
+    }
+    const u8* p = static_cast<const u8*>(data);
+    while (0 < size)
+    {
+        ssize_t rc = write(fd, p, size);
+        if (rc == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+        p += rc;
+        size -= rc;
+    }
+    if (!sealBulk(fd))
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+bool RpcBulk::
+read(int fd, void* data, size_t size)
+{
+    if (!checkBulk(fd, size))
+    {
+        return false;
+    }
+    u8* p = static_cast<u8*>(data);
+    off_t offset = 0;
+    while (0 < size)
+    {
+        ssize_t rc = pread(fd, p, size, offset);
+        if (rc <= 0)
+        {
+            if (rc == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        p += rc;
+        offset += rc;
+        size -= rc;
+    }
+    return true;
+}
+
 struct sockaddr* getSocketAddress(int pid, struct sockaddr_un* sa)
 {
     // Use the abstract namespace
@@ -126,8 +305,8 @@ ssize_t receiveCommand(int s, CmdUnion* cmd, int flags)
                 rc = -1;
                 break;
             }
-            fds = &cmd->chanReq.sockfd;
-            maxfds = 1;
+            fds = &cmd->chanReq.sockfd;    // followed by ringfd
+            maxfds = 2;
             break;
         case CMD_CHAN_RES:
             if (sizeof(CmdChanRes) != rc)
@@ -159,10 +338,90 @@ ssize_t receiveCommand(int s, CmdUnion* cmd, int flags)
     return rc;
 }
 
+RpcHdr* readMessage(int s, int* fdv, int*& fdmax, size_t* size)
+{
+    unsigned char buf[CMSG_SPACE(8 * sizeof(int))];
+    struct msghdr msg;
+    struct iovec iov;
+
+    msg.msg_name = 0;
+    msg.msg_namelen = 0;
+    iov.iov_base = RpcStack::top();
+    iov.iov_len = RpcStack::getFreeSize();
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buf;
+    msg.msg_controllen = sizeof buf;
+    msg.msg_flags = 0;
+    int rc = recvmsg(s, &msg, 0);
+    if (0 <= rc)
+    {
+        fdmax = getRights(&msg, fdv, 8);
+//        esDump(iov.iov_base, rc);
+    }
+    else
+    {
+        fdmax = fdv;
+    }
+
+    // A truncated message is dropped.
+    if (0 <= rc && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+#if 0
+        fprintf(stderr, "%s:\n", __func__);
+        esDump(iov.iov_base, rc);
+#endif
+        RpcHdr* hdr = reinterpret_cast<RpcHdr*>(iov.iov_base);
+        if (isValidMessage(hdr, rc))
+        {
+            RpcStack::alloc(rc);
+            if (size)
+            {
+                *size = rc;
+            }
+            return hdr;
+        }
+    }
+
+    // An empty message is never sent, so it tells the peer has closed the
+    // connection over a SOCK_SEQPACKET socket.
+    int error = (rc < 0) ? errno : (rc == 0) ? ECONNRESET : EBADMSG;
+
+    // Close unused rights
+    for (int* p = fdv; p < fdmax; ++p)
+    {
+        close(*p);
+    }
+    fdmax = fdv;
+    errno = error;
+    return 0;
+}
+
+bool isValidMessage(const RpcHdr* hdr, size_t size)
+{
+    if (size < sizeof(RpcHdr))
+    {
+        return false;
+    }
+    switch (hdr->cmd)
+    {
+    case RPC_REQ:
+    case RPC_ONEWAY:
+        return sizeof(RpcReq) <= size &&
+               reinterpret_cast<const RpcReq*>(hdr)->paramCount <= (size - sizeof(RpcReq)) / sizeof(Any);
+    case RPC_RES:
+        return sizeof(RpcRes) <= size;
+    case RPC_RELEASE:
+        return sizeof(RpcRelease) <= size &&
+               reinterpret_cast<const RpcRelease*>(hdr)->count <= (size - sizeof(RpcRelease)) / sizeof(Capability);
+    default:
+        return false;
+    }
+}
+
 RpcHdr* receiveMessage(int epfd, int* fdv, int*& fdmax, int* s)
 {
     RpcHdr* hdr;
-    unsigned char buf[CMSG_SPACE(8 * sizeof(int))];
     struct epoll_event event;
 
     // wait for the reply. note the thread might receive another request by recursive call, etc.
@@ -179,54 +438,16 @@ RpcHdr* receiveMessage(int epfd, int* fdv, int*& fdmax, int* s)
             continue;
         }
 
-        struct msghdr msg;
-        struct iovec iov;
-        msg.msg_name = 0;
-        msg.msg_namelen = 0;
-        iov.iov_base = RpcStack::top();
-        iov.iov_len = RpcStack::getFreeSize();
-        msg.msg_iov = &iov;
-        msg.msg_iovlen = 1;
-        msg.msg_control = buf;
-        msg.msg_controllen = sizeof buf;
-        msg.msg_flags = 0;
-        int rc = recvmsg(event.data.fd, &msg, 0);
-        if (0 <= rc)
-        {
-            fdmax = getRights(&msg, fdv, 8);
-//            esDump(iov.iov_base, rc);
-        }
-        else
-        {
-            fdmax = fdv;
-        }
-
-        // TODO check message length msg.msg_iov[0].iov_len
-
-        if (static_cast<ssize_t>(sizeof(RpcHdr)) <= rc)
+        hdr = readMessage(event.data.fd, fdv, fdmax);
+        if (hdr)
         {
-#if 0
-            fprintf(stderr, "%s:\n", __func__);
-            esDump(iov.iov_base, rc);
-#endif
-            // TODO check trunk etc.
-            hdr = reinterpret_cast<RpcHdr*>(iov.iov_base);
-            if (hdr->cmd == RPC_REQ && static_cast<ssize_t>(sizeof(RpcReq)) <= rc)
-            {
-                RpcStack::alloc(rc);
-                break;
-            }
-            else if (hdr->cmd == RPC_RES && static_cast<ssize_t>(sizeof(RpcRes)) <= rc)
-            {
-                RpcStack::alloc(rc);
-                break;
-            }
+            break;
         }
-
-        // Close unused rights
-        for (int* p = fdv; p < fdmax; ++p)
+        if (errno == ECONNRESET)
         {
-            close(*p);
+            // The peer has gone.
+            epoll_ctl(epfd, EPOLL_CTL_DEL, event.data.fd, &event);
+            close(event.data.fd);
         }
     }
 
@@ -0,0 +1,576 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "rpcChannel.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+
+namespace es
+{
+
+namespace
+{
+
+// Record types
+const u32 RECORD_DATA = 0;
+const u32 RECORD_SOCKET = 1;    // the message is on the socket
+const u32 RECORD_PAD = 2;       // skip to the beginning of the ring
+
+const u32 ALIGN = 8;
+
+struct Record
+{
+    u32 size;   // of the data that follows
+    u32 type;
+};
+
+u32 getRecordSize(size_t len)
+{
+    return (sizeof(Record) + len + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+inline void relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__ ("pause");
+#endif
+}
+
+int futex(volatile u32* addr, int op, u32 val)
+{
+    // Not FUTEX_PRIVATE_FLAG as the word is shared between the processes.
+    return syscall(SYS_futex, addr, op, val, 0, 0, 0);
+}
+
+long long getMilliseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+}   // namespace
+
+const u32 RpcRing::SIZE;
+
+const int RpcChannel::MIN_SPIN;
+const int RpcChannel::MAX_SPIN;
+const unsigned RpcChannel::MAX_RELEASE;
+const int RpcChannel::RELEASE_INTERVAL;
+
+int RpcChannel::maxSpin = -1;
+
+pthread_mutex_t RpcChannel::listLock = PTHREAD_MUTEX_INITIALIZER;
+RpcChannel* RpcChannel::list;
+
+RpcChannel::
+RpcChannel(int s, void* rings, bool client, pid_t peer) :
+    s(s),
+    peer(peer),
+    rings(rings),
+    in(0),
+    out(0),
+    pending(0),
+    releaseCount(0),
+    releaseTime(0),
+    prev(0)
+{
+    pthread_mutex_init(&lock, 0);
+
+    if (peer == 0)
+    {
+        // The credentials of a socket pair are the ones of the process that
+        // created it, which a peer cannot forge.
+        struct ucred cred;
+        socklen_t len = sizeof cred;
+        if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0)
+        {
+            this->peer = cred.pid;
+        }
+    }
+
+    pthread_mutex_lock(&listLock);
+    next = list;
+    if (list)
+    {
+        list->prev = this;
+    }
+    list = this;
+    pthread_mutex_unlock(&listLock);
+
+    if (maxSpin < 0)
+    {
+        maxSpin = (1 < sysconf(_SC_NPROCESSORS_ONLN)) ? MAX_SPIN : 0;
+    }
+    spin = (MIN_SPIN < maxSpin) ? MIN_SPIN : maxSpin;
+
+    if (rings)
+    {
+        RpcRing* ring = static_cast<RpcRing*>(rings);
+        in = client ? &ring[1] : &ring[0];
+        out = client ? &ring[0] : &ring[1];
+    }
+}
+
+RpcChannel::
+~RpcChannel()
+{
+    pthread_mutex_lock(&listLock);
+    if (prev)
+    {
+        prev->next = next;
+    }
+    else
+    {
+        list = next;
+    }
+    if (next)
+    {
+        next->prev = prev;
+    }
+    pthread_mutex_unlock(&listLock);
+
+    unmapRings(rings);
+    close(s);
+    pthread_mutex_destroy(&lock);
+}
+
+void* RpcChannel::
+createRings(int* fd)
+{
+    *fd = -1;
+
+    const char* env = getenv("ES_RPC_RING");
+    if (env && strcmp(env, "0") == 0)
+    {
+        return 0;
+    }
+
+#ifdef SYS_memfd_create
+    int memfd = syscall(SYS_memfd_create, "es-rpc-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd == -1)
+    {
+        return 0;
+    }
+    if (ftruncate(memfd, 2 * sizeof(RpcRing)) == -1)
+    {
+        close(memfd);
+        return 0;
+    }
+#ifdef F_ADD_SEALS
+    // Keep the peer from resizing the rings under the mapping, which would
+    // raise SIGBUS.
+    if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)
+    {
+        close(memfd);
+        return 0;
+    }
+#endif
+    void* rings = mapRings(memfd);
+    if (!rings)
+    {
+        close(memfd);
+        return 0;
+    }
+    *fd = memfd;
+    return rings;
+#else
+    return 0;
+#endif
+}
+
+void* RpcChannel::
+mapRings(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size != static_cast<off_t>(2 * sizeof(RpcRing)))
+    {
+        return 0;
+    }
+#ifdef F_GET_SEALS
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW))
+    {
+        return 0;
+    }
+#endif
+    void* rings = mmap(0, 2 * sizeof(RpcRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (rings == MAP_FAILED)
+    {
+        return 0;
+    }
+    return rings;
+}
+
+void RpcChannel::
+unmapRings(void* rings)
+{
+    if (rings)
+    {
+        munmap(rings, 2 * sizeof(RpcRing));
+    }
+}
+
+// Copies the message into the outgoing ring. Waits for the consumer if
+// the ring is full, which does not happen in practice as the calls are
+// synchronous and each direction holds at most a few messages.
+ssize_t RpcChannel::
+push(const struct msghdr* msg, size_t len, int type)
+{
+    u32 size = getRecordSize(len);
+    u32 tail = out->tail;
+    u32 offset = tail & (RpcRing::SIZE - 1);
+    u32 pad = (RpcRing::SIZE - offset < size) ? RpcRing::SIZE - offset : 0;
+    while (RpcRing::SIZE - (tail - out->head) < pad + size)
+    {
+        sched_yield();
+    }
+    __sync_synchronize();   // Do not overwrite the data being read.
+
+    Record* record;
+    if (pad)
+    {
+        record = reinterpret_cast<Record*>(out->data + offset);
+        record->size = pad - sizeof(Record);
+        record->type = RECORD_PAD;
+        offset = 0;
+    }
+    record = reinterpret_cast<Record*>(out->data + offset);
+    record->size = len;
+    record->type = type;
+    u8* data = reinterpret_cast<u8*>(record + 1);
+    for (size_t i = 0; msg && i < msg->msg_iovlen; ++i)
+    {
+        memcpy(data, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        data += msg->msg_iov[i].iov_len;
+    }
+
+    __sync_synchronize();   // Publish the record before the tail.
+    out->tail = tail + pad + size;
+    __sync_synchronize();   // Against the waiting flag set by the consumer.
+    if (out->waiting)
+    {
+        out->waiting = 0;
+        futex(&out->tail, FUTEX_WAKE, 1);
+    }
+    return len;
+}
+
+void RpcChannel::
+share()
+{
+    ASSERT(!rings);
+}
+
+ssize_t RpcChannel::
+send(const struct msghdr* msg)
+{
+    pthread_mutex_lock(&lock);
+    ssize_t rc = 0;
+    if (releaseCount)
+    {
+        rc = sendReleases();
+    }
+    if (rc != -1)
+    {
+        rc = transmit(msg);
+    }
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+ssize_t RpcChannel::
+transmit(const struct msghdr* msg)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < msg->msg_iovlen; ++i)
+    {
+        len += msg->msg_iov[i].iov_len;
+    }
+
+    if (!out || msg->msg_controllen || RpcRing::SIZE / 2 < getRecordSize(len))
+    {
+        // Not to raise SIGPIPE if the peer has gone.
+        ssize_t rc = sendmsg(s, msg, MSG_NOSIGNAL);
+        if (rc != -1 && out)
+        {
+            push(0, 0, RECORD_SOCKET);
+        }
+        return rc;
+    }
+    return push(msg, len, RECORD_DATA);
+}
+
+// Waits until the producer moves the tail from head, spinning first. The
+// spin count is doubled each time the message arrives while spinning, and
+// halved each time it does not so that an idle channel soon sleeps.
+void RpcChannel::
+wait(u32 head)
+{
+    if (in->tail != head)
+    {
+        return;
+    }
+
+    for (int i = 0; i < spin; ++i)
+    {
+        relax();
+        if (in->tail != head)
+        {
+            if (spin < maxSpin)
+            {
+                spin *= 2;
+            }
+            return;
+        }
+    }
+    if (MIN_SPIN < spin)
+    {
+        spin /= 2;
+    }
+
+    for (;;)
+    {
+        in->waiting = 1;
+        __sync_synchronize();
+        if (in->tail != head)
+        {
+            break;
+        }
+        if (futex(&in->tail, FUTEX_WAIT, head) == -1 && errno != EAGAIN && errno != EINTR)
+        {
+            perror("futex");
+            exit(EXIT_FAILURE);
+        }
+    }
+    in->waiting = 0;
+}
+
+RpcHdr* RpcChannel::
+receive(int* fdv, int*& fdmax, size_t* size)
+{
+    for (;;)
+    {
+        RpcHdr* hdr;
+        if (!in)
+        {
+            hdr = readMessage(s, fdv, fdmax, size);
+            if (hdr || errno == ECONNRESET)
+            {
+                return hdr;
+            }
+            continue;
+        }
+
+        u32 head = in->head;
+        wait(head);
+        __sync_synchronize();   // Read the record after the tail.
+
+        u32 offset = head & (RpcRing::SIZE - 1);
+        Record* record = reinterpret_cast<Record*>(in->data + offset);
+        u32 length = record->size;
+        u32 type = record->type;
+        if (RpcRing::SIZE - offset - sizeof(Record) < length ||
+            (type != RECORD_DATA && type != RECORD_SOCKET && type != RECORD_PAD))
+        {
+            // The peer has broken the ring. Stop using the rings, losing the
+            // messages left in them.
+            pthread_mutex_lock(&lock);
+            in = out = 0;
+            pthread_mutex_unlock(&lock);
+            continue;
+        }
+        hdr = 0;
+        fdmax = fdv;
+        if (type == RECORD_DATA)
+        {
+            if (length <= RpcStack::getFreeSize())
+            {
+                hdr = static_cast<RpcHdr*>(RpcStack::top());
+                memcpy(hdr, record + 1, length);
+                if (isValidMessage(hdr, length))
+                {
+                    RpcStack::alloc(length);
+                    if (size)
+                    {
+                        *size = length;
+                    }
+                }
+                else
+                {
+                    hdr = 0;
+                }
+            }
+        }
+
+        __sync_synchronize();   // Finish reading before releasing the record.
+        in->head = head + getRecordSize(length);
+
+        if (type == RECORD_SOCKET)
+        {
+            // The message has been sent already before the marker.
+            hdr = readMessage(s, fdv, fdmax, size);
+            if (!hdr && errno == ECONNRESET)
+            {
+                return 0;
+            }
+        }
+        if (hdr)
+        {
+            return hdr;
+        }
+    }
+}
+
+void RpcChannel::
+expect(RpcFuture* future, int tag)
+{
+    future->next = 0;
+    future->channel = this;
+    future->tag = tag;
+    future->ready = false;
+
+    // Append to the list, as the replies come in the order of the requests.
+    RpcFuture** p = &pending;
+    while (*p)
+    {
+        p = &(*p)->next;
+    }
+    *p = future;
+}
+
+int RpcChannel::
+release(const Capability& cap)
+{
+    long long now = getMilliseconds();
+    int rc = 0;
+    pthread_mutex_lock(&lock);
+    if (releaseCount == 0)
+    {
+        releaseTime = now;
+    }
+    releases[releaseCount++] = cap;
+    if (releaseCount == MAX_RELEASE || RELEASE_INTERVAL <= now - releaseTime)
+    {
+        rc = sendReleases();
+    }
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+int RpcChannel::
+flush()
+{
+    pthread_mutex_lock(&lock);
+    int rc = sendReleases();
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+void RpcChannel::
+flushAll()
+{
+    pthread_mutex_lock(&listLock);
+    for (RpcChannel* channel = list; channel; channel = channel->next)
+    {
+        if (channel->releaseCount && pthread_mutex_trylock(&channel->lock) == 0)
+        {
+            channel->sendReleases();
+            pthread_mutex_unlock(&channel->lock);
+        }
+    }
+    pthread_mutex_unlock(&listLock);
+}
+
+int RpcChannel::
+sendReleases()
+{
+    if (releaseCount == 0)
+    {
+        return 0;
+    }
+
+    RpcRelease hdr = { RPC_RELEASE, 0, getpid(), releaseCount };
+    struct iovec iov[2];
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof hdr;
+    iov[1].iov_base = releases;
+    iov[1].iov_len = sizeof(Capability) * releaseCount;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    releaseCount = 0;
+    return (transmit(&msg) == -1) ? -1 : 0;
+}
+
+bool RpcChannel::
+deliver(RpcRes* res)
+{
+    for (RpcFuture** p = &pending; *p; p = &(*p)->next)
+    {
+        RpcFuture* future = *p;
+        if (future->tag == res->tag)
+        {
+            *p = future->next;
+            future->next = 0;
+            future->res = *res;
+            future->ready = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RpcChannel::
+forget(RpcFuture* future)
+{
+    for (RpcFuture** p = &pending; *p; p = &(*p)->next)
+    {
+        if (*p == future)
+        {
+            *p = future->next;
+            future->next = 0;
+            break;
+        }
+    }
+}
+
+}   // namespace es
@@ -0,0 +1,632 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+
+#include "rpcPool.h"
+
+namespace es
+{
+
+namespace
+{
+
+long long getNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}   // namespace
+
+// A message received by the dispatcher, which is followed by the message.
+struct RpcPool::Task
+{
+    Entry*          entry;
+    void*           cookie;
+    unsigned long   key;
+    long long       time;   // when received [ns]
+    size_t          size;   // of the message
+    bool            stolen;
+    int             fdc;
+    int             fdv[8];
+
+    RpcHdr* getHdr()
+    {
+        return reinterpret_cast<RpcHdr*>(this + 1);
+    }
+};
+
+// The tasks queued to a servant thread.
+struct RpcPool::Queue
+{
+    RpcPool*            pool;
+    unsigned            index;
+    pthread_mutex_t     lock;
+    std::deque<Task*>   tasks;
+
+    Queue() :
+        pool(0),
+        index(0)
+    {
+        pthread_mutex_init(&lock, 0);
+    }
+
+    ~Queue()
+    {
+        pthread_mutex_destroy(&lock);
+    }
+
+    Task* pop(bool front)
+    {
+        Task* task = 0;
+        pthread_mutex_lock(&lock);
+        if (!tasks.empty())
+        {
+            if (front)
+            {
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            else
+            {
+                task = tasks.back();
+                tasks.pop_back();
+            }
+        }
+        pthread_mutex_unlock(&lock);
+        return task;
+    }
+};
+
+// A channel served by the pool. The members are guarded by the lock of
+// the pool.
+struct RpcPool::Entry
+{
+    RpcPool*            pool;
+    RpcChannel*         channel;
+    bool                used;       // by the servant thread owning the channel
+    bool                closed;     // as the client has gone
+    int                 depth;      // of the waits of the owner
+    unsigned            tasks;      // received and not yet finished
+    std::deque<Task*>   mailbox;    // the messages passed to the owner
+    pthread_cond_t      cond;
+
+    Entry(RpcPool* pool, RpcChannel* channel) :
+        pool(pool),
+        channel(channel),
+        used(false),
+        closed(false),
+        depth(0),
+        tasks(0)
+    {
+        pthread_cond_init(&cond, 0);
+    }
+
+    ~Entry()
+    {
+        delete channel;
+        pthread_cond_destroy(&cond);
+    }
+};
+
+const unsigned RpcPool::MAX_THREADS;
+
+__thread RpcPool::Entry* RpcPool::owned;
+__thread RpcPool::Queue* RpcPool::local;
+
+RpcPool::
+RpcPool(Servant* servant, unsigned size) :
+    servant(servant),
+    epfd(epoll_create(MAX_THREADS)),
+    size(size),
+    queues(new Queue[size]),
+    next(0),
+    idle(0),
+    queued(0),
+    served(0),
+    stolen(0),
+    totalLatency(0),
+    maxLatency(0)
+{
+    pthread_mutex_init(&idleLock, 0);
+    pthread_cond_init(&idleCond, 0);
+    pthread_mutex_init(&lock, 0);
+    pthread_mutex_init(&orderLock, 0);
+
+    for (unsigned i = 0; i < size; ++i)
+    {
+        queues[i].pool = this;
+        queues[i].index = i;
+        servant->start(work, &queues[i]);
+    }
+    servant->start(dispatch, this);
+}
+
+RpcPool* RpcPool::
+create(Servant* servant)
+{
+    const char* value = getenv("ES_RPC_POOL");
+    if (!value)
+    {
+        return 0;
+    }
+    long size = atol(value);
+    if (size <= 0)
+    {
+        size = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (size < 1)
+    {
+        size = 1;
+    }
+    else if (MAX_THREADS < static_cast<unsigned long>(size))
+    {
+        size = MAX_THREADS;
+    }
+    return new RpcPool(servant, size);
+}
+
+void RpcPool::
+add(RpcChannel* channel)
+{
+    channel->share();
+    Entry* entry = new Entry(this, channel);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = entry;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, channel->getSocket(), &event);
+}
+
+void* RpcPool::
+dispatch(void* param)
+{
+    RpcPool* pool = static_cast<RpcPool*>(param);
+    RpcStack::init();
+    for (;;)
+    {
+        struct epoll_event event;
+        if (epoll_wait(pool->epfd, &event, 1, -1) <= 0)
+        {
+            continue;
+        }
+        Entry* entry = static_cast<Entry*>(event.data.ptr);
+
+        // The messages sent before the client has gone are still served.
+        RpcStack stackBase;
+        int fdv[8];
+        int* fdmax;
+        size_t size;
+        RpcHdr* hdr = 0;
+        if (event.events & EPOLLIN)
+        {
+            hdr = readMessage(entry->channel->getSocket(), fdv, fdmax, &size);
+        }
+        if (!hdr)
+        {
+            if (event.events & (EPOLLERR | EPOLLHUP))
+            {
+                // The client has gone.
+                pool->hangUp(entry);
+            }
+            continue;
+        }
+        Task* task = static_cast<Task*>(malloc(sizeof(Task) + size));
+        if (!task)
+        {
+            for (int* fdp = fdv; fdp < fdmax; ++fdp)
+            {
+                close(*fdp);
+            }
+            continue;
+        }
+        task->entry = entry;
+        task->cookie = 0;
+        task->key = 0;
+        task->time = getNanoseconds();
+        task->size = size;
+        task->stolen = false;
+        task->fdc = fdmax - fdv;
+        memcpy(task->fdv, fdv, sizeof(int) * task->fdc);
+        memcpy(task->getHdr(), hdr, size);
+        pool->post(task);
+    }
+    return 0;
+}
+
+// Passes the task to the owner of the channel if the owner waits for it,
+// or queues it otherwise.
+void RpcPool::
+post(Task* task)
+{
+    Entry* entry = task->entry;
+    int cmd = task->getHdr()->cmd;
+    pthread_mutex_lock(&lock);
+    ++entry->tasks;
+    if (entry->used && (0 < entry->depth || cmd == RPC_RES))
+    {
+        entry->mailbox.push_back(task);
+        pthread_cond_signal(&entry->cond);
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    pthread_mutex_unlock(&lock);
+
+    if (cmd == RPC_RES)
+    {
+        // No one waits for it.
+        discard(task);
+        return;
+    }
+    schedule(task, &queues[next++ % size]);
+}
+
+// Queues the task unless a task of the same order key is being served, in
+// which case the task is queued after it has been served.
+void RpcPool::
+schedule(Task* task, Queue* queue)
+{
+    task->cookie = servant->accept(task->entry->channel, task->getHdr(), &task->key);
+    if (task->key)
+    {
+        pthread_mutex_lock(&orderLock);
+        std::map<unsigned long, std::deque<Task*> >::iterator it = orders.find(task->key);
+        if (it != orders.end())
+        {
+            (*it).second.push_back(task);
+            pthread_mutex_unlock(&orderLock);
+            return;
+        }
+        orders[task->key];
+        pthread_mutex_unlock(&orderLock);
+    }
+    push(task, queue);
+}
+
+void RpcPool::
+push(Task* task, Queue* queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->tasks.push_back(task);
+    pthread_mutex_unlock(&queue->lock);
+
+    pthread_mutex_lock(&idleLock);
+    __sync_add_and_fetch(&queued, 1);
+    if (0 < idle)
+    {
+        pthread_cond_signal(&idleCond);
+    }
+    pthread_mutex_unlock(&idleLock);
+}
+
+RpcPool::Task* RpcPool::
+take(Queue* queue)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&idleLock);
+        while (queued == 0)
+        {
+            ++idle;
+            pthread_cond_wait(&idleCond, &idleLock);
+            --idle;
+        }
+        pthread_mutex_unlock(&idleLock);
+
+        Task* task = queue->pop(true);
+        for (unsigned i = 1; !task && i < size; ++i)
+        {
+            task = queues[(queue->index + i) % size].pop(false);
+            if (task)
+            {
+                task->stolen = true;
+            }
+        }
+        if (task)
+        {
+            __sync_sub_and_fetch(&queued, 1);
+            return task;
+        }
+
+        // Another thread has taken the task counted.
+        sched_yield();
+    }
+}
+
+void* RpcPool::
+work(void* param)
+{
+    Queue* queue = static_cast<Queue*>(param);
+    RpcPool* pool = queue->pool;
+    RpcStack::init();
+    local = queue;
+    for (;;)
+    {
+        pool->run(pool->take(queue), queue);
+    }
+    return 0;
+}
+
+void RpcPool::
+run(Task* task, Queue* queue)
+{
+    record(getNanoseconds() - task->time, task->stolen);
+
+    Entry* entry = task->entry;
+    pthread_mutex_lock(&lock);
+    if (!entry->used)
+    {
+        entry->used = true;
+        owned = entry;
+    }
+    pthread_mutex_unlock(&lock);
+
+    {
+        RpcStack stackBase;
+        servant->serve(entry->channel, task->getHdr(), task->size, task->fdv, task->fdv + task->fdc, task->cookie);
+    }
+
+    // In case the servant has not replied.
+    disown();
+
+    if (task->key)
+    {
+        Task* next = 0;
+        pthread_mutex_lock(&orderLock);
+        std::map<unsigned long, std::deque<Task*> >::iterator it = orders.find(task->key);
+        if ((*it).second.empty())
+        {
+            orders.erase(it);
+        }
+        else
+        {
+            next = (*it).second.front();
+            (*it).second.pop_front();
+        }
+        pthread_mutex_unlock(&orderLock);
+        if (next)
+        {
+            push(next, queue);
+        }
+    }
+    finish(task);
+}
+
+// Queues the requests left in the mailbox as the owner has stopped waiting.
+// Called with the lock held so that they are queued ahead of the requests
+// received later.
+void RpcPool::
+settle(Entry* entry)
+{
+    std::deque<Task*> replies;
+    while (!entry->mailbox.empty())
+    {
+        Task* task = entry->mailbox.front();
+        entry->mailbox.pop_front();
+        if (task->getHdr()->cmd == RPC_RES)
+        {
+            replies.push_back(task);
+        }
+        else
+        {
+            schedule(task, local);
+        }
+    }
+    entry->mailbox.swap(replies);
+}
+
+void RpcPool::
+record(long long latency, bool steal)
+{
+    if (latency < 0)
+    {
+        latency = 0;
+    }
+    __sync_add_and_fetch(&served, 1);
+    if (steal)
+    {
+        __sync_add_and_fetch(&stolen, 1);
+    }
+    __sync_add_and_fetch(&totalLatency, static_cast<u64>(latency));
+    u64 max = maxLatency;
+    while (max < static_cast<u64>(latency))
+    {
+        u64 prev = __sync_val_compare_and_swap(&maxLatency, max, static_cast<u64>(latency));
+        if (prev == max)
+        {
+            break;
+        }
+        max = prev;
+    }
+}
+
+void RpcPool::
+discard(Task* task)
+{
+    for (int i = 0; i < task->fdc; ++i)
+    {
+        close(task->fdv[i]);
+    }
+    finish(task);
+}
+
+// Frees the task, and the entry with the channel if the client has gone and
+// the task has been the last one of the channel. The entry is not in use
+// then, as it is used only while one of its tasks is being served.
+void RpcPool::
+finish(Task* task)
+{
+    Entry* entry = task->entry;
+    RpcPool* pool = entry->pool;
+    free(task);
+    pthread_mutex_lock(&pool->lock);
+    bool done = --entry->tasks == 0 && entry->closed;
+    pthread_mutex_unlock(&pool->lock);
+    if (done)
+    {
+        delete entry;
+    }
+}
+
+// Stops waiting on the channel of the client that has gone, and destroys
+// the entry with the channel unless any of its tasks is left to finish.
+void RpcPool::
+hangUp(Entry* entry)
+{
+    struct epoll_event event;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, entry->channel->getSocket(), &event);
+    pthread_mutex_lock(&lock);
+    entry->closed = true;
+    pthread_cond_signal(&entry->cond);
+    bool done = entry->tasks == 0;
+    pthread_mutex_unlock(&lock);
+    if (done)
+    {
+        delete entry;
+    }
+}
+
+void RpcPool::
+getStats(RpcPoolStats* stats)
+{
+    stats->threads = size;
+    stats->queued = queued;
+    stats->served = served;
+    stats->stolen = stolen;
+    stats->totalLatency = totalLatency;
+    stats->maxLatency = maxLatency;
+}
+
+void RpcPool::
+disown()
+{
+    Entry* entry = owned;
+    if (!entry)
+    {
+        return;
+    }
+    RpcPool* pool = entry->pool;
+    pthread_mutex_lock(&pool->lock);
+    if (0 < entry->depth)
+    {
+        // Replying to a nested call while waiting on the channel.
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+    entry->used = false;
+    std::deque<Task*> replies;
+    entry->mailbox.swap(replies);
+    pthread_mutex_unlock(&pool->lock);
+    owned = 0;
+
+    while (!replies.empty())
+    {
+        // The reply to a request no one waits for.
+        discard(replies.front());
+        replies.pop_front();
+    }
+}
+
+bool RpcPool::
+owns(RpcChannel* channel)
+{
+    return owned && owned->channel == channel;
+}
+
+RpcHdr* RpcPool::
+receive(RpcChannel* channel, int* fdv, int*& fdmax, size_t* size)
+{
+    Entry* entry = owned;
+    if (!entry || entry->channel != channel || entry->depth == 0)
+    {
+        return channel->receive(fdv, fdmax, size);
+    }
+
+    RpcPool* pool = entry->pool;
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (entry->mailbox.empty() && !entry->closed)
+        {
+            pthread_cond_wait(&entry->cond, &pool->lock);
+        }
+        if (entry->mailbox.empty())
+        {
+            // The client has gone.
+            pthread_mutex_unlock(&pool->lock);
+            fdmax = fdv;
+            return 0;
+        }
+        Task* task = entry->mailbox.front();
+        entry->mailbox.pop_front();
+        pthread_mutex_unlock(&pool->lock);
+
+        RpcHdr* hdr = static_cast<RpcHdr*>(RpcStack::alloc(task->size));
+        if (!hdr)
+        {
+            // Truncated as it would be on the socket.
+            discard(task);
+            continue;
+        }
+        memcpy(hdr, task->getHdr(), task->size);
+        memcpy(fdv, task->fdv, sizeof(int) * task->fdc);
+        fdmax = fdv + task->fdc;
+        if (size)
+        {
+            *size = task->size;
+        }
+        finish(task);
+        return hdr;
+    }
+}
+
+RpcPool::Wait::
+Wait(RpcChannel* channel) :
+    entry(0)
+{
+    if (owned && owned->channel == channel)
+    {
+        entry = owned;
+        pthread_mutex_lock(&entry->pool->lock);
+        ++entry->depth;
+        pthread_mutex_unlock(&entry->pool->lock);
+    }
+}
+
+RpcPool::Wait::
+~Wait()
+{
+    if (entry)
+    {
+        pthread_mutex_lock(&entry->pool->lock);
+        if (--entry->depth == 0)
+        {
+            entry->pool->settle(entry);
+        }
+        pthread_mutex_unlock(&entry->pool->lock);
+    }
+}
+
+}   // namespace es
@@ -0,0 +1,30 @@
+#!/usr/bin/awk -f
+
+BEGIN {
+    print "#include <es/rpcStub.h>"
+}
+
+{
+    if (!($1 in headers))
+    {
+        headers[$1] = 1
+        print "#include <" $1 ">"
+    }
+    names[NR] = $2
+}
+
+END {
+    print ""
+    print "namespace es"
+    print "{"
+    print ""
+    print "void registerStubs()"
+    print "{"
+    for (i = 1; i <= NR; ++i)
+    {
+        print "    registerStub<" names[i] ", " names[i] "_Proxy, " names[i] "_Skeleton>();"
+    }
+    print "}"
+    print ""
+    print "}  // namespace es"
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Passes the sequences out of line in RpcBulk regions over a socket, and
+// checks the regions shorter than asked for or not sealed are rejected.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <es.h>
+#include <es/rpc.h>
+
+using namespace es;
+
+namespace
+{
+    const size_t SIZE = 4 * RPC_BULK_SIZE;
+    const int ROUNDS = 100;
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Sends a request with the file descriptor fd.
+static void send(int s, int fd)
+{
+    RpcReq req = { RPC_REQ, 1, getpid() };
+    req.paramCount = 0;
+    struct iovec iov;
+    iov.iov_base = &req;
+    iov.iov_len = sizeof req;
+
+    unsigned char buf[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buf;
+    msg.msg_controllen = sizeof buf;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    ssize_t sent = sendmsg(s, &msg, 0);
+    ASSERT(sent == sizeof req);
+}
+
+// Receives the file descriptor sent by send().
+static int receive(int s)
+{
+    RpcStack stackBase;
+    int fdv[8];
+    int* fdmax;
+    RpcHdr* hdr = readMessage(s, fdv, fdmax);
+    ASSERT(hdr && hdr->cmd == RPC_REQ);
+    ASSERT(fdmax == fdv + 1);
+    return fdv[0];
+}
+
+int main()
+{
+    RpcStack::init();
+
+    int pair[2];
+    int rc = socketpair(PF_UNIX, SOCK_DGRAM, 0, pair);
+    ASSERT(rc == 0);
+
+    u8* data = static_cast<u8*>(malloc(SIZE));
+    u8* copy = static_cast<u8*>(malloc(SIZE));
+    for (size_t i = 0; i < SIZE; ++i)
+    {
+        data[i] = static_cast<u8>(rand());
+    }
+
+    // An argument: created by the caller, and mapped by the callee.
+    int fd = RpcBulk::create(data, SIZE);
+    ASSERT(fd != -1);
+    send(pair[0], fd);
+    close(fd);
+    {
+        RpcBulk bulk;
+        void* ptr = bulk.map(receive(pair[1]), SIZE);
+        ASSERT(ptr);
+        ASSERT(memcmp(ptr, data, SIZE) == 0);
+        ASSERT(bulk.getFd() == -1);
+
+        // The mapping is private to the callee.
+        memset(ptr, 0, SIZE);
+    }
+
+    // A result: written in place by the callee, and read by the caller.
+    {
+        RpcBulk bulk;
+        void* ptr = bulk.allocate(SIZE);
+        ASSERT(ptr);
+        ASSERT(bulk.getFd() != -1);
+        memmove(ptr, data, SIZE);
+        send(pair[1], bulk.getFd());
+    }
+    fd = receive(pair[0]);
+    bool read = RpcBulk::read(fd, copy, SIZE);
+    ASSERT(read);
+    ASSERT(memcmp(copy, data, SIZE) == 0);
+
+    // A region shorter than asked for is rejected.
+    read = RpcBulk::read(fd, copy, SIZE + 1);
+    ASSERT(!read);
+    {
+        RpcBulk bulk;
+        void* ptr = bulk.map(fd, SIZE + 1); // closes fd
+        ASSERT(!ptr);
+    }
+
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS)
+    // A region the peer could shrink under the mapping is rejected.
+    fd = syscall(SYS_memfd_create, "es-rpc-bulk", 0);
+    ASSERT(fd != -1);
+    ssize_t written = write(fd, data, SIZE);
+    ASSERT(written == static_cast<ssize_t>(SIZE));
+    read = RpcBulk::read(fd, copy, SIZE);
+    ASSERT(!read);
+    {
+        RpcBulk bulk;
+        void* ptr = bulk.map(fd, SIZE);     // closes fd
+        ASSERT(!ptr);
+    }
+#endif
+
+    // Throughput of the arguments passed out of line, read through by the
+    // callee as a method would.
+    unsigned sum = 0;
+    for (size_t i = 0; i < SIZE; ++i)
+    {
+        sum += data[i];
+    }
+    long long start = now();
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        fd = RpcBulk::create(data, SIZE);
+        send(pair[0], fd);
+        close(fd);
+        RpcBulk bulk;
+        const u8* ptr = static_cast<const u8*>(bulk.map(receive(pair[1]), SIZE));
+        ASSERT(ptr);
+        unsigned check = 0;
+        for (size_t j = 0; j < SIZE; ++j)
+        {
+            check += ptr[j];
+        }
+        ASSERT(check == sum);
+    }
+    long long elapsed = now() - start;
+    printf("%d regions of %zu bytes passed in %lld us (%lld MB/s)\n",
+           ROUNDS, SIZE, elapsed / 1000, (ROUNDS * (long long) SIZE * 1000) / (elapsed ? elapsed : 1));
+
+    free(copy);
+    free(data);
+    close(pair[0]);
+    close(pair[1]);
+
+    printf("done.\n");
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Exchanges the messages between two processes over an RpcChannel with
+// and without the shared memory rings, and checks the order of the
+// messages going over the rings and the socket, the file descriptor
+// passing, the wrap around of the rings, the batches of the releases, and
+// that the rings not sealed against resizing are refused. Also reports the round trips per second.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <es.h>
+#include "rpcChannel.h"
+
+using namespace es;
+
+namespace
+{
+    const unsigned QUIT = 0xffffffff;
+    const unsigned RELEASED = 0xfffffffe;  // gets the number of the releases
+    const int ROUND_TRIPS = 100000;
+    const int MAX_DATA = 48 * 1024;     // goes over the socket
+
+    u8 data[MAX_DATA];
+}
+
+static unsigned checksum(const u8* data, int len)
+{
+    unsigned sum = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        sum = sum * 31 + data[i];
+    }
+    return sum;
+}
+
+// Replies to each request with the checksum of its data. If a file
+// descriptor is passed, the checksum is written to it as well. The
+// released capabilities must come numbered in the order.
+static void serve(RpcChannel* channel)
+{
+    unsigned released = 0;
+
+    RpcStack::init();
+    for (;;)
+    {
+        RpcStack stackBase;
+        int fdv[8];
+        int* fdmax;
+        RpcHdr* hdr = channel->receive(fdv, fdmax);
+        if (hdr->cmd == RPC_RELEASE)
+        {
+            RpcRelease* release = reinterpret_cast<RpcRelease*>(hdr);
+            ASSERT(0 < release->count && release->count <= RpcChannel::MAX_RELEASE);
+            Capability* cap = release->getCapabilities();
+            for (unsigned i = 0; i < release->count; ++i, ++cap)
+            {
+                ASSERT(cap->object == static_cast<int>(released++));
+            }
+            continue;
+        }
+        ASSERT(hdr->cmd == RPC_REQ);
+        RpcReq* req = reinterpret_cast<RpcReq*>(hdr);
+        if (req->methodNumber == QUIT)
+        {
+            break;
+        }
+
+        RpcRes res = { RPC_RES, req->tag, getpid(), 0 };
+        if (req->methodNumber == RELEASED)
+        {
+            res.exceptionCode = released;
+        }
+        else
+        {
+            res.exceptionCode = checksum(static_cast<u8*>(req->getData()), req->methodNumber);
+        }
+        for (int* fdp = fdv; fdp < fdmax; ++fdp)
+        {
+            write(*fdp, &res.exceptionCode, sizeof res.exceptionCode);
+            close(*fdp);
+        }
+
+        struct iovec iov;
+        iov.iov_base = &res;
+        iov.iov_len = sizeof res;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        ssize_t rc = channel->send(&msg);
+        ASSERT(rc == sizeof res);
+    }
+}
+
+static void request(RpcChannel* channel, int tag, int len, int fd = -1)
+{
+    RpcReq req = { RPC_REQ, tag, getpid() };
+    req.methodNumber = (len < 0) ? QUIT : len;
+    req.paramCount = 0;
+
+    struct iovec iov[2];
+    iov[0].iov_base = &req;
+    iov[0].iov_len = sizeof req;
+    iov[1].iov_base = data;
+    iov[1].iov_len = (0 < len) ? len : 0;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    unsigned char buf[CMSG_SPACE(sizeof(int))];
+    if (0 <= fd)
+    {
+        msg.msg_control = buf;
+        msg.msg_controllen = sizeof buf;
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        *(int*) CMSG_DATA(cmsg) = fd;
+        msg.msg_controllen = cmsg->cmsg_len;
+    }
+    ssize_t rc = channel->send(&msg);
+    ASSERT(rc == static_cast<ssize_t>(sizeof req + iov[1].iov_len));
+}
+
+static void reply(RpcChannel* channel, int tag, int len)
+{
+    RpcStack stackBase;
+    int fdv[8];
+    int* fdmax;
+    RpcHdr* hdr = channel->receive(fdv, fdmax);
+    ASSERT(hdr->cmd == RPC_RES);
+    ASSERT(hdr->tag == tag);
+    ASSERT(fdmax == fdv);
+    ASSERT(reinterpret_cast<RpcRes*>(hdr)->exceptionCode == checksum(data, len));
+}
+
+// Gets the number of the releases received by the server.
+static unsigned getReleased(RpcChannel* channel, int tag)
+{
+    RpcReq req = { RPC_REQ, tag, getpid() };
+    req.methodNumber = RELEASED;
+    req.paramCount = 0;
+
+    struct iovec iov;
+    iov.iov_base = &req;
+    iov.iov_len = sizeof req;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    ssize_t rc = channel->send(&msg);
+    ASSERT(rc == sizeof req);
+
+    RpcStack stackBase;
+    int fdv[8];
+    int* fdmax;
+    RpcHdr* hdr = channel->receive(fdv, fdmax);
+    ASSERT(hdr->cmd == RPC_RES);
+    ASSERT(hdr->tag == tag);
+    return reinterpret_cast<RpcRes*>(hdr)->exceptionCode;
+}
+
+// Queues the releases, which must be sent ahead of the next request, when
+// the batch gets full or old, or when flushed.
+static int testRelease(RpcChannel* channel, int tag)
+{
+    Capability cap = { getpid(), 0, 1 };
+    unsigned released = 0;
+    unsigned count;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        cap.object = static_cast<int>(released++);
+        int rc = channel->release(cap);
+        ASSERT(rc == 0);
+    }
+    ASSERT(channel->getReleaseCount() == 3);
+    count = getReleased(channel, ++tag);
+    ASSERT(count == released);
+    ASSERT(channel->getReleaseCount() == 0);
+
+    for (unsigned i = 0; i < RpcChannel::MAX_RELEASE; ++i)
+    {
+        cap.object = static_cast<int>(released++);
+        int rc = channel->release(cap);
+        ASSERT(rc == 0);
+    }
+    ASSERT(channel->getReleaseCount() == 0);
+    count = getReleased(channel, ++tag);
+    ASSERT(count == released);
+
+    cap.object = static_cast<int>(released++);
+    channel->release(cap);
+    usleep((RpcChannel::RELEASE_INTERVAL + 10) * 1000);
+    cap.object = static_cast<int>(released++);
+    channel->release(cap);
+    ASSERT(channel->getReleaseCount() == 0);
+
+    cap.object = static_cast<int>(released++);
+    channel->release(cap);
+    int rc = channel->flush();
+    ASSERT(rc == 0);
+    ASSERT(channel->getReleaseCount() == 0);
+    count = getReleased(channel, ++tag);
+    ASSERT(count == released);
+
+    // As by the focus thread for an idle channel
+    cap.object = static_cast<int>(released++);
+    channel->release(cap);
+    RpcChannel::flushAll();
+    ASSERT(channel->getReleaseCount() == 0);
+    count = getReleased(channel, ++tag);
+    ASSERT(count == released);
+    return tag;
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void test(bool useRings)
+{
+    int pair[2];
+    int rc = socketpair(PF_UNIX, SOCK_DGRAM, 0, pair);
+    ASSERT(rc == 0);
+    int ringfd = -1;
+    void* rings = useRings ? RpcChannel::createRings(&ringfd) : 0;
+    if (useRings && !rings)
+    {
+        printf("memfd is not available.\n");
+    }
+
+    pid_t pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0)
+    {
+        close(pair[0]);
+        RpcChannel::unmapRings(rings);
+        RpcChannel server(pair[1], (0 <= ringfd) ? RpcChannel::mapRings(ringfd) : 0, false);
+        ASSERT(server.hasRings() == (0 <= ringfd));
+        // The peer is the process that created the pair.
+        ASSERT(server.getPeer() == getppid());
+        serve(&server);
+        _exit(EXIT_SUCCESS);
+    }
+    close(pair[1]);
+    if (0 <= ringfd)
+    {
+        close(ringfd);
+    }
+    RpcChannel client(pair[0], rings, true, pid);
+    ASSERT(client.getPeer() == pid);
+
+    // Round trips
+    int tag = 0;
+    long long start = now();
+    for (int i = 0; i < ROUND_TRIPS; ++i)
+    {
+        request(&client, ++tag, 16);
+        reply(&client, tag, 16);
+    }
+    long long ns = now() - start;
+    printf("%s: %d round trips in %lld ms, %lld round trips/sec\n",
+           client.hasRings() ? "rings" : "socket", ROUND_TRIPS, ns / 1000000,
+           ROUND_TRIPS * 1000000000LL / (ns ? ns : 1));
+
+    // Varying sizes to wrap around the rings, mixed with the messages
+    // going over the socket.
+    for (int i = 0; i < MAX_DATA; ++i)
+    {
+        data[i] = rand();
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        int len = (i % 10 == 9) ? MAX_DATA : rand() % 8192;
+        request(&client, ++tag, len);
+        reply(&client, tag, len);
+    }
+
+    // File descriptor passing
+    int fds[2];
+    rc = pipe(fds);
+    ASSERT(rc == 0);
+    request(&client, ++tag, 100, fds[1]);
+    close(fds[1]);
+    reply(&client, tag, 100);
+    unsigned sum;
+    ssize_t len = read(fds[0], &sum, sizeof sum);
+    ASSERT(len == sizeof sum);
+    ASSERT(sum == checksum(data, 100));
+    close(fds[0]);
+
+    tag = testRelease(&client, tag);
+
+    request(&client, ++tag, -1);
+    int status;
+    pid_t child = waitpid(pid, &status, 0);
+    ASSERT(child == pid);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+// Checks a memfd the peer could resize under the mapping is not mapped.
+static void testUnsealed()
+{
+#ifdef SYS_memfd_create
+    int fd = syscall(SYS_memfd_create, "es-rpc-ring", 0);
+    if (fd == -1)
+    {
+        return;
+    }
+    int rc = ftruncate(fd, 2 * sizeof(RpcRing));
+    ASSERT(rc == 0);
+    void* rings = RpcChannel::mapRings(fd);
+    ASSERT(!rings);
+    close(fd);
+#endif
+}
+
+int main()
+{
+    RpcStack::init();
+    test(false);
+    test(true);
+    testUnsealed();
+    printf("done.\n");
+}
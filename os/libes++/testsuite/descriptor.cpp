@@ -0,0 +1,200 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the call descriptors of every interface in the interface list
+// against the reflection data, and compares the time to look up a method
+// through the descriptors with the time to parse the reflection data.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+
+#include <es.h>
+#include <es/exception.h>
+#include <es/interfaceData.h>
+#include <es/reflect.h>
+#include "callDescriptor.h"
+
+using namespace es;
+
+namespace
+{
+    const int LOOKUPS = 1000000;
+
+    // A minimal interface store over the interface list
+    std::map<std::string, Reflect::Interface> store;
+    std::map<std::string, const char*> names;
+}
+
+namespace es
+{
+
+Reflect::Interface& getInterface(const char* iid)
+{
+    std::map<std::string, Reflect::Interface>::iterator it = store.find(iid);
+    if (it == store.end())
+    {
+        throw SystemException<ENOENT>();
+    }
+    return (*it).second;
+}
+
+const char* getUniqueIdentifier(const char* iid)
+{
+    std::map<std::string, const char*>::iterator it = names.find(iid);
+    return (it != names.end()) ? (*it).second : 0;
+}
+
+}   // namespace es
+
+static void initialize()
+{
+    for (InterfaceData* data = interfaceData; data->iid; ++data)
+    {
+        store[data->iid()] = Reflect::Interface(data->info(), data->iid());
+        names[data->iid()] = data->iid();
+    }
+    for (InterfaceData* data = interfaceData; data->iid; ++data)
+    {
+        unsigned inheritedMethodCount = 0;
+        Reflect::Interface* super = &getInterface(data->iid());
+        for (std::string name; (name = super->getQualifiedSuperName()) != ""; )
+        {
+            super = &getInterface(name.c_str());
+            inheritedMethodCount += super->getMethodCount();
+        }
+        getInterface(data->iid()).setInheritedMethodCount(inheritedMethodCount);
+    }
+}
+
+// Looks up the method from the reflection data as the stubs used to do.
+static Reflect::Method lookup(const char* iid, unsigned methodNumber, bool* root, unsigned* number)
+{
+    Reflect::Interface super(getInterface(iid));
+    unsigned baseMethodCount;
+    for (;;)
+    {
+        baseMethodCount = super.getInheritedMethodCount();
+        if (baseMethodCount <= methodNumber)
+        {
+            break;
+        }
+        super = getInterface(super.getQualifiedSuperName().c_str());
+    }
+    *root = (super.getQualifiedSuperName() == "");
+    *number = methodNumber - baseMethodCount;
+    return super.getMethod(methodNumber - baseMethodCount);
+}
+
+static void check(const ParameterDescriptor& descriptor, Reflect::Type type)
+{
+    ASSERT(descriptor.getType() == type.getType());
+    ASSERT(descriptor.getSize() == type.getSize());
+    ASSERT(descriptor.getQualifiedName() == type.getQualifiedName());
+    if (type.getType() == Reflect::kSequence)
+    {
+        Reflect::Sequence seq(type);
+        ASSERT(descriptor.getElementSize() == seq.getType().getSize());
+    }
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main()
+{
+    initialize();
+
+    int methods = 0;
+    for (InterfaceData* data = interfaceData; data->iid; ++data)
+    {
+        const CallDescriptorTable* table = CallDescriptorTable::get(data->iid());
+        ASSERT(table);
+        ASSERT(table == CallDescriptorTable::get(data->iid()));
+
+        Reflect::Interface& interface = getInterface(data->iid());
+        ASSERT(table->getMethodCount() == interface.getInheritedMethodCount() + interface.getMethodCount());
+        ASSERT(!table->getMethod(table->getMethodCount()));
+        for (unsigned n = 0; n < table->getMethodCount(); ++n, ++methods)
+        {
+            const CallDescriptor* descriptor = table->getMethod(n);
+            bool root;
+            unsigned number;
+            Reflect::Method method = lookup(data->iid(), n, &root, &number);
+            ASSERT(descriptor->getName() == method.getName());
+            check(descriptor->getReturnType(), method.getReturnType());
+
+            unsigned count = 0;
+            for (Reflect::Parameter param = method.listParameter(); param.next(); ++count)
+            {
+                ASSERT(count < descriptor->getParameterCount());
+                check(descriptor->getParameter(count), param.getType());
+            }
+            ASSERT(count == descriptor->getParameterCount());
+
+            CallDescriptor::Kind kind = CallDescriptor::Operation;
+            if (root && number < 3)
+            {
+                kind = static_cast<CallDescriptor::Kind>(CallDescriptor::QueryInterface + number);
+            }
+            ASSERT(descriptor->getKind() == kind);
+        }
+    }
+    printf("%d methods checked.\n", methods);
+
+    // Look up the last method of the last interface, which is the deepest
+    // in the reflection data.
+    InterfaceData* data = interfaceData;
+    while (data[1].iid)
+    {
+        ++data;
+    }
+    const CallDescriptorTable* table = CallDescriptorTable::get(data->iid());
+    unsigned methodNumber = table->getMethodCount() - 1;
+
+    long long start = now();
+    unsigned sum = 0;
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        bool root;
+        unsigned number;
+        Reflect::Method method = lookup(data->iid(), methodNumber, &root, &number);
+        sum += method.getReturnType().getType();
+    }
+    long long reflect = now() - start;
+
+    start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        sum -= table->getMethod(methodNumber)->getReturnType().getType();
+    }
+    long long descriptor = now() - start;
+    ASSERT(sum == 0);
+
+    printf("%s %u: reflection %lld ns, descriptor %lld ns per lookup\n",
+           data->iid(), methodNumber, reflect / LOOKUPS, descriptor / LOOKUPS);
+
+    printf("done.\n");
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the index of the reflection data of every interface in the
+// interface list against the reflection data itself, and compares the time
+// to look up a method and its parameters with and without the index.
+
+#include <stdio.h>
+#include <time.h>
+
+#include <es.h>
+#include <es/interfaceData.h>
+#include <es/reflect.h>
+
+using namespace es;
+
+namespace
+{
+    const int LOOKUPS = 1000000;
+}
+
+static void check(Reflect::Method indexed, Reflect::Method parsed)
+{
+    ASSERT(indexed.getType() == parsed.getType());
+    ASSERT(indexed.getName() == parsed.getName());
+    ASSERT(indexed.getReturnType().getType() == parsed.getReturnType().getType());
+    ASSERT(indexed.getParameterCount() == parsed.getParameterCount());
+
+    unsigned count = 0;
+    Reflect::Parameter p = indexed.listParameter();
+    Reflect::Parameter q = parsed.listParameter();
+    for (;;)
+    {
+        bool more = p.next();
+        bool parsedMore = q.next();
+        ASSERT(more == parsedMore);
+        if (!more)
+        {
+            break;
+        }
+        ASSERT(p.getType().getType() == q.getType().getType());
+        ASSERT(p.getType().getQualifiedName() == q.getType().getQualifiedName());
+        ASSERT(p.getName() == q.getName());
+        ASSERT(indexed.getParameter(count).getName() == q.getName());
+        ASSERT(parsed.getParameter(count).getName() == q.getName());
+        ++count;
+    }
+    ASSERT(count == parsed.getParameterCount());
+    ASSERT(indexed.getParameter(count).getType().getType() == 0);
+    ASSERT(parsed.getParameter(count).getType().getType() == 0);
+}
+
+// Looks up the parameter of the method as the marshaling code does.
+static unsigned lookup(const Reflect::Interface& interface, unsigned n)
+{
+    Reflect::Method method = interface.getMethod(n);
+    unsigned sum = method.getReturnType().getType();
+    Reflect::Parameter param = method.listParameter();
+    while (param.next())
+    {
+        sum += param.getType().getType();
+    }
+    return sum;
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main()
+{
+    int methods = 0;
+    InterfaceData* last = 0;
+    for (InterfaceData* data = interfaceData; data->iid; ++data)
+    {
+        Reflect::Interface indexed(data->info(), data->iid(), data->infoIndex());
+        Reflect::Interface parsed(data->info(), data->iid());
+        ASSERT(indexed.getIndex() == data->infoIndex());
+        ASSERT(!parsed.getIndex());
+
+        ASSERT(indexed.getMethodCount() == parsed.getMethodCount());
+        for (unsigned n = 0; n < parsed.getMethodCount(); ++n, ++methods)
+        {
+            check(indexed.getMethod(n), parsed.getMethod(n));
+        }
+
+        ASSERT(indexed.getConstructorCount() == parsed.getConstructorCount());
+        for (unsigned n = 0; n < parsed.getConstructorCount(); ++n)
+        {
+            check(indexed.getConstructor(n), parsed.getConstructor(n));
+        }
+
+        ASSERT(indexed.getConstantCount() == parsed.getConstantCount());
+        for (unsigned n = 0; n < parsed.getConstantCount(); ++n)
+        {
+            Reflect::Constant c = indexed.getConstant(n);
+            Reflect::Constant d = parsed.getConstant(n);
+            ASSERT(c.getName() == d.getName());
+            ASSERT(c.getValue() == d.getValue());
+        }
+
+        if (!last || last->infoIndex()[0] < data->infoIndex()[0])
+        {
+            last = data;
+        }
+    }
+    printf("%d methods checked.\n", methods);
+
+    // Look up the last method of the interface of the most methods.
+    Reflect::Interface indexed(last->info(), last->iid(), last->infoIndex());
+    Reflect::Interface parsed(last->info(), last->iid());
+    unsigned methodNumber = parsed.getMethodCount() - 1;
+
+    long long start = now();
+    unsigned sum = 0;
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        sum += lookup(parsed, methodNumber);
+    }
+    long long parsing = now() - start;
+
+    start = now();
+    for (int i = 0; i < LOOKUPS; ++i)
+    {
+        sum -= lookup(indexed, methodNumber);
+    }
+    long long indexing = now() - start;
+    ASSERT(sum == 0);
+
+    printf("%s %u: reflection %lld ns, index %lld ns per lookup\n",
+           last->iid(), methodNumber, parsing / LOOKUPS, indexing / LOOKUPS);
+
+    printf("done.\n");
+}
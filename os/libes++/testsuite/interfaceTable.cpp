@@ -0,0 +1,109 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the hashes of the interface identifiers generated by esidl, and
+// queryInterface() implemented with an InterfaceTable.
+
+#include <stdio.h>
+#include <string.h>
+#include <es.h>
+#include <es/interfaceTable.h>
+#include <es/ref.h>
+#include <es/base/ICallback.h>
+#include <es/base/IService.h>
+#include <es/naming/IBinding.h>
+
+using namespace es;
+
+class Worker : public es::Callback, public es::Service
+{
+    Ref ref;
+
+public:
+    int invoke(int result)
+    {
+        return result;
+    }
+
+    bool start()
+    {
+        return true;
+    }
+
+    bool stop()
+    {
+        return true;
+    }
+
+    Object* queryInterface(const char* riid)
+    {
+        return InterfaceTable<Worker, es::Callback, es::Service>::query(this, riid);
+    }
+
+    unsigned int addRef()
+    {
+        return ref.addRef();
+    }
+
+    unsigned int release()
+    {
+        return ref.release();
+    }
+
+    unsigned int getCount() const
+    {
+        return ref;
+    }
+};
+
+int main()
+{
+    ASSERT(hashIid(Object::iid()) == Object::iidHash);
+    ASSERT(hashIid(es::Callback::iid()) == es::Callback::iidHash);
+    ASSERT(hashIid(es::Service::iid()) == es::Service::iidHash);
+    ASSERT(hashIid(es::Binding::iid()) == es::Binding::iidHash);
+
+    Worker worker;
+
+    // By the unique identifiers
+    Object* object = worker.queryInterface(Object::iid());
+    ASSERT(object == static_cast<es::Callback*>(&worker));
+    ASSERT(worker.getCount() == 2);
+    object = worker.queryInterface(es::Callback::iid());
+    ASSERT(object == static_cast<es::Callback*>(&worker));
+    object = worker.queryInterface(es::Service::iid());
+    ASSERT(object == static_cast<es::Service*>(&worker));
+    ASSERT(worker.getCount() == 4);
+    object = worker.queryInterface(es::Binding::iid());
+    ASSERT(!object);
+    ASSERT(worker.getCount() == 4);
+
+    // By the copies of the identifiers
+    char riid[64];
+    strcpy(riid, es::Service::iid());
+    object = worker.queryInterface(riid);
+    ASSERT(object == static_cast<es::Service*>(&worker));
+    strcpy(riid, Object::iid());
+    object = worker.queryInterface(riid);
+    ASSERT(object == static_cast<es::Callback*>(&worker));
+    strcpy(riid, es::Binding::iid());
+    object = worker.queryInterface(riid);
+    ASSERT(!object);
+    ASSERT(worker.getCount() == 6);
+
+    printf("done.\n");
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Serves the requests sent over an RpcChannel with an RpcPool, and checks
+// the requests are served concurrently, the ordered requests are served
+// in order, the idle threads steal the tasks, the nested calls back to the
+// client are served by the thread waiting on the channel, the statistics
+// are kept, and the channels of the clients that have gone are closed after
+// the requests sent over them are served.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <es.h>
+#include "rpcPool.h"
+
+using namespace es;
+
+namespace
+{
+    const unsigned PLAIN = 0;
+    const unsigned SLEEP = 1;       // takes SLEEP_TIME
+    const unsigned ORDERED = 2;     // served in order per object
+    const unsigned CALLBACK = 3;    // calls back to the client
+    const unsigned ECHO = 4;        // the call back
+    const unsigned COUNT = 5;       // counted in counted
+
+    const unsigned THREADS = 4;
+    const int SLEEP_TIME = 200;     // [ms]
+    const int CALLBACK_TAG = 1000000;
+    const int CLIENTS = 1000;
+
+    int last[2];    // the tag of the last ordered request for each object
+    int counted;
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static ssize_t send(RpcChannel* channel, const void* data, size_t len)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = len;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    return channel->send(&msg);
+}
+
+static void request(RpcChannel* channel, int tag, unsigned methodNumber, int object = 0)
+{
+    RpcReq req = { RPC_REQ, tag, getpid() };
+    req.capability.object = object;
+    req.methodNumber = methodNumber;
+    req.paramCount = 0;
+    ssize_t sent = send(channel, &req, sizeof req);
+    ASSERT(sent == sizeof req);
+}
+
+// The client may have gone without waiting for the reply.
+static void reply(RpcChannel* channel, int tag)
+{
+    RpcRes res = { RPC_RES, tag, getpid(), 0 };
+    send(channel, &res, sizeof res);
+}
+
+static void serve(RpcChannel* channel, RpcReq* req)
+{
+    switch (req->methodNumber)
+    {
+    case SLEEP:
+        usleep(SLEEP_TIME * 1000);
+        break;
+    case ORDERED: {
+        int i = req->capability.object;
+        usleep((req->tag % 4) * 100);
+        ASSERT(last[i] < req->tag);
+        last[i] = req->tag;
+        break;
+    }
+    case CALLBACK: {
+        ASSERT(RpcPool::owns(channel));
+        RpcPool::Wait wait(channel);
+        request(channel, CALLBACK_TAG + req->tag, ECHO);
+        for (;;)
+        {
+            RpcStack stackBase;
+            int fdv[8];
+            int* fdmax;
+            RpcHdr* hdr = RpcPool::receive(channel, fdv, fdmax);
+            if (hdr->cmd == RPC_REQ)
+            {
+                // Sent by the client while it serves the call back.
+                serve(channel, reinterpret_cast<RpcReq*>(hdr));
+                continue;
+            }
+            ASSERT(hdr->cmd == RPC_RES);
+            ASSERT(hdr->tag == CALLBACK_TAG + req->tag);
+            break;
+        }
+        break;
+    }
+    case COUNT:
+        __sync_add_and_fetch(&counted, 1);
+        break;
+    default:
+        break;
+    }
+    RpcPool::disown();
+    reply(channel, req->tag);
+}
+
+class TestServant : public RpcPool::Servant
+{
+public:
+    void* accept(RpcChannel* channel, RpcHdr* hdr, unsigned long* key)
+    {
+        RpcReq* req = reinterpret_cast<RpcReq*>(hdr);
+        *key = (req->methodNumber == ORDERED) ? req->capability.object + 1 : 0;
+        return req;
+    }
+
+    void serve(RpcChannel* channel, RpcHdr* hdr, size_t size, int* fdv, int* fdmax, void* cookie)
+    {
+        ASSERT(cookie == hdr);
+        ASSERT(size == sizeof(RpcReq));
+        ASSERT(fdmax == fdv);
+        ::serve(channel, reinterpret_cast<RpcReq*>(hdr));
+    }
+};
+
+static RpcHdr* receive(RpcChannel* channel)
+{
+    int fdv[8];
+    int* fdmax;
+    RpcHdr* hdr = channel->receive(fdv, fdmax);
+    ASSERT(fdmax == fdv);
+    return hdr;
+}
+
+static int countDescriptors()
+{
+    int count = 0;
+    for (int fd = 0; fd < 1024; ++fd)
+    {
+        if (fcntl(fd, F_GETFD) != -1)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Waits for the replies to the requests tagged [first, last).
+static void wait(RpcChannel* channel, int first, int last)
+{
+    for (int n = first; n < last; ++n)
+    {
+        RpcStack stackBase;
+        RpcHdr* hdr = receive(channel);
+        ASSERT(hdr->cmd == RPC_RES);
+        ASSERT(first <= hdr->tag && hdr->tag < last);
+    }
+}
+
+int main()
+{
+    RpcStack::init();
+
+    int pair[2];
+    int rc = socketpair(PF_UNIX, SOCK_DGRAM, 0, pair);
+    ASSERT(rc == 0);
+    RpcChannel client(pair[0], 0, true);
+
+    TestServant servant;
+    RpcPool pool(&servant, THREADS);
+    pool.add(new RpcChannel(pair[1], 0, false));
+
+    RpcPoolStats stats;
+    pool.getStats(&stats);
+    ASSERT(stats.threads == THREADS);
+    ASSERT(stats.served == 0);
+
+    // Concurrency
+    int tag = 0;
+    long long start = now();
+    for (unsigned i = 0; i < THREADS; ++i)
+    {
+        request(&client, ++tag, SLEEP);
+    }
+    wait(&client, 1, tag + 1);
+    long long elapsed = now() - start;
+    printf("%u requests of %d ms served in %lld ms\n", THREADS, SLEEP_TIME, elapsed);
+    ASSERT(elapsed < 2 * SLEEP_TIME);
+
+    // Work stealing: the tasks queued behind a long one are taken by the
+    // other threads.
+    int first = tag + 1;
+    request(&client, ++tag, SLEEP);
+    for (unsigned i = 0; i < 2 * THREADS - 1; ++i)
+    {
+        request(&client, ++tag, PLAIN);
+    }
+    wait(&client, first, tag + 1);
+    pool.getStats(&stats);
+    ASSERT(1 <= stats.stolen);
+
+    // Ordered requests mixed with the others
+    first = tag + 1;
+    for (int i = 0; i < 200; ++i)
+    {
+        request(&client, ++tag, (i % 3) ? ORDERED : PLAIN, i % 2);
+    }
+    wait(&client, first, tag + 1);
+    ASSERT(last[0] != 0 && last[1] != 0);
+
+    // Nested calls: the request sent while serving the call back is passed
+    // to the thread waiting for the reply to it.
+    request(&client, ++tag, CALLBACK);
+    {
+        RpcStack stackBase;
+        RpcHdr* hdr = receive(&client);
+        ASSERT(hdr->cmd == RPC_REQ);
+        ASSERT(reinterpret_cast<RpcReq*>(hdr)->methodNumber == ECHO);
+        ASSERT(hdr->tag == CALLBACK_TAG + tag);
+
+        request(&client, tag + 1, PLAIN);
+        wait(&client, tag + 1, tag + 2);
+        reply(&client, hdr->tag);
+        wait(&client, tag, tag + 1);
+        ++tag;
+    }
+
+    pool.getStats(&stats);
+    printf("served %llu, stolen %llu, latency avg %llu ns, max %llu ns\n",
+           (unsigned long long) stats.served, (unsigned long long) stats.stolen,
+           (unsigned long long) (stats.totalLatency / (stats.served ? stats.served : 1)),
+           (unsigned long long) stats.maxLatency);
+    // Every request but the one served in the nested call has been queued.
+    ASSERT(stats.served == static_cast<u64>(tag - 1));
+    ASSERT(stats.queued == 0);
+    ASSERT(stats.maxLatency <= stats.totalLatency);
+
+    // Clients connecting and going away, every other one with its request
+    // in flight. SOCK_SEQPACKET lets the pool see them go.
+    int fds = countDescriptors();
+    for (int i = 0; i < CLIENTS; ++i)
+    {
+        rc = socketpair(PF_UNIX, SOCK_SEQPACKET, 0, pair);
+        ASSERT(rc == 0);
+        RpcChannel* channel = new RpcChannel(pair[0], 0, true);
+        pool.add(new RpcChannel(pair[1], 0, false));
+        request(channel, 1, COUNT);
+        if (i % 2)
+        {
+            wait(channel, 1, 2);
+        }
+        delete channel;
+    }
+    for (int i = 0; i < 200 && (counted < CLIENTS || fds < countDescriptors()); ++i)
+    {
+        usleep(10000);
+    }
+    printf("%d clients served, %d descriptors left open\n", counted, countDescriptors() - fds);
+    ASSERT(counted == CLIENTS);
+    ASSERT(countDescriptors() == fds);
+
+    printf("done.\n");
+}
@@ -0,0 +1,475 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Calls an object through the typed proxy generated by esidl -stub over a
+// loopback transport, and checks the requests are served the same by the
+// typed skeleton and by the reflective path that unmarshals the arguments
+// from the call descriptors and invokes the method with apply(). The
+// asynchronous calls and the one-way calls are sent over an RpcChannel to
+// check the replies are matched to the futures by the tag. Also checks the
+// skeleton leaves a request with a string not terminated within it to the
+// reflective path. The two paths are compared between the processes by
+// os/testsuite/stub.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <map>
+#include <string>
+
+#include <es.h>
+#include <es/exception.h>
+#include <es/reflect.h>
+#include <es/rpcStub.h>
+#include "callDescriptor.h"
+#include "rpcChannel.h"
+#include "stubTest.stub.h"
+
+using namespace es;
+
+typedef ExtendedStubTest_Proxy<RpcProxy<ExtendedStubTest> > Proxy;
+
+namespace
+{
+    const int FUTURES = 8;
+
+    // A minimal interface store over the interfaces used here
+    std::map<std::string, Reflect::Interface> store;
+    std::map<std::string, const char*> names;
+
+    class Servant : public ExtendedStubTest
+    {
+        int value;
+
+    public:
+        Servant() :
+            value(0)
+        {
+        }
+
+        int getValue()
+        {
+            return value;
+        }
+
+        void setValue(int value)
+        {
+            this->value = value;
+        }
+
+        long long add(int x, long long y)
+        {
+            value += x;
+            return value + y;
+        }
+
+        unsigned int pack(unsigned char a, short b, unsigned short c, bool d)
+        {
+            return (a << 24) ^ (static_cast<unsigned short>(b) << 8) ^ c ^ (d ? 0x80000000 : 0);
+        }
+
+        bool compare(const char* a, const char* b)
+        {
+            if (!a || !b)
+            {
+                return a == b;
+            }
+            return strcmp(a, b) == 0;
+        }
+
+        StubTest* self()
+        {
+            return this;
+        }
+
+        void post(int digit)
+        {
+            value = value * 10 + digit;
+        }
+
+        int length(const char* s)
+        {
+            return s ? strlen(s) : -1;
+        }
+
+        void clear()
+        {
+            value = 0;
+        }
+
+        Object* queryInterface(const char* riid)
+        {
+            return 0;
+        }
+
+        unsigned int addRef()
+        {
+            return 1;
+        }
+
+        unsigned int release()
+        {
+            return 1;
+        }
+    };
+
+    Servant servant;
+    bool typed;                 // dispatch requests through the skeleton
+    unsigned reflected = ~0u;   // the method number passed to the reflective proxy
+    u8 wire[1024];
+
+    // The channel the asynchronous requests are sent over
+    RpcChannel* client;
+    RpcChannel* server;
+    int rpctag;
+    unsigned oneway;            // the number of the one-way requests served
+}
+
+namespace es
+{
+
+Reflect::Interface& getInterface(const char* iid)
+{
+    std::map<std::string, Reflect::Interface>::iterator it = store.find(iid);
+    if (it == store.end())
+    {
+        throw SystemException<ENOENT>();
+    }
+    return (*it).second;
+}
+
+const char* getUniqueIdentifier(const char* iid)
+{
+    std::map<std::string, const char*>::iterator it = names.find(iid);
+    return (it != names.end()) ? (*it).second : 0;
+}
+
+}   // namespace es
+
+// Serves the request on the wire as callLocal() does without the skeleton.
+static Any applyReflect(RpcReq* req)
+{
+    const CallDescriptorTable* table = CallDescriptorTable::get(ExtendedStubTest::iid());
+    const CallDescriptor* method = table->getMethod(req->methodNumber);
+    ASSERT(method && method->getParameterCount() + 1 == req->paramCount);
+
+    Any* argv = req->getArgv();
+    argv[0] = Any(static_cast<Object*>(static_cast<ExtendedStubTest*>(&servant)));
+    u8* data = static_cast<u8*>(req->getData());
+    for (unsigned i = 0; i < method->getParameterCount(); ++i)
+    {
+        if (method->getParameter(i).getType() == Reflect::kString && static_cast<const char*>(argv[i + 1]))
+        {
+            argv[i + 1] = Any(reinterpret_cast<const char*>(data));
+            data += strlen(reinterpret_cast<const char*>(data)) + 1;
+        }
+    }
+
+    typedef long long (*Method)(void* self, ...);
+    Method** object = reinterpret_cast<Method**>(static_cast<ExtendedStubTest*>(&servant));
+    Method function = (*object)[req->methodNumber];
+    switch (method->getReturnType().getType())
+    {
+    case Reflect::kBoolean:
+        return apply(req->paramCount, argv, (bool (*)()) function);
+    case Reflect::kLong:
+        return apply(req->paramCount, argv, (int32_t (*)()) function);
+    case Reflect::kUnsignedLong:
+        return apply(req->paramCount, argv, (uint32_t (*)()) function);
+    case Reflect::kLongLong:
+        return apply(req->paramCount, argv, (int64_t (*)()) function);
+    default:
+        apply(req->paramCount, argv, (int32_t (*)()) function);
+        return Any();
+    }
+}
+
+namespace es
+{
+
+// The loopback transport
+Any invokeRemote(unsigned interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt)
+{
+    iov[0].iov_base = req;
+    iov[0].iov_len = sizeof(RpcReq) + sizeof(Any) * req->paramCount;
+    u8* p = wire;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        ASSERT(p + iov[i].iov_len <= wire + sizeof wire);
+        memcpy(p, iov[i].iov_base, iov[i].iov_len);
+        p += iov[i].iov_len;
+    }
+
+    req = reinterpret_cast<RpcReq*>(wire);
+    u8* data = static_cast<u8*>(req->getData());
+    Any result;
+    if (typed &&
+        ExtendedStubTest_Skeleton<>::dispatch(&servant, req->methodNumber, req->getArgv(),
+                                              data, p - data, &result))
+    {
+        return result;
+    }
+    return applyReflect(req);
+}
+
+// Sends the request over the channel, and serves it at once leaving the
+// reply on the channel.
+void invokeRemote(unsigned interfaceNumber, RpcReq* req, struct iovec* iov, int iovcnt, RpcFuture* future)
+{
+    int tag = ++rpctag;
+    req->cmd = future ? RPC_REQ : RPC_ONEWAY;
+    req->tag = tag;
+    req->pid = getpid();
+    iov[0].iov_base = req;
+    iov[0].iov_len = sizeof(RpcReq) + sizeof(Any) * req->paramCount;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    ssize_t rc = client->send(&msg);
+    ASSERT(0 < rc);
+    if (future)
+    {
+        client->expect(future, tag);
+    }
+
+    RpcStack stackBase;
+    int fdv[8];
+    int* fdmax;
+    size_t size;
+    req = reinterpret_cast<RpcReq*>(server->receive(fdv, fdmax, &size));
+    RpcRes res = { RPC_RES, req->tag, getpid(), 0 };
+    u8* data = static_cast<u8*>(req->getData());
+    bool dispatched = ExtendedStubTest_Skeleton<>::dispatch(&servant, req->methodNumber, req->getArgv(),
+                                                            data, reinterpret_cast<u8*>(req) + size - data,
+                                                            &res.result);
+    ASSERT(dispatched);
+    if (req->cmd == RPC_ONEWAY)
+    {
+        ++oneway;
+        return;
+    }
+    struct iovec reply;
+    reply.iov_base = &res;
+    reply.iov_len = sizeof res;
+    msg.msg_iov = &reply;
+    msg.msg_iovlen = 1;
+    rc = server->send(&msg);
+    ASSERT(rc == sizeof res);
+}
+
+long long invokeRemote(unsigned interfaceNumber, unsigned methodNumber, va_list ap, Any* variant)
+{
+    reflected = methodNumber;
+    return 0;
+}
+
+void RpcFuture::wait()
+{
+    while (!ready)
+    {
+        RpcStack stackBase;
+        int fdv[8];
+        int* fdmax;
+        RpcHdr* hdr = channel->receive(fdv, fdmax);
+        ASSERT(hdr->cmd == RPC_RES);
+        bool delivered = channel->deliver(reinterpret_cast<RpcRes*>(hdr));
+        ASSERT(delivered);
+    }
+}
+
+void RpcFuture::abandon()
+{
+    try
+    {
+        wait();
+    }
+    catch (...)
+    {
+        channel->forget(this);
+    }
+}
+
+}   // namespace es
+
+static void initialize()
+{
+    store[Object::iid()] = Reflect::Interface(Object::info(), Object::iid());
+    names[Object::iid()] = Object::iid();
+    store[StubTest::iid()] = Reflect::Interface(StubTest::info(), StubTest::iid());
+    names[StubTest::iid()] = StubTest::iid();
+    store[ExtendedStubTest::iid()] = Reflect::Interface(ExtendedStubTest::info(), ExtendedStubTest::iid());
+    names[ExtendedStubTest::iid()] = ExtendedStubTest::iid();
+
+    getInterface(StubTest::iid()).setInheritedMethodCount(getInterface(Object::iid()).getMethodCount());
+    getInterface(ExtendedStubTest::iid()).setInheritedMethodCount(getInterface(Object::iid()).getMethodCount() +
+                                                                  getInterface(StubTest::iid()).getMethodCount());
+}
+
+static void check(ExtendedStubTest* proxy)
+{
+    servant.clear();
+    proxy->setValue(42);
+    ASSERT(servant.getValue() == 42);
+    int32_t value = proxy->getValue();
+    ASSERT(value == 42);
+    long long sum = proxy->add(-2, 10000000000LL);
+    ASSERT(sum == 10000000040LL);
+    uint32_t packed = proxy->pack(0x12, -2, 0x3456, true);
+    ASSERT(packed == servant.pack(0x12, -2, 0x3456, true));
+    bool equal = proxy->compare("stub", "stub");
+    ASSERT(equal);
+    equal = proxy->compare("stub", "skeleton");
+    ASSERT(!equal);
+    equal = proxy->compare(0, "stub");
+    ASSERT(!equal);
+    equal = proxy->compare(0, 0);
+    ASSERT(equal);
+    int32_t length = proxy->length("skeleton");
+    ASSERT(length == 8);
+    length = proxy->length(0);
+    ASSERT(length == -1);
+    proxy->clear();
+    ASSERT(servant.getValue() == 0);
+}
+
+static void checkAsync(Proxy* proxy)
+{
+    RpcFuture futures[FUTURES];
+    int values[FUTURES];
+
+    // Mix the one-way requests with the asynchronous ones, and wait for
+    // the replies in the reverse order.
+    servant.clear();
+    int value = 0;
+    for (int i = 0; i < FUTURES; ++i)
+    {
+        proxy->post(i);
+        value = value * 10 + i;
+        values[i] = value;
+        proxy->getValue(&futures[i]);
+        ASSERT(!futures[i].isReady());
+    }
+    for (int i = FUTURES - 1; 0 <= i; --i)
+    {
+        Any result = futures[i].get();
+        ASSERT(static_cast<int32_t>(result) == values[i]);
+        ASSERT(futures[0].isReady());
+    }
+    ASSERT(oneway == FUTURES);
+
+    RpcFuture add;
+    RpcFuture compare;
+    proxy->add(&add, 1, 10000000000LL);
+    proxy->compare(&compare, "stub", "stub");
+    Any equal = compare.get();
+    ASSERT(static_cast<bool>(equal));
+    Any sum = add.get();
+    ASSERT(static_cast<int64_t>(sum) == values[FUTURES - 1] + 1 + 10000000000LL);
+
+    // A future left pending takes its reply when it goes away.
+    {
+        RpcFuture length;
+        proxy->length(&length, "skeleton");
+    }
+    RpcFuture clear;
+    proxy->clear(&clear);
+    clear.get();
+    ASSERT(servant.getValue() == 0);
+}
+
+// Checks a string must be terminated within the data of the request.
+static void checkUnterminated()
+{
+    struct
+    {
+        RpcMessage<2> msg;
+        char data[8];
+    } req;
+    req.msg.req.paramCount = 2;
+    req.msg.argv[1] = Any("skeleton");
+    memcpy(req.data, "skeleton", sizeof req.data);
+
+    // length() is the first method of ExtendedStubTest.
+    unsigned methodNumber = ExtendedStubTest_Skeleton<>::BASE;
+    Any result;
+    bool dispatched = ExtendedStubTest_Skeleton<>::dispatch(&servant, methodNumber, req.msg.argv,
+                                                            reinterpret_cast<u8*>(req.data), sizeof req.data,
+                                                            &result);
+    ASSERT(!dispatched);
+
+    req.data[7] = '\0';
+    dispatched = ExtendedStubTest_Skeleton<>::dispatch(&servant, methodNumber, req.msg.argv,
+                                                       reinterpret_cast<u8*>(req.data), sizeof req.data,
+                                                       &result);
+    ASSERT(dispatched);
+    ASSERT(static_cast<int32_t>(result) == 7);
+}
+
+int main()
+{
+    initialize();
+    RpcStack::init();
+
+    int pair[2];
+    int rc = socketpair(PF_UNIX, SOCK_DGRAM, 0, pair);
+    ASSERT(rc == 0);
+    client = new RpcChannel(pair[0]);
+    server = new RpcChannel(pair[1], 0, false);
+
+    Proxy* proxy = new Proxy(0);
+
+    // The method numbers must match the reflection data.
+    const CallDescriptorTable* table = CallDescriptorTable::get(ExtendedStubTest::iid());
+    ASSERT(table);
+    ASSERT(Proxy::METHOD_COUNT == table->getMethodCount());
+    ASSERT(ExtendedStubTest_Skeleton<>::METHOD_COUNT == table->getMethodCount());
+
+    // self returns an object, which is left to the reflective path.
+    StubTest* self = proxy->self();
+    ASSERT(self == 0);
+    ASSERT(reflected < table->getMethodCount());
+    ASSERT(table->getMethod(reflected)->getName() == "self");
+    proxy->release();
+    ASSERT(reflected == 2);
+
+    // post is [Oneway] in the reflection data as well, and only the methods
+    // declared in StubTest are [Ordered].
+    unsigned first = getInterface(Object::iid()).getMethodCount();
+    unsigned last = first + getInterface(StubTest::iid()).getMethodCount();
+    for (unsigned i = 0; i < table->getMethodCount(); ++i)
+    {
+        ASSERT(table->getMethod(i)->isOneway() == (table->getMethod(i)->getName() == "post"));
+        ASSERT(table->getMethod(i)->isOrdered() == (first <= i && i < last));
+    }
+
+    typed = false;
+    check(proxy);
+
+    typed = true;
+    check(proxy);
+
+    checkAsync(proxy);
+    checkUnterminated();
+
+    delete proxy;
+    delete client;
+    delete server;
+    printf("done.\n");
+}
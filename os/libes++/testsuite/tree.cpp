@@ -107,5 +107,61 @@ int main()
     ASSERT(b.contains(2));
     ASSERT(!b.contains(0));
 
+    // b holds 2, 4, 5 and 6.
+    ASSERT(b.getFloor(1) == 0);
+    ASSERT(b.getFloor(2)->getKey() == 2);
+    ASSERT(b.getFloor(3)->getKey() == 2);
+    ASSERT(b.getFloor(9)->getKey() == 6);
+    ASSERT(b.getCeiling(1)->getKey() == 2);
+    ASSERT(b.getCeiling(3)->getKey() == 4);
+    ASSERT(b.getCeiling(6)->getKey() == 6);
+    ASSERT(b.getCeiling(7) == 0);
+    ASSERT(b.getNext(b.getFloor(4))->getKey() == 5);
+    ASSERT(b.getNext(b.getLast()) == 0);
+    ASSERT(b.getPrevious(b.getFirst()) == 0);
+
+    // The parent links must be kept across the rotations for getNext()
+    // and getPrevious().
+    Tree<int, int> c;
+    bool in[64] = { false };
+    unsigned seed = 1;
+    for (int i = 0; i < 10000; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        int key = (seed >> 16) % 64;
+        if (in[key])
+        {
+            c.remove(key);
+        }
+        else
+        {
+            c.add(key, 0);
+        }
+        in[key] = !in[key];
+
+        int count = 0;
+        for (int k = 0; k < 64; ++k)
+        {
+            if (in[k])
+            {
+                ++count;
+            }
+        }
+        int forward = 0;
+        int last = -1;
+        for (node = c.getFirst(); node; node = c.getNext(node))
+        {
+            ASSERT(last < node->getKey() && in[node->getKey()]);
+            last = node->getKey();
+            ++forward;
+        }
+        int backward = 0;
+        for (node = c.getLast(); node; node = c.getPrevious(node))
+        {
+            ++backward;
+        }
+        ASSERT(forward == count && backward == count);
+    }
+
     printf("done.\n");
 }
@@ -30,7 +30,6 @@ class Address : public es::InternetAddress
 {
     u8                      mac[6];
     Collection<Socket*>     sockets;
-    Collection<Messenger*>  packets;
 
 public:
     Address()
@@ -72,21 +71,6 @@ public:
 
     virtual Address* getNextHop() = 0;
 
-    void hold(Messenger* m)
-    {
-        m->addRef();
-        packets.addLast(m);
-    }
-
-    Messenger* retrieve()
-    {
-        if (packets.isEmpty())
-        {
-            return 0;
-        }
-        return packets.removeFirst();
-    }
-
     friend class UDPReceiver;
 };
 
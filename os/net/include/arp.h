@@ -24,24 +24,37 @@
 #include <es/net/arp.h>
 #include "socket.h"
 #include "inet4address.h"
+#include "neighbor.h"
 
 class ARPReceiver : public InetReceiver
 {
-    InFamily*   inFamily;
+    InFamily*       inFamily;
+    NeighborCache*  neighborCache;
+
+    Inet4Address* getAddress(InAddr addr, int scopeID);
 
 public:
-    ARPReceiver(InFamily* inFamily) :
-        inFamily(inFamily)
+    ARPReceiver(InFamily* inFamily, NeighborCache* neighborCache) :
+        inFamily(inFamily),
+        neighborCache(neighborCache)
     {
     }
 
     bool input(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerLink;
+    }
 };
 
 class ARPFamily : public AddressFamily
 {
     InFamily*                   inFamily;
 
+    // Neighbor cache
+    NeighborCache               neighborCache;
+
     // Scope demultiplexer
     InetScopeAccessor           scopeAccessor;
     ConduitFactory              scopeFactory;
@@ -68,6 +81,11 @@ public:
         return &arpProtocol;
     }
 
+    NeighborCache* getNeighborCache()
+    {
+        return &neighborCache;
+    }
+
     void addInterface(NetworkInterface* interface)
     {
         Conduit* c = interface->addAddressFamily(this, &scopeMux);
@@ -86,6 +104,7 @@ public:
             m.setLocal(address);
             Installer installer(&m);
             arpMux.accept(&installer, &arpProtocol);
+            neighborCache.add(address);
         }
     }
 
@@ -94,6 +113,7 @@ public:
         ASSERT(address);
         if (address)
         {
+            neighborCache.remove(address);
             Adapter* adapter = dynamic_cast<Adapter*>(address->getAdapter());
             if (adapter)
             {
@@ -26,6 +26,7 @@
 #include <es/ref.h>
 #include <es/types.h>
 #include <es/tree.h>
+#include "rwlock.h"
 
 class Accessor;
 class Adapter;
@@ -292,6 +293,8 @@ public:
 
 class Conduit
 {
+    Ref             ref;
+
 protected:
     Receiver*       receiver;
     Conduit*        sideA;
@@ -306,17 +309,28 @@ public:
     }
     virtual ~Conduit()
     {
+        if (receiver)
+        {
+            receiver->release();
+        }
     }
 
-    virtual unsigned int release()
+    /** Keeps this conduit while it is visited without the lock of the
+     * mux that holds it. The conduit is deleted by the last release().
+     */
+    unsigned int addRef()
     {
-        if (receiver)
+        return ref.addRef();
+    }
+
+    unsigned int release()
+    {
+        unsigned int count = ref.release();
+        if (count == 0)
         {
-            receiver->release();
-            receiver = 0;
+            delete this;
         }
-        delete this;
-        return 0;
+        return count;
     }
 
     virtual bool accept(Messenger* m) = 0;
@@ -458,14 +472,12 @@ public:
     {
     }
 
-    unsigned int release()
+    ~ConduitFactory()
     {
         if (prototype)
         {
             prototype->release();
-            prototype = 0;
         }
-        return Conduit::release();
     }
 
     bool accept(Messenger* m)
@@ -588,6 +600,7 @@ class Mux : public Conduit
     Accessor*               accessor;
     ConduitFactory*         factory;
     Tree<void*, Conduit*>   sideB;
+    mutable ReadWriteLock   lock;       // Guards sideB
 
     Conduit* getB() const
     {
@@ -605,17 +618,11 @@ public:
         factory->setA(this);
     }
     ~Mux()
-    {
-    }
-
-    unsigned int release()
     {
         if (factory)
         {
             factory->release();
-            factory = 0;
         }
-        return Conduit::release();
     }
 
     ConduitFactory* getFactory() const
@@ -663,33 +670,52 @@ public:
     }
     void addB(void* key, Conduit* c)
     {
+        ReadWriteLock::Writer writer(lock);
         sideB.add(key, c);
     }
     void removeB(void* key)
     {
+        ReadWriteLock::Writer writer(lock);
         sideB.remove(key);
     }
 
     bool isEmpty() const
     {
+        ReadWriteLock::Reader reader(lock);
         return sideB.isEmpty();
     }
 
+    /** Returns the conduit at side B for the key with its reference
+     * count incremented, as it can be removed once the lock is released.
+     * The caller must release it.
+     */
     Conduit* getB(void* key) const
     {
-        return sideB.get(key);
+        ReadWriteLock::Reader reader(lock);
+        Conduit* b = sideB.get(key);
+        b->addRef();
+        return b;
     }
 
     bool contains(void* key) const
     {
+        ReadWriteLock::Reader reader(lock);
         return sideB.contains(key);
     }
 
+    /** Returns the iterator over side B. The caller must hold the read
+     * lock returned by getLock() while iterating.
+     */
     Tree<void*, Conduit*>::Iterator list()
     {
         return sideB.begin();
     }
 
+    ReadWriteLock& getLock() const
+    {
+        return lock;
+    }
+
     Mux* clone(void* key)
     {
         Mux* m = new Mux(accessor, factory->clone(key));
@@ -707,6 +733,7 @@ public:
 
     void* getKey(Conduit* b)
     {
+        ReadWriteLock::Reader reader(lock);
         Tree<void*, Conduit*>::Node* node;
         Tree<void*, Conduit*>::Iterator iter = list();
         while ((node = iter.next()))
@@ -818,17 +845,23 @@ inline bool Visitor::toB(Mux* m)
 {
     void* key = m->getKey(getMessenger());
     do {
+        Conduit* b = 0;
         try
         {
-            Conduit* b = m->getB(key);
+            b = m->getB(key);
             if (b->accept(this, m))
             {
+                b->release();
                 return true;
             }
         }
         catch (SystemException<ENOENT>)
         {
         }
+        if (b)
+        {
+            b->release();
+        }
     } while (!m->getFactory()->accept(this, m));    // Have factory added a new conduit to sideB?
     return false;
 }
@@ -843,12 +876,40 @@ public:
 
     bool toB(Mux* m)
     {
-        Tree<void*, Conduit*>::Node* node;
-        Tree<void*, Conduit*>::Iterator iter = m->list();
-        while ((node = iter.next()))
+        // Collect the conduits under the lock, and visit them after it is
+        // released so that they can update the muxes on the way.
+        Conduit* local[8];
+        Conduit** targets = local;
+        int count = 0;
+        {
+            ReadWriteLock::Reader reader(m->getLock());
+            Tree<void*, Conduit*>::Node* node;
+            Tree<void*, Conduit*>::Iterator iter = m->list();
+            while ((node = iter.next()))
+            {
+                ++count;
+            }
+            if (sizeof local / sizeof local[0] < static_cast<size_t>(count))
+            {
+                targets = new Conduit*[count];
+            }
+            count = 0;
+            iter = m->list();
+            while ((node = iter.next()))
+            {
+                Conduit* b = node->getValue();
+                b->addRef();
+                targets[count++] = b;
+            }
+        }
+        for (int i = 0; i < count; ++i)
         {
-            Conduit* b = node->getValue();
-            b->accept(this, m);
+            targets[i]->accept(this, m);
+            targets[i]->release();
+        }
+        if (targets != local)
+        {
+            delete[] targets;
         }
         return true;
     }
@@ -872,23 +933,31 @@ public:
         esReport("transport: %p (%ld)\n", key, (long) key);
 
         do {
+            Conduit* b = 0;
             try
             {
-                Conduit* b = m->getB(key);
+                b = m->getB(key);
                 if (b->accept(this, m))
                 {
+                    b->release();
                     return true;
                 }
             }
             catch (SystemException<ENOENT>)
             {
+                if (b)
+                {
+                    b->release();
+                    b = 0;
+                }
                 if (factory->hasDefaultKey())
                 {
                     try // with default key
                     {
-                        Conduit* b = m->getB(factory->getDefaultKey());
+                        b = m->getB(factory->getDefaultKey());
                         if (b->accept(this, m))
                         {
+                            b->release();
                             return true;
                         }
                     }
@@ -897,6 +966,10 @@ public:
                     }
                 }
             }
+            if (b)
+            {
+                b->release();
+            }
         } while (!factory->accept(this, m));    // Have factory added a new conduit to sideB?
         return false;
     }
@@ -37,6 +37,11 @@ class DatagramReceiver :
     int         errorCode;
     Socket*     socket;
 
+    // Statistics
+    unsigned long long  inOctets;
+    unsigned long long  outOctets;
+    unsigned long       inDiscards;
+
     struct RingHdr
     {
         long        len;
@@ -68,6 +73,9 @@ class DatagramReceiver :
         return true;
     }
 
+    bool wait(SocketMessenger* m);
+    void send(InetMessenger* m, Address* remote, int remotePort, void* data, int len);
+
 public:
     DatagramReceiver(Conduit* conduit = 0) :
         monitor(0),
@@ -75,7 +83,10 @@ public:
         sendBuf(0),
         conduit(conduit),
         errorCode(0),
-        socket(0)
+        socket(0),
+        inOctets(0),
+        outOctets(0),
+        inDiscards(0)
     {
         monitor = es::Monitor::createInstance();
     }
@@ -113,6 +124,7 @@ public:
         {
             socket->selector->notifyAll();
         }
+        Selector::notify(socket);
     }
 
     bool input(InetMessenger* m, Conduit* c);
@@ -121,8 +133,11 @@ public:
 
     bool read(SocketMessenger* m, Conduit* c);
     bool write(SocketMessenger* m, Conduit* c);
+    bool readBatch(SocketMessenger* m, Conduit* c);
+    bool writeBatch(SocketMessenger* m, Conduit* c);
     bool close(SocketMessenger* m, Conduit* c);
     bool notify(SocketMessenger* m, Conduit* c);
+    bool getStatistics(SocketMessenger* m, Conduit* c);
 
     bool isAcceptable(SocketMessenger* m, Conduit* c)
     {
@@ -158,6 +173,11 @@ public:
         delete this;
         return 0;
     }
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerUDP;
+    }
 };
 
 #endif  // DATAGRAM_H_INCLUDED
@@ -58,6 +58,11 @@ public:
 
     bool input(InetMessenger* m, Conduit* c);
     bool output(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerLink;
+    }
 };
 
 class DIXInReceiver : public InetReceiver
@@ -71,6 +76,11 @@ public:
     }
 
     bool output(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerLink;
+    }
 };
 
 class DIXARPReceiver : public InetReceiver
@@ -84,6 +94,11 @@ public:
     }
 
     bool output(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerLink;
+    }
 };
 
 class DIXInterface : public NetworkInterface
@@ -105,6 +120,28 @@ class DIXInterface : public NetworkInterface
 public:
     DIXInterface(es::NetworkInterface* networkInterface);
 
+    long getHeaderSize(const u8* frame, long len, int* family)
+    {
+        if (len < static_cast<long>(sizeof(DIXHdr)))
+        {
+            return -1;
+        }
+        const DIXHdr* dixhdr = reinterpret_cast<const DIXHdr*>(frame);
+        switch (ntohs(dixhdr->type))
+        {
+        case DIXHdr::DIX_IP:
+            *family = AF_INET;
+            break;
+        case DIXHdr::DIX_IPv6:
+            *family = AF_INET6;
+            break;
+        default:
+            *family = 0;
+            break;
+        }
+        return sizeof(DIXHdr);
+    }
+
     Conduit* addAddressFamily(AddressFamily* af, Conduit* c)
     {
         switch (af->getAddressFamily())
@@ -146,6 +183,15 @@ public:
         }
         return 0;
     }
+
+    int segment(InetMessenger* m)
+    {
+        if (stream)
+        {
+            return NetworkInterface::segment(m, sizeof(DIXHdr), stream);
+        }
+        return 0;
+    }
 };
 
 #endif  // DIX_H_INCLUDED
@@ -44,6 +44,11 @@ class ICMPReceiver : public InetReceiver
 public:
     bool input(InetMessenger* m, Conduit* c);
     bool output(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerIPv4;
+    }
 };
 
 class ICMPEchoRequestReceiver : public InetReceiver
@@ -36,6 +36,11 @@ public:
     s16 checksum(InetMessenger* m);
     bool input(InetMessenger* m);
     bool output(InetMessenger* m);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerIPv4;
+    }
 };
 
 #endif  // IGMP_H_INCLUDED
@@ -24,6 +24,7 @@
 #include <es/list.h>
 #include "address.h"
 #include "conduit.h"
+#include "inetProfile.h"
 
 class InetMessenger;
 
@@ -43,6 +44,14 @@ public:
         return true;
     }
 
+    /** Gets the layer to which InetProfile adds the time spent in this
+     *  receiver.
+     */
+    virtual int getProfileLayer() const
+    {
+        return InetProfile::LayerOther;
+    }
+
     typedef bool (InetReceiver::*Command)(InetMessenger* m, Conduit* c);
 };
 
@@ -59,6 +68,9 @@ private:
     u16         localPort;
     int         code;
     int         flag;
+    int         segmentSize;    // TCP payload size per segment of a large send
+    s32         payloadSum;     // Partial sum of the trailing payloadSize bytes
+    long        payloadSize;
 
 public:
     static const int Unicast = 1;
@@ -75,7 +87,10 @@ public:
         remotePort(0),
         localPort(0),
         code(0),
-        flag(0)
+        flag(0),
+        segmentSize(0),
+        payloadSum(0),
+        payloadSize(0)
     {
     }
     ~InetMessenger()
@@ -91,6 +106,11 @@ public:
             InetReceiver* receiver = dynamic_cast<InetReceiver*>(c->getReceiver());
             if (receiver)
             {
+                if (InetProfile::isEnabled())
+                {
+                    InetProfile::Sample sample(receiver->getProfileLayer());
+                    return (receiver->*op)(this, c);
+                }
                 return (receiver->*op)(this, c);
             }
         }
@@ -182,6 +202,37 @@ public:
         this->flag = flag;
     }
 
+    /** Gets the TCP payload size of each segment if this messenger holds
+     *  a large send super-segment, which is to be segmented by the network
+     *  interface. Zero otherwise.
+     */
+    int getSegmentSize() const
+    {
+        return segmentSize;
+    }
+    void setSegmentSize(int size)
+    {
+        segmentSize = size;
+    }
+
+    /** Gets the partial checksum of the trailing payload bytes of this
+     *  messenger, which has been calculated while the payload was copied
+     *  in. Only the headers need to be summed up for the rest.
+     */
+    s32 getPayloadSum() const
+    {
+        return payloadSum;
+    }
+    long getPayloadSize() const
+    {
+        return payloadSize;
+    }
+    void setPayloadSum(s32 sum, long size)
+    {
+        payloadSum = sum;
+        payloadSize = size;
+    }
+
     void setCommand(InetReceiver::Command command)
     {
         op = command;
@@ -28,6 +28,7 @@
 #include "igmp.h"
 #include "inet4address.h"
 #include "inet4reass.h"
+#include "route.h"
 #include "socket.h"
 #include "stream.h"
 #include "tcp.h"
@@ -53,6 +54,11 @@ public:
     bool input(InetMessenger* m, Conduit* c);
     bool output(InetMessenger* m, Conduit* c);
     bool error(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerIPv4;
+    }
 };
 
 class InFamily : public AddressFamily
@@ -157,21 +163,15 @@ class InFamily : public AddressFamily
 
     // Fragment Reassemble
     ReassReceiver               reassReceiver;
-    Adapter                     reassAdapter;
-    InetRemotePortAccessor      reassIdAccessor;
-    ConduitFactory              reassIdFactory;
-    Mux                         reassIdMux;
-    InetRemoteAddressAccessor   reassRemoteAddressAccessor;
-    ConduitFactory              reassRemoteAddressFactory;
-    Mux                         reassRemoteAddressMux;
-    InetLocalAddressAccessor    reassLocalAddressAccessor;
-    ConduitFactory              reassLocalAddressFactory;
-    Mux                         reassLocalAddressMux;
     Protocol                    reassProtocol;
-    ReassFactoryReceiver        reassFactoryReceiver;
 
     // Inet4Address tree
     Tree<InAddr, Inet4Address*> addressTable[Socket::INTERFACE_MAX];
+    ReadWriteLock               addressLock;    // Guards addressTable
+
+    // Forwarding table
+    RouteTable                  routeTable;
+    ReadWriteLock               routeLock;      // Guards routeTable
 
     // ARP family
     ARPFamily                   arpFamily;
@@ -187,6 +187,16 @@ public:
         return AF_INET;
     }
 
+    ReassReceiver* getReassReceiver()
+    {
+        return &reassReceiver;
+    }
+
+    NeighborCache* getNeighborCache()
+    {
+        return arpFamily.getNeighborCache();
+    }
+
     Conduit* getProtocol(Socket* socket)
     {
         if (socket->getAddressFamily() == AF_INET)
@@ -257,12 +267,38 @@ public:
 
     Inet4Address* getAddress(InAddr addr, int scopeID = 0);
     void addAddress(Inet4Address* address);
+    /** Adds the address unless the address of the same value is already
+     * in the table of its scope. Returns the address in the table with a
+     * reference added.
+     */
+    Inet4Address* findOrAddAddress(Inet4Address* address);
     void removeAddress(Inet4Address* address);
 
     Inet4Address* getRouter();
     void addRouter(Inet4Address* addr);
     void removeRouter(Inet4Address* addr);
 
+    /** Adds a route to dest/prefix through the gateway, or a connected
+     *  route to the network of the local address source if gateway is
+     *  zero.
+     *  @return false if the route of the same prefix exists, or if the
+     *          gateway is not on link.
+     */
+    bool addRoute(InAddr dest, int prefix, Inet4Address* gateway, Inet4Address* source = 0);
+
+    /** Removes the route to dest/prefix. If address is not zero, the route
+     *  is removed only if its gateway or its source is address.
+     */
+    bool removeRoute(InAddr dest, int prefix, Inet4Address* address = 0);
+
+    /** Gets the number of the routes in the forwarding table.
+     */
+    int getRouteCount()
+    {
+        ReadWriteLock::Reader reader(routeLock);
+        return routeTable.getSize();
+    }
+
     void joinGroup(Inet4Address* addr);
     void leaveGroup(Inet4Address* addr);
 
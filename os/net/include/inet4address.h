@@ -216,6 +216,10 @@ class Inet4Address :
     int         timeoutCount;
     int         pathMTU;
 
+    // Destination cache
+    Inet4Address*   nextHop;
+    unsigned int    routeGeneration;
+
 public:
     Inet4Address(InAddr addr, State& state, int scopeID = 0, int prefix = 0);
     virtual ~Inet4Address();
@@ -304,6 +308,11 @@ public:
     void alarm(TimeSpan delay);
     void cancel();
 
+    /** Starts resolving the link layer address of this address, and
+     *  queues m until it is resolved.
+     */
+    void resolve(InetMessenger* m);
+
     // IInternetAddress
     int getAddress(void* address, int len);
     int getAddressFamily();
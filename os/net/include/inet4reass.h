@@ -18,63 +18,135 @@
 #ifndef INET4REASS_H_INCLUDED
 #define INET4REASS_H_INCLUDED
 
+#include <es/list.h>
+#include <es/timer.h>
+#include <es/base/IMonitor.h>
 #include "inet.h"
 
+/** Reassembles the IPv4 datagrams of all the interfaces. The datagrams
+ *  being reassembled are kept in a hash table keyed on (src, dst, id,
+ *  proto), and each of them holds the payloads of its fragments in a
+ *  list sorted by the offset until the datagram is complete. The total
+ *  size of the fragments held is bounded; the oldest datagrams are
+ *  dropped to make room for new fragments. A single timer expires the
+ *  datagrams in batches.
+ */
 class ReassReceiver :
     public InetReceiver,
-    public InetMessenger,
     public TimerTask
 {
-    static const u16 EOH = 1;   // end-of-hole mark (EOH % sizeof(Hole) != 0)
+    static const int HASH_SIZE = 64;
 
-    struct Hole
+    struct Fragment
     {
-        u16 first;
-        u16 last;
-        u16 next;
-        u16 _unused;
+        Fragment*   next;
+        u16         first;      // Offset of the first byte
+        u16         end;        // Offset of the byte next to the last byte
+
+        u8* getData()
+        {
+            return reinterpret_cast<u8*>(this + 1);
+        }
     };
 
-    // The first fragment header needs to be saved for inclusion in a
-    // possible ICMP Time Exceeded (Reassembly Timeout) message. [RFC 1122]
-    u8              firstFragment[IPHdr::MaxHdrSize + 8];
+    struct Datagram
+    {
+        Link<Datagram>  link;       // Hash chain
+        Link<Datagram>  ageLink;    // In the order of arrival
+        Address*        remote;
+        Address*        local;
+        u16             id;
+        u8              proto;
+        int             scopeID;
+        DateTime        expiration;
+        Fragment*       fragments;  // Sorted by the offset without overlaps
+        long            received;   // Number of the payload bytes received
+        long            total;      // Payload size, or -1 until the last fragment arrives
+        long            size;       // Number of the bytes allocated
+
+        // The first fragment header needs to be saved for inclusion in a
+        // possible ICMP Time Exceeded (Reassembly Timeout) message. [RFC 1122]
+        // It is also the header of the reassembled datagram.
+        u8              firstFragment[IPHdr::MaxHdrSize + 8];
+    };
+
+    typedef ::List<Datagram, &Datagram::link> DatagramList;
+    typedef ::List<Datagram, &Datagram::ageLink> AgeList;
 
     Protocol*       inProtocol;
     Protocol*       timeExceededProtocol;
-    InetMessenger*  r;
-    u16             list;
 
-    Conduit*        adapter;
+    es::Monitor*    monitor;
+    DatagramList    table[HASH_SIZE];
+    AgeList         ageList;    // The oldest first
+    long            memory;     // Number of the bytes allocated for the datagrams
+    long            memoryMax;
+    bool            scheduled;
+
+    // Statistics
+    unsigned int    reassembled;
+    unsigned int    timedOut;
+    unsigned int    evicted;
+
+    static int hash(Address* remote, Address* local, u16 id, u8 proto);
+
+    Datagram* lookup(InetMessenger* m, IPHdr* iphdr);
+    Datagram* create(InetMessenger* m, IPHdr* iphdr);
+    void remove(Datagram* datagram);
+    void destroy(Datagram* datagram);
+    bool reserve(long size, Datagram* keep);
+    void schedule();
+    void timeExceeded(Datagram* datagram);
+    InetMessenger* assemble(Datagram* datagram);
 
 public:
-    ReassReceiver(Protocol* inProtocol, Protocol* timeExceededProtocol, Conduit* adapter) :
-        inProtocol(inProtocol),
-        timeExceededProtocol(timeExceededProtocol),
-        r(0),
-        adapter(adapter)
+    static const long MEMORY_MAX;       // Default upper limit of the bytes held
+    static const TimeSpan TIMEOUT;      // Reassembly timeout
+
+    ReassReceiver(Protocol* inProtocol, Protocol* timeExceededProtocol);
+    ~ReassReceiver();
+
+    bool input(InetMessenger* m, Conduit* c);
+
+    // TimerTask
+    void run();
+
+    /** Sets the upper limit of the bytes held for the reassembly.
+     */
+    void setMemoryMax(long size);
+
+    long getMemoryMax()
     {
+        return memoryMax;
     }
 
-    bool input(InetMessenger* m, Conduit* c);
+    long getMemoryUsed()
+    {
+        return memory;
+    }
 
-    ReassReceiver* clone(Conduit* conduit, void* key)
+    unsigned int getReassembled()
     {
-        return new ReassReceiver(inProtocol, timeExceededProtocol, conduit);
+        return reassembled;
     }
 
-    unsigned int release()
+    unsigned int getTimedOut()
     {
-        delete this;
-        return 0;
+        return timedOut;
     }
 
-    void run();
-};
+    /** Gets the number of the datagrams dropped to make room for the
+     *  newer fragments.
+     */
+    unsigned int getEvicted()
+    {
+        return evicted;
+    }
 
-class ReassFactoryReceiver : public InetReceiver
-{
-public:
-    bool input(InetMessenger* m, Conduit* c);
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerIPv4;
+    }
 };
 
 #endif  // INET4REASS_H_INCLUDED
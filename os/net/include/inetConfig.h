@@ -45,6 +45,9 @@ public:
     es::InternetAddress* getRouter();
     void removeRouter(es::InternetAddress* router);
 
+    bool addRoute(es::InternetAddress* destination, unsigned int prefix, es::InternetAddress* router);
+    bool removeRoute(es::InternetAddress* destination, unsigned int prefix);
+
     int addInterface(es::NetworkInterface* networkInterface);
     Object* getInterface(int scopeID);
     int getScopeID(es::NetworkInterface* networkInterface);
@@ -59,6 +62,8 @@ public:
     const char* getSearchDomain(void* address, int addressLength, int pos);
     void removeSearchDomain(const char* address);
 
+    void getStatistics(void* statistics);
+
     //
     // IInterface
     //
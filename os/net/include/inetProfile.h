@@ -0,0 +1,141 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INETPROFILE_H_INCLUDED
+#define INETPROFILE_H_INCLUDED
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/types.h>
+#include <es/base/IMonitor.h>
+
+/** Accumulates the number of the calls to the receivers of each layer and
+ *  the time spent in them while the profiling is enabled. The total time
+ *  of a receiver includes the time of the messengers sent from within it,
+ *  e.g., the time to send an ACK from the TCP input, while its self time
+ *  excludes them. Each thread accumulates into its own block of counters
+ *  without a lock, as InetStatistics does. When the profiling is
+ *  disabled, the messengers only test a flag.
+ */
+class InetProfile
+{
+public:
+    enum Layer
+    {
+        LayerLink,      // DIX, ARP, or the loopback framing
+        LayerIPv4,      // IPv4, reassembly, ICMP and IGMP
+        LayerUDP,
+        LayerTCP,
+        LayerSocket,    // The socket operations on the receivers
+        LayerOther,
+        LayerMax
+    };
+
+    class Sample;
+
+private:
+    struct Counter
+    {
+        unsigned long long  calls;
+        s64                 ticks;
+        s64                 selfTicks;
+    };
+
+    struct Block
+    {
+        Block*  next;
+        Counter counters[LayerMax];
+    };
+
+    static bool             enabled;
+    static es::Monitor*     monitor;
+    static Block*           blocks;
+    static __thread Block*  local;
+    static __thread Sample* current;    // The innermost sample of the thread
+
+    static Block* attach();
+
+    static void add(int layer, s64 ticks, s64 selfTicks)
+    {
+        Block* block = local;
+        if (!block)
+        {
+            block = attach();
+        }
+        Counter& counter(block->counters[layer]);
+        ++counter.calls;
+        counter.ticks += ticks;
+        counter.selfTicks += selfTicks;
+    }
+
+public:
+    /** Measures the time until the end of the scope, and adds it to the
+     *  layer. The time of the samples nested within it is subtracted
+     *  from its self time.
+     */
+    class Sample
+    {
+        int         layer;
+        s64         nested;
+        Sample*     outer;
+        DateTime    start;
+
+    public:
+        Sample(int layer) :
+            layer(layer),
+            nested(0),
+            outer(current),
+            start(DateTime::getNow())
+        {
+            current = this;
+        }
+        ~Sample()
+        {
+            s64 ticks = (DateTime::getNow() - start).getTicks();
+            current = outer;
+            if (outer)
+            {
+                outer->nested += ticks;
+            }
+            add(layer, ticks, ticks - nested);
+        }
+    };
+
+    static bool isEnabled()
+    {
+        return enabled;
+    }
+
+    /** Starts or stops the profiling. The counters are kept until reset.
+     */
+    static void enable(bool on);
+    static void reset();
+
+    static const char* getName(int layer);
+
+    /** Gets the sums of the counters of the layer over all the threads.
+     */
+    static unsigned long long getCalls(int layer);
+    static s64 getTicks(int layer);
+    static s64 getSelfTicks(int layer);
+
+    /** Reports the counters of all the layers with esReport.
+     */
+    static void report();
+};
+
+#endif  // INETPROFILE_H_INCLUDED
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INETSTATISTICS_H_INCLUDED
+#define INETSTATISTICS_H_INCLUDED
+
+#include <es.h>
+#include <es/types.h>
+#include <es/base/IMonitor.h>
+#include <es/net/statistics.h>
+
+/** Counts the datagrams and the segments of each protocol in the manner
+ *  of the IP-MIB, the TCP-MIB and the UDP-MIB. Each thread increments its
+ *  own block of counters without a lock, and the blocks are summed up
+ *  only when the counters are read. The block of a thread is kept after
+ *  the thread exits so that the counters never go backward.
+ */
+class InetStatistics
+{
+public:
+    enum Counter
+    {
+        IpInReceives,
+        IpInHdrErrors,
+        IpInDiscards,
+        IpInDelivers,
+        IpOutRequests,
+        IpOutDiscards,
+        IpReasmReqds,
+        IpReasmOKs,
+        IpReasmFails,
+        IpFragOKs,
+        IpFragCreates,
+        TcpActiveOpens,
+        TcpPassiveOpens,
+        TcpInSegs,
+        TcpInErrs,
+        TcpOutSegs,
+        TcpRetransSegs,
+        TcpOutRsts,
+        UdpInDatagrams,
+        UdpNoPorts,
+        UdpInErrors,
+        UdpOutDatagrams,
+        CounterMax
+    };
+
+private:
+    struct Block
+    {
+        Block*              next;
+        unsigned long long  counts[CounterMax];
+    };
+
+    static es::Monitor*     monitor;
+    static Block*           blocks;
+    static __thread Block*  local;
+
+    static Block* attach();
+
+public:
+    static void initialize();
+
+    static void increment(int counter, unsigned long long count = 1)
+    {
+        Block* block = local;
+        if (!block)
+        {
+            block = attach();
+        }
+        block->counts[counter] += count;
+    }
+
+    /** Gets the sum of the counter over all the threads.
+     */
+    static unsigned long long get(int counter);
+
+    static void get(es::InternetStatistics* statistics);
+};
+
+#endif  // INETSTATISTICS_H_INCLUDED
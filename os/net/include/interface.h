@@ -19,6 +19,7 @@
 #define INTERFACE_H_INCLUDED
 
 #include <es/handle.h>
+#include <es/base/IMonitor.h>
 #include <es/base/IStream.h>
 #include <es/base/IThread.h>
 #include <es/device/INetworkInterface.h>
@@ -34,11 +35,60 @@ es::Thread* esCreateThread(void* (*start)(void* param), void* param);
  */
 class NetworkInterface
 {
+public:
     static const int MRU = 1518;
+    static const int QUEUE_MAX = 8;
+
+private:
+    /** A receive queue that holds the frames of the flows hashed to it
+     *  until its worker thread processes them in a batch.
+     */
+    class ReceiveQueue
+    {
+        static const int LENGTH = 128;
+        static const int LARGE_SIZE = 64 + 65535;  // Link header and the largest IP datagram
+
+        struct Frame
+        {
+            int     len;
+            u8      data[MRU];
+        };
+
+        NetworkInterface*   interface;
+        es::Monitor*        monitor;
+        es::Thread*         thread;
+        int                 head;
+        int                 used;
+        unsigned int        dropped;
+        unsigned int        coalesced;
+        Frame               frames[LENGTH];
+
+        int coalesce(int first, int count, InetMessenger* m);
+        void* work();
+        static void* run(void* param);
+
+    public:
+        ReceiveQueue(NetworkInterface* interface);
+
+        bool push(const void* frame, int len);
+
+        unsigned int getDropped() const
+        {
+            return dropped;
+        }
+
+        unsigned int getCoalesced() const
+        {
+            return coalesced;
+        }
+    };
 
     Handle<es::NetworkInterface>   networkInterface;
 
     es::Thread*     thread;
+    ReceiveQueue*   queues[QUEUE_MAX];
+    int             queueCount;         // The number of the receive queues in use
+    bool            coalescing;         // Whether TCP segments are coalesced in the queues
 
     u8              mac[6];             // MAC address
 
@@ -48,6 +98,26 @@ class NetworkInterface
     ConduitFactory  factory;
     Adapter         adapter;
     int             scopeID;
+    int             capabilities;       // Offload capabilities of networkInterface
+
+    void process(InetMessenger* m, int len)
+    {
+#ifdef VERBOSE
+        esReport("# input\n");
+        esDump(m->fix(len), len);
+#endif
+        long size = m->getSize();
+        m->setSize(len);
+        m->setScopeID(scopeID);
+        Transporter v(m);
+        adapter.accept(&v);
+        m->setSize(size);   // Restore the size
+        m->setPosition(0);
+        m->setPayloadSum(0, 0);
+
+        m->setLocal(0);
+        m->setRemote(0);
+    }
 
     void* vent()
     {
@@ -58,19 +128,16 @@ class NetworkInterface
             int len = stream->read(m->fix(MRU), MRU);
             if (0 < len)
             {
-#ifdef VERBOSE
-                esReport("# input\n");
-                esDump(m->fix(len), len);
-#endif
-                m->setSize(len);
-                m->setScopeID(scopeID);
-                Transporter v(m);
-                adapter.accept(&v);
-                m->setSize(MRU);    // Restore the size
-                m->setPosition(0);
-
-                m->setLocal(0);
-                m->setRemote(0);
+                int count = queueCount;
+                if (1 < count || coalescing)
+                {
+                    const u8* frame = static_cast<const u8*>(m->fix(len));
+                    queues[hash(frame, len) % count]->push(frame, len);
+                }
+                else
+                {
+                    process(m, len);
+                }
             }
         }
         return 0;
@@ -92,9 +159,13 @@ public:
         accessor(accessor),
         receiver(receiver),
         mux(accessor, &factory),
-        scopeID(0)
+        queueCount(1),
+        coalescing(false),
+        scopeID(0),
+        capabilities(networkInterface->getCapabilities())
     {
         memset(mac, 0, sizeof mac);
+        memset(queues, 0, sizeof queues);
 
         adapter.setReceiver(receiver);
         Conduit::connectAA(&adapter, &mux);
@@ -114,6 +185,11 @@ public:
     {
         return scopeID;
     }
+
+    int getCapabilities()
+    {
+        return capabilities;
+    }
     void setScopeID(int id)
     {
         scopeID = id;
@@ -149,8 +225,68 @@ public:
         thread->start();
     }
 
+    int getQueueCount() const
+    {
+        return queueCount;
+    }
+
+    /** Sets the number of the receive queues. With more than one queue,
+     * the received frames are hashed by their flows to the queues, each
+     * of which is processed by its own worker thread, so that the frames
+     * of independent flows are processed in parallel while the frames of
+     * each flow are processed in order. The frames queued before the
+     * number is changed may be processed out of order.
+     * @param count the number of the receive queues, at most QUEUE_MAX.
+     */
+    void setQueueCount(int count);
+
+    /** Returns the number of the frames dropped as the receive queues
+     * were full.
+     */
+    unsigned int getQueueDropped() const;
+
+    bool isCoalescing() const
+    {
+        return coalescing;
+    }
+
+    /** Enables the coalescing of the received TCP segments. Each batch of
+     * the frames taken from a receive queue is scanned for the in-order
+     * TCP/IPv4 segments of the same flow that come one after another,
+     * and they are merged into a single segment before the TCP input
+     * processes it. The frames go through a receive queue while the
+     * coalescing is enabled, even if there is only one queue.
+     */
+    void setCoalescing(bool on);
+
+    /** Returns the number of the TCP segments that have been merged into
+     * the preceding segments.
+     */
+    unsigned int getCoalesced() const;
+
+    /** Returns the flow hash of the frame, which is computed from the
+     * IPv4 or IPv6 addresses and the protocol, and also from the ports
+     * for TCP and UDP. Fragments are hashed without the ports so that
+     * all the fragments of a datagram are reassembled on the same queue.
+     * Frames other than IP are hashed to zero.
+     */
+    u32 hash(const u8* frame, long len);
+
+    /** Returns the size of the link layer header of the frame, and sets
+     * the address family of the network layer packet it carries to family,
+     * or zero if unknown.
+     */
+    virtual long getHeaderSize(const u8* frame, long len, int* family) = 0;
+
     virtual Conduit* addAddressFamily(AddressFamily* af, Conduit* c) = 0;
 
+    /** Splits the TCP/IPv4 large send super-segment held in m into the
+     * segments of m->getSegmentSize() bytes of payload, and writes each
+     * of them with the fixed up headers and sums to the stream.
+     * @param hlen the size of the link layer header that precedes the IP header.
+     */
+    static int segment(InetMessenger* m, long hlen, es::Stream* stream);
+
     friend class Socket;
 };
 
@@ -44,10 +44,12 @@ class LoopbackReceiver :
     public InetReceiver
 {
     Handle<es::Stream> stream;
+    int                capabilities;
 
 public:
     LoopbackReceiver(es::NetworkInterface* loopbackInterface) :
-        stream(loopbackInterface, true)
+        stream(loopbackInterface, true),
+        capabilities(loopbackInterface->getCapabilities())
     {
         ASSERT(stream);
     }
@@ -64,9 +66,22 @@ public:
         esReport("# output\n");
         esDump(packet, len);
 #endif
-        stream->write(packet, len);
+        if (0 < m->getSegmentSize() &&
+            !(capabilities & es::NetworkInterface::LargeSend))
+        {
+            NetworkInterface::segment(m, sizeof(int), stream);
+        }
+        else
+        {
+            stream->write(packet, len);
+        }
         return true;
     }
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerLink;
+    }
 };
 
 class LoopbackInterface : public NetworkInterface
@@ -85,6 +100,18 @@ public:
     {
     }
 
+    long getHeaderSize(const u8* frame, long len, int* family)
+    {
+        if (len < static_cast<long>(sizeof(int)))
+        {
+            return -1;
+        }
+        int af;
+        memmove(&af, frame, sizeof(int));
+        *family = af;
+        return sizeof(int);
+    }
+
     Conduit* addAddressFamily(AddressFamily* af, Conduit* c)
     {
         int pf = af->getAddressFamily();
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEIGHBOR_H_INCLUDED
+#define NEIGHBOR_H_INCLUDED
+
+#include <es/dateTime.h>
+#include <es/list.h>
+#include <es/timer.h>
+#include <es/timeSpan.h>
+#include <es/base/IMonitor.h>
+#include "inet4address.h"
+
+/** Keeps the IPv4 addresses of the ARP cache in a hash table keyed on
+ *  (address, scope ID). Each entry queues a few packets while the link
+ *  layer address is being resolved; the oldest packet is dropped once
+ *  the queue is full. The retransmitted requests, the refresh probes and
+ *  the gratuitous announcements of all the entries are driven by a
+ *  single timer, so that the entries due close together are handled in
+ *  a single run.
+ */
+class NeighborCache : public TimerTask
+{
+    static const int HASH_SIZE = 64;
+    static const int BATCH_MAX = 32;    // Entries handled at once by run()
+
+public:
+    static const int PENDING_MAX = 3;   // Packets queued per entry
+    static const TimeSpan REACHABLE_TIME;
+
+private:
+    struct Neighbor
+    {
+        Link<Neighbor>  link;       // Hash chain
+        Inet4Address*   address;
+        DateTime        expiration; // Zero unless deferred
+        InetMessenger*  pending[PENDING_MAX];
+        int             head;
+        int             count;      // Number of the pending packets
+    };
+
+    typedef ::List<Neighbor, &Neighbor::link> NeighborList;
+
+    es::Monitor*    monitor;
+    NeighborList    table[HASH_SIZE];
+    DateTime        next;       // Time the timer is scheduled, or zero
+    int             size;
+
+    // Statistics
+    unsigned int    lookups;
+    unsigned int    misses;
+    unsigned int    held;
+    unsigned int    dropped;
+    unsigned int    requests;
+    unsigned int    probes;
+    unsigned int    announcements;
+    unsigned int    runs;
+
+    static int hash(InAddr addr, int scopeID);
+
+    Neighbor* find(InAddr addr, int scopeID);
+    void purge(Neighbor* neighbor);
+    void schedule(DateTime expiration);
+
+public:
+    NeighborCache();
+    ~NeighborCache();
+
+    /** Adds the specified address to this cache. The cache keeps a
+     *  reference to the address until it is removed.
+     */
+    void add(Inet4Address* address);
+
+    /** Removes the specified address from this cache. The packets queued
+     *  for the address are discarded.
+     */
+    void remove(Inet4Address* address);
+
+    /** Looks up the address of the specified address and scope ID.
+     *  @return the referenced address, or zero if not found.
+     */
+    Inet4Address* lookup(InAddr addr, int scopeID);
+
+    /** Queues m until the link layer address of the address is resolved.
+     *  @return false if m is dropped as the address is not in this cache.
+     */
+    bool hold(Inet4Address* address, InetMessenger* m);
+
+    /** Dequeues the oldest packet queued for the address.
+     *  @return the referenced packet, or zero if none.
+     */
+    InetMessenger* retrieve(Inet4Address* address);
+
+    /** Discards the packets queued for the address, e.g., when the
+     *  resolution has failed.
+     */
+    void purge(Inet4Address* address);
+
+    /** Runs the expired() handler of the address after the delay.
+     */
+    void defer(Inet4Address* address, TimeSpan delay);
+
+    /** Cancels the deferred handler of the address if any.
+     */
+    void cancel(Inet4Address* address);
+
+    /** Sends the ARP packet m through the adapter of the address.
+     */
+    void send(Inet4Address* address, InetMessenger* m);
+
+    // TimerTask
+    void run();
+
+    int getSize()
+    {
+        return size;
+    }
+
+    unsigned int getLookups()
+    {
+        return lookups;
+    }
+
+    unsigned int getMisses()
+    {
+        return misses;
+    }
+
+    unsigned int getHeld()
+    {
+        return held;
+    }
+
+    /** Gets the number of the packets dropped while waiting for the
+     *  resolution.
+     */
+    unsigned int getDropped()
+    {
+        return dropped;
+    }
+
+    unsigned int getRequests()
+    {
+        return requests;
+    }
+
+    /** Gets the number of the unicast refresh probes and the address
+     *  conflict probes sent.
+     */
+    unsigned int getProbes()
+    {
+        return probes;
+    }
+
+    unsigned int getAnnouncements()
+    {
+        return announcements;
+    }
+
+    /** Gets the number of the timer runs that handled the deferred
+     *  entries.
+     */
+    unsigned int getRuns()
+    {
+        return runs;
+    }
+};
+
+#endif  // NEIGHBOR_H_INCLUDED
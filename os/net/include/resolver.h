@@ -20,6 +20,8 @@
 
 #include <string.h>
 #include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
 #include <es/interlocked.h>
 #include <es/list.h>
 #include <es/ref.h>
@@ -33,6 +35,14 @@
 
 class Resolver : public es::Resolver
 {
+    static const u32 MaxTtl = 86400;        // [sec]
+    static const int MaxControl = 8;        // max idle controls kept
+    static const int CacheMax = 256;        // max cache entries
+    static const int CacheHashSize = 64;
+
+    // A control queries the name server over its own socket. Each lookup
+    // uses a control of its own so that the lookups for the different
+    // names can run in parallel.
     class Control
     {
         // the minimum retransmission interval should be 2-5 seconds [RFC 1035]
@@ -47,26 +57,76 @@ class Resolver : public es::Resolver
         Interlocked id;
         u8          query[1472];
         u8          response[1472];
+        u32         ttl;    // TTL of the last result; zero if not to be cached
 
         int a(u16 id, const char* hostName);
         int ptr(u16 id, InAddr addr);
         es::InternetAddress* resolve(const char* hostName);
+        u32 getNegativeTtl(const u8* ptr, const u8* end);
 
         static u8* skipName(const u8* ptr, const u8* end);
         static bool copyName(const u8* dns, const u8* ptr, const u8* end, char* name);
 
     public:
+        Link<Control>   link;
+
         Control(es::InternetAddress* server);
         ~Control();
         es::InternetAddress* getHostByName(const char* hostName, int addressFamily);
         bool getHostName(es::InternetAddress* address, char* hostName, unsigned int len);
+
+        bool isServer(es::InternetAddress* server)
+        {
+            return this->server == server;
+        }
+
+        /** Gets the time in seconds for which the result of the last
+         *  lookup can be cached, including a negative result.
+         */
+        u32 getTtl() const
+        {
+            return ttl;
+        }
+    };
+
+    typedef ::List<Control, &Control::link> ControlList;
+
+    // A cached answer, or a pending one while the query for the name is
+    // in progress. The lookups for the same name wait for the pending
+    // entry instead of sending queries of their own.
+    struct Entry
+    {
+        Link<Entry> link;
+        u16         type;                       // DNSType::A or DNSType::PTR
+        char        name[DNSHdr::NameMax];      // in lower case
+        bool        pending;
+        bool        negative;
+        int         serial;                     // incremented as answered
+        DateTime    expiration;
+        InAddr      addr;                       // for DNSType::A
+        char        hostName[DNSHdr::NameMax];  // for DNSType::PTR
     };
 
+    typedef ::List<Entry, &Entry::link> EntryList;
+
     Ref         ref;
     es::Monitor*   monitor;
-    Control*    control;
+    ControlList controls;       // idle controls
+    int         controlCount;
+    EntryList   cache[CacheHashSize];
+    int         cacheCount;
+    long long   hits;
+    long long   misses;
+
+    Control* getControl();
+    void putControl(Control* control);
 
-    bool setup();
+    static bool makeKey(const char* name, char* key);
+    static u32 hash(u16 type, const char* key);
+    Entry* find(u16 type, const char* key);
+    void evict();
+    bool lookup(u16 type, const char* key, Entry* result);
+    void complete(u16 type, const char* key, const Entry* result, u32 ttl);
 
 public:
     Resolver();
@@ -78,6 +138,8 @@ public:
     es::InternetAddress* getHostByName(const char* hostName, int addressFamily);
     es::InternetAddress* getHostByAddress(const void* address, int len, unsigned int scopeID);
     const char* getHostName(void* hostName, int len, es::InternetAddress* address);
+    long long getCacheHits();
+    long long getCacheMisses();
 
     //
     // IInterface
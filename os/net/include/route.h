@@ -0,0 +1,153 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ROUTE_H_INCLUDED
+#define ROUTE_H_INCLUDED
+
+#include <es.h>
+#include <es/endian.h>
+#include <es/tree.h>
+#include <es/net/inet4.h>
+
+class Inet4Address;
+
+/** An IPv4 route. A route without a gateway is a connected route to the
+ *  network of the local address source.
+ */
+struct Route
+{
+    InAddr          dest;
+    int             prefix;
+    Inet4Address*   gateway;
+    Inet4Address*   source;
+};
+
+/** An IPv4 forwarding table for the longest prefix match, in the style of
+ *  DIR-24-8 with the strides of 16, 8 and 8 bits. The first 16 bits of the
+ *  address index the top level table of which each slot holds either the
+ *  index of the longest matching route or the index of a 256-slot chunk
+ *  for the next 8 bits. The chunks are created only under the slots that
+ *  have longer routes and are freed again when they become uniform, so a
+ *  lookup takes at most three memory accesses. The routes themselves are
+ *  also kept in a tree keyed on (prefix, length) for the updates.
+ *
+ *  This class is not synchronized.
+ */
+class RouteTable
+{
+    static const u32 CHUNK = 0x80000000u;   // The slot refers to a chunk.
+    static const int TOP_SIZE = 65536;
+    static const int CHUNK_SIZE = 256;
+
+    u32*            top;
+    u32**           chunks;
+    int             chunkCount;     // Number of the chunk slots allocated
+    int             chunkFree;      // Head of the free chunks, or -1
+    int             chunkUsed;
+    Route**         routes;         // Indexed by the route index; 0 is unused.
+    int*            freeRoutes;     // Stack of the free route indices
+    int             routeCount;     // Number of the route slots allocated
+    int             freeCount;
+    int             size;
+    unsigned int    generation;
+    Tree<u64, int>  tree;           // (prefix, length) to the route index
+
+    static u64 key(u32 addr, int prefix)
+    {
+        return (u64) addr << 6 | prefix;
+    }
+
+    static u32 mask(int prefix)
+    {
+        return prefix ? 0xffffffffu << (32 - prefix) : 0;
+    }
+
+    int getPrefix(u32 slot)
+    {
+        return slot ? routes[slot]->prefix : -1;
+    }
+
+    int allocateChunk(u32 slot);
+    void freeChunk(int index);
+    int allocateRoute(Route* route);
+    void freeRoute(int index);
+
+    void set(u32& slot, u32 index, int prefix);
+    void reset(u32& slot, u32 index, u32 replacement);
+    void collapse(u32& slot);
+    void update(u32 addr, int prefix, u32 index, u32 replacement, bool add);
+
+public:
+    RouteTable();
+    ~RouteTable();
+
+    /** Looks up the route of the longest prefix that matches addr.
+     *  @return the route, or zero if none matches.
+     */
+    Route* lookup(InAddr addr) const
+    {
+        u32 a = ntohl(addr.addr);
+        u32 slot = top[a >> 16];
+        if (slot & CHUNK)
+        {
+            slot = chunks[slot & ~CHUNK][(a >> 8) & 0xff];
+            if (slot & CHUNK)
+            {
+                slot = chunks[slot & ~CHUNK][a & 0xff];
+            }
+        }
+        return slot ? routes[slot] : 0;
+    }
+
+    /** Gets the route of exactly the specified prefix.
+     *  @return the route, or zero if not found.
+     */
+    Route* get(InAddr dest, int prefix);
+
+    /** Adds a route. The table keeps references to the gateway and the
+     *  source addresses until the route is removed.
+     *  @return false if the route of the same prefix exists.
+     */
+    bool add(InAddr dest, int prefix, Inet4Address* gateway, Inet4Address* source);
+
+    /** Removes the route of the specified prefix.
+     *  @return false if not found.
+     */
+    bool remove(InAddr dest, int prefix);
+
+    int getSize() const
+    {
+        return size;
+    }
+
+    /** Gets the number of the 256-slot chunks in use.
+     */
+    int getChunks() const
+    {
+        return chunkUsed;
+    }
+
+    /** Gets the generation number incremented every time this table
+     *  is updated, for validating the cached routes.
+     */
+    unsigned int getGeneration() const
+    {
+        return generation;
+    }
+};
+
+#endif  // ROUTE_H_INCLUDED
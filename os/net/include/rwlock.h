@@ -0,0 +1,133 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RWLOCK_H_INCLUDED
+#define RWLOCK_H_INCLUDED
+
+#include <es.h>
+#include <es/interlocked.h>
+
+/** A readers-writer spin lock for the tables that are looked up for
+ *  every frame by the receive threads, and are only rarely updated.
+ *  Any number of readers can hold the lock at the same time. A waiting
+ *  writer keeps the new readers out so that it is not starved. The lock
+ *  is not recursive. A thread that has spun for a while sleeps briefly,
+ *  so that a holder of a lower priority can run and release the lock.
+ */
+class ReadWriteLock
+{
+    Interlocked state;      // The number of readers, or -1 while written.
+    Interlocked writers;    // The number of the writers waiting or writing.
+
+    ReadWriteLock(const ReadWriteLock&);
+    ReadWriteLock& operator=(const ReadWriteLock&);
+
+    static const int SPIN_MAX = 1000;           // Spins before sleeping
+    static const long long SLEEP = 10000;       // 1 msec
+
+    static void pause(int& spins)
+    {
+        if (++spins < SPIN_MAX)
+        {
+#if defined(__i386__) || defined(__x86_64__)
+            // Use the pause instruction for Hyper-Threading
+            __asm__ __volatile__ ("pause\n");
+#endif
+        }
+        else
+        {
+            spins = 0;
+            esSleep(SLEEP);
+        }
+    }
+
+public:
+    ReadWriteLock()
+    {
+    }
+
+    void readLock()
+    {
+        int spins = 0;
+        for (;;)
+        {
+            while (0 < writers)
+            {
+                pause(spins);
+            }
+            long count = state;
+            if (0 <= count && state.compareExchange(count + 1, count) == count)
+            {
+                return;
+            }
+            pause(spins);
+        }
+    }
+
+    void readUnlock()
+    {
+        state.decrement();
+    }
+
+    void writeLock()
+    {
+        int spins = 0;
+        writers.increment();
+        while (state.compareExchange(-1, 0) != 0)
+        {
+            pause(spins);
+        }
+    }
+
+    void writeUnlock()
+    {
+        state.exchange(0);
+        writers.decrement();
+    }
+
+    class Reader
+    {
+        ReadWriteLock& lock;
+        Reader& operator=(const Reader&);
+    public:
+        Reader(ReadWriteLock& lock) : lock(lock)
+        {
+            lock.readLock();
+        }
+        ~Reader()
+        {
+            lock.readUnlock();
+        }
+    };
+
+    class Writer
+    {
+        ReadWriteLock& lock;
+        Writer& operator=(const Writer&);
+    public:
+        Writer(ReadWriteLock& lock) : lock(lock)
+        {
+            lock.writeLock();
+        }
+        ~Writer()
+        {
+            lock.writeUnlock();
+        }
+    };
+};
+
+#endif  // RWLOCK_H_INCLUDED
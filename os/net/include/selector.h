@@ -0,0 +1,119 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SELECTOR_H_INCLUDED
+#define SELECTOR_H_INCLUDED
+
+#include <es/list.h>
+#include <es/ref.h>
+#include <es/base/IMonitor.h>
+#include <es/base/ISelector.h>
+
+class Socket;
+
+class Selector : public es::Selector
+{
+public:
+    // A registration of a socket to a selector. A registration is linked
+    // to the list of the socket, to the list of the selector, and to the
+    // ready queue of the selector while the socket waits to be examined,
+    // and to the pending list of wait() while the socket is examined.
+    class Registration
+    {
+        Ref                 ref;
+        Selector*           selector;
+        Socket*             socket;
+        int                 events;
+        int                 cookie;
+        bool                queued;
+        bool                removed;
+        Link<Registration>  linkSocket;
+        Link<Registration>  linkSelector;
+        Link<Registration>  linkReady;
+        Link<Registration>  linkPending;
+
+        Registration(Selector* selector, Socket* socket, int events, int cookie);
+        ~Registration();
+
+        unsigned int addRef()
+        {
+            return ref.addRef();
+        }
+        unsigned int release();
+
+        friend class Selector;
+
+    public:
+        typedef ::List<Registration, &Registration::linkSocket> SocketList;
+        typedef ::List<Registration, &Registration::linkSelector> SelectorList;
+        typedef ::List<Registration, &Registration::linkReady> ReadyList;
+        typedef ::List<Registration, &Registration::linkPending> PendingList;
+    };
+
+private:
+    // Guards the registration lists of the sockets. The lock order is
+    // the socket, registry, and then the selector monitor.
+    static es::Monitor*         registry;
+
+    Ref                         ref;
+    es::Monitor*                monitor;
+    Registration::SelectorList  registrations;
+    Registration::ReadyList     ready;
+
+    Registration* find(Socket* socket);
+    void enqueue(Registration* registration);
+    int poll(int* events, int eventsLength);
+
+public:
+    Selector();
+    ~Selector();
+
+    // Pushes the registrations of the socket into the ready queues of
+    // their selectors. Called by the socket whenever its state changes.
+    static void notify(Socket* socket);
+
+    // Removes all the registrations of the socket.
+    static void cancel(Socket* socket);
+
+    //
+    // ISelector
+    //
+    int add(es::Selectable* target, int events, int cookie);
+    int modify(es::Selectable* target, int events, int cookie);
+    int remove(es::Selectable* target);
+    int wait(int* events, int eventsLength, long long timeout);
+
+    //
+    // IInterface
+    //
+    Object* queryInterface(const char* riid);
+    unsigned int addRef();
+    unsigned int release();
+
+    class Constructor : public es::Selector::Constructor
+    {
+    public:
+        es::Selector* createInstance();
+        Object* queryInterface(const char* riid);
+        unsigned int addRef();
+        unsigned int release();
+    };
+
+    static void initializeConstructor();
+};
+
+#endif  // SELECTOR_H_INCLUDED
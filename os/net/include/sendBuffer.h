@@ -0,0 +1,176 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENDBUFFER_H_INCLUDED
+#define SENDBUFFER_H_INCLUDED
+
+#include <es/ring.h>
+#include <es/base/IStream.h>
+
+/** The send buffer of a stream socket. The bytes written by the socket
+ *  are copied into the ring, while the ranges of the streams passed to
+ *  sendFile() are kept by reference and are read directly into the
+ *  outgoing segments. Each stream is referenced until all the bytes
+ *  queued from it have been acknowledged and skipped.
+ */
+class SendBuffer
+{
+public:
+    static const int EXTENT_MAX = 64;
+
+    /** The ranges of the streams to be read into an outgoing segment.
+     *  peek() only records the ranges, so that they can be read after the
+     *  monitor of the socket is released; reading a stream may block. Each
+     *  stream is referenced until the reader is destructed, since the range
+     *  can be acknowledged and skipped in the meantime.
+     */
+    class Reader
+    {
+        struct Range
+        {
+            es::Stream* stream;
+            long long   offset;
+            u8*         dst;
+            long        count;
+        };
+
+        Range   ranges[EXTENT_MAX];
+        int     count;
+
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+
+    public:
+        Reader() :
+            count(0)
+        {
+        }
+
+        ~Reader();
+
+        bool isEmpty() const
+        {
+            return count == 0;
+        }
+
+        void add(es::Stream* stream, long long offset, u8* dst, long count);
+
+        /** Reads all the recorded ranges.
+         * @return          false if any stream could not be read in full,
+         *                  e.g., as it has been truncated since the range
+         *                  was queued.
+         */
+        bool read();
+    };
+
+private:
+    struct Extent
+    {
+        es::Stream* stream;     // Zero for the bytes in the ring
+        long long   offset;
+        long        count;
+    };
+
+    Ring    ring;
+    Extent  extents[EXTENT_MAX];
+    int     first;              // Index of the oldest extent
+    int     count;              // Number of the extents in use
+    long    used;               // Number of the bytes queued
+    long    fileUsed;           // Number of the bytes queued from streams
+
+    Extent& at(int i)
+    {
+        return extents[(first + i) % EXTENT_MAX];
+    }
+    const Extent& at(int i) const
+    {
+        return extents[(first + i) % EXTENT_MAX];
+    }
+
+    SendBuffer(const SendBuffer&);
+    SendBuffer& operator=(const SendBuffer&);
+
+public:
+    SendBuffer() :
+        first(0),
+        count(0),
+        used(0),
+        fileUsed(0)
+    {
+    }
+
+    ~SendBuffer();
+
+    void initialize(void* buf, long size)
+    {
+        ring.initialize(buf, size);
+    }
+
+    /** Peeks the queued bytes into dst. The bytes in the ring are copied
+     *  at once, while the stream ranges are recorded in the reader to be
+     *  read later.
+     * @param dst       the buffer to which the bytes are copied.
+     * @param count     the number of bytes to be peeked.
+     * @param offset    the position in the queued bytes to peek from.
+     * @param reader    the reader to which the stream ranges are added.
+     * @return          the number of bytes peeked.
+     */
+    long peek(void* dst, long count, long offset, Reader* reader) const;
+
+    /** Discards the bytes that have been acknowledged, and releases the
+     *  streams that are no longer referenced.
+     * @param count     the number of bytes to be discarded.
+     * @return          the number of bytes discarded.
+     */
+    long skip(long count);
+
+    /** Copies the bytes into the ring.
+     * @return          the number of bytes queued.
+     */
+    long write(const void* src, long count);
+
+    /** Queues the range of the stream by reference.
+     * @return          the number of bytes queued.
+     */
+    long writeFile(es::Stream* stream, long long offset, long count);
+
+    long getUsed() const
+    {
+        return used;
+    }
+
+    /** Gets the number of bytes that can be copied into the ring.
+     */
+    long getUnused()
+    {
+        return isFull() ? 0 : ring.getUnused();
+    }
+
+    long getFileUsed() const
+    {
+        return fileUsed;
+    }
+
+    /** Checks if no more extents can be added.
+     */
+    bool isFull() const
+    {
+        return count == EXTENT_MAX;
+    }
+};
+
+#endif  // SENDBUFFER_H_INCLUDED
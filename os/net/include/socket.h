@@ -29,10 +29,12 @@
 #include <es/net/IInternetConfig.h>
 #include <es/net/IResolver.h>
 #include <es/net/ISocket.h>
+#include <es/net/statistics.h>
 #include <es/net/udp.h>
 #include "inet.h"
 #include "interface.h"
 #include "address.h"
+#include "selector.h"
 
 class AddressFamily;
 class Socket;
@@ -67,6 +69,14 @@ class Socket :
 public:
     static const int INTERFACE_MAX = 8;
 
+    // The header of a datagram transferred by recvBatch or sendBatch
+    struct BatchEntry
+    {
+        Address*    addr;   // Source or destination; zero for the connected peer
+        int         port;
+        int         len;
+    };
+
     static es::Resolver*        resolver;
     static es::InternetConfig*  config;
     static es::Context*         interface;
@@ -84,6 +94,7 @@ private:
     AddressFamily*       af;
     int                  recvBufferSize;
     int                  sendBufferSize;
+    int                  congestionControl;
     int                  errorCode;
     TimeSpan             timeout;
     Collection<Address*> addresses;
@@ -91,11 +102,18 @@ private:
     // Asynchronous I/O
     es::Monitor*         selector;
     bool                 blocking;
+    Selector::Registration::SocketList registrations;
 
     // recvFrom
     es::InternetAddress* recvFromAddress;
     int                  recvFromPort;
 
+    // recvBatch, sendBatch
+    BatchEntry           batch[es::Socket::BatchMax];
+    int                  batchCount;
+
+    void clearBatch();
+
 public:
     static void initialize();
 
@@ -223,6 +241,7 @@ public:
     {
         return type;
     }
+    void getStatistics(void* statistics);
     int getLastError()
     {
         return errorCode;
@@ -241,6 +260,9 @@ public:
     int getSendBufferSize();
     void setSendBufferSize(int size);
 
+    int getCongestionControl();
+    void setCongestionControl(int algorithm);
+
     bool getReuseAddress();
     void setReuseAddress(bool on);
 
@@ -257,9 +279,17 @@ public:
     es::InternetAddress* getRecvFromAddress() ;
     int getRecvFromPort();
     int sendTo(const void* src, int count, int flags, es::InternetAddress* addr, int port);
+    int recvBatch(void* buf, int bufLength, int count, int flags);
+    int getBatchCount();
+    int getBatchLength(int index);
+    es::InternetAddress* getBatchAddress(int index);
+    int getBatchPort(int index);
+    void setBatchAddress(int index, es::InternetAddress* addr, int port);
+    int sendBatch(const void* src, int srcLength, const int* lengths, int lengthsLength, int flags);
     void shutdownInput();
     void shutdownOutput();
     int write(const void* src, int count);
+    int sendFile(es::Stream* src, long long offset, int count);
     bool sockAtMark();
     bool isUrgent();
 
@@ -296,8 +326,14 @@ public:
     unsigned int addRef();
     unsigned int release();
 
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerSocket;
+    }
+
     friend class StreamReceiver;
     friend class DatagramReceiver;
+    friend class Selector;
 };
 
 class SocketMessenger;
@@ -319,6 +355,21 @@ public:
         return true;
     }
 
+    virtual bool sendFile(SocketMessenger* m, Conduit* c)
+    {
+        return true;
+    }
+
+    virtual bool readBatch(SocketMessenger* m, Conduit* c)
+    {
+        return true;
+    }
+
+    virtual bool writeBatch(SocketMessenger* m, Conduit* c)
+    {
+        return true;
+    }
+
     virtual bool accept(SocketMessenger* m, Conduit* c)
     {
         return false;
@@ -379,6 +430,12 @@ public:
         return false;
     }
 
+    // Fills in the es::SocketStatistics given as the chunk of m.
+    virtual bool getStatistics(SocketMessenger* m, Conduit* c)
+    {
+        return false;
+    }
+
     typedef bool (SocketReceiver::*Command)(SocketMessenger*, Conduit*);
 };
 
@@ -386,13 +443,23 @@ class SocketMessenger : public InetMessenger
 {
     Socket* socket;
     SocketReceiver::Command op;
+    es::Stream* stream;     // The source of sendFile
+    long long   offset;
+    long        count;
+    Socket::BatchEntry* batch;  // The datagram headers of readBatch and writeBatch
+    int         batchCount;
 
 public:
     SocketMessenger(Socket* socket, SocketReceiver::Command op,
                     void* chunk = 0, long len = 0, long pos = 0) :
         InetMessenger(0, len, pos, chunk),
         socket(socket),
-        op(op)
+        op(op),
+        stream(0),
+        offset(0),
+        count(0),
+        batch(0),
+        batchCount(0)
     {
         if (socket)
         {
@@ -418,6 +485,11 @@ public:
         {
             if (SocketReceiver* receiver = dynamic_cast<SocketReceiver*>(c->getReceiver()))
             {
+                if (InetProfile::isEnabled())
+                {
+                    InetProfile::Sample sample(InetProfile::LayerSocket);
+                    return (receiver->*op)(this, c);
+                }
                 return (receiver->*op)(this, c);
             }
         }
@@ -438,6 +510,51 @@ public:
         }
         return socket;
     }
+
+    // The range of the stream to be sent by sendFile. The messenger does
+    // not hold a reference to the stream.
+    es::Stream* getStream() const
+    {
+        return stream;
+    }
+    long long getOffset() const
+    {
+        return offset;
+    }
+    long getCount() const
+    {
+        return count;
+    }
+    void setCount(long count)
+    {
+        this->count = count;
+    }
+    void setStream(es::Stream* stream, long long offset, long count)
+    {
+        this->stream = stream;
+        this->offset = offset;
+        this->count = count;
+    }
+    // The datagram headers of a batch. The batch count is the maximum
+    // number of the datagrams to be transferred on the way down, and the
+    // number of the datagrams actually transferred on the way back.
+    Socket::BatchEntry* getBatch() const
+    {
+        return batch;
+    }
+    int getBatchCount() const
+    {
+        return batchCount;
+    }
+    void setBatchCount(int count)
+    {
+        batchCount = count;
+    }
+    void setBatch(Socket::BatchEntry* batch, int count)
+    {
+        this->batch = batch;
+        batchCount = count;
+    }
     void setSocket(Socket* socket)
     {
         if (socket)
@@ -23,16 +23,20 @@
 #include <es/endian.h>
 #include <es/ring.h>
 #include <es/timer.h>
+#include <es/tree.h>
 #include <es/synchronized.h>
 #include <es/base/IMonitor.h>
 #include <es/net/inet4.h>
 #include <es/net/inet6.h>
 #include <es/net/tcp.h>
 #include "inet.h"
+#include "inetStatistics.h"
+#include "sendBuffer.h"
 #include "socket.h"
 
 #define TCP_SACK
 #define TCP_LIMITED_TRANSMIT
+#define TCP_LARGE_SEND
 
 class StreamReceiver :
     public SocketReceiver
@@ -49,6 +53,8 @@ private:
                                                 // Must be more than R1, add less than 31.
     static const int RXMIT_THRESH;              // Fast restransmission threshold
     static const int LIMITED_THRESH = 2;        // Limited Transmit threshold
+    static const int LARGE_SEND_MAX;            // Maximum payload of a large send super-segment
+    static const int SEND_FILE_MAX;             // Maximum bytes queued by reference from streams
 
     static const TimeSpan R2;
     static const TimeSpan R2_SYN;
@@ -59,7 +65,9 @@ private:
     static const TimeSpan PERSIST_MAX;          // Maximum idle time in persist state
     static const TimeSpan DACK_TIMEOUT;         // Delayed ACK timeout
 
-    static const int      MaxConn;              // upper limit of partial and pending connection
+    static const int      MaxConn;              // upper limit of the listen backlog
+    static const TimeSpan SYN_TIMEOUT;          // Lifetime of a half-open connection in the SYN table
+    static const TimeSpan COOKIE_PERIOD;        // Period of the SYN cookie counter
     
     class RxmitTimer : public TimerTask
     {
@@ -95,6 +103,100 @@ private:
         TCPSeq  rxmit;      // next seq. no in hole to be retransmitted
     };
 
+    typedef Tree<TCPSeq, TCPSeq> BlockTree;     // left edge to right edge
+    typedef Tree<TCPSeq, SackHole*> HoleTree;   // start seq no. to hole
+
+    // Congestion control algorithm. The loss recovery procedures (fast
+    // retransmit, NewReno partial ACKs, and SACK) are common to all the
+    // algorithms; an algorithm only decides how cWin and ssThresh evolve.
+    class CongestionControl
+    {
+    public:
+        virtual ~CongestionControl()
+        {
+        }
+        // Sets the initial window at the beginning of a connection.
+        virtual void start(StreamReceiver* s);
+        // Opens cWin as acked bytes of new data are acknowledged
+        // outside of the loss recovery.
+        virtual void ack(StreamReceiver* s, s32 acked) = 0;
+        // Takes a new round trip time sample.
+        virtual void rtt(StreamReceiver* s, TimeSpan rtt)
+        {
+        }
+        // Sets ssThresh as a loss is detected by duplicate ACKs.
+        virtual void loss(StreamReceiver* s) = 0;
+        // Collapses cWin as the retransmission timer expires.
+        virtual void timeout(StreamReceiver* s) = 0;
+        // Restarts an idle connection. [RFC 2581 4.1]
+        virtual void restart(StreamReceiver* s);
+        virtual const char* getName() const = 0;
+
+        static CongestionControl* createInstance(int algorithm);
+    };
+
+    class Reno : public CongestionControl
+    {
+    public:
+        void ack(StreamReceiver* s, s32 acked);
+        void loss(StreamReceiver* s);
+        void timeout(StreamReceiver* s);
+        const char* getName() const
+        {
+            return "Reno";
+        }
+    };
+
+    // CUBIC [RFC 8312] with the HyStart slow start exit.
+    class Cubic : public CongestionControl
+    {
+        static const int BETA = 717;                // Multiplicative decrease factor (x/1024)
+        static const int C = 410;                   // Scaling constant (x/1024) [segments/sec^3]
+        static const int HYSTART_LOW_WINDOW = 16;   // HyStart is not used below this cWin [segments]
+        static const s64 MAX_DELTA;                 // Limit of |t - K| to avoid overflow [msec]
+        static const TimeSpan HYSTART_DELAY_MIN;
+        static const TimeSpan HYSTART_DELAY_MAX;
+        static const TimeSpan HYSTART_ACK_DELTA;
+
+        s32         wMax;           // cWin just before the last reduction [bytes]
+        s32         wLastMax;       // wMax before the last reduction [bytes]
+        s32         wEst;           // TCP-friendly window estimate [bytes]
+        s64         k;              // Time to reach wMax [msec]
+        DateTime    epoch;          // Start of the current congestion avoidance epoch
+        s64         remainder;      // Fractional part of the cWin increase
+        s64         estRemainder;   // Fractional part of the wEst increase
+        TimeSpan    minRtt;         // Minimum RTT ever observed
+
+        // HyStart
+        bool        hystart;
+        TCPSeq      roundEnd;       // sendMax at the start of the current round
+        DateTime    roundStart;
+        DateTime    lastAck;
+        TimeSpan    currRoundMinRtt;
+        TimeSpan    lastRoundMinRtt;
+
+        void reset();
+        void startRound(StreamReceiver* s);
+        void exitSlowStart(StreamReceiver* s);
+        static s64 cubeRoot(s64 n);
+
+    public:
+        Cubic()
+        {
+            reset();
+        }
+        void start(StreamReceiver* s);
+        void ack(StreamReceiver* s, s32 acked);
+        void rtt(StreamReceiver* s, TimeSpan rtt);
+        void loss(StreamReceiver* s);
+        void timeout(StreamReceiver* s);
+        void restart(StreamReceiver* s);
+        const char* getName() const
+        {
+            return "Cubic";
+        }
+    };
+
     class State
     {
     public:
@@ -361,7 +463,8 @@ private:
     u8*         recvBuf;
     Ring        recvRing;
     u8*         sendBuf;
-    Ring        sendRing;
+    SendBuffer  sendRing;
+    SendBuffer::Reader* reader; // The stream ranges of the segment being made
     Conduit*    conduit;
     int         err;
     Socket*     socket;
@@ -402,7 +505,8 @@ private:
     TCPSeq      irs;        // initial receive sequence number
     TCPSeq      recvAcked;
     s32         dupAcks;    // # of duplicated ACKs received.
-    Ring::Vec   asb[TCPHdr::ASB_MAX];   // above sequence blocks received
+    BlockTree   recvBlocks; // above sequence blocks received in recvRing
+    TCPSeq      recvLast;   // left edge of the block received last
 
     // Slow start, Congestion avoidance
     s32         cWin;       // Congestion window size. The congestion
@@ -410,6 +514,7 @@ private:
                             // fit in the pipe.
     s32         ssThresh;   // Slow start threshold.
     s32         cAcked;     // Count of acked bytes during congestion avoidance
+    CongestionControl*  cc; // Congestion control algorithm
 
     // Round trip timing
     DateTime    rttTiming;  // Non-zero while measuring RTT value
@@ -430,21 +535,52 @@ private:
     AckTimer    ackTimer;
 
     // SACK/FACK
-    SackHole    scoreboard[TCPHdr::ASB_MAX];
-                                // list of non-SACKed holes
+    HoleTree    scoreboard;     // non-SACKed holes
     int         sendHoles;      // # of holes in scoreboard
+    TCPSeq      rxmitHole;      // the holes below have been retransmitted
     TCPSeq      sendRecover;    // sendNext at the time the first loss was detected
     TCPSeq      lastSack;
     TCPSeq      onxt;
     SackHole*   hole;
 
+    // Statistics
+    unsigned long       retransmits;    // # of segments retransmitted
+    unsigned long       recoveries;     // # of losses detected by duplicate ACKs or SACK
+    unsigned long       timeouts;       // # of retransmission timeouts
+    unsigned long long  inOctets;       // # of octets received in order
+    unsigned long long  outOctets;      // # of octets acknowledged
+
     // Listen/Accept
     StreamReceiver*                             listening;  // listening socket
     List<StreamReceiver, &StreamReceiver::link> accepted;
-    int                                         backLogCount; // sum partial&pending connection
-    int                                         parConn;  // count partial connection
+    int                                         backLogCount; // size of SYN table and accepted-queue
     int                                         pendingConn;  // count accetped-queue
-    
+
+    // A half-open connection is kept in the SYN table of the listening
+    // socket until its handshake completes; no socket is created for it
+    // until then. When the table is full, the state is encoded in the ISS
+    // of the SYN-ACK instead (SYN cookie).
+    struct SynEntry
+    {
+        SynEntry*   next;       // Next entry in the hash chain or in the free list
+        Address*    remote;
+        Address*    local;
+        u16         remotePort;
+        u16         localPort;
+        TCPSeq      irs;
+        TCPSeq      iss;
+        s32         mss;        // MSS of the peer
+        bool        sack;
+        DateTime    expiration;
+    };
+    SynEntry*   synTable;
+    SynEntry**  synHash;
+    SynEntry*   synFree;
+    int         synHashSize;
+    int         synCount;       // count partial connection
+    DateTime    cookieExpiration;   // SYN cookies are accepted until then
+    long        cookiesSent;
+
     TCPSeq isn(InetMessenger* m);
     int getDefaultMSS();
     int getDefaultMSS(int mtu);
@@ -455,6 +591,18 @@ private:
         return 2 * mss;
     }
 
+    // Returns the size of the messenger to be used for the next output
+    // segment, which is large enough for a large send super-segment if
+    // there is more than one segment of unsent data.
+    int getSegmentBufferSize()
+    {
+        s32 size = mss;
+#ifdef TCP_LARGE_SEND
+        size = std::max(size, std::min(LARGE_SEND_MAX, (s32) (sendRing.getUsed() - (sendNext - sendUna))));
+#endif  // TCP_LARGE_SEND
+        return 14 + 60 + 60 + size;  // XXX Assume MAC, IPv4, TCP
+    }
+
     int countOptionSize(u16 flag);
     int fillOptions(u8* opt, u16 flag);
 
@@ -529,10 +677,24 @@ private:
     s32 getSendable();
     s32 getSendableWithFin(u16& flag);
     bool canSend(s32 len, s32 mss, u16 flag);
+    bool canLargeSend(InetMessenger* m, u16 flag);
     bool send(InetMessenger* m, s32 sendable, u16 flag);
     void sendReset(InetMessenger* m);
     void sendReset();
 
+    //
+    // Listen
+    //
+    void initSynTable(int size);
+    void clearSynTable();
+    SynEntry** lookupSyn(InetMessenger* m);
+    SynEntry* addSyn(InetMessenger* m);
+    void removeSyn(SynEntry** prev);
+    void sendSynAck(InetMessenger* m, TCPSeq iss, TCPSeq irs, bool sack);
+    TCPSeq makeCookie(InetMessenger* m, TCPSeq irs, s32 mss, bool sack);
+    bool checkCookie(InetMessenger* m, TCPSeq iss, TCPSeq irs, s32& mss, bool& sack);
+    StreamReceiver* createAccepted(InetMessenger* m, TCPSeq iss, TCPSeq irs, s32 mss, bool sack);
+
     //
     // Timer
     //
@@ -552,6 +714,16 @@ private:
     //
     // Sack
     //
+    void addRecvBlock(TCPSeq start, TCPSeq end);
+    s32 pullRecvBlocks();
+    void clearRecvBlocks();
+    int countSackBlocks();
+    void fillSackOption(TCPOptSack* optSack);
+
+    SackHole* addSackHole(TCPSeq start, TCPSeq end, int dupAcks, TCPSeq rxmit);
+    void trimSackHole(HoleTree::Node* node, TCPSeq start, TCPSeq end);
+    void removeSackHole(HoleTree::Node* node);
+    void clearScoreboard();
     SackHole* getSackHole();
     void deleteSackHoles(TCPSeq ack);
     void updateScoreboard(TCPSeq ack, TCPOptSack* optSack);
@@ -570,7 +742,11 @@ private:
     }
     bool isWritable()
     {
-        return 0 < socket->getSendBufferSize() - sendRing.getUsed() ||
+        return 0 < sendRing.getUnused() || isShutdownOutput() || err;
+    }
+    bool isFileWritable()
+    {
+        return (sendRing.getFileUsed() < SEND_FILE_MAX && !sendRing.isFull()) ||
                isShutdownOutput() || err;
     }
     bool isClosable()
@@ -578,12 +754,16 @@ private:
         return state == &stateClosed || state == &stateTimeWait;
     }
 
+    bool waitUntil(bool (StreamReceiver::*ready)(), SocketMessenger* m);
+    void transmit(SocketMessenger* m);
+
 public:
     StreamReceiver(Conduit* conduit = 0) :
         state(&stateClosed),
         monitor(0),
         recvBuf(0),
         sendBuf(0),
+        reader(0),
         conduit(conduit),
         err(0),
         socket(0),
@@ -607,15 +787,29 @@ public:
         cWin(2 * mss),  // RFC 2581 allows a TCP to use an initial cwnd of up to 2 segments.
         ssThresh(DEF_SSTHRESH),
         cAcked(0),
+        cc(0),
 
         rxmitTimer(this),
 
         ackTimer(this),
 
+        sendHoles(0),
+
+        retransmits(0),
+        recoveries(0),
+        timeouts(0),
+        inOctets(0),
+        outOctets(0),
+
         listening(0),
         backLogCount(0),
-        parConn(0),
-        pendingConn(0)
+        pendingConn(0),
+        synTable(0),
+        synHash(0),
+        synFree(0),
+        synHashSize(0),
+        synCount(0),
+        cookiesSent(0)
     {
         monitor = es::Monitor::createInstance();
 
@@ -632,6 +826,21 @@ public:
         {
             delete[] sendBuf;
         }
+        if (cc)
+        {
+            delete cc;
+        }
+        clearRecvBlocks();
+        clearScoreboard();
+        clearSynTable();
+        if (synTable)
+        {
+            delete[] synTable;
+        }
+        if (synHash)
+        {
+            delete[] synHash;
+        }
         if (monitor)
         {
             monitor->release();
@@ -661,9 +870,15 @@ public:
         recvRing.initialize(recvBuf, socket->getReceiveBufferSize());
         sendBuf = new u8[socket->getSendBufferSize()];
         sendRing.initialize(sendBuf, socket->getSendBufferSize());
+        cc = CongestionControl::createInstance(socket->getCongestionControl());
         return true;
     }
 
+    const char* getCongestionControlName() const
+    {
+        return cc ? cc->getName() : 0;
+    }
+
     void notify()
     {
         monitor->notifyAll();
@@ -671,14 +886,21 @@ public:
         {
             socket->selector->notifyAll();
         }
+        Selector::notify(socket);
     }
 
     bool input(InetMessenger* m, Conduit* c);
     bool output(InetMessenger* m, Conduit* c);
     bool error(InetMessenger* m, Conduit* c);
 
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerTCP;
+    }
+
     bool read(SocketMessenger* m, Conduit* c);
     bool write(SocketMessenger* m, Conduit* c);
+    bool sendFile(SocketMessenger* m, Conduit* c);
 
     bool accept(SocketMessenger* m, Conduit* c);
     bool listen(SocketMessenger* m, Conduit* c);
@@ -728,6 +950,8 @@ public:
         return false;
     }
 
+    bool getStatistics(SocketMessenger* m, Conduit* c);
+
     void expired();
     void abort();
 
@@ -757,19 +981,14 @@ public:
          return backLogCount;
     }
 
-    void setBackLogCount(int len)
+    void setBackLogCount(int len);
+
+    /** Gets the number of the SYN-ACKs sent with a SYN cookie, i.e., while
+     *  the SYN table was full.
+     */
+    long getCookiesSent()
     {
-        int l;
-        if (len <= 0)
-        {
-            l = 1;
-        }
-        else
-        {
-             l = std::min(len, MaxConn);
-        }
-        
-        backLogCount = l;
+        return cookiesSent;
     }
     
     static class StateClosed        stateClosed;
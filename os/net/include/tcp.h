@@ -30,6 +30,11 @@ public:
     bool input(InetMessenger* m, Conduit* c);
     bool output(InetMessenger* m, Conduit* c);
     bool error(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerTCP;
+    }
 };
 
 #endif  // TCP_H_INCLUDED
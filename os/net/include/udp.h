@@ -31,6 +31,11 @@ public:
     bool input(InetMessenger* m, Conduit* c);
     bool output(InetMessenger* m, Conduit* c);
     bool error(InetMessenger* m, Conduit* c);
+
+    int getProfileLayer() const
+    {
+        return InetProfile::LayerUDP;
+    }
 };
 
 class UDPUnreachReceiver : public InetReceiver
@@ -24,7 +24,7 @@
 ARPFamily::ARPFamily(InFamily* inFamily) :
     inFamily(inFamily),
     scopeMux(&scopeAccessor, &scopeFactory),
-    arpReceiver(inFamily),
+    arpReceiver(inFamily, &neighborCache),
     arpFactory(&arpAdapter),
     arpMux(&arpAccessor, &arpFactory)
 {
@@ -79,10 +79,12 @@ StateIncomplete::expired(Inet4Address* a)
     {
         esReport("StateIncomplete::timeoutCount: %d\n", a->timeoutCount);
 
+        NeighborCache* cache = a->inFamily->arpFamily.getNeighborCache();
         Handle<Inet4Address> src = a->inFamily->selectSourceAddress(a);
         if (!src)
         {
             a->setState(stateInit);
+            cache->purge(a);
             return;
         }
 
@@ -99,14 +101,14 @@ StateIncomplete::expired(Inet4Address* a)
 
         arphdr->op = htons(ARPHdr::OP_REQUEST);
 
-        Visitor v(m);
-        a->adapter->accept(&v);
-        a->alarm(5000000LL << a->timeoutCount);
+        cache->send(a, m);
+        cache->defer(a, 5000000LL << a->timeoutCount);
     }
     else
     {
-        // Not found:
+        // Not found: discard the packets waiting for the resolution.
         a->setState(stateInit);
+        a->inFamily->arpFamily.getNeighborCache()->purge(a);
     }
 }
 
@@ -133,10 +135,11 @@ StateIncomplete::error(InetMessenger* m, Inet4Address* a)
 void Inet4Address::
 StateReachable::start(Inet4Address* a)
 {
-    a->alarm(20 * 60 * 10000000LL);
+    NeighborCache* cache = a->inFamily->arpFamily.getNeighborCache();
+    cache->defer(a, NeighborCache::REACHABLE_TIME);
 
     // Send kept packets
-    while (Handle<InetMessenger> m = a->retrieve())
+    while (Handle<InetMessenger> m = cache->retrieve(a))
     {
         Visitor v(m);
         Conduit* conduit = &a->inFamily->scopeMux;
@@ -148,6 +151,7 @@ void Inet4Address::
 StateReachable::expired(Inet4Address* a)
 {
     a->setState(stateProbe);
+    a->run();   // Send the first probe
 }
 
 bool Inet4Address::
@@ -178,10 +182,12 @@ StateProbe::expired(Inet4Address* a)
     {
         esReport("StateProbe::timeoutCount: %d\n", a->timeoutCount);
 
+        NeighborCache* cache = a->inFamily->arpFamily.getNeighborCache();
         Handle<Inet4Address> src = a->inFamily->selectSourceAddress(a);
         if (!src)
         {
             a->setState(stateInit);
+            cache->purge(a);
             return;
         }
 
@@ -199,9 +205,8 @@ StateProbe::expired(Inet4Address* a)
 
         arphdr->op = htons(ARPHdr::OP_REQUEST);
 
-        Visitor v(m);
-        a->adapter->accept(&v);
-        a->alarm(5000000LL << a->timeoutCount);
+        cache->send(a, m);
+        cache->defer(a, 5000000LL << a->timeoutCount);
     }
     else
     {
@@ -268,8 +273,7 @@ StateTentative::expired(Inet4Address* a)
         a->getMacAddress(arphdr->sha);
         arphdr->op = htons(ARPHdr::OP_REQUEST);
 
-        Visitor v(m);
-        a->adapter->accept(&v);
+        a->inFamily->arpFamily.getNeighborCache()->send(a, m);
         if (a->timeoutCount < ARPHdr::PROBE_NUM)
         {
             a->alarm(ARPHdr::PROBE_MIN * 10000000LL + rand48() % (ARPHdr::PROBE_MAX * 10000000LL));
@@ -315,6 +319,12 @@ StatePreferred::start(Inet4Address* a)
     m.setLocal(a);
     Installer installer(&m);
     a->inFamily->echoRequestMux.accept(&installer, &a->inFamily->icmpMux);
+
+    // Add the connected route to the network of this address.
+    if (a->getPrefix())
+    {
+        a->inFamily->addRoute(a->getAddress(), a->getPrefix(), 0, a);
+    }
 }
 
 void Inet4Address::
@@ -338,9 +348,12 @@ StatePreferred::expired(Inet4Address* a)
         a->getMacAddress(arphdr->sha);
         arphdr->op = htons(ARPHdr::OP_REQUEST);
 
-        Visitor v(m);
-        a->adapter->accept(&v);
-        a->alarm(ARPHdr::ANNOUNCE_INTERVAL * 10000000LL);
+        NeighborCache* cache = a->inFamily->arpFamily.getNeighborCache();
+        cache->send(a, m);
+        if (a->timeoutCount < ARPHdr::ANNOUNCE_NUM)
+        {
+            cache->defer(a, ARPHdr::ANNOUNCE_INTERVAL * 10000000LL);
+        }
     }
 }
 
@@ -369,8 +382,7 @@ StatePreferred::input(InetMessenger* m, Inet4Address* a)
         a->getMacAddress(rephdr->sha);
         rephdr->op = htons(ARPHdr::OP_REPLY);
 
-        Visitor v(r);
-        a->adapter->accept(&v);
+        a->inFamily->arpFamily.getNeighborCache()->send(a, r);
     }
     return true;
 }
@@ -395,16 +407,23 @@ StateDeprecated::start(Inet4Address* a)
     // Uninstall ARP cache for this address.
     a->inFamily->arpFamily.removeAddress(a);
 
+    // Remove the connected route to the network of this address.
+    if (a->getPrefix())
+    {
+        a->inFamily->removeRoute(a->getAddress(), a->getPrefix(), a);
+    }
+
     // Install an ICMP echo request adapter for this address if necessary.
     InetMessenger m;
     m.setLocal(a);
     void* key = a->inFamily->echoRequestMux.getKey(&m);
-    Adapter* adapter = dynamic_cast<Adapter*>(a->inFamily->echoRequestMux.getB(key));
-    if (adapter)
+    Conduit* conduit = a->inFamily->echoRequestMux.getB(key);
+    if (Adapter* adapter = dynamic_cast<Adapter*>(conduit))
     {
         Uninstaller uninstaller(&m);
         adapter->accept(&uninstaller);
     }
+    conduit->release();
 }
 
 bool Inet4Address::
@@ -425,8 +444,33 @@ StateDeprecated::error(InetMessenger* m, Inet4Address* a)
     return true;
 }
 
+// Inet4Address
+
+void Inet4Address::
+resolve(InetMessenger* m)
+{
+    start();
+    if (inFamily)
+    {
+        inFamily->arpFamily.getNeighborCache()->hold(this, m);
+    }
+}
+
 // ARPReceiver
 
+// Looks up the neighbor cache first as most of the ARP packets are for the
+// addresses being resolved or the local addresses.
+Inet4Address* ARPReceiver::
+getAddress(InAddr addr, int scopeID)
+{
+    Inet4Address* address = neighborCache->lookup(addr, scopeID);
+    if (!address)
+    {
+        address = inFamily->getAddress(addr, scopeID);
+    }
+    return address;
+}
+
 bool ARPReceiver::
 input(InetMessenger* m, Conduit* c)
 {
@@ -446,11 +490,12 @@ input(InetMessenger* m, Conduit* c)
 
     Handle<Inet4Address> addr;
 
-    addr = inFamily->getAddress(arphdr->spa, m->getScopeID());
+    addr = getAddress(arphdr->spa, m->getScopeID());
     if (addr)
     {
         addr->setMacAddress(arphdr->sha);
         addr->cancel();
+        neighborCache->cancel(addr);
         if (addr->isLocalAddress())
         {
             addr->setState(Inet4Address::stateDeprecated);
@@ -462,7 +507,7 @@ input(InetMessenger* m, Conduit* c)
         addr->start();  // To send waiting packets.
     }
 
-    addr = inFamily->getAddress(arphdr->tpa, m->getScopeID());
+    addr = getAddress(arphdr->tpa, m->getScopeID());
     m->setLocal(addr);
 
     return true;
@@ -17,12 +17,11 @@
 
 #include <es/net/inet4.h>
 #include "datagram.h"
+#include "inetStatistics.h"
 
 bool DatagramReceiver::
 input(InetMessenger* m, Conduit* c)
 {
-    esReport("DatagramReceiver::input\n");
-
     long len = m->getLength();
 
     RingHdr ringhdr(len, m->getRemote(), m->getRemotePort());
@@ -33,10 +32,15 @@ input(InetMessenger* m, Conduit* c)
     {
         // Ins. space in recvRing.
         // XXX record error code.
+        ringhdr.addr->release();
+        ++inDiscards;
+        InetStatistics::increment(InetStatistics::UdpInErrors);
         return true;
     }
     recvRing.write(&ringhdr, sizeof ringhdr);
     recvRing.write(m->fix(len), len);
+    inOctets += len;
+    InetStatistics::increment(InetStatistics::UdpInDatagrams);
     notify();
     return true;
 }
@@ -58,16 +62,13 @@ error(InetMessenger* m, Conduit* c)
     return true;
 }
 
+// Waits for a datagram with the monitor held. Returns false with the error
+// code set in m if no datagram can be read.
 bool DatagramReceiver::
-read(SocketMessenger* m, Conduit* c)
+wait(SocketMessenger* m)
 {
-    Synchronized<es::Monitor*> method(monitor);
-
-    esReport("DatagramReceiver::read()\n");
-
     ASSERT(socket);
 
-    // Copy-out data
     while (!isReadable())
     {
         if (!socket->getBlocking())
@@ -91,6 +92,19 @@ read(SocketMessenger* m, Conduit* c)
         m->setPosition(m->getSize());
         return false;
     }
+    return true;
+}
+
+bool DatagramReceiver::
+read(SocketMessenger* m, Conduit* c)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    // Copy-out data
+    if (!wait(m))
+    {
+        return false;
+    }
 
     RingHdr ringhdr;
     long len = recvRing.read(&ringhdr, sizeof ringhdr);
@@ -112,22 +126,112 @@ read(SocketMessenger* m, Conduit* c)
     return false;
 }
 
+// Hands over as many queued datagrams as requested and fit in the buffer
+// with a single acquisition of the monitor. The references to the source
+// addresses held by the ring are passed on to the batch.
 bool DatagramReceiver::
-write(SocketMessenger* m, Conduit* c)
+readBatch(SocketMessenger* m, Conduit* c)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    if (!wait(m))
+    {
+        return false;
+    }
+
+    Socket::BatchEntry* batch = m->getBatch();
+    int max = m->getBatchCount();
+    long size = m->getSize();
+    u8* ptr = static_cast<u8*>(m->fix(size));
+    long pos = 0;
+    int n = 0;
+    while (n < max && 0 < recvRing.getUsed())
+    {
+        RingHdr ringhdr;
+        recvRing.peek(&ringhdr, sizeof ringhdr);
+        long len = ringhdr.len;
+        if (size - pos < len)
+        {
+            if (0 < n)
+            {
+                break;  // Leave it for the next call.
+            }
+            len = size; // Truncate the first datagram.
+        }
+        recvRing.skip(sizeof ringhdr);
+        recvRing.read(ptr + pos, len);
+        recvRing.skip(ringhdr.len - len);
+        batch[n].addr = ringhdr.addr;
+        batch[n].port = ringhdr.port;
+        batch[n].len = len;
+        pos += len;
+        ++n;
+    }
+    m->setBatchCount(n);
+    m->setSize(pos);
+    return false;
+}
+
+void DatagramReceiver::
+send(InetMessenger* m, Address* remote, int remotePort, void* data, int len)
 {
     int pos = 14 + 60 + 60;  // XXX Assume MAC, IPv4
-    int len = m->getSize();
     Handle<InetMessenger> d = new InetMessenger(&InetReceiver::output, pos + len, pos);
-    memmove(d->fix(len), m->fix(len), len);
+    memmove(d->fix(len), data, len);
 
-    Handle<Address> addr;
-    d->setLocal(addr = m->getLocal());
-    d->setRemote(addr = m->getRemote());
+    d->setLocal(Handle<Address>(m->getLocal()));
+    d->setRemote(remote);
     d->setLocalPort(m->getLocalPort());
-    d->setRemotePort(m->getRemotePort());
+    d->setRemotePort(remotePort);
     d->setType(IPPROTO_UDP);
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        outOctets += len;
+    }
     Visitor v(d);
     conduit->accept(&v, conduit->getB());
+}
+
+bool DatagramReceiver::
+write(SocketMessenger* m, Conduit* c)
+{
+    int len = m->getSize();
+    send(m, Handle<Address>(m->getRemote()), m->getRemotePort(), m->fix(len), len);
+    return false;
+}
+
+// Sends the datagrams of the batch one after another. A datagram without
+// its destination is sent to the connected peer.
+bool DatagramReceiver::
+writeBatch(SocketMessenger* m, Conduit* c)
+{
+    Socket::BatchEntry* batch = m->getBatch();
+    int max = m->getBatchCount();
+    Handle<Address> remote = m->getRemote();
+    u8* ptr = static_cast<u8*>(m->fix(m->getSize()));
+    int n;
+    for (n = 0; n < max; ++n)
+    {
+        if (batch[n].addr)
+        {
+            send(m, batch[n].addr, batch[n].port, ptr, batch[n].len);
+        }
+        else if (remote)
+        {
+            send(m, remote, m->getRemotePort(), ptr, batch[n].len);
+        }
+        else
+        {
+            break;
+        }
+        ptr += batch[n].len;
+    }
+    if (n == 0 && 0 < max)
+    {
+        m->setErrorCode(EDESTADDRREQ);
+    }
+    m->setBatchCount(n);
     return false;
 }
 
@@ -146,3 +250,17 @@ notify(SocketMessenger* m, Conduit* c)
     notify();
     return false;
 }
+
+bool DatagramReceiver::
+getStatistics(SocketMessenger* m, Conduit* c)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    es::SocketStatistics* statistics =
+        static_cast<es::SocketStatistics*>(m->fix(sizeof(es::SocketStatistics)));
+    statistics->inOctets = inOctets;
+    statistics->outOctets = outOctets;
+    statistics->inDiscards = inDiscards;
+    statistics->receiveQueued = recvRing.getUsed();
+    return false;
+}
@@ -20,6 +20,7 @@
 #include <es/dateTime.h>
 #include <es/endian.h>
 #include <es/handle.h>
+#include <es/interfaceTable.h>
 #include <es/list.h>
 #include <es/ref.h>
 #include <es/base/IService.h>
@@ -805,21 +806,7 @@ public:
 
     Object* queryInterface(const char* riid)
     {
-        Object* objectPtr;
-        if (strcmp(riid, es::Service::iid()) == 0)
-        {
-            objectPtr = static_cast<es::Service*>(this);
-        }
-        else if (strcmp(riid, Object::iid()) == 0)
-        {
-            objectPtr = static_cast<es::Service*>(this);
-        }
-        else
-        {
-            return NULL;
-        }
-        objectPtr->addRef();
-        return objectPtr;
+        return es::InterfaceTable<DHCPControl, es::Service>::query(this, riid);
     }
 
     unsigned int addRef()
@@ -78,7 +78,15 @@ bool DIXReceiver::output(InetMessenger* m, Conduit* c)
         esReport("# dix output\n");
         esDump(packet, len);
 #endif
-        dix->write(packet, len);
+        if (0 < m->getSegmentSize() &&
+            !(dix->getCapabilities() & es::NetworkInterface::LargeSend))
+        {
+            dix->segment(m);
+        }
+        else
+        {
+            dix->write(packet, len);
+        }
     }
     // else discard the packet
     return true;
@@ -104,9 +112,8 @@ bool DIXInReceiver::output(InetMessenger* m, Conduit* c)
         {
             nextHop->setScopeID(m->getScopeID());
         }
-        nextHop->start();
         m->restorePosition();
-        nextHop->hold(m);
+        nextHop->resolve(m);
         return false;
     }
     return true;
@@ -17,6 +17,7 @@
 
 #include <new>
 #include "inet4.h"
+#include "inetStatistics.h"
 
 u16 InReceiver::identification;
 
@@ -54,13 +55,7 @@ InFamily::InFamily() :
     tcpLocalPortFactory(&tcpLocalAddressMux),
     tcpLocalPortMux(&tcpLocalPortAccessor, &tcpLocalPortFactory),
 
-    reassReceiver(&inProtocol, &timeExceededProtocol, &reassAdapter),
-    reassIdFactory(&reassAdapter),
-    reassIdMux(&reassIdAccessor, &reassIdFactory),
-    reassRemoteAddressFactory(&reassIdMux),
-    reassRemoteAddressMux(&reassRemoteAddressAccessor, &reassRemoteAddressFactory),
-    reassLocalAddressFactory(&reassRemoteAddressMux),
-    reassLocalAddressMux(&reassLocalAddressAccessor, &reassLocalAddressFactory),
+    reassReceiver(&inProtocol, &timeExceededProtocol),
 
     addressAny(InAddrAny, Inet4Address::statePreferred),
     addressAllRouters(InAddrAllRouters, Inet4Address::stateNonMember),
@@ -134,11 +129,7 @@ InFamily::InFamily() :
     Conduit::connectBA(&tcpProtocol, &tcpLocalPortMux);
 
     // Fragment Reassemble
-    reassAdapter.setReceiver(&reassReceiver);
-    reassIdFactory.setReceiver(&reassFactoryReceiver);
-    reassRemoteAddressFactory.setReceiver(&reassFactoryReceiver);
-    reassLocalAddressFactory.setReceiver(&reassFactoryReceiver);
-    Conduit::connectBA(&reassProtocol, &reassLocalAddressMux);
+    reassProtocol.setReceiver(&reassReceiver);
 
     Socket::addAddressFamily(this);
 }
@@ -160,6 +151,7 @@ Inet4Address* InFamily::getAddress(InAddr addr, int scopeID)
     }
 
     Inet4Address* address;
+    ReadWriteLock::Reader reader(addressLock);
     try
     {
         address = addressTable[scopeID].get(addr);
@@ -175,13 +167,34 @@ Inet4Address* InFamily::getAddress(InAddr addr, int scopeID)
 void InFamily::addAddress(Inet4Address* address)
 {
     int scopeID = address->getScopeID();
+    ReadWriteLock::Writer writer(addressLock);
     addressTable[scopeID].add(address->getAddress(), address);
     address->inFamily = this;
 }
 
+Inet4Address* InFamily::findOrAddAddress(Inet4Address* address)
+{
+    int scopeID = address->getScopeID();
+    ReadWriteLock::Writer writer(addressLock);
+    Inet4Address* found;
+    try
+    {
+        found = addressTable[scopeID].get(address->getAddress());
+    }
+    catch (SystemException<ENOENT>)
+    {
+        addressTable[scopeID].add(address->getAddress(), address);
+        address->inFamily = this;
+        found = address;
+    }
+    found->addRef();
+    return found;
+}
+
 void InFamily::removeAddress(Inet4Address* address)
 {
     int scopeID = address->getScopeID();
+    ReadWriteLock::Writer writer(addressLock);
     addressTable[scopeID].remove(address->getAddress());
     address->inFamily = 0;
 }
@@ -198,16 +211,53 @@ void InFamily::addRouter(Inet4Address* addr)
     if (local)
     {
         routerList.addAddress(addr);
+        addRoute(InAddrAny, 0, addr);   // Unless the default route exists
     }
 }
 
 void InFamily::removeRouter(Inet4Address* addr)
 {
     routerList.removeAddress(addr);
+    if (removeRoute(InAddrAny, 0, addr))
+    {
+        // Fall back to the next default router.
+        Handle<Inet4Address> router = routerList.getAddress();
+        if (router)
+        {
+            addRoute(InAddrAny, 0, router);
+        }
+    }
+}
+
+bool InFamily::addRoute(InAddr dest, int prefix, Inet4Address* gateway, Inet4Address* source)
+{
+    if (gateway)
+    {
+        Handle<Inet4Address> local;
+        local = onLink(gateway->getAddress(), gateway->getScopeID());
+        if (!local)
+        {
+            return false;
+        }
+    }
+    ReadWriteLock::Writer writer(routeLock);
+    return routeTable.add(dest, prefix, gateway, source);
+}
+
+bool InFamily::removeRoute(InAddr dest, int prefix, Inet4Address* address)
+{
+    ReadWriteLock::Writer writer(routeLock);
+    Route* route = routeTable.get(dest, prefix);
+    if (!route || (address && route->gateway != address && route->source != address))
+    {
+        return false;
+    }
+    return routeTable.remove(dest, prefix);
 }
 
 Inet4Address* InFamily::getHostAddress(int scopeID)
 {
+    ReadWriteLock::Reader reader(echoRequestMux.getLock());
     Tree<void*, Conduit*>::Node* node;
     Tree<void*, Conduit*>::Iterator iter = echoRequestMux.list();
     while ((node = iter.next()))
@@ -228,43 +278,50 @@ Inet4Address* InFamily::getHostAddress(int scopeID)
 
 Inet4Address* InFamily::onLink(InAddr addr, int scopeID)
 {
-    Tree<void*, Conduit*>::Node* node;
-    Tree<void*, Conduit*>::Iterator iter = echoRequestMux.list();
-    while ((node = iter.next()))
+    ReadWriteLock::Reader reader(routeLock);
+    Route* route = routeTable.lookup(addr);
+    if (route && !route->gateway && route->source &&
+        (scopeID == 0 || scopeID == route->source->getScopeID()))
     {
-        Conduit* conduit = node->getValue();
-        ICMPEchoRequestReceiver* receiver = dynamic_cast<ICMPEchoRequestReceiver*>(conduit->getReceiver());
-        ASSERT(receiver);
-        Inet4Address* local = receiver->getAddress();
-        ASSERT(local);
-        if (local->getPrefix() &&
-            IN_IS_ADDR_IN_NET(addr, local->getAddress(), local->getMask()) &&
-            (scopeID == 0 || scopeID == local->getScopeID()))
-        {
-            return local;
-        }
-        local->release();
+        route->source->addRef();
+        return route->source;
     }
     return 0;
 }
 
+// Gets the next hop to dst. The result is cached in dst until the
+// forwarding table is updated, so the sockets connected to dst look up
+// the table only once.
 Inet4Address* InFamily::getNextHop(Inet4Address* dst)
 {
-    Inet4Address* local = onLink(dst->getAddress(), dst->getScopeID());
-    if (!local)
     {
-        Inet4Address* router = routerList.getAddress();
-        if (router)
+        ReadWriteLock::Reader reader(routeLock);
+        if (dst->nextHop && dst->routeGeneration == routeTable.getGeneration())
         {
-            return router;
+            dst->nextHop->addRef();
+            return dst->nextHop;
         }
     }
-    else
+
+    ReadWriteLock::Writer writer(routeLock);
+    Inet4Address* nextHop = dst;
+    Route* route = routeTable.lookup(dst->getAddress());
+    if (route && route->gateway)
     {
-        local->release();
+        nextHop = route->gateway;
+    }
+    if (dst->nextHop && dst->nextHop != dst)
+    {
+        dst->nextHop->release();
     }
-    dst->addRef();
-    return dst;
+    if (nextHop != dst)
+    {
+        nextHop->addRef();  // Not to refer to dst itself
+    }
+    dst->nextHop = nextHop;
+    dst->routeGeneration = routeTable.getGeneration();
+    nextHop->addRef();
+    return nextHop;
 }
 
 Inet4Address* InFamily::selectSourceAddress(Inet4Address* dst)
@@ -289,16 +346,18 @@ Inet4Address* InFamily::selectSourceAddress(Inet4Address* dst)
         return src;
     }
 
-    // XXX Check destination cache
-
-    Inet4Address* router = routerList.getAddress();
-    if (router)
+    // Use the local address on the link of the gateway.
     {
-        src = onLink(router->getAddress(), router->getScopeID());
-        router->release();
-        if (src)
+        ReadWriteLock::Reader reader(routeLock);
+        Route* route = routeTable.lookup(dst->getAddress());
+        if (route && route->gateway)
         {
-            return src;
+            route = routeTable.lookup(route->gateway->getAddress());
+            if (route && !route->gateway && route->source)
+            {
+                route->source->addRef();
+                return route->source;
+            }
         }
     }
 
@@ -349,7 +408,7 @@ bool InFamily::isReachable(Inet4Address* dst, long long timeout)
     bool replied = receiver->isReplied();
 
     echoReplyMux.removeB(dst);
-    delete adapter;
+    adapter->release();
     delete receiver;
 
     return replied;
@@ -439,14 +498,17 @@ input(InetMessenger* m, Conduit* c)
 {
     Handle<Inet4Address> addr;
 
+    InetStatistics::increment(InetStatistics::IpInReceives);
     IPHdr* iphdr = static_cast<IPHdr*>(m->fix(sizeof(IPHdr)));
     if (!iphdr)
     {
+        InetStatistics::increment(InetStatistics::IpInHdrErrors);
         return false;
     }
     int hlen = iphdr->getHdrSize();
     if (m->getLength() < iphdr->getSize() || checksum(m, hlen) != 0)
     {
+        InetStatistics::increment(InetStatistics::IpInHdrErrors);
         return false;
     }
     m->setLength(iphdr->getSize()); // Cut trailer
@@ -460,6 +522,7 @@ input(InetMessenger* m, Conduit* c)
         Handle<Inet4Address> onLink;
         if (IN_IS_ADDR_LOOPBACK(iphdr->dst))
         {
+            InetStatistics::increment(InetStatistics::IpInDiscards);
             return false;
         }
         else if (IN_IS_ADDR_MULTICAST(iphdr->dst))
@@ -474,7 +537,8 @@ input(InetMessenger* m, Conduit* c)
         {
             addr = new Inet4Address(iphdr->dst, Inet4Address::stateDestination, scopeID);
         }
-        inFamily->addAddress(addr);
+        // Another receive thread might have added the same address.
+        addr = inFamily->findOrAddAddress(addr);
     }
     m->setLocal(addr);
 
@@ -482,12 +546,9 @@ input(InetMessenger* m, Conduit* c)
     if (!addr)
     {
         Handle<Inet4Address> onLink;
-        if (IN_IS_ADDR_LOOPBACK(iphdr->src))
-        {
-            return false;
-        }
-        else if (IN_IS_ADDR_MULTICAST(iphdr->src))
+        if (IN_IS_ADDR_LOOPBACK(iphdr->src) || IN_IS_ADDR_MULTICAST(iphdr->src))
         {
+            InetStatistics::increment(InetStatistics::IpInDiscards);
             return false;
         }
         else if (onLink = inFamily->onLink(iphdr->src))
@@ -498,29 +559,25 @@ input(InetMessenger* m, Conduit* c)
         {
             addr = new Inet4Address(iphdr->src, Inet4Address::stateDestination, scopeID);
         }
-        inFamily->addAddress(addr);
+        addr = inFamily->findOrAddAddress(addr);
     }
     m->setRemote(addr);
 
     if (iphdr->getOffset() == 0 && !iphdr->moreFragments())
     {
         m->setType(iphdr->proto);
+        InetStatistics::increment(InetStatistics::IpInDelivers);
     }
     else
     {
         // RFC 1858
         if (iphdr->proto == IPPROTO_TCP && iphdr->getOffset() == 8)
         {
+            InetStatistics::increment(InetStatistics::IpInDiscards);
             return false;
         }
 
         m->setType(IPPROTO_FRAGMENT);
-        int id = iphdr->getId();
-        if (id == 0)
-        {
-            id = 65536;
-        }
-        m->setRemotePort(id);
     }
     m->savePosition();
     m->movePosition(iphdr->getHdrSize());
@@ -533,11 +590,13 @@ output(InetMessenger* m, Conduit* c)
 {
     Handle<Inet4Address> addr;
 
+    InetStatistics::increment(InetStatistics::IpOutRequests);
     long len = m->getLength();
     len += sizeof(IPHdr);
     if (65535 < len)
     {
         // XXX Return an error code to the upper layers.
+        InetStatistics::increment(InetStatistics::IpOutDiscards);
         return false;
     }
 
@@ -549,6 +608,12 @@ output(InetMessenger* m, Conduit* c)
     iphdr->tos = 0;
     iphdr->len = htons(len);    // octets in header and data
     iphdr->id = htons(++identification);
+    if (0 < m->getSegmentSize())
+    {
+        // Reserve the identifications for the rest of the segments of
+        // the large send super-segment.
+        identification += (len - 1) / m->getSegmentSize();
+    }
     iphdr->frag = 0;
     iphdr->ttl = 64;
     iphdr->proto = m->getType();
@@ -560,6 +625,7 @@ output(InetMessenger* m, Conduit* c)
     if (addr->isDeprecated())
     {
         // XXX Notify an error
+        InetStatistics::increment(InetStatistics::IpOutDiscards);
         return false;
     }
 
@@ -570,11 +636,12 @@ output(InetMessenger* m, Conduit* c)
     m->setType(AF_INET);
 
     int mtu = addr->getPathMTU();
-    if (mtu < m->getLength())
+    if (mtu < m->getLength() && m->getSegmentSize() == 0)
     {
         if (iphdr->dontFragment())
         {
             // XXX Notify an error
+            InetStatistics::increment(InetStatistics::IpOutDiscards);
             return false;
         }
 
@@ -641,6 +708,7 @@ fragment(const InetMessenger* m, int mtu, Address* nextHop)
     d->setLocal(addr);
 
     esReport("frag size = %d\n", frag->getSize());
+    InetStatistics::increment(InetStatistics::IpFragCreates);
     Visitor v(d);
     inFamily->scopeMux.accept(&v, &inFamily->inProtocol);
 
@@ -714,9 +782,11 @@ fragment(const InetMessenger* m, int mtu, Address* nextHop)
         d->setLocal(addr);
 
         esReport("frag size = %d\n", frag->getSize());
+        InetStatistics::increment(InetStatistics::IpFragCreates);
         Visitor v(d);
         inFamily->scopeMux.accept(&v, &inFamily->inProtocol);
 
         offset += len;
     }
+    InetStatistics::increment(InetStatistics::IpFragOKs);
 }
@@ -15,6 +15,7 @@
  * limitations under the License.
  */
 
+#include <es/interfaceTable.h>
 #include "inet4.h"
 #include "inet4address.h"
 
@@ -40,7 +41,9 @@ Inet4Address(InAddr addr, State& state, int scopeID, int prefix) :
     inFamily(0),
     adapter(0),
     timeoutCount(0),
-    pathMTU(1500)
+    pathMTU(1500),
+    nextHop(0),
+    routeGeneration(0)
 {
     ASSERT(0 <= prefix && prefix <= 32);
     u8 mac[6];
@@ -70,6 +73,10 @@ Inet4Address::
         inFamily->removeAddress(this);
         inFamily = 0;
     }
+    if (nextHop && nextHop != this)
+    {
+        nextHop->release();
+    }
 }
 
 void Inet4Address::
@@ -208,21 +215,7 @@ socket(int type, int protocol, int port)
 Object* Inet4Address::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::InternetAddress::iid()) == 0)
-    {
-        objectPtr = static_cast<es::InternetAddress*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::InternetAddress*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Inet4Address, es::InternetAddress>::query(this, riid);
 }
 
 unsigned int Inet4Address::
@@ -15,194 +15,353 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include "inet4.h"
-#include "visualizer.h"
+#include "inetStatistics.h"
 
-bool ReassReceiver::input(InetMessenger* m, Conduit* c)
-{
-    esReport("ReassReceiver::input\n");
+const long ReassReceiver::MEMORY_MAX(256 * 1024);
+const TimeSpan ReassReceiver::TIMEOUT(600000000LL);    // 60 sec
 
-    m->restorePosition();   // Back to IPHdr
-    IPHdr* frag = static_cast<IPHdr*>(m->fix(sizeof(IPHdr)));
+ReassReceiver::
+ReassReceiver(Protocol* inProtocol, Protocol* timeExceededProtocol) :
+    inProtocol(inProtocol),
+    timeExceededProtocol(timeExceededProtocol),
+    memory(0),
+    memoryMax(MEMORY_MAX),
+    scheduled(false),
+    reassembled(0),
+    timedOut(0),
+    evicted(0)
+{
+    monitor = es::Monitor::createInstance();
+}
 
-    if (!r)
+ReassReceiver::
+~ReassReceiver()
+{
+    if (scheduled)
     {
-        list = 0;
-        firstFragment[0] = 0;
-        setRemote(Handle<Address>(m->getRemote()));
-        setLocal(Handle<Address>(m->getLocal()));
-        setRemotePort(m->getRemotePort());
-
-        r = new InetMessenger(&InetReceiver::input, 65535); // XXX
-        Socket::alarm(this, 600000000LL);
-
-        memmove(r->fix(sizeof(IPHdr)), m->fix(sizeof(IPHdr)), sizeof(IPHdr));
-        Hole* hole = (Hole*) r->fix(sizeof(Hole), sizeof(IPHdr));
-        hole->first = 0;
-        hole->last  = 65535 - sizeof(IPHdr);
-        hole->next  = EOH;
-
-        Visualizer v;
-        inProtocol->accept(&v);
+        Socket::cancel(this);
+    }
+    while (Datagram* datagram = ageList.getFirst())
+    {
+        remove(datagram);
+        destroy(datagram);
     }
-    IPHdr* iphdr = static_cast<IPHdr*>(r->fix(sizeof(IPHdr)));
+    if (monitor)
+    {
+        monitor->release();
+    }
+}
 
-    int first = frag->getOffset();
-    int len = frag->getSize() - frag->getHdrSize();
-    int last = first + len - 1;
-    if (len <= 0 || (frag->moreFragments() && len % 8 != 0))
+int ReassReceiver::
+hash(Address* remote, Address* local, u16 id, u8 proto)
+{
+    u32 h = (u32) (reinterpret_cast<unsigned long>(remote) ^ (reinterpret_cast<unsigned long>(local) >> 4));
+    h ^= (id << 8 | proto) * 2654435761u;
+    h ^= h >> 16;
+    return h % HASH_SIZE;
+}
+
+ReassReceiver::Datagram* ReassReceiver::
+lookup(InetMessenger* m, IPHdr* iphdr)
+{
+    Handle<Address> remote = m->getRemote();
+    Handle<Address> local = m->getLocal();
+    u16 id = iphdr->getId();
+    DatagramList::Iterator iter = table[hash(remote, local, id, iphdr->proto)].begin();
+    while (Datagram* datagram = iter.next())
     {
-        r->release();
-        r = 0;
-        Socket::cancel(this);
+        if (datagram->id == id && datagram->proto == iphdr->proto &&
+            datagram->remote == remote && datagram->local == local)
+        {
+            return datagram;
+        }
+    }
+    return 0;
+}
 
-        // Uninstall this conduits
-        Uninstaller uninstaller(m);
-        adapter->accept(&uninstaller);
+ReassReceiver::Datagram* ReassReceiver::
+create(InetMessenger* m, IPHdr* iphdr)
+{
+    Datagram* datagram = new Datagram;
+    datagram->remote = m->getRemote();
+    datagram->local = m->getLocal();
+    datagram->id = iphdr->getId();
+    datagram->proto = iphdr->proto;
+    datagram->scopeID = m->getScopeID();
+    datagram->expiration = DateTime::getNow() + TIMEOUT;
+    datagram->fragments = 0;
+    datagram->received = 0;
+    datagram->total = -1;
+    datagram->size = sizeof(Datagram);
+    datagram->firstFragment[0] = 0;
 
-        return true;
+    table[hash(datagram->remote, datagram->local, datagram->id, datagram->proto)].addLast(datagram);
+    ageList.addLast(datagram);
+    memory += datagram->size;
+    schedule();
+    return datagram;
+}
+
+// Removes the datagram from the table.
+void ReassReceiver::
+remove(Datagram* datagram)
+{
+    table[hash(datagram->remote, datagram->local, datagram->id, datagram->proto)].remove(datagram);
+    ageList.remove(datagram);
+    memory -= datagram->size;
+}
+
+void ReassReceiver::
+destroy(Datagram* datagram)
+{
+    while (Fragment* fragment = datagram->fragments)
+    {
+        datagram->fragments = fragment->next;
+        delete[] reinterpret_cast<u8*>(fragment);
     }
+    datagram->remote->release();
+    datagram->local->release();
+    delete datagram;
+}
 
-    int offset = frag->getOffset();
-    if (offset == 0 && frag->getHdrSize() + 8 <= frag->getSize() && !firstFragment[0])
+// Drops the oldest datagrams other than keep until size bytes can be
+// allocated.
+bool ReassReceiver::
+reserve(long size, Datagram* keep)
+{
+    Datagram* next;
+    for (Datagram* datagram = ageList.getFirst();
+         datagram && memoryMax < memory + size;
+         datagram = next)
     {
-        memmove(firstFragment, frag, frag->getHdrSize() + 8);
-        // XXX Check the size of datagram
-        if (sizeof(IPHdr) < frag->getHdrSize())
+        next = datagram->ageLink.next;
+        if (datagram != keep)
         {
-            memmove((char*) iphdr + frag->getHdrSize(),
-                    (char*) iphdr + sizeof(IPHdr),
-                    iphdr->getSize() - sizeof(IPHdr));
-            memmove(iphdr, frag, frag->getHdrSize());
+            remove(datagram);
+            destroy(datagram);
+            ++evicted;
+            InetStatistics::increment(InetStatistics::IpReasmFails);
         }
     }
+    return memory + size <= memoryMax;
+}
 
-    // Update iphdr
-    if (iphdr->getSize() < iphdr->getHdrSize() + first + len)
+// Schedules the timer for the oldest datagram. The expiration time is
+// rounded up to the next second so that the datagrams expiring close
+// together are handled in a single run.
+void ReassReceiver::
+schedule()
+{
+    Datagram* oldest = ageList.getFirst();
+    if (scheduled || !oldest)
+    {
+        return;
+    }
+    s64 delay = (oldest->expiration - DateTime::getNow()).getTicks();
+    if (delay < 0)
     {
-        iphdr->setSize(iphdr->getHdrSize() + first + len);
+        delay = 0;
     }
+    delay += TimeSpan::TICKS_PER_SECOND - delay % TimeSpan::TICKS_PER_SECOND;
+    Socket::alarm(this, TimeSpan(delay));
+    scheduled = true;
+}
 
-    u16* next = &list;
-    while (*next != EOH)
+// Sends ICMP time exceeded on reassembly timeout [RFC 1122 MUST]
+void ReassReceiver::
+timeExceeded(Datagram* datagram)
+{
+    IPHdr* first = reinterpret_cast<IPHdr*>(datagram->firstFragment);
+    if (first->getVersion() != 4)   // Is the first fragment saved?
     {
-        Hole* hole = (Hole*) ((u8*) iphdr + iphdr->getHdrSize() + *next);
-        if (hole->last < first || last < hole->first)
-        {
-            next = &hole->next;
-            continue;
-        }
+        return;
+    }
 
-        u16 holeFirst = hole->first;
-        u16 holeLast = hole->last;
-        *next = hole->next; // Delete current hole
+    int len = first->getHdrSize() + 8;
+    int pos = 14 + 60 + sizeof(ICMPTimeExceeded);    // XXX Assume MAC, IPv4
+    Handle<InetMessenger> e = new InetMessenger(&InetReceiver::output, pos + len, pos);
 
-        if (holeFirst < first)
-        {
-            Hole* newHole = hole;
-            newHole->last = (u16) (first - 1);
+    memmove(e->fix(len), first, len);
+    e->setRemote(datagram->remote);
+    e->setLocal(datagram->local);
+    e->setType(ICMPTimeExceeded::FragmentTimeout);
+    Visitor v(e);
+    timeExceededProtocol->accept(&v, timeExceededProtocol->getB());
+}
 
-            *next = newHole->first;
-            next = &newHole->next;
+// Copies the fragments into a new messenger in a single pass.
+InetMessenger* ReassReceiver::
+assemble(Datagram* datagram)
+{
+    IPHdr* first = reinterpret_cast<IPHdr*>(datagram->firstFragment);
+    int hlen = first->getHdrSize();
+    InetMessenger* r = new InetMessenger(&InetReceiver::input, hlen + datagram->total);
 
-            offset = 0;
-        }
-        else // if (first <= holeFirst)
-        {
-            offset = holeFirst - first;
-        }
+    IPHdr* iphdr = static_cast<IPHdr*>(r->fix(hlen));
+    memmove(iphdr, first, hlen);
+    iphdr->setSize(hlen + datagram->total);
+    iphdr->frag = 0;
+    for (Fragment* fragment = datagram->fragments; fragment; fragment = fragment->next)
+    {
+        int len = fragment->end - fragment->first;
+        memmove(r->fix(len, hlen + fragment->first), fragment->getData(), len);
+    }
+
+    r->setLocal(datagram->local);
+    r->setRemote(datagram->remote);
+    r->setScopeID(datagram->scopeID);
+    r->setType(datagram->proto);
+    r->savePosition();
+    r->movePosition(hlen);
+    return r;
+}
+
+bool ReassReceiver::
+input(InetMessenger* m, Conduit* c)
+{
+    m->restorePosition();   // Back to IPHdr
+    IPHdr* frag = static_cast<IPHdr*>(m->fix(sizeof(IPHdr)));
+    int hlen = frag->getHdrSize();
+    int first = frag->getOffset();
+    int len = frag->getSize() - hlen;
+    int end = first + len;
+    bool more = frag->moreFragments();
 
-        if (last < holeLast)
+    InetStatistics::increment(InetStatistics::IpReasmReqds);
+    Handle<InetMessenger> r;
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        Datagram* datagram = lookup(m, frag);
+        if (len <= 0 || (more && len % 8 != 0) || 65535 - hlen < end)
         {
-            if (frag->moreFragments())
+            if (datagram)
             {
-                Hole* newHole = (Hole*) ((u8*) iphdr + iphdr->getHdrSize() + last + 1);
-                newHole->first = (u16) (last + 1);
-                newHole->last = holeLast;
-                newHole->next = *next;
-
-                *next = newHole->first;
-                next = &newHole->next;
+                remove(datagram);
+                destroy(datagram);
             }
-            else
+            InetStatistics::increment(InetStatistics::IpReasmFails);
+            return false;
+        }
+
+        long size = sizeof(Fragment) + len;
+        if (!datagram)
+        {
+            if (!reserve(sizeof(Datagram) + size, 0))
             {
-                *next = EOH;
+                InetStatistics::increment(InetStatistics::IpReasmFails);
+                return false;
             }
+            datagram = create(m, frag);
+        }
+        else if (!reserve(size, datagram))
+        {
+            InetStatistics::increment(InetStatistics::IpReasmFails);
+            return false;
+        }
+
+        // Find the position of the fragment.
+        Fragment** prev = &datagram->fragments;
+        while (*prev && (*prev)->end <= first)
+        {
+            prev = &(*prev)->next;
+        }
+        Fragment* next = *prev;
+        if (next && next->first == first && next->end == end)
+        {
+            return false;   // Duplicated
+        }
+        Fragment* tail = next;
+        while (tail && tail->next)
+        {
+            tail = tail->next;
         }
-        else // if (holeLast <= last)
+        if ((next && next->first < end) ||
+            (0 <= datagram->total && datagram->total < end) ||
+            (!more && 0 <= datagram->total && datagram->total != end) ||
+            (!more && tail))
         {
-            last = holeLast;
+            // Overlapping or inconsistent fragments discard the whole
+            // datagram. cf. RFC 5722
+            remove(datagram);
+            destroy(datagram);
+            InetStatistics::increment(InetStatistics::IpReasmFails);
+            return false;
         }
 
-        ASSERT(0 <= last - (first + offset) + 1);   // Teardrop check
-        memmove((u8*) iphdr + iphdr->getHdrSize() + first + offset,
-                (u8*) frag + frag->getHdrSize() + offset,
-                (u32) (last - (first + offset) + 1));
+        Fragment* fragment = reinterpret_cast<Fragment*>(new u8[size]);
+        fragment->first = (u16) first;
+        fragment->end = (u16) end;
+        memmove(fragment->getData(), m->fix(len, m->getPosition() + hlen), len);
+        fragment->next = next;
+        *prev = fragment;
+        datagram->received += len;
+        datagram->size += size;
+        memory += size;
+
+        if (first == 0)
+        {
+            memmove(datagram->firstFragment, frag, hlen + std::min(8, len));
+        }
+        if (!more)
+        {
+            datagram->total = end;
+        }
+
+        if (datagram->received == datagram->total)
+        {
+            r = assemble(datagram);
+            remove(datagram);
+            destroy(datagram);
+            ++reassembled;
+            InetStatistics::increment(InetStatistics::IpReasmOKs);
+            InetStatistics::increment(InetStatistics::IpInDelivers);
+        }
     }
 
-    if (list == EOH)
+    if (r)
     {
-        Socket::cancel(this);
-
-        // Send r
-        r->setSize(iphdr->getSize());
-        r->setLocal(Handle<Address>(getLocal()));
-        r->setRemote(Handle<Address>(getRemote()));
-        r->setType(iphdr->proto);
-        r->savePosition();
-        r->movePosition(iphdr->getHdrSize());
         Transporter v(r);
         inProtocol->getB()->accept(&v, inProtocol);
-
-        r->release();
-        r = 0;
-
-        // Uninstall this conduits
-        Uninstaller uninstaller(m);
-        adapter->accept(&uninstaller);
     }
-
-    return true;
+    return false;
 }
 
-// Running out of time.
-void ReassReceiver::run()
+// Expires the datagrams whose time has come.
+void ReassReceiver::
+run()
 {
-    IPHdr* header = reinterpret_cast<IPHdr*>(firstFragment);
-
-    // Time-to-live check (60 sec)
-    if (r)
+    AgeList expired;
     {
-        // Send ICMP time exceeded on reassembly timeout [RFC 1122 MUST]
-        IPHdr* first = reinterpret_cast<IPHdr*>(firstFragment);
-        if (first->getVersion() == 4)   // Is the first fragment saved?
+        Synchronized<es::Monitor*> method(monitor);
+
+        scheduled = false;
+        DateTime now = DateTime::getNow();
+        Datagram* datagram;
+        while ((datagram = ageList.getFirst()) && datagram->expiration <= now)
         {
-            int len = first->getHdrSize() + 8;
-            int pos = 14 + 60 + sizeof(ICMPTimeExceeded);    // XXX Assume MAC, IPv4
-            Handle<InetMessenger> e = new InetMessenger(&InetReceiver::output, pos + len, pos);
-
-            memmove(e->fix(len), first, len);
-            e->setRemote(Handle<Address>(getRemote()));
-            e->setLocal(Handle<Address>(getLocal()));
-            e->setType(ICMPTimeExceeded::FragmentTimeout);
-            Visitor v(e);
-            timeExceededProtocol->accept(&v, timeExceededProtocol->getB());
+            remove(datagram);
+            expired.addLast(datagram);
+            ++timedOut;
+            InetStatistics::increment(InetStatistics::IpReasmFails);
         }
-
-        r->release();
-        r = 0;
+        schedule();
     }
 
-    // Uninstall this conduits
-    Uninstaller uninstaller(this);
-    adapter->accept(&uninstaller);
+    while (Datagram* datagram = expired.removeFirst())
+    {
+        timeExceeded(datagram);
+        destroy(datagram);
+    }
 }
 
-// c is a pointer to a conduit factory.
-bool ReassFactoryReceiver::input(InetMessenger* m, Conduit* c)
+void ReassReceiver::
+setMemoryMax(long size)
 {
-    Installer installer(m);
-    Conduit* mux = c->getA();
-    mux->accept(&installer, mux->getA());
-    return false;
+    Synchronized<es::Monitor*> method(monitor);
+
+    memoryMax = size;
+    reserve(0, 0);
 }
@@ -15,9 +15,11 @@
  * limitations under the License.
  */
 
+#include <es/interfaceTable.h>
 #include <es/object.h>
 #include <es/naming/IBinding.h>
 #include "inetConfig.h"
+#include "inetStatistics.h"
 
 void InternetConfig::
 addAddress(es::InternetAddress* address, unsigned int prefix)
@@ -106,6 +108,43 @@ removeRouter(es::InternetAddress* router)
     }
 }
 
+bool InternetConfig::
+addRoute(es::InternetAddress* destination, unsigned int prefix, es::InternetAddress* router)
+{
+    int af = destination->getAddressFamily();
+    switch (af)
+    {
+    case AF_INET:
+        Inet4Address* dest = dynamic_cast<Inet4Address*>(destination);
+        Inet4Address* node = dynamic_cast<Inet4Address*>(router);
+        if (dest && node && prefix <= 32)
+        {
+            InFamily* inFamily = dynamic_cast<InFamily*>(Socket::getAddressFamily(AF_INET));
+            return inFamily->addRoute(dest->getAddress(), prefix, node);
+        }
+        break;
+    }
+    return false;
+}
+
+bool InternetConfig::
+removeRoute(es::InternetAddress* destination, unsigned int prefix)
+{
+    int af = destination->getAddressFamily();
+    switch (af)
+    {
+    case AF_INET:
+        Inet4Address* dest = dynamic_cast<Inet4Address*>(destination);
+        if (dest && prefix <= 32)
+        {
+            InFamily* inFamily = dynamic_cast<InFamily*>(Socket::getAddressFamily(AF_INET));
+            return inFamily->removeRoute(dest->getAddress(), prefix);
+        }
+        break;
+    }
+    return false;
+}
+
 int InternetConfig::
 addInterface(es::NetworkInterface* networkInterface)
 {
@@ -213,24 +252,16 @@ removeSearchDomain(const char* address)
     }
 }
 
+void InternetConfig::
+getStatistics(void* statistics)
+{
+    InetStatistics::get(static_cast<es::InternetStatistics*>(statistics));
+}
+
 Object* InternetConfig::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::InternetConfig::iid()) == 0)
-    {
-        objectPtr = static_cast<es::InternetConfig*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::InternetConfig*>(this);
-    }
-    else
-    {
-        return 0;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<InternetConfig, es::InternetConfig>::query(this, riid);
 }
 
 unsigned int InternetConfig::
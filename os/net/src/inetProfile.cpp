@@ -0,0 +1,168 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <es/synchronized.h>
+#include "inetProfile.h"
+
+bool InetProfile::enabled;
+es::Monitor* InetProfile::monitor;
+InetProfile::Block* InetProfile::blocks;
+__thread InetProfile::Block* InetProfile::local;
+__thread InetProfile::Sample* InetProfile::current;
+
+namespace
+{
+    const char* layerNames[InetProfile::LayerMax] =
+    {
+        "link",
+        "ipv4",
+        "udp",
+        "tcp",
+        "socket",
+        "other"
+    };
+}
+
+void InetProfile::
+enable(bool on)
+{
+    if (!monitor)
+    {
+        monitor = es::Monitor::createInstance();
+    }
+    enabled = on;
+}
+
+void InetProfile::
+reset()
+{
+    if (!monitor)
+    {
+        return;
+    }
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    for (Block* block = blocks; block; block = block->next)
+    {
+        memset(block->counters, 0, sizeof block->counters);
+    }
+}
+
+// Allocates the block of the current thread.
+InetProfile::Block* InetProfile::
+attach()
+{
+    ASSERT(monitor);
+    Block* block = new Block;
+    memset(block->counters, 0, sizeof block->counters);
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    block->next = blocks;
+    blocks = block;
+    local = block;
+    return block;
+}
+
+const char* InetProfile::
+getName(int layer)
+{
+    if (layer < 0 || LayerMax <= layer)
+    {
+        return 0;
+    }
+    return layerNames[layer];
+}
+
+unsigned long long InetProfile::
+getCalls(int layer)
+{
+    if (!monitor || layer < 0 || LayerMax <= layer)
+    {
+        return 0;
+    }
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    unsigned long long sum = 0;
+    for (Block* block = blocks; block; block = block->next)
+    {
+        sum += block->counters[layer].calls;
+    }
+    return sum;
+}
+
+s64 InetProfile::
+getTicks(int layer)
+{
+    if (!monitor || layer < 0 || LayerMax <= layer)
+    {
+        return 0;
+    }
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    s64 sum = 0;
+    for (Block* block = blocks; block; block = block->next)
+    {
+        sum += block->counters[layer].ticks;
+    }
+    return sum;
+}
+
+s64 InetProfile::
+getSelfTicks(int layer)
+{
+    if (!monitor || layer < 0 || LayerMax <= layer)
+    {
+        return 0;
+    }
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    s64 sum = 0;
+    for (Block* block = blocks; block; block = block->next)
+    {
+        sum += block->counters[layer].selfTicks;
+    }
+    return sum;
+}
+
+void InetProfile::
+report()
+{
+    const s64 ticksPerMicrosecond = TimeSpan::TICKS_PER_MILLISECOND / 1000;
+
+    esReport("%-8s %12s %12s %12s %14s\n", "layer", "calls", "usec", "self usec", "self nsec/call");
+    for (int i = 0; i < LayerMax; ++i)
+    {
+        unsigned long long calls = getCalls(i);
+        if (calls == 0)
+        {
+            continue;
+        }
+        s64 ticks = getTicks(i);
+        s64 selfTicks = getSelfTicks(i);
+        esReport("%-8s %12llu %12lld %12lld %14lld\n",
+                 layerNames[i], calls,
+                 (long long) (ticks / ticksPerMicrosecond),
+                 (long long) (selfTicks / ticksPerMicrosecond),
+                 (long long) (selfTicks * 100 / (s64) calls));
+    }
+}
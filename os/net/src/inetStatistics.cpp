@@ -0,0 +1,109 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <es/synchronized.h>
+#include "inetStatistics.h"
+
+es::Monitor* InetStatistics::monitor;
+InetStatistics::Block* InetStatistics::blocks;
+__thread InetStatistics::Block* InetStatistics::local;
+
+void InetStatistics::
+initialize()
+{
+    if (!monitor)
+    {
+        monitor = es::Monitor::createInstance();
+    }
+}
+
+// Allocates the block of the current thread.
+InetStatistics::Block* InetStatistics::
+attach()
+{
+    ASSERT(monitor);
+    Block* block = new Block;
+    memset(block->counts, 0, sizeof block->counts);
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    block->next = blocks;
+    blocks = block;
+    local = block;
+    return block;
+}
+
+unsigned long long InetStatistics::
+get(int counter)
+{
+    if (!monitor || counter < 0 || CounterMax <= counter)
+    {
+        return 0;
+    }
+
+    Synchronized<es::Monitor*> method(monitor);
+
+    unsigned long long sum = 0;
+    for (Block* block = blocks; block; block = block->next)
+    {
+        sum += block->counts[counter];
+    }
+    return sum;
+}
+
+void InetStatistics::
+get(es::InternetStatistics* statistics)
+{
+    unsigned long long counts[CounterMax];
+    memset(counts, 0, sizeof counts);
+    if (monitor)
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        for (Block* block = blocks; block; block = block->next)
+        {
+            for (int i = 0; i < CounterMax; ++i)
+            {
+                counts[i] += block->counts[i];
+            }
+        }
+    }
+
+    statistics->ipInReceives = counts[IpInReceives];
+    statistics->ipInHdrErrors = counts[IpInHdrErrors];
+    statistics->ipInDiscards = counts[IpInDiscards];
+    statistics->ipInDelivers = counts[IpInDelivers];
+    statistics->ipOutRequests = counts[IpOutRequests];
+    statistics->ipOutDiscards = counts[IpOutDiscards];
+    statistics->ipReasmReqds = counts[IpReasmReqds];
+    statistics->ipReasmOKs = counts[IpReasmOKs];
+    statistics->ipReasmFails = counts[IpReasmFails];
+    statistics->ipFragOKs = counts[IpFragOKs];
+    statistics->ipFragCreates = counts[IpFragCreates];
+    statistics->tcpActiveOpens = counts[TcpActiveOpens];
+    statistics->tcpPassiveOpens = counts[TcpPassiveOpens];
+    statistics->tcpInSegs = counts[TcpInSegs];
+    statistics->tcpInErrs = counts[TcpInErrs];
+    statistics->tcpOutSegs = counts[TcpOutSegs];
+    statistics->tcpRetransSegs = counts[TcpRetransSegs];
+    statistics->tcpOutRsts = counts[TcpOutRsts];
+    statistics->udpInDatagrams = counts[UdpInDatagrams];
+    statistics->udpNoPorts = counts[UdpNoPorts];
+    statistics->udpInErrors = counts[UdpInErrors];
+    statistics->udpOutDatagrams = counts[UdpOutDatagrams];
+}
@@ -0,0 +1,509 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <es/endian.h>
+#include <es/net/inet4.h>
+#include <es/net/inet6.h>
+#include <es/net/tcp.h>
+#include "interface.h"
+
+namespace
+{
+    s16 fold(s32 sum)
+    {
+        while (sum >> 16)
+        {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        return ~sum;
+    }
+
+    // FNV-1a
+    const u32 FNV_OFFSET_BASIS = 2166136261u;
+    const u32 FNV_PRIME = 16777619u;
+
+    u32 hashBytes(u32 hash, const void* data, long len)
+    {
+        const u8* ptr = static_cast<const u8*>(data);
+        while (0 < len--)
+        {
+            hash ^= *ptr++;
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    // Returns the one's complement sum of the bytes folded into 16 bits.
+    s32 sumBytes(const void* data, long len)
+    {
+        const u16* ptr = static_cast<const u16*>(data);
+        s32 sum = 0;
+        while (1 < len)
+        {
+            sum += *ptr++;
+            len -= 2;
+        }
+        if (0 < len)
+        {
+            sum += *reinterpret_cast<const u8*>(ptr);
+        }
+        while (sum >> 16)
+        {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        return sum;
+    }
+
+    // The TCP/IPv4 segment that can be coalesced with its neighbors.
+    struct Segment
+    {
+        const u8*       frame;
+        long            hlen;       // Link layer header size
+        const IPHdr*    iphdr;
+        const TCPHdr*   tcphdr;
+        long            hdrlen;     // Size of all the headers
+        long            payload;
+        s32             payloadSum;
+
+        // Checks the frame carries an error free TCP/IPv4 segment with
+        // data and without the flags other than ACK and PSH.
+        bool parse(NetworkInterface* interface, const u8* frame, long len)
+        {
+            int family;
+            this->frame = frame;
+            hlen = interface->getHeaderSize(frame, len, &family);
+            if (family != AF_INET || hlen < 0 ||
+                len < hlen + IPHdr::MinHdrSize + TCPHdr::MIN_HLEN)
+            {
+                return false;
+            }
+            iphdr = reinterpret_cast<const IPHdr*>(frame + hlen);
+            int iphlen = iphdr->getHdrSize();
+            if (iphdr->getVersion() != 4 || iphlen != IPHdr::MinHdrSize ||
+                iphdr->proto != IPPROTO_TCP ||
+                (ntohs(iphdr->frag) & (IPHdr::MoreFragments | IPHdr::FragmentOffset)) ||
+                len < hlen + iphdr->getSize() ||
+                fold(sumBytes(iphdr, iphlen)) != 0)
+            {
+                return false;
+            }
+            tcphdr = reinterpret_cast<const TCPHdr*>(frame + hlen + iphlen);
+            int tcphlen = tcphdr->getHdrSize();
+            u16 flag = ntohs(tcphdr->flag) & 0x0fff;
+            hdrlen = hlen + iphlen + tcphlen;
+            payload = iphdr->getSize() - iphlen - tcphlen;
+            if (tcphlen < TCPHdr::MIN_HLEN || payload <= 0 ||
+                (flag & ~TCPHdr::PSH) != TCPHdr::ACK)
+            {
+                return false;
+            }
+
+            payloadSum = sumBytes(frame + hdrlen, payload);
+            s32 sum = sumBytes(tcphdr, tcphlen) + payloadSum;
+            const u16* addr = reinterpret_cast<const u16*>(&iphdr->src);
+            for (int i = 0; i < 4; ++i)
+            {
+                sum += addr[i];     // src and dst
+            }
+            sum += htons(tcphlen + payload);
+            sum += ntohs(IPPROTO_TCP);
+            return fold(sum) == 0;
+        }
+
+        bool hasPush() const
+        {
+            return ntohs(tcphdr->flag) & TCPHdr::PSH;
+        }
+
+        // Checks next immediately follows this segment in the same flow
+        // with the same headers other than the sequence number and PSH.
+        bool precedes(const Segment& next) const
+        {
+            int tcphlen = tcphdr->getHdrSize();
+            return hdrlen == next.hdrlen &&
+                   memcmp(frame, next.frame, hlen) == 0 &&
+                   iphdr->tos == next.iphdr->tos &&
+                   memcmp(&iphdr->src, &next.iphdr->src, sizeof(InAddr) * 2) == 0 &&
+                   tcphdr->src == next.tcphdr->src &&
+                   tcphdr->dst == next.tcphdr->dst &&
+                   (u32) (ntohl(tcphdr->seq) + payload) == (u32) ntohl(next.tcphdr->seq) &&
+                   tcphdr->ack == next.tcphdr->ack &&
+                   tcphdr->win == next.tcphdr->win &&
+                   memcmp(tcphdr + 1, next.tcphdr + 1, tcphlen - sizeof(TCPHdr)) == 0;
+        }
+    };
+}
+
+NetworkInterface::ReceiveQueue::
+ReceiveQueue(NetworkInterface* interface) :
+    interface(interface),
+    head(0),
+    used(0),
+    dropped(0),
+    coalesced(0)
+{
+    monitor = es::Monitor::createInstance();
+    thread = esCreateThread(run, this);
+    thread->setPriority(es::Thread::Highest);
+    thread->start();
+}
+
+// Called by the receive thread of the interface.
+bool NetworkInterface::ReceiveQueue::
+push(const void* frame, int len)
+{
+    monitor->lock();
+    if (LENGTH <= used)
+    {
+        ++dropped;
+        monitor->unlock();
+        return false;
+    }
+    Frame* f = &frames[(head + used) % LENGTH];
+    memmove(f->data, frame, len);
+    f->len = len;
+    if (used++ == 0)
+    {
+        monitor->notify();
+    }
+    monitor->unlock();
+    return true;
+}
+
+// Merges the in-order segments of a flow that come one after another
+// from frames[first] into m, and processes m, so that the TCP input copies
+// them in, wakes up the reader, and acknowledges them only once. Each
+// segment is checked before it is merged, and the merged segment gets a
+// new IP header sum and TCP sum; the partial sum of its payload is set to
+// m so that the payload is not summed up again. Returns the number of the
+// frames processed, or zero if the first frame is to be processed by itself.
+int NetworkInterface::ReceiveQueue::
+coalesce(int first, int count, InetMessenger* m)
+{
+    Segment front;
+    Frame* f = &frames[first % LENGTH];
+    if (count < 2 || !front.parse(interface, f->data, f->len) || front.hasPush())
+    {
+        return 0;
+    }
+
+    Segment last = front;
+    Segment next;
+    long payload = front.payload;
+    s32 payloadSum = front.payloadSum;
+    int n;
+    for (n = 1; n < count; ++n)
+    {
+        // Keep the payload of the merged segments 16-bit aligned for the sum.
+        if (last.hasPush() || (last.payload & 1))
+        {
+            break;
+        }
+        f = &frames[(first + n) % LENGTH];
+        if (!next.parse(interface, f->data, f->len) || !last.precedes(next) ||
+            65535 < front.iphdr->getHdrSize() + front.tcphdr->getHdrSize() + payload + next.payload)
+        {
+            break;
+        }
+        payload += next.payload;
+        payloadSum += next.payloadSum;
+        last = next;
+    }
+    if (n < 2)
+    {
+        return 0;
+    }
+
+    // Copy the headers of the first segment and the payloads. The headers
+    // of all the merged segments are of the same size.
+    u8* ptr = static_cast<u8*>(m->fix(front.hdrlen + payload));
+    memmove(ptr, front.frame, front.hdrlen);
+    long offset = front.hdrlen;
+    for (int i = 0; i < n; ++i)
+    {
+        f = &frames[(first + i) % LENGTH];
+        const IPHdr* iphdr = reinterpret_cast<const IPHdr*>(f->data + front.hlen);
+        long len = iphdr->getSize() - (front.hdrlen - front.hlen);
+        memmove(ptr + offset, f->data + front.hdrlen, len);
+        offset += len;
+    }
+
+    IPHdr* ip = reinterpret_cast<IPHdr*>(ptr + front.hlen);
+    int iphlen = ip->getHdrSize();
+    TCPHdr* tcp = reinterpret_cast<TCPHdr*>(ptr + front.hlen + iphlen);
+    int tcphlen = tcp->getHdrSize();
+    ip->setSize(iphlen + tcphlen + payload);
+    ip->sum = 0;
+    ip->sum = fold(sumBytes(ip, iphlen));
+
+    tcp->flag = last.tcphdr->flag;  // PSH
+    tcp->sum = 0;
+    while (payloadSum >> 16)
+    {
+        payloadSum = (payloadSum & 0xffff) + (payloadSum >> 16);
+    }
+    s32 sum = sumBytes(tcp, tcphlen) + payloadSum;
+    u16* addr = reinterpret_cast<u16*>(&ip->src);
+    for (int i = 0; i < 4; ++i)
+    {
+        sum += addr[i];     // src and dst
+    }
+    sum += htons(tcphlen + payload);
+    sum += ntohs(IPPROTO_TCP);
+    tcp->sum = fold(sum);
+    m->setPayloadSum(payloadSum, payload);
+    interface->process(m, front.hdrlen + payload);
+
+    coalesced += n - 1;
+    return n;
+}
+
+// Processes the queued frames in batches. The frames of a batch stay in
+// the queue while they are processed without the lock, as push() only
+// writes to the free slots.
+void* NetworkInterface::ReceiveQueue::
+work()
+{
+    Handle<InetMessenger> m = new InetMessenger(&InetReceiver::input, MRU);
+    Handle<InetMessenger> large = new InetMessenger(&InetReceiver::input, LARGE_SIZE);
+    for (;;)
+    {
+        monitor->lock();
+        while (used == 0)
+        {
+            monitor->wait();
+        }
+        int first = head;
+        int count = used;
+        monitor->unlock();
+
+        for (int i = 0; i < count; )
+        {
+            if (interface->coalescing)
+            {
+                int n = coalesce(first + i, count - i, large);
+                if (0 < n)
+                {
+                    i += n;
+                    continue;
+                }
+            }
+            Frame* f = &frames[(first + i) % LENGTH];
+            memmove(m->fix(f->len), f->data, f->len);
+            interface->process(m, f->len);
+            ++i;
+        }
+
+        monitor->lock();
+        head = (head + count) % LENGTH;
+        used -= count;
+        monitor->unlock();
+    }
+    return 0;
+}
+
+void* NetworkInterface::ReceiveQueue::
+run(void* param)
+{
+    ReceiveQueue* queue = static_cast<ReceiveQueue*>(param);
+    return queue->work();
+}
+
+void NetworkInterface::
+setQueueCount(int count)
+{
+    count = std::min(std::max(1, count), static_cast<int>(QUEUE_MAX));
+    if (1 < count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (!queues[i])
+            {
+                queues[i] = new ReceiveQueue(this);
+            }
+        }
+    }
+    queueCount = count;
+}
+
+void NetworkInterface::
+setCoalescing(bool on)
+{
+    if (on && !queues[0])
+    {
+        queues[0] = new ReceiveQueue(this);
+    }
+    coalescing = on;
+}
+
+unsigned int NetworkInterface::
+getCoalesced() const
+{
+    unsigned int count = 0;
+    for (int i = 0; i < QUEUE_MAX; ++i)
+    {
+        if (queues[i])
+        {
+            count += queues[i]->getCoalesced();
+        }
+    }
+    return count;
+}
+
+unsigned int NetworkInterface::
+getQueueDropped() const
+{
+    unsigned int dropped = 0;
+    for (int i = 0; i < QUEUE_MAX; ++i)
+    {
+        if (queues[i])
+        {
+            dropped += queues[i]->getDropped();
+        }
+    }
+    return dropped;
+}
+
+u32 NetworkInterface::
+hash(const u8* frame, long len)
+{
+    int family;
+    long hlen = getHeaderSize(frame, len, &family);
+    if (hlen < 0 || len <= hlen)
+    {
+        return 0;
+    }
+    const u8* packet = frame + hlen;
+    len -= hlen;
+
+    u32 hash = FNV_OFFSET_BASIS;
+    int proto;
+    const u8* ports;
+    switch (family)
+    {
+      case AF_INET:
+      {
+        if (len < IPHdr::MinHdrSize)
+        {
+            return 0;
+        }
+        const IPHdr* iphdr = reinterpret_cast<const IPHdr*>(packet);
+        int iphlen = iphdr->getHdrSize();
+        proto = iphdr->proto;
+        hash = hashBytes(hash, &iphdr->src, sizeof(InAddr) * 2);
+        hash = hashBytes(hash, &iphdr->proto, sizeof iphdr->proto);
+        if (ntohs(iphdr->frag) & (IPHdr::MoreFragments | IPHdr::FragmentOffset))
+        {
+            return hash;
+        }
+        ports = packet + iphlen;
+        len -= iphlen;
+        break;
+      }
+      case AF_INET6:
+      {
+        if (len < static_cast<long>(sizeof(IP6Hdr)))
+        {
+            return 0;
+        }
+        const IP6Hdr* ip6hdr = reinterpret_cast<const IP6Hdr*>(packet);
+        proto = ip6hdr->next;
+        hash = hashBytes(hash, &ip6hdr->src, sizeof(In6Addr) * 2);
+        hash = hashBytes(hash, &ip6hdr->next, sizeof ip6hdr->next);
+        ports = packet + sizeof(IP6Hdr);
+        len -= sizeof(IP6Hdr);
+        break;
+      }
+      default:
+        return 0;
+    }
+
+    // The source and destination ports of TCP and UDP come first.
+    if ((proto == IPPROTO_TCP || proto == IPPROTO_UDP) && 4 <= len)
+    {
+        hash = hashBytes(hash, ports, 4);
+    }
+    return hash;
+}
+
+// Software segmentation of the large send super-segment. Each segment
+// gets a copy of the link, IP, and TCP headers of the super-segment,
+// of which the IP total length, the IP identification, the TCP sequence
+// number, the TCP flags, and the sums are fixed up. FIN and PSH are only
+// set to the last segment.
+int NetworkInterface::
+segment(InetMessenger* m, long hlen, es::Stream* stream)
+{
+    long len = m->getLength();
+    u8* frame = static_cast<u8*>(m->fix(len));
+    IPHdr* iphdr = reinterpret_cast<IPHdr*>(frame + hlen);
+    int iphlen = iphdr->getHdrSize();
+    TCPHdr* tcphdr = reinterpret_cast<TCPHdr*>(frame + hlen + iphlen);
+    int tcphlen = tcphdr->getHdrSize();
+    long hdrlen = hlen + iphlen + tcphlen;
+    long payload = iphdr->getSize() - iphlen - tcphlen;
+    long segmentSize = m->getSegmentSize();
+    ASSERT(iphdr->proto == IPPROTO_TCP);
+    ASSERT(0 < segmentSize);
+
+    u16 id = iphdr->getId();
+    TCPSeq seq = ntohl(tcphdr->seq);
+    u16 flag = ntohs(tcphdr->flag);
+
+    Messenger seg(hdrlen + segmentSize);
+    u8* ptr = static_cast<u8*>(seg.fix(hdrlen + segmentSize));
+    memmove(ptr, frame, hdrlen);
+    IPHdr* ip = reinterpret_cast<IPHdr*>(ptr + hlen);
+    TCPHdr* tcp = reinterpret_cast<TCPHdr*>(ptr + hlen + iphlen);
+    for (long offset = 0; offset < payload; offset += segmentSize)
+    {
+        long count = std::min(segmentSize, payload - offset);
+        memmove(ptr + hdrlen, frame + hdrlen + offset, count);
+
+        ip->setSize(iphlen + tcphlen + count);
+        ip->id = htons(id++);
+        ip->sum = 0;
+        seg.setPosition(hlen);
+        ip->sum = fold(seg.sumUp(iphlen));
+
+        tcp->seq = htonl(seq + offset);
+        if (offset + count < payload)
+        {
+            tcp->flag = htons(flag & ~(TCPHdr::FIN | TCPHdr::PSH));
+        }
+        else
+        {
+            tcp->flag = htons(flag);
+        }
+        tcp->sum = 0;
+        seg.setPosition(hlen + iphlen);
+        s32 sum = seg.sumUp(tcphlen + count);
+        u16* addr = reinterpret_cast<u16*>(&ip->src);
+        for (int i = 0; i < 4; ++i)
+        {
+            sum += addr[i];     // src and dst
+        }
+        sum += htons(tcphlen + count);
+        sum += ntohs(IPPROTO_TCP);
+        tcp->sum = fold(sum);
+
+        stream->write(ptr, hdrlen + count);
+    }
+    return len;
+}
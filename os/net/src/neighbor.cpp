@@ -0,0 +1,345 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <es/net/arp.h>
+#include "inet4.h"
+#include "neighbor.h"
+
+const TimeSpan NeighborCache::REACHABLE_TIME(20 * 60 * 10000000LL);  // 20 min
+
+NeighborCache::
+NeighborCache() :
+    size(0),
+    lookups(0),
+    misses(0),
+    held(0),
+    dropped(0),
+    requests(0),
+    probes(0),
+    announcements(0),
+    runs(0)
+{
+    monitor = es::Monitor::createInstance();
+}
+
+NeighborCache::
+~NeighborCache()
+{
+    if (next != DateTime())
+    {
+        Socket::cancel(this);
+    }
+    for (int i = 0; i < HASH_SIZE; ++i)
+    {
+        while (Neighbor* neighbor = table[i].removeFirst())
+        {
+            purge(neighbor);
+            neighbor->address->release();
+            delete neighbor;
+        }
+    }
+    if (monitor)
+    {
+        monitor->release();
+    }
+}
+
+int NeighborCache::
+hash(InAddr addr, int scopeID)
+{
+    u32 h = (addr.addr ^ scopeID) * 2654435761u;
+    h ^= h >> 16;
+    return h % HASH_SIZE;
+}
+
+NeighborCache::Neighbor* NeighborCache::
+find(InAddr addr, int scopeID)
+{
+    NeighborList::Iterator iter = table[hash(addr, scopeID)].begin();
+    while (Neighbor* neighbor = iter.next())
+    {
+        if (IN_ARE_ADDR_EQUAL(neighbor->address->getAddress(), addr) &&
+            neighbor->address->getScopeID() == scopeID)
+        {
+            return neighbor;
+        }
+    }
+    return 0;
+}
+
+void NeighborCache::
+purge(Neighbor* neighbor)
+{
+    while (0 < neighbor->count)
+    {
+        neighbor->pending[neighbor->head]->release();
+        neighbor->head = (neighbor->head + 1) % PENDING_MAX;
+        --neighbor->count;
+        ++dropped;
+    }
+}
+
+// Schedules the timer for the expiration unless it is scheduled earlier.
+// The time is rounded up to the next second so that the entries due close
+// together are handled in a single run.
+void NeighborCache::
+schedule(DateTime expiration)
+{
+    DateTime now = DateTime::getNow();
+    s64 delay = (expiration - now).getTicks();
+    if (delay < 0)
+    {
+        delay = 0;
+    }
+    delay += TimeSpan::TICKS_PER_SECOND - delay % TimeSpan::TICKS_PER_SECOND;
+    expiration = now + TimeSpan(delay);
+    if (next != DateTime())
+    {
+        if (next <= expiration)
+        {
+            return;
+        }
+        Socket::cancel(this);
+    }
+    Socket::alarm(this, TimeSpan(delay));
+    next = expiration;
+}
+
+void NeighborCache::
+add(Inet4Address* address)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    if (find(address->getAddress(), address->getScopeID()))
+    {
+        return;
+    }
+    Neighbor* neighbor = new Neighbor;
+    address->addRef();
+    neighbor->address = address;
+    neighbor->head = 0;
+    neighbor->count = 0;
+    table[hash(address->getAddress(), address->getScopeID())].addLast(neighbor);
+    ++size;
+}
+
+void NeighborCache::
+remove(Inet4Address* address)
+{
+    Neighbor* neighbor;
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        neighbor = find(address->getAddress(), address->getScopeID());
+        if (!neighbor || neighbor->address != address)
+        {
+            return;
+        }
+        table[hash(address->getAddress(), address->getScopeID())].remove(neighbor);
+        --size;
+        purge(neighbor);
+    }
+    neighbor->address->release();
+    delete neighbor;
+}
+
+Inet4Address* NeighborCache::
+lookup(InAddr addr, int scopeID)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    ++lookups;
+    Neighbor* neighbor = find(addr, scopeID);
+    if (!neighbor)
+    {
+        ++misses;
+        return 0;
+    }
+    neighbor->address->addRef();
+    return neighbor->address;
+}
+
+bool NeighborCache::
+hold(Inet4Address* address, InetMessenger* m)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    Neighbor* neighbor = find(address->getAddress(), address->getScopeID());
+    if (!neighbor)
+    {
+        ++dropped;
+        return false;
+    }
+    if (neighbor->count == PENDING_MAX)
+    {
+        // Drop the oldest packet. [RFC 1122]
+        neighbor->pending[neighbor->head]->release();
+        neighbor->head = (neighbor->head + 1) % PENDING_MAX;
+        --neighbor->count;
+        ++dropped;
+    }
+    m->addRef();
+    neighbor->pending[(neighbor->head + neighbor->count) % PENDING_MAX] = m;
+    ++neighbor->count;
+    ++held;
+    return true;
+}
+
+InetMessenger* NeighborCache::
+retrieve(Inet4Address* address)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    Neighbor* neighbor = find(address->getAddress(), address->getScopeID());
+    if (!neighbor || neighbor->count == 0)
+    {
+        return 0;
+    }
+    InetMessenger* m = neighbor->pending[neighbor->head];
+    neighbor->head = (neighbor->head + 1) % PENDING_MAX;
+    --neighbor->count;
+    return m;
+}
+
+void NeighborCache::
+purge(Inet4Address* address)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    Neighbor* neighbor = find(address->getAddress(), address->getScopeID());
+    if (neighbor)
+    {
+        purge(neighbor);
+    }
+}
+
+void NeighborCache::
+defer(Inet4Address* address, TimeSpan delay)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    Neighbor* neighbor = find(address->getAddress(), address->getScopeID());
+    if (neighbor)
+    {
+        neighbor->expiration = DateTime::getNow() + delay;
+        schedule(neighbor->expiration);
+    }
+}
+
+void NeighborCache::
+cancel(Inet4Address* address)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    Neighbor* neighbor = find(address->getAddress(), address->getScopeID());
+    if (neighbor)
+    {
+        neighbor->expiration = DateTime();
+    }
+}
+
+void NeighborCache::
+send(Inet4Address* address, InetMessenger* m)
+{
+    static const u8 zero[6] = { 0, 0, 0, 0, 0, 0 };
+
+    Conduit* adapter = address->getAdapter();
+    if (!adapter)
+    {
+        return;
+    }
+
+    ARPHdr* arphdr = static_cast<ARPHdr*>(m->fix(sizeof(ARPHdr)));
+    if (ntohs(arphdr->op) == ARPHdr::OP_REQUEST)
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        if (IN_ARE_ADDR_EQUAL(arphdr->spa, arphdr->tpa))
+        {
+            ++announcements;
+        }
+        else if (IN_IS_ADDR_UNSPECIFIED(arphdr->spa) || memcmp(arphdr->tha, zero, 6) != 0)
+        {
+            ++probes;
+        }
+        else
+        {
+            ++requests;
+        }
+    }
+
+    Visitor v(m);
+    adapter->accept(&v);
+}
+
+// Runs the expired() handlers of the entries whose time has come, up to
+// BATCH_MAX entries at a time.
+void NeighborCache::
+run()
+{
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        next = DateTime();
+        ++runs;
+    }
+
+    Inet4Address* due[BATCH_MAX];
+    int count;
+    do
+    {
+        count = 0;
+        {
+            Synchronized<es::Monitor*> method(monitor);
+
+            DateTime now = DateTime::getNow();
+            DateTime earliest;
+            for (int i = 0; i < HASH_SIZE; ++i)
+            {
+                NeighborList::Iterator iter = table[i].begin();
+                while (Neighbor* neighbor = iter.next())
+                {
+                    if (neighbor->expiration == DateTime())
+                    {
+                        continue;
+                    }
+                    if (neighbor->expiration <= now && count < BATCH_MAX)
+                    {
+                        neighbor->expiration = DateTime();
+                        neighbor->address->addRef();
+                        due[count++] = neighbor->address;
+                    }
+                    else if (earliest == DateTime() || neighbor->expiration < earliest)
+                    {
+                        earliest = neighbor->expiration;
+                    }
+                }
+            }
+            if (count < BATCH_MAX && earliest != DateTime())
+            {
+                schedule(earliest);
+            }
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            due[i]->run();
+            due[i]->release();
+        }
+    } while (count == BATCH_MAX);
+}
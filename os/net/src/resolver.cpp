@@ -15,8 +15,12 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <es/interfaceTable.h>
 #include "resolver.h"
 
+const u32 Resolver::MaxTtl;
+
 int Resolver::
 Control::a(u16 id, const char* hostName)
 {
@@ -116,6 +120,7 @@ Control::ptr(u16 id, InAddr addr)
 es::InternetAddress* Resolver::
 Control::resolve(const char* hostName)
 {
+    ttl = 0;
     u16 xid = id.increment();
     int len = a(xid, hostName);
     if (len <= 0)
@@ -140,21 +145,10 @@ Control::resolve(const char* hostName)
             continue;
         }
 
-        if (dns->getResponseCode() != DNSHdr::NoError)
-        {
-            // switch search domain / nameserver, do not retransmit
-            return 0;
-        }
-
-        if (ntohs(dns->ancount) == 0)
-        {
-            continue;
-        }
-
         u8* opt = response + sizeof(DNSHdr);
         u8* end = response + rlen;
         opt = skipName(opt, end);
-        if (end < opt + 4)
+        if (!opt || end < opt + 4)
         {
             continue;
         }
@@ -167,6 +161,19 @@ Control::resolve(const char* hostName)
             continue;
         }
 
+        if (dns->getResponseCode() == DNSHdr::NameError ||
+            dns->getResponseCode() == DNSHdr::NoError && ntohs(dns->ancount) == 0)
+        {
+            // The name or the address does not exist.
+            ttl = getNegativeTtl(opt, end);
+            return 0;
+        }
+        if (dns->getResponseCode() != DNSHdr::NoError)
+        {
+            // switch search domain / nameserver, do not retransmit
+            return 0;
+        }
+
         for (int i = 0; i < ntohs(dns->ancount); ++i)
         {
             opt = skipName(opt, end);
@@ -189,12 +196,58 @@ Control::resolve(const char* hostName)
             }
             InAddr addr = *reinterpret_cast<InAddr*>(opt + DNSRR::Size);
             es::InternetAddress* host = Socket::resolver->getHostByAddress(&addr.addr, sizeof(InAddr), 0);
+            ttl = std::min(ntohl(rr->ttl), MaxTtl);
             return host;
         }
     }
     return 0;
 }
 
+// Gets the TTL of the negative answer in response from the SOA record in
+// its authority section [RFC 2308]. ptr points to the answer section.
+// Returns zero if the answer must not be cached.
+u32 Resolver::
+Control::getNegativeTtl(const u8* ptr, const u8* end)
+{
+    DNSHdr* dns = reinterpret_cast<DNSHdr*>(response);
+    int ancount = ntohs(dns->ancount);
+    int count = ancount + ntohs(dns->nscount);
+    for (int i = 0; i < count; ++i)
+    {
+        ptr = skipName(ptr, end);
+        if (!ptr || end - ptr < DNSRR::Size)
+        {
+            return 0;
+        }
+        const DNSRR* rr = reinterpret_cast<const DNSRR*>(ptr);
+        const u8* rdata = ptr + DNSRR::Size;
+        ptr = rdata + ntohs(rr->rdlength);
+        if (end < ptr)
+        {
+            return 0;
+        }
+        if (i < ancount || ntohs(rr->type) != DNSType::SOA)
+        {
+            continue;
+        }
+
+        // MNAME and RNAME are followed by SERIAL, REFRESH, RETRY, EXPIRE,
+        // and MINIMUM.
+        const u8* field = skipName(rdata, ptr);
+        if (field)
+        {
+            field = skipName(field, ptr);
+        }
+        if (!field || ptr - field < 20)
+        {
+            return 0;
+        }
+        u32 minimum = ntohl(*reinterpret_cast<const u32*>(field + 16));
+        return std::min(std::min(ntohl(rr->ttl), minimum), MaxTtl);
+    }
+    return 0;
+}
+
 u8* Resolver::
 Control::skipName(const u8* ptr, const u8* end)
 {
@@ -264,7 +317,8 @@ Control::copyName(const u8* dns, const u8* ptr, const u8* end, char* name)
 
 Resolver::
 Control::Control(es::InternetAddress* server) :
-    server(server)
+    server(server),
+    ttl(0)
 {
     memset(suffix, 0, sizeof suffix);
 
@@ -282,6 +336,7 @@ Control::~Control()
 es::InternetAddress* Resolver::
 Control::getHostByName(const char* hostName, int addressFamily)
 {
+    ttl = 0;
     if (!hostName)
     {
         return 0;
@@ -315,14 +370,20 @@ Control::getHostByName(const char* hostName, int addressFamily)
         // or append each search domain to hostname
         else
         {
-            for (int domainCount=0; Socket::config->getSearchDomain(suffix,sizeof suffix,domainCount) &&
+            // The name is known not to exist only if it does not exist
+            // in any of the search domains.
+            u32 negative = MaxTtl;
+            int domainCount;
+            for (domainCount=0; Socket::config->getSearchDomain(suffix,sizeof suffix,domainCount) &&
                     domainCount < MaxSearch; domainCount++ )
             {
                 if (host = resolve(hostName))
                 {
                     return host;
                 }
+                negative = std::min(negative, ttl);
             }
+            ttl = (0 < domainCount) ? negative : 0;
         }
 
     return 0;
@@ -333,6 +394,7 @@ Control::getHostName(es::InternetAddress* address, char* hostName, unsigned int
 {
     InAddr addr;
 
+    ttl = 0;
     if (nlen < DNSHdr::NameMax)
     {
         return false;
@@ -362,15 +424,14 @@ Control::getHostName(es::InternetAddress* address, char* hostName, unsigned int
         DNSHdr* dns = reinterpret_cast<DNSHdr*>(response);
         if (dns->getID() != xid ||
             !dns->isResponse() ||
-            ntohs(dns->qdcount) != 1 ||
-            ntohs(dns->ancount) == 0)
+            ntohs(dns->qdcount) != 1)
         {
             continue;
         }
         u8* opt = response + sizeof(DNSHdr);
         u8* end = response + rlen;
         opt = skipName(opt, end);
-        if (end < opt + 4)
+        if (!opt || end < opt + 4)
         {
             continue;
         }
@@ -383,29 +444,42 @@ Control::getHostName(es::InternetAddress* address, char* hostName, unsigned int
             continue;
         }
 
+        if (dns->getResponseCode() == DNSHdr::NameError ||
+            dns->getResponseCode() == DNSHdr::NoError && ntohs(dns->ancount) == 0)
+        {
+            ttl = getNegativeTtl(opt, end);
+            return false;
+        }
+        if (dns->getResponseCode() != DNSHdr::NoError)
+        {
+            return false;
+        }
+
         for (int i = 0; i < ntohs(dns->ancount); ++i)
         {
             opt = skipName(opt, end);
-            if (end - opt < sizeof(DNSRR))
+            if (!opt || end - opt < DNSRR::Size)
             {
-                continue;
+                break;
             }
             DNSRR* rr = reinterpret_cast<DNSRR*>(opt);
+            if (end < opt + DNSRR::Size + ntohs(rr->rdlength))
+            {
+                break;
+            }
             if (ntohs(rr->type) != DNSType::PTR ||
                 ntohs(rr->cls) != DNSClass::IN)
             {
+                // Realign opt with next RR
+                opt += DNSRR::Size + ntohs(rr->rdlength);
                 continue;
             }
 
-            if (end < opt + DNSRR::Size + ntohs(rr->rdlength))
-            {
-                break;
-            }
-
             if (!copyName(response, opt + DNSRR::Size, end, hostName))
             {
                 break;
             }
+            ttl = std::min(ntohl(rr->ttl), MaxTtl);
             return true;
         }
     }
@@ -413,53 +487,301 @@ Control::getHostName(es::InternetAddress* address, char* hostName, unsigned int
     return false;
 }
 
-bool Resolver::
-setup()
+Resolver::Control* Resolver::
+getControl()
 {
     Handle<es::InternetAddress> nameServer = Socket::config->getNameServer();
     if (!nameServer)
     {
-        if (control)
+        return 0;
+    }
+
+    ControlList list;
+    Control* control;
+    monitor->lock();
+    while ((control = controls.removeFirst()))
+    {
+        --controlCount;
+        if (control->isServer(nameServer))
         {
-            delete control;
-            control = 0;
+            break;
         }
-        return false;
+        // The name server has been changed.
+        list.addLast(control);
     }
+    monitor->unlock();
+
+    while (Control* stale = list.removeFirst())
+    {
+        delete stale;
+    }
+    if (!control)
+    {
+        control = new Control(nameServer);
+    }
+    return control;
+}
+
+void Resolver::
+putControl(Control* control)
+{
+    monitor->lock();
+    if (controlCount < MaxControl)
+    {
+        controls.addFirst(control);
+        ++controlCount;
+        control = 0;
+    }
+    monitor->unlock();
 
     if (control)
     {
-        return true;
+        delete control;
     }
+}
 
-    control = new Control(nameServer);
-    return true;
+// Copies name into key in lower case, as DNS names are case insensitive.
+bool Resolver::
+makeKey(const char* name, char* key)
+{
+    for (int i = 0; i < DNSHdr::NameMax; ++i)
+    {
+        char c = name[i];
+        if ('A' <= c && c <= 'Z')
+        {
+            c += 'a' - 'A';
+        }
+        key[i] = c;
+        if (c == '\0')
+        {
+            return 0 < i;
+        }
+    }
+    return false;
 }
 
-es::InternetAddress* Resolver::
-getHostByName(const char* hostName, int addressFamily)
+u32 Resolver::
+hash(u16 type, const char* key)
+{
+    u32 h = type;
+    while (*key)
+    {
+        h = 31 * h + (u8) *key++;
+    }
+    return h;
+}
+
+// Must be called with the monitor locked.
+Resolver::Entry* Resolver::
+find(u16 type, const char* key)
+{
+    EntryList& list(cache[hash(type, key) % CacheHashSize]);
+    Entry* entry;
+    EntryList::Iterator iter = list.begin();
+    while ((entry = iter.next()))
+    {
+        if (entry->type == type && strcmp(entry->name, key) == 0)
+        {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+// Removes the expired entries, or if there is none, an arbitrary answered
+// entry to make room for a new one. Must be called with the monitor locked.
+void Resolver::
+evict()
+{
+    DateTime now = DateTime::getNow();
+    Entry* victim = 0;
+    for (int i = 0; i < CacheHashSize; ++i)
+    {
+        Entry* entry;
+        EntryList::Iterator iter = cache[i].begin();
+        while ((entry = iter.next()))
+        {
+            if (entry->pending)
+            {
+                continue;
+            }
+            if (entry->expiration <= now)
+            {
+                iter.remove();
+                delete entry;
+                --cacheCount;
+            }
+            else if (!victim)
+            {
+                victim = entry;
+            }
+        }
+    }
+    if (cacheCount < CacheMax || !victim)
+    {
+        return;
+    }
+    cache[hash(victim->type, victim->name) % CacheHashSize].remove(victim);
+    delete victim;
+    --cacheCount;
+}
+
+// Looks up the cache. If the answer for the name is cached, or has just
+// been given to the query in progress for the name, copies it to result
+// and returns true. Otherwise, marks the entry of the name as pending and
+// returns false, in which case the caller must query the name server and
+// then call complete().
+bool Resolver::
+lookup(u16 type, const char* key, Entry* result)
 {
     Synchronized<es::Monitor*> method(monitor);
 
-    if (!setup())
+    int serial = -1;
+    for (;;)
+    {
+        Entry* entry = find(type, key);
+        if (!entry)
+        {
+            if (CacheMax <= cacheCount)
+            {
+                evict();
+            }
+            entry = new Entry;
+            entry->type = type;
+            strcpy(entry->name, key);
+            entry->negative = true;
+            entry->serial = 0;
+            cache[hash(type, key) % CacheHashSize].addFirst(entry);
+            ++cacheCount;
+        }
+        else if (entry->pending)
+        {
+            // Wait for the query in progress.
+            serial = entry->serial;
+            monitor->wait();
+            continue;
+        }
+        else if (entry->serial != serial && serial != -1 ||
+                 DateTime::getNow() < entry->expiration)
+        {
+            ++hits;
+            *result = *entry;
+            return true;
+        }
+        entry->pending = true;
+        ++misses;
+        return false;
+    }
+}
+
+void Resolver::
+complete(u16 type, const char* key, const Entry* result, u32 ttl)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    Entry* entry = find(type, key);
+    ASSERT(entry && entry->pending);
+    entry->negative = result->negative;
+    entry->addr = result->addr;
+    strcpy(entry->hostName, result->hostName);
+    entry->expiration = DateTime::getNow() + TimeSpan(0, 0, ttl);
+    entry->pending = false;
+    ++entry->serial;
+    monitor->notifyAll();
+}
+
+es::InternetAddress* Resolver::
+getHostByName(const char* hostName, int addressFamily)
+{
+    char key[DNSHdr::NameMax];
+    if (!hostName || addressFamily != AF_INET || !makeKey(hostName, key))
     {
         return 0;
     }
 
-    return control->getHostByName(hostName, addressFamily);
+    Entry answer;
+    if (lookup(DNSType::A, key, &answer))
+    {
+        if (answer.negative)
+        {
+            return 0;
+        }
+        return getHostByAddress(&answer.addr.addr, sizeof(InAddr), 0);
+    }
+
+    es::InternetAddress* host = 0;
+    u32 ttl = 0;
+    answer.negative = true;
+    answer.hostName[0] = '\0';
+    if (Control* control = getControl())
+    {
+        host = control->getHostByName(hostName, addressFamily);
+        ttl = control->getTtl();
+        putControl(control);
+    }
+    if (host)
+    {
+        answer.negative = false;
+        host->getAddress(&answer.addr, sizeof(InAddr));
+    }
+    complete(DNSType::A, key, &answer, ttl);
+    return host;
 }
 
 const char* Resolver::
 getHostName(void* hostName, int len, es::InternetAddress* address)
 {
-    Synchronized<es::Monitor*> method(monitor);
-
-    if (!setup() || !control->getHostName(address, static_cast<char*>(hostName), len))
+    char key[DNSHdr::NameMax];
+    InAddr addr;
+    if (!hostName || len < DNSHdr::NameMax || !address ||
+        address->getAddress(&addr, sizeof(InAddr)) != sizeof(InAddr) ||
+        addr.ntoa(key, sizeof key) <= 0)
     {
         return 0;
     }
 
-    return static_cast<char*>(hostName);
+    Entry answer;
+    if (lookup(DNSType::PTR, key, &answer))
+    {
+        if (answer.negative)
+        {
+            return 0;
+        }
+        strcpy(static_cast<char*>(hostName), answer.hostName);
+        return static_cast<char*>(hostName);
+    }
+
+    bool found = false;
+    u32 ttl = 0;
+    answer.negative = true;
+    answer.hostName[0] = '\0';
+    if (Control* control = getControl())
+    {
+        found = control->getHostName(address, answer.hostName, sizeof answer.hostName);
+        ttl = control->getTtl();
+        putControl(control);
+    }
+    if (found)
+    {
+        answer.negative = false;
+        strcpy(static_cast<char*>(hostName), answer.hostName);
+    }
+    complete(DNSType::PTR, key, &answer, ttl);
+    return found ? static_cast<char*>(hostName) : 0;
+}
+
+long long Resolver::
+getCacheHits()
+{
+    Synchronized<es::Monitor*> method(monitor);
+    return hits;
+}
+
+long long Resolver::
+getCacheMisses()
+{
+    Synchronized<es::Monitor*> method(monitor);
+    return misses;
 }
 
 // Note DNS is not queried.
@@ -521,21 +843,7 @@ getHostByAddress(const void* address, int len, unsigned int scopeID)
 Object* Resolver::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Resolver::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Resolver*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Resolver*>(this);
-    }
-    else
-    {
-        return NULL;
-    }
-    objectPtr->addRef();
-    return objectPtr;
+    return es::InterfaceTable<Resolver, es::Resolver>::query(this, riid);
 }
 
 unsigned int Resolver::
@@ -558,7 +866,10 @@ release()
 
 Resolver::
 Resolver() :
-    control(0)
+    controlCount(0),
+    cacheCount(0),
+    hits(0),
+    misses(0)
 {
     monitor = es::Monitor::createInstance();
 }
@@ -566,9 +877,16 @@ Resolver() :
 Resolver::
 ~Resolver()
 {
-    if (control)
+    while (Control* control = controls.removeFirst())
     {
         delete control;
-        control = 0;
     }
+    for (int i = 0; i < CacheHashSize; ++i)
+    {
+        while (Entry* entry = cache[i].removeFirst())
+        {
+            delete entry;
+        }
+    }
+    monitor->release();
 }
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "inet4address.h"
+#include "route.h"
+
+RouteTable::
+RouteTable() :
+    chunks(0),
+    chunkCount(0),
+    chunkFree(-1),
+    chunkUsed(0),
+    routes(0),
+    freeRoutes(0),
+    routeCount(0),
+    freeCount(0),
+    size(0),
+    generation(0)
+{
+    top = new u32[TOP_SIZE];
+    memset(top, 0, sizeof(u32) * TOP_SIZE);
+}
+
+RouteTable::
+~RouteTable()
+{
+    for (int i = 1; i < routeCount; ++i)
+    {
+        if (Route* route = routes[i])
+        {
+            if (route->gateway)
+            {
+                route->gateway->release();
+            }
+            if (route->source)
+            {
+                route->source->release();
+            }
+            delete route;
+        }
+    }
+    for (int i = 0; i < chunkCount; ++i)
+    {
+        delete[] chunks[i];
+    }
+    delete[] chunks;
+    delete[] routes;
+    delete[] freeRoutes;
+    delete[] top;
+}
+
+// Allocates a chunk of which all the slots are initialized to slot.
+int RouteTable::
+allocateChunk(u32 slot)
+{
+    int index = chunkFree;
+    if (0 <= index)
+    {
+        chunkFree = chunks[index][0];
+    }
+    else
+    {
+        int count = chunkCount ? chunkCount * 2 : 64;
+        u32** array = new u32*[count];
+        if (chunkCount)
+        {
+            memmove(array, chunks, sizeof(u32*) * chunkCount);
+        }
+        for (int i = chunkCount; i < count; ++i)
+        {
+            array[i] = 0;
+        }
+        delete[] chunks;
+        chunks = array;
+        index = chunkCount;
+        for (int i = count - 1; index < i; --i)
+        {
+            array[i] = new u32[CHUNK_SIZE];
+            array[i][0] = chunkFree;
+            chunkFree = i;
+        }
+        array[index] = new u32[CHUNK_SIZE];
+        chunkCount = count;
+    }
+    u32* chunk = chunks[index];
+    for (int i = 0; i < CHUNK_SIZE; ++i)
+    {
+        chunk[i] = slot;
+    }
+    ++chunkUsed;
+    return index;
+}
+
+void RouteTable::
+freeChunk(int index)
+{
+    chunks[index][0] = chunkFree;
+    chunkFree = index;
+    --chunkUsed;
+}
+
+int RouteTable::
+allocateRoute(Route* route)
+{
+    if (freeCount == 0)
+    {
+        int count = routeCount ? routeCount * 2 : 64;
+        Route** array = new Route*[count];
+        int* free = new int[count];
+        if (routeCount)
+        {
+            memmove(array, routes, sizeof(Route*) * routeCount);
+        }
+        for (int i = routeCount; i < count; ++i)
+        {
+            array[i] = 0;
+        }
+        // Index 0 stands for no route.
+        for (int i = count - 1; std::max(routeCount, 1) <= i; --i)
+        {
+            free[freeCount++] = i;
+        }
+        delete[] routes;
+        delete[] freeRoutes;
+        routes = array;
+        freeRoutes = free;
+        routeCount = count;
+    }
+    int index = freeRoutes[--freeCount];
+    routes[index] = route;
+    return index;
+}
+
+void RouteTable::
+freeRoute(int index)
+{
+    routes[index] = 0;
+    freeRoutes[freeCount++] = index;
+}
+
+// Sets the route of the index to the slot, or to the slots under it, that
+// are not covered by the longer prefixes.
+void RouteTable::
+set(u32& slot, u32 index, int prefix)
+{
+    if (slot & CHUNK)
+    {
+        u32* chunk = chunks[slot & ~CHUNK];
+        for (int i = 0; i < CHUNK_SIZE; ++i)
+        {
+            set(chunk[i], index, prefix);
+        }
+    }
+    else if (getPrefix(slot) < prefix)
+    {
+        slot = index;
+    }
+}
+
+// Replaces the route of the index in the slot, or in the slots under it,
+// with the replacement.
+void RouteTable::
+reset(u32& slot, u32 index, u32 replacement)
+{
+    if (slot & CHUNK)
+    {
+        u32* chunk = chunks[slot & ~CHUNK];
+        for (int i = 0; i < CHUNK_SIZE; ++i)
+        {
+            reset(chunk[i], index, replacement);
+        }
+        collapse(slot);
+    }
+    else if (slot == index)
+    {
+        slot = replacement;
+    }
+}
+
+// Frees the chunk of the slot if all of its slots hold the same route.
+void RouteTable::
+collapse(u32& slot)
+{
+    if (!(slot & CHUNK))
+    {
+        return;
+    }
+    u32* chunk = chunks[slot & ~CHUNK];
+    u32 value = chunk[0];
+    if (value & CHUNK)
+    {
+        return;
+    }
+    for (int i = 1; i < CHUNK_SIZE; ++i)
+    {
+        if (chunk[i] != value)
+        {
+            return;
+        }
+    }
+    freeChunk(slot & ~CHUNK);
+    slot = value;
+}
+
+// Adds the route of the index, or replaces it with the replacement, in the
+// slots covered by the prefix.
+void RouteTable::
+update(u32 addr, int prefix, u32 index, u32 replacement, bool add)
+{
+    if (prefix <= 16)
+    {
+        u32 first = addr >> 16;
+        u32 end = first + (1u << (16 - prefix));
+        for (u32 i = first; i < end; ++i)
+        {
+            add ? set(top[i], index, prefix) : reset(top[i], index, replacement);
+        }
+        return;
+    }
+
+    u32& upper = top[addr >> 16];
+    if (!(upper & CHUNK))
+    {
+        if (!add)
+        {
+            return;
+        }
+        upper = CHUNK | allocateChunk(upper);
+    }
+    u32* chunk = chunks[upper & ~CHUNK];
+    if (prefix <= 24)
+    {
+        u32 first = (addr >> 8) & 0xff;
+        u32 end = first + (1u << (24 - prefix));
+        for (u32 i = first; i < end; ++i)
+        {
+            add ? set(chunk[i], index, prefix) : reset(chunk[i], index, replacement);
+        }
+    }
+    else
+    {
+        u32& middle = chunk[(addr >> 8) & 0xff];
+        if (!(middle & CHUNK))
+        {
+            if (!add)
+            {
+                return;
+            }
+            middle = CHUNK | allocateChunk(middle);
+        }
+        u32* lower = chunks[middle & ~CHUNK];
+        u32 first = addr & 0xff;
+        u32 end = first + (1u << (32 - prefix));
+        for (u32 i = first; i < end; ++i)
+        {
+            add ? set(lower[i], index, prefix) : reset(lower[i], index, replacement);
+        }
+        collapse(middle);
+    }
+    collapse(upper);
+}
+
+Route* RouteTable::
+get(InAddr dest, int prefix)
+{
+    u32 addr = ntohl(dest.addr) & mask(prefix);
+    Tree<u64, int>::Node* node = tree.getFloor(key(addr, prefix));
+    if (!node || node->getKey() != key(addr, prefix))
+    {
+        return 0;
+    }
+    return routes[node->getValue()];
+}
+
+bool RouteTable::
+add(InAddr dest, int prefix, Inet4Address* gateway, Inet4Address* source)
+{
+    ASSERT(0 <= prefix && prefix <= 32);
+    u32 addr = ntohl(dest.addr) & mask(prefix);
+    if (tree.contains(key(addr, prefix)))
+    {
+        return false;
+    }
+
+    Route* route = new Route;
+    route->dest.addr = htonl(addr);
+    route->prefix = prefix;
+    route->gateway = gateway;
+    route->source = source;
+    if (gateway)
+    {
+        gateway->addRef();
+    }
+    if (source)
+    {
+        source->addRef();
+    }
+    int index = allocateRoute(route);
+    tree.add(key(addr, prefix), index);
+    update(addr, prefix, index, 0, true);
+    ++size;
+    ++generation;
+    return true;
+}
+
+bool RouteTable::
+remove(InAddr dest, int prefix)
+{
+    u32 addr = ntohl(dest.addr) & mask(prefix);
+    Tree<u64, int>::Node* node = tree.getFloor(key(addr, prefix));
+    if (!node || node->getKey() != key(addr, prefix))
+    {
+        return false;
+    }
+    int index = node->getValue();
+    tree.remove(key(addr, prefix));
+
+    // The slots of the route fall back to the longest shorter prefix.
+    int replacement = 0;
+    for (int len = prefix - 1; 0 <= len; --len)
+    {
+        node = tree.getFloor(key(addr & mask(len), len));
+        if (node && node->getKey() == key(addr & mask(len), len))
+        {
+            replacement = node->getValue();
+            break;
+        }
+    }
+    update(addr, prefix, index, replacement, false);
+
+    Route* route = routes[index];
+    if (route->gateway)
+    {
+        route->gateway->release();
+    }
+    if (route->source)
+    {
+        route->source->release();
+    }
+    delete route;
+    freeRoute(index);
+    --size;
+    ++generation;
+    return true;
+}
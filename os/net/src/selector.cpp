@@ -0,0 +1,452 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/interfaceTable.h>
+#include "selector.h"
+#include "socket.h"
+
+es::Monitor* Selector::registry;
+
+namespace
+{
+    const int EVENT_MASK = es::Selector::Readable | es::Selector::Writable |
+                           es::Selector::Acceptable | es::Selector::Connectable;
+
+    int getReadiness(Socket* socket, int events)
+    {
+        int ready = 0;
+        if ((events & es::Selector::Readable) && socket->isReadable())
+        {
+            ready |= es::Selector::Readable;
+        }
+        if ((events & es::Selector::Writable) && socket->isWritable())
+        {
+            ready |= es::Selector::Writable;
+        }
+        if ((events & es::Selector::Acceptable) && socket->isAcceptable())
+        {
+            ready |= es::Selector::Acceptable;
+        }
+        if ((events & es::Selector::Connectable) && socket->isConnectable())
+        {
+            ready |= es::Selector::Connectable;
+        }
+        return ready;
+    }
+
+    Socket* getSocket(es::Selectable* target)
+    {
+        if (!target)
+        {
+            return 0;
+        }
+        Handle<es::Socket> socket(target, true);
+        if (!socket)
+        {
+            return 0;
+        }
+        return static_cast<Socket*>(static_cast<es::Socket*>(socket));
+    }
+}
+
+Selector::Registration::
+Registration(Selector* selector, Socket* socket, int events, int cookie) :
+    selector(selector),
+    socket(socket),
+    events(events),
+    cookie(cookie),
+    queued(false),
+    removed(false)
+{
+    socket->addRef();
+}
+
+Selector::Registration::
+~Registration()
+{
+    socket->release();
+}
+
+unsigned int Selector::Registration::
+release()
+{
+    unsigned int count = ref.release();
+    if (count == 0)
+    {
+        delete this;
+        return 0;
+    }
+    return count;
+}
+
+Selector::
+Selector()
+{
+    monitor = es::Monitor::createInstance();
+}
+
+Selector::
+~Selector()
+{
+    Registration::SelectorList list;
+
+    registry->lock();
+    monitor->lock();
+    while (Registration* registration = registrations.removeFirst())
+    {
+        registration->socket->registrations.remove(registration);
+        if (registration->queued)
+        {
+            ready.remove(registration);
+            registration->queued = false;
+        }
+        registration->removed = true;
+        list.addLast(registration);
+    }
+    monitor->unlock();
+    registry->unlock();
+
+    while (Registration* registration = list.removeFirst())
+    {
+        registration->release();
+    }
+    monitor->release();
+}
+
+// Must be called with the registry locked.
+Selector::Registration* Selector::
+find(Socket* socket)
+{
+    Registration* registration;
+    Registration::SocketList::Iterator iter = socket->registrations.begin();
+    while ((registration = iter.next()))
+    {
+        if (registration->selector == this)
+        {
+            return registration;
+        }
+    }
+    return 0;
+}
+
+// Must be called with the monitor locked.
+void Selector::
+enqueue(Registration* registration)
+{
+    if (!registration->queued && !registration->removed)
+    {
+        registration->queued = true;
+        ready.addLast(registration);
+        monitor->notifyAll();
+    }
+}
+
+void Selector::
+notify(Socket* socket)
+{
+    // Most sockets are not registered to any selector.
+    if (socket->registrations.isEmpty() || !registry)
+    {
+        return;
+    }
+
+    registry->lock();
+    Registration* registration;
+    Registration::SocketList::Iterator iter = socket->registrations.begin();
+    while ((registration = iter.next()))
+    {
+        Selector* selector = registration->selector;
+        selector->monitor->lock();
+        selector->enqueue(registration);
+        selector->monitor->unlock();
+    }
+    registry->unlock();
+}
+
+void Selector::
+cancel(Socket* socket)
+{
+    if (socket->registrations.isEmpty() || !registry)
+    {
+        return;
+    }
+
+    Registration::SelectorList list;
+
+    registry->lock();
+    while (Registration* registration = socket->registrations.removeFirst())
+    {
+        Selector* selector = registration->selector;
+        selector->monitor->lock();
+        selector->registrations.remove(registration);
+        if (registration->queued)
+        {
+            selector->ready.remove(registration);
+            registration->queued = false;
+        }
+        registration->removed = true;
+        selector->monitor->unlock();
+        list.addLast(registration);
+    }
+    registry->unlock();
+
+    while (Registration* registration = list.removeFirst())
+    {
+        registration->release();
+    }
+}
+
+int Selector::
+add(es::Selectable* target, int events, int cookie)
+{
+    Socket* socket = getSocket(target);
+    if (!socket || !(events & EVENT_MASK))
+    {
+        return -1;
+    }
+
+    registry->lock();
+    if (find(socket))
+    {
+        registry->unlock();
+        return -1;
+    }
+    Registration* registration = new Registration(this, socket, events, cookie);
+    socket->registrations.addLast(registration);
+    monitor->lock();
+    registrations.addLast(registration);
+    // The socket may already be ready; let wait() examine it.
+    enqueue(registration);
+    monitor->unlock();
+    registry->unlock();
+    return 0;
+}
+
+int Selector::
+modify(es::Selectable* target, int events, int cookie)
+{
+    Socket* socket = getSocket(target);
+    if (!socket || !(events & EVENT_MASK))
+    {
+        return -1;
+    }
+
+    registry->lock();
+    Registration* registration = find(socket);
+    if (!registration)
+    {
+        registry->unlock();
+        return -1;
+    }
+    monitor->lock();
+    registration->events = events;
+    registration->cookie = cookie;
+    enqueue(registration);
+    monitor->unlock();
+    registry->unlock();
+    return 0;
+}
+
+int Selector::
+remove(es::Selectable* target)
+{
+    Socket* socket = getSocket(target);
+    if (!socket)
+    {
+        return -1;
+    }
+
+    registry->lock();
+    Registration* registration = find(socket);
+    if (!registration)
+    {
+        registry->unlock();
+        return -1;
+    }
+    socket->registrations.remove(registration);
+    monitor->lock();
+    registrations.remove(registration);
+    if (registration->queued)
+    {
+        ready.remove(registration);
+        registration->queued = false;
+    }
+    registration->removed = true;
+    monitor->unlock();
+    registry->unlock();
+
+    registration->release();
+    return 0;
+}
+
+// Examines the registrations in the ready queue. Only the registrations
+// that are in the queue on entry are examined, since the level triggered
+// ones that are still ready are put back to the queue.
+int Selector::
+poll(int* events, int eventsLength)
+{
+    Registration::PendingList list;
+
+    monitor->lock();
+    for (int count = 0; count < eventsLength / 2; ++count)
+    {
+        Registration* registration = ready.removeFirst();
+        if (!registration)
+        {
+            break;
+        }
+        registration->queued = false;
+        registration->addRef();
+        list.addLast(registration);
+    }
+    monitor->unlock();
+
+    int n = 0;
+    while (Registration* registration = list.removeFirst())
+    {
+        // Check the readiness without holding the monitor, as the socket
+        // locks its own monitor which is held while notify() is called.
+        int mask = getReadiness(registration->socket, registration->events);
+        if (mask)
+        {
+            monitor->lock();
+            if (!registration->removed)
+            {
+                events[2 * n] = registration->cookie;
+                events[2 * n + 1] = mask;
+                ++n;
+                if (!(registration->events & es::Selector::EdgeTriggered))
+                {
+                    enqueue(registration);
+                }
+            }
+            monitor->unlock();
+        }
+        registration->release();
+    }
+    return n;
+}
+
+int Selector::
+wait(int* events, int eventsLength, long long timeout)
+{
+    if (!events || eventsLength < 2)
+    {
+        return -1;
+    }
+
+    DateTime due = DateTime::getNow() + TimeSpan(timeout);
+    for (;;)
+    {
+        // Each ready object takes two elements of the sequence.
+        int n = poll(events, eventsLength);
+        if (0 < n)
+        {
+            return 2 * n;
+        }
+
+        // Keep examining the queue until it becomes empty, since the
+        // sockets examined so far might not be ready any more.
+        monitor->lock();
+        while (ready.isEmpty())
+        {
+            if (timeout < 0)
+            {
+                monitor->wait();
+                continue;
+            }
+            DateTime now = DateTime::getNow();
+            if (due <= now)
+            {
+                monitor->unlock();
+                return 0;
+            }
+            monitor->wait(due - now);
+        }
+        monitor->unlock();
+    }
+}
+
+//
+// IInterface
+//
+
+Object* Selector::
+queryInterface(const char* riid)
+{
+    return es::InterfaceTable<Selector, es::Selector>::query(this, riid);
+}
+
+unsigned int Selector::
+addRef()
+{
+    return ref.addRef();
+}
+
+unsigned int Selector::
+release()
+{
+    unsigned int count = ref.release();
+    if (count == 0)
+    {
+        delete this;
+        return 0;
+    }
+    return count;
+}
+
+//
+// Constructor
+//
+
+es::Selector* Selector::
+Constructor::createInstance()
+{
+    return new Selector;
+}
+
+Object* Selector::
+Constructor::queryInterface(const char* riid)
+{
+    return es::InterfaceTable<Selector::Constructor, es::Selector::Constructor>::query(this, riid);
+}
+
+unsigned int Selector::
+Constructor::addRef()
+{
+    return 1;
+}
+
+unsigned int Selector::
+Constructor::release()
+{
+    return 1;
+}
+
+void Selector::
+initializeConstructor()
+{
+    registry = es::Monitor::createInstance();
+
+    // cf. -fthreadsafe-statics for g++
+    static Constructor constructor;
+    es::Selector::setConstructor(&constructor);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <es.h>
+#include "sendBuffer.h"
+
+SendBuffer::
+~SendBuffer()
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (at(i).stream)
+        {
+            at(i).stream->release();
+        }
+    }
+}
+
+SendBuffer::Reader::
+~Reader()
+{
+    for (int i = 0; i < count; ++i)
+    {
+        ranges[i].stream->release();
+    }
+}
+
+void SendBuffer::Reader::
+add(es::Stream* stream, long long offset, u8* dst, long count)
+{
+    ASSERT(this->count < EXTENT_MAX);
+    stream->addRef();
+    Range& range(ranges[this->count++]);
+    range.stream = stream;
+    range.offset = offset;
+    range.dst = dst;
+    range.count = count;
+}
+
+bool SendBuffer::Reader::
+read()
+{
+    for (int i = 0; i < count; ++i)
+    {
+        Range& range(ranges[i]);
+        long n = 0;
+        while (n < range.count)
+        {
+            int result = range.stream->read(range.dst + n, range.count - n, range.offset + n);
+            if (result <= 0)
+            {
+                return false;
+            }
+            n += result;
+        }
+    }
+    return true;
+}
+
+long SendBuffer::
+peek(void* dst, long count, long offset, Reader* reader) const
+{
+    u8* ptr = static_cast<u8*>(dst);
+    long ringOffset = 0;    // Offset of the current extent in the ring
+    long peeked = 0;
+    for (int i = 0; i < this->count && 0 < count; ++i)
+    {
+        const Extent& extent(at(i));
+        if (extent.count <= offset)
+        {
+            offset -= extent.count;
+            if (!extent.stream)
+            {
+                ringOffset += extent.count;
+            }
+            continue;
+        }
+
+        long len = std::min(count, extent.count - offset);
+        if (!extent.stream)
+        {
+            ring.peek(ptr, len, ringOffset + offset);
+            ringOffset += extent.count;
+        }
+        else
+        {
+            reader->add(extent.stream, extent.offset + offset, ptr, len);
+        }
+        ptr += len;
+        peeked += len;
+        count -= len;
+        offset = 0;
+    }
+    return peeked;
+}
+
+long SendBuffer::
+skip(long count)
+{
+    long skipped = 0;
+    while (0 < this->count && 0 < count)
+    {
+        Extent& extent(at(0));
+        long len = std::min(count, extent.count);
+        if (!extent.stream)
+        {
+            ring.skip(len);
+        }
+        else
+        {
+            extent.offset += len;
+            fileUsed -= len;
+        }
+        extent.count -= len;
+        if (extent.count == 0)
+        {
+            if (extent.stream)
+            {
+                extent.stream->release();
+                extent.stream = 0;
+            }
+            first = (first + 1) % EXTENT_MAX;
+            --this->count;
+        }
+        used -= len;
+        skipped += len;
+        count -= len;
+    }
+    return skipped;
+}
+
+long SendBuffer::
+write(const void* src, long count)
+{
+    if (this->count == 0 || at(this->count - 1).stream)
+    {
+        if (isFull())
+        {
+            return 0;
+        }
+        Extent& extent(at(this->count));
+        extent.stream = 0;
+        extent.offset = 0;
+        extent.count = 0;
+        ++this->count;
+    }
+    long len = ring.write(src, count);
+    at(this->count - 1).count += len;
+    used += len;
+    return len;
+}
+
+long SendBuffer::
+writeFile(es::Stream* stream, long long offset, long count)
+{
+    if (!stream || count <= 0)
+    {
+        return 0;
+    }
+    if (0 < this->count)
+    {
+        // Extend the last extent if the range follows it.
+        Extent& last(at(this->count - 1));
+        if (last.stream == stream && last.offset + last.count == offset)
+        {
+            last.count += count;
+            used += count;
+            fileUsed += count;
+            return count;
+        }
+    }
+    if (isFull())
+    {
+        return 0;
+    }
+    stream->addRef();
+    Extent& extent(at(this->count));
+    extent.stream = stream;
+    extent.offset = offset;
+    extent.count = count;
+    ++this->count;
+    used += count;
+    fileUsed += count;
+    return count;
+}
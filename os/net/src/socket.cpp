@@ -18,9 +18,11 @@
 #include <new>
 #include <stdlib.h>
 #include <string.h>
+#include <es/interfaceTable.h>
 #include <es/net/arp.h>
 #include "dix.h"
 #include "inet4address.h"
+#include "inetStatistics.h"
 #include "loopback.h"
 #include "socket.h"
 #include "visualizer.h"
@@ -41,6 +43,8 @@ initialize()
     DateTime seed = DateTime::getNow();
     srand48(seed.getTicks());
     timer = new Timer;
+    InetStatistics::initialize();
+    Selector::initializeConstructor();
 }
 
 int Socket::
@@ -139,13 +143,21 @@ Socket(int family, int type, int protocol) :
     af(0),
     recvBufferSize(8192),
     sendBufferSize(8192),
+    congestionControl(es::Socket::Reno),
     errorCode(0),
     selector(0),
     blocking(true),
     recvFromAddress(0),
-    recvFromPort(0)
+    recvFromPort(0),
+    batchCount(0)
 {
     af = getAddressFamily(family);
+    for (int i = 0; i < es::Socket::BatchMax; ++i)
+    {
+        batch[i].addr = 0;
+        batch[i].port = 0;
+        batch[i].len = 0;
+    }
 }
 
 Socket::
@@ -158,6 +170,7 @@ Socket::
         SocketUninstaller uninstaller(this);
         adapter->accept(&uninstaller);
     }
+    clearBatch();
 }
 
 bool Socket::
@@ -244,6 +257,21 @@ isUrgent()
     return m.getFlag();    
 }
 
+void Socket::
+getStatistics(void* statistics)
+{
+    memset(statistics, 0, sizeof(es::SocketStatistics));
+    if (!adapter)
+    {
+        return;
+    }
+
+    SocketMessenger m(this, &SocketReceiver::getStatistics,
+                      statistics, sizeof(es::SocketStatistics));
+    Visitor v(&m);
+    adapter->accept(&v);
+}
+
 bool Socket::
 isConnected()
 {
@@ -290,6 +318,30 @@ setSendBufferSize(int size)
     }
 }
 
+int Socket::
+getCongestionControl()
+{
+    return congestionControl;
+}
+
+void Socket::
+setCongestionControl(int algorithm)
+{
+    if (isBound() || type != es::Socket::Stream)
+    {
+        return;
+    }
+    switch (algorithm)
+    {
+      case es::Socket::Reno:
+      case es::Socket::Cubic:
+        congestionControl = algorithm;
+        break;
+      default:
+        break;
+    }
+}
+
 long long Socket::
 getTimeout()
 {
@@ -445,6 +497,8 @@ accept()
 void Socket::
 close()
 {
+    Selector::cancel(this);
+
     if (!adapter)
     {
         return;
@@ -570,6 +624,157 @@ sendTo(const void* src, int count, int flags, es::InternetAddress* addr, int por
     return m.getLength();
 }
 
+void Socket::
+clearBatch()
+{
+    for (int i = 0; i < es::Socket::BatchMax; ++i)
+    {
+        if (batch[i].addr)
+        {
+            batch[i].addr->release();
+            batch[i].addr = 0;
+        }
+        batch[i].port = 0;
+        batch[i].len = 0;
+    }
+    batchCount = 0;
+}
+
+// Receives the queued datagrams with a single visit to the receiver, which
+// takes its lock only once for the whole batch.
+int Socket::
+recvBatch(void* dst, int count, int max, int flags)
+{
+    if (!adapter)
+    {
+        errorCode = ENOTCONN;
+        return -errorCode;
+    }
+    if (max <= 0 || es::Socket::BatchMax < max)
+    {
+        errorCode = EINVAL;
+        return -errorCode;
+    }
+
+    clearBatch();
+    SocketMessenger m(this, &SocketReceiver::readBatch, dst, count);
+    m.setBatch(batch, max);
+    m.setFlag(flags);
+    Visitor v(&m);
+    adapter->accept(&v);
+    int code = m.getErrorCode();
+    if (code)
+    {
+        if (code != EAGAIN)
+        {
+            errorCode = code;
+        }
+        return -errorCode;
+    }
+    batchCount = m.getBatchCount();
+    return m.getLength();
+}
+
+int Socket::
+getBatchCount()
+{
+    return batchCount;
+}
+
+int Socket::
+getBatchLength(int index)
+{
+    if (index < 0 || batchCount <= index)
+    {
+        return -EINVAL;
+    }
+    return batch[index].len;
+}
+
+es::InternetAddress* Socket::
+getBatchAddress(int index)
+{
+    if (index < 0 || es::Socket::BatchMax <= index || !batch[index].addr)
+    {
+        return 0;
+    }
+    batch[index].addr->addRef();
+    return batch[index].addr;
+}
+
+int Socket::
+getBatchPort(int index)
+{
+    if (index < 0 || es::Socket::BatchMax <= index)
+    {
+        return 0;
+    }
+    return batch[index].port;
+}
+
+void Socket::
+setBatchAddress(int index, es::InternetAddress* addr, int port)
+{
+    if (index < 0 || es::Socket::BatchMax <= index)
+    {
+        return;
+    }
+    Address* address = dynamic_cast<Address*>(addr);
+    if (address)
+    {
+        address->addRef();
+    }
+    if (batch[index].addr)
+    {
+        batch[index].addr->release();
+    }
+    batch[index].addr = address;
+    batch[index].port = port;
+}
+
+int Socket::
+sendBatch(const void* src, int count, const int* lengths, int max, int flags)
+{
+    if (!adapter)
+    {
+        errorCode = ENOTCONN;
+        return -errorCode;
+    }
+    if (max < 0 || es::Socket::BatchMax < max)
+    {
+        errorCode = EINVAL;
+        return -errorCode;
+    }
+
+    int total = 0;
+    for (int i = 0; i < max; ++i)
+    {
+        if (lengths[i] < 0 || count - total < lengths[i])
+        {
+            errorCode = EINVAL;
+            return -errorCode;
+        }
+        batch[i].len = lengths[i];
+        total += lengths[i];
+    }
+
+    SocketMessenger m(this, &SocketReceiver::writeBatch, const_cast<void*>(src), total);
+    m.setBatch(batch, max);
+    m.setFlag(flags);
+    Visitor v(&m);
+    adapter->accept(&v);
+    int code = m.getErrorCode();
+    if (code)
+    {
+        if (code != EAGAIN)
+        {
+            errorCode = code;
+        }
+        return -errorCode;
+    }
+    return m.getBatchCount();
+}
+
 void Socket::
 shutdownInput()
 {
@@ -622,6 +827,41 @@ write(const void* src, int count)
     return m.getLength();
 }
 
+int Socket::
+sendFile(es::Stream* src, long long offset, int count)
+{
+    if (!adapter)
+    {
+        errorCode = ENOTCONN;
+        return -errorCode;
+    }
+    if (type != es::Socket::Stream)
+    {
+        errorCode = EOPNOTSUPP;
+        return -errorCode;
+    }
+    if (!src || offset < 0 || count < 0)
+    {
+        errorCode = EINVAL;
+        return -errorCode;
+    }
+
+    SocketMessenger m(this, &SocketReceiver::sendFile);
+    m.setStream(src, offset, count);
+    Visitor v(&m);
+    adapter->accept(&v);
+    int code = m.getErrorCode();
+    if (code)
+    {
+        if (code != EAGAIN)
+        {
+            errorCode = code;
+        }
+        return -errorCode;
+    }
+    return m.getCount();
+}
+
 bool Socket::
 isAcceptable()
 {
@@ -758,24 +998,12 @@ remove(es::Monitor* selector)
 Object* Socket::
 queryInterface(const char* riid)
 {
-    Object* objectPtr;
-    if (strcmp(riid, es::Socket::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Socket*>(this);
-    }
-    else if (strcmp(riid, es::Selectable::iid()) == 0)
-    {
-        objectPtr = static_cast<es::Selectable*>(this);
-    }
-    else if (strcmp(riid, Object::iid()) == 0)
+    Object* objectPtr = es::InterfaceTable<Socket, es::Socket, es::Selectable>::find(this, riid);
+    if (!objectPtr && type == es::Socket::Datagram && es::isInterface<es::MulticastSocket>(riid))
     {
         objectPtr = static_cast<es::Socket*>(this);
     }
-    else if (strcmp(riid, es::MulticastSocket::iid()) == 0 && type == es::Socket::Datagram)
-    {
-        objectPtr = static_cast<es::Socket*>(this);
-    }
-    else
+    if (!objectPtr)
     {
         return NULL;
     }
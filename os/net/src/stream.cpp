@@ -30,7 +30,11 @@ const TimeSpan StreamReceiver::RTT_DEFAULT(30000000);
 const TimeSpan StreamReceiver::PERSIST_MAX(MAX_BACKOFF * RTT_MAX);
 const TimeSpan StreamReceiver::DACK_TIMEOUT(2000000);
 
-const int      StreamReceiver::MaxConn(5);
+const int      StreamReceiver::MaxConn(1024);
+const TimeSpan StreamReceiver::SYN_TIMEOUT(750000000LL);
+const TimeSpan StreamReceiver::COOKIE_PERIOD(640000000LL);
+const int      StreamReceiver::LARGE_SEND_MAX(65535 - IPHdr::MaxHdrSize - TCPHdr::MAX_HLEN);
+const int      StreamReceiver::SEND_FILE_MAX(256 * 1024);
 
 StreamReceiver::StateClosed      StreamReceiver::stateClosed;
 StreamReceiver::StateListen      StreamReceiver::stateListen;
@@ -115,33 +119,66 @@ getDefaultMSS(int mtu)
 bool StreamReceiver::
 input(InetMessenger* m, Conduit* c)
 {
-    Synchronized<es::Monitor*> method(monitor);
-
-    esReport("StreamReceiver::input %s\n", state->getName());
-    if (state->input(m, this))
+    int size;
     {
-        int size = 14 + 60 + 60 + mss;  // XXX Assume MAC, IPv4, TCP
-        Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size);
-        Handle<Address> addr;
-        seg->setLocal(addr = m->getLocal());
-        seg->setRemote(addr = m->getRemote());
-        seg->setLocalPort(m->getLocalPort());
-        seg->setRemotePort(m->getRemotePort());
-        seg->setType(IPPROTO_TCP);
-        Visitor v(seg);
-        conduit->accept(&v, conduit->getB());
+        Synchronized<es::Monitor*> method(monitor);
+
+        if (!state->input(m, this))
+        {
+            return true;
+        }
+        size = getSegmentBufferSize();
     }
+
+    // Send the segments without holding the monitor so that output() can
+    // read the queued stream ranges with the monitor released.
+    Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size);
+    Handle<Address> addr;
+    seg->setLocal(addr = m->getLocal());
+    seg->setRemote(addr = m->getRemote());
+    seg->setLocalPort(m->getLocalPort());
+    seg->setRemotePort(m->getRemotePort());
+    seg->setType(IPPROTO_TCP);
+    Visitor v(seg);
+    conduit->accept(&v, conduit->getB());
     return true;
 }
 
 bool StreamReceiver::
 output(InetMessenger* m, Conduit* c)
 {
-    Synchronized<es::Monitor*> method(monitor);
+    SendBuffer::Reader streams;
+    {
+        Synchronized<es::Monitor*> method(monitor);
+
+        hole = 0;
+        onxt = sendNext;
+        reader = &streams;
+        bool result = state->output(m, this);
+        reader = 0;
+        if (!result || streams.isEmpty())
+        {
+            return result;
+        }
+    }
 
-    hole = 0;
-    onxt = sendNext;
-    return state->output(m, this);
+    // Read the ranges queued by sendFile() without holding the monitor,
+    // since reading a stream may block.
+    if (!streams.read())
+    {
+        // The stream has been truncated since the range was queued. The
+        // sequence space of the range has already been sent, and it can
+        // never be filled in; give up the connection.
+        Synchronized<es::Monitor*> method(monitor);
+
+        if (err == 0)
+        {
+            err = EIO;
+        }
+        abort();
+        return false;
+    }
+    return true;
 }
 
 bool StreamReceiver::
@@ -175,9 +212,16 @@ abort()
     {
         Synchronized<es::Monitor*> method(listening->monitor);
         if (listening->accepted.contains(this))
-            listening->accepted.remove(this);        
+        {
+            listening->accepted.remove(this);
+            listening->pendingConn--;
+            ASSERT(listening->pendingConn >= 0);
+        }
     }
 
+    // Drop the half-open connections
+    clearSynTable();
+
     // TODO Is it nessary to clean up corresponding part in conduit graph? 
 #if 0
     // clean up corresponding part in conduit graph
@@ -267,12 +311,12 @@ read(SocketMessenger* m, Conduit* c)
     return false;
 }
 
-// Copy data into sendRing
+// Waits until the specified condition holds. Must be called with the
+// monitor locked.
 bool StreamReceiver::
-write(SocketMessenger* m, Conduit* c)
+waitUntil(bool (StreamReceiver::*ready)(), SocketMessenger* m)
 {
-    Synchronized<es::Monitor*> method(monitor);
-    while (!isWritable())
+    while (!(this->*ready)())
     {
         if (!socket->getBlocking())
         {
@@ -283,7 +327,7 @@ write(SocketMessenger* m, Conduit* c)
         {
             monitor->wait(socket->getTimeout());
 
-            if (!isWritable())
+            if (!(this->*ready)())
             {
                 m->setErrorCode(ETIMEDOUT);
                 return false;
@@ -295,22 +339,18 @@ write(SocketMessenger* m, Conduit* c)
         }
         monitor->wait();
     }
+    return true;
+}
 
-    long len = socket->getSendBufferSize() - sendRing.getUsed();
-    if (len < 0)
-    {
-        // XXX m->setErrorCode(XXX);
-        return false;
-    }
-
-    if (m->getLength() < len)
+// Sends out the data newly queued in sendRing.
+void StreamReceiver::
+transmit(SocketMessenger* m)
+{
+    int size;
     {
-        len = m->getLength();
+        Synchronized<es::Monitor*> method(monitor);
+        size = getSegmentBufferSize();
     }
-    sendRing.write(m->fix(len), len);
-    m->setPosition(m->getSize() - len);
-
-    int size = 14 + 60 + 60 + mss;  // XXX Assume MAC, IPv4, TCP
     Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size);
     Handle<Address> addr;
     seg->setLocal(addr = m->getLocal());
@@ -321,6 +361,62 @@ write(SocketMessenger* m, Conduit* c)
     seg->setFlag(m->getFlag());
     Visitor v(seg);
     conduit->accept(&v, conduit->getB());
+}
+
+// Copy data into sendRing
+bool StreamReceiver::
+write(SocketMessenger* m, Conduit* c)
+{
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        if (!waitUntil(&StreamReceiver::isWritable, m))
+        {
+            return false;
+        }
+
+        long len = sendRing.getUnused();
+        if (len < 0)
+        {
+            // XXX m->setErrorCode(XXX);
+            return false;
+        }
+
+        if (m->getLength() < len)
+        {
+            len = m->getLength();
+        }
+        len = sendRing.write(m->fix(len), len);
+        m->setPosition(m->getSize() - len);
+    }
+
+    transmit(m);
+
+    return false;
+}
+
+// Queue a range of the stream in sendRing by reference. The bytes are
+// read from the stream as each segment is made.
+bool StreamReceiver::
+sendFile(SocketMessenger* m, Conduit* c)
+{
+    {
+        Synchronized<es::Monitor*> method(monitor);
+        if (!waitUntil(&StreamReceiver::isFileWritable, m))
+        {
+            return false;
+        }
+
+        long len = std::min(m->getCount(), SEND_FILE_MAX - sendRing.getFileUsed());
+        if (len <= 0)
+        {
+            m->setCount(0);
+            return false;
+        }
+        len = sendRing.writeFile(m->getStream(), m->getOffset(), len);
+        m->setCount(len);
+    }
+
+    transmit(m);
 
     return false;
 }
@@ -352,16 +448,20 @@ connect(SocketMessenger* m, Conduit* c)
 bool StreamReceiver::
 close(SocketMessenger* m, Conduit* c)
 {
-    Synchronized<es::Monitor*> method(monitor);
-
-    if (socket->getTimeout() == 0 && !socket->getBlocking())
+    bool fin;
     {
-        state->abort(this);
-        return false;
-    }
+        Synchronized<es::Monitor*> method(monitor);
+
+        if (socket->getTimeout() == 0 && !socket->getBlocking())
+        {
+            state->abort(this);
+            return false;
+        }
 
-    shutrd = shutwr = true;
-    if (state->close(m, this))
+        shutrd = shutwr = true;
+        fin = state->close(m, this);
+    }
+    if (fin)
     {
         int size = 14 + 60 + 60 + mss;  // XXX Assume MAC, IPv4, TCP
         Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size);
@@ -375,6 +475,8 @@ close(SocketMessenger* m, Conduit* c)
         conduit->accept(&v, conduit->getB());
     }
 
+    Synchronized<es::Monitor*> method(monitor);
+
     while (!isClosable())
     {
         ASSERT(socket);
@@ -391,22 +493,26 @@ close(SocketMessenger* m, Conduit* c)
 bool StreamReceiver::
 shutdownOutput(SocketMessenger* m, Conduit* c)
 {
-    Synchronized<es::Monitor*> method(monitor);
-
-    shutwr = true;
-    if (state->close(m, this))
     {
-        int size = 14 + 60 + 60 + mss;  // XXX Assume MAC, IPv4, TCP
-        Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size);
-        Handle<Address> addr;
-        seg->setLocal(addr = m->getLocal());
-        seg->setRemote(addr = m->getRemote());
-        seg->setLocalPort(m->getLocalPort());
-        seg->setRemotePort(m->getRemotePort());
-        seg->setType(IPPROTO_TCP);
-        Visitor v(seg);
-        conduit->accept(&v, conduit->getB());
+        Synchronized<es::Monitor*> method(monitor);
+
+        shutwr = true;
+        if (!state->close(m, this))
+        {
+            return false;
+        }
     }
+
+    int size = 14 + 60 + 60 + mss;  // XXX Assume MAC, IPv4, TCP
+    Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size);
+    Handle<Address> addr;
+    seg->setLocal(addr = m->getLocal());
+    seg->setRemote(addr = m->getRemote());
+    seg->setLocalPort(m->getLocalPort());
+    seg->setRemotePort(m->getRemotePort());
+    seg->setType(IPPROTO_TCP);
+    Visitor v(seg);
+    conduit->accept(&v, conduit->getB());
     return false;
 }
 
@@ -420,6 +526,29 @@ shutdownInput(SocketMessenger* m, Conduit* c)
     return false;
 }
 
+bool StreamReceiver::
+getStatistics(SocketMessenger* m, Conduit* c)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    es::SocketStatistics* statistics =
+        static_cast<es::SocketStatistics*>(m->fix(sizeof(es::SocketStatistics)));
+    statistics->roundTripTime = srtt.getTicks();
+    statistics->roundTripTimeVariance = rttDe;
+    statistics->retransmissionTimeout = rto.getTicks();
+    statistics->congestionWindow = cWin;
+    statistics->slowStartThreshold = ssThresh;
+    statistics->maxSegmentSize = mss;
+    statistics->retransmits = retransmits;
+    statistics->recoveries = recoveries;
+    statistics->timeouts = timeouts;
+    statistics->inOctets = inOctets;
+    statistics->outOctets = outOctets;
+    statistics->receiveQueued = recvRing.getUsed();
+    statistics->sendQueued = sendRing.getUsed();
+    return false;
+}
+
 bool StreamReceiver::
 StateClosed::connect(SocketMessenger* m, StreamReceiver* s)
 {
@@ -444,6 +573,7 @@ StateClosed::connect(SocketMessenger* m, StreamReceiver* s)
     Handle<Address> local = m->getLocal();
     s->mss = s->getDefaultMSS(local->getPathMTU());
 
+    InetStatistics::increment(InetStatistics::TcpActiveOpens);
     s->setState(stateSynSent);
 
     // Send SYN
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <es/handle.h>
+#include "stream.h"
+
+const s64 StreamReceiver::Cubic::MAX_DELTA = 30000;
+const TimeSpan StreamReceiver::Cubic::HYSTART_DELAY_MIN(40000);     // 4 msec
+const TimeSpan StreamReceiver::Cubic::HYSTART_DELAY_MAX(160000);    // 16 msec
+const TimeSpan StreamReceiver::Cubic::HYSTART_ACK_DELTA(20000);     // 2 msec
+
+StreamReceiver::CongestionControl* StreamReceiver::
+CongestionControl::createInstance(int algorithm)
+{
+    switch (algorithm)
+    {
+      case es::Socket::Cubic:
+        return new Cubic;
+      case es::Socket::Reno:
+      default:
+        return new Reno;
+    }
+}
+
+void StreamReceiver::
+CongestionControl::start(StreamReceiver* s)
+{
+    s->cWin = s->getInitialCongestionWindowSize();
+    s->ssThresh = DEF_SSTHRESH;
+    s->cAcked = 0;
+}
+
+void StreamReceiver::
+CongestionControl::restart(StreamReceiver* s)
+{
+    // For TCP connections that have been idle for more than one
+    // retransmission timeout, cWin is reduced to the value of the
+    // restart window (IW) before transmission begins. [RFC 2581 4.1]
+    s->cWin = std::min(s->cWin, s->getInitialCongestionWindowSize());
+}
+
+//
+// Reno [RFC 2581]
+//
+
+void StreamReceiver::
+Reno::ack(StreamReceiver* s, s32 acked)
+{
+    if (s->cWin < s->ssThresh)
+    {
+        // Slow start (open exponentially): increase cWin by at
+        // most one segment on each ack for new data.
+        s->cWin += std::min(acked, s->mss);
+        if (s->ssThresh <= s->cWin)
+        {
+            // Switching to congestion avoidance
+            s->cAcked = 0;
+        }
+    }
+    else
+    {
+        // Congestion avoidance (open linearly): increase cWin by
+        // 1 full-sized segment per RTT on each non-duplicate ACK.
+        s->cAcked += acked;
+        while (s->cWin <= s->cAcked)
+        {
+            s->cAcked -= s->cWin;
+            s->cWin += s->mss;
+        }
+    }
+}
+
+void StreamReceiver::
+Reno::loss(StreamReceiver* s)
+{
+    s->cutThresh();
+}
+
+void StreamReceiver::
+Reno::timeout(StreamReceiver* s)
+{
+    s->cutThresh();
+    s->cWin = s->mss;
+}
+
+//
+// CUBIC [RFC 8312]
+//
+// cWin grows as a cubic function of the time elapsed since the last
+// congestion event, W(t) = C * (t - K)^3 + W_max, independently of the
+// RTT. Everything below is computed in integer arithmetic; times are
+// in milliseconds, and windows are in bytes.
+//
+
+void StreamReceiver::
+Cubic::reset()
+{
+    wMax = 0;
+    wLastMax = 0;
+    wEst = 0;
+    k = 0;
+    epoch = 0;
+    remainder = 0;
+    estRemainder = 0;
+    minRtt = 0;
+    hystart = true;
+    roundEnd = 0;
+    roundStart = 0;
+    lastAck = 0;
+    currRoundMinRtt = 0;
+    lastRoundMinRtt = 0;
+}
+
+// Returns the integer cube root of n (0 <= n).
+s64 StreamReceiver::
+Cubic::cubeRoot(s64 n)
+{
+    s64 x = 0;
+    for (int shift = 63 / 3 * 3; 0 <= shift; shift -= 3)
+    {
+        x <<= 1;
+        s64 y = 3 * x * (x + 1) + 1;
+        if ((n >> shift) >= y)
+        {
+            n -= y << shift;
+            ++x;
+        }
+    }
+    return x;
+}
+
+void StreamReceiver::
+Cubic::start(StreamReceiver* s)
+{
+    CongestionControl::start(s);
+    reset();
+    startRound(s);
+}
+
+void StreamReceiver::
+Cubic::startRound(StreamReceiver* s)
+{
+    roundEnd = s->sendMax;
+    roundStart = lastAck = DateTime::getNow();
+    lastRoundMinRtt = currRoundMinRtt;
+    currRoundMinRtt = 0;
+}
+
+void StreamReceiver::
+Cubic::exitSlowStart(StreamReceiver* s)
+{
+    s->ssThresh = s->cWin;
+    s->cAcked = 0;
+    hystart = false;
+}
+
+void StreamReceiver::
+Cubic::ack(StreamReceiver* s, s32 acked)
+{
+    DateTime now = DateTime::getNow();
+
+    if (s->cWin < s->ssThresh)
+    {
+        if (hystart && HYSTART_LOW_WINDOW * s->mss <= s->cWin)
+        {
+            if (roundEnd <= TCPSeq(s->sendUna + acked))
+            {
+                startRound(s);
+            }
+            else if (now - lastAck <= HYSTART_ACK_DELTA)
+            {
+                // ACK train: the ACKs of a round keep arriving closely
+                // spaced for longer than half of the minimum RTT.
+                lastAck = now;
+                if (minRtt != 0 && minRtt / 2 <= now - roundStart)
+                {
+                    exitSlowStart(s);
+                    return;
+                }
+            }
+        }
+
+        // Slow start
+        s->cWin += std::min(acked, s->mss);
+        if (s->ssThresh <= s->cWin)
+        {
+            // Switching to congestion avoidance
+            s->cAcked = 0;
+        }
+        return;
+    }
+
+    // Congestion avoidance
+    if (epoch == 0)
+    {
+        epoch = now;
+        remainder = 0;
+        estRemainder = 0;
+        if (s->cWin < wMax)
+        {
+            // K = cubic_root((W_max - cwnd) / C)
+            k = cubeRoot((s64) (wMax - s->cWin) * 1024 * 1000000000LL / (C * s->mss));
+        }
+        else
+        {
+            k = 0;
+            wMax = s->cWin;
+        }
+        wEst = s->cWin;
+    }
+
+    // Compute the window one RTT ahead, W(t + RTT).
+    s64 t = (s64) (now - epoch + minRtt) / TimeSpan::TICKS_PER_MILLISECOND;
+    s64 d = std::min(std::max(t - k, -MAX_DELTA), MAX_DELTA);
+    s64 offset = d * d * d * C / 1024 * s->mss / 1000000000LL;
+    s64 target = wMax + offset;
+    target = std::max(target, (s64) s->cWin);
+    target = std::min(target, (s64) s->cWin * 3 / 2);
+
+    // Increase cWin by (target - cWin) / cWin per acked segment.
+    remainder += (s64) acked * (target - s->cWin);
+    s32 inc = (s32) (remainder / s->cWin);
+    remainder -= (s64) inc * s->cWin;
+    s->cWin += inc;
+
+    // TCP-friendly region: W_est grows by 3 * (1 - beta) / (1 + beta)
+    // segments per RTT.
+    estRemainder += (s64) acked * s->mss * 3 * (1024 - BETA) / (1024 + BETA);
+    inc = (s32) (estRemainder / s->cWin);
+    estRemainder -= (s64) inc * s->cWin;
+    wEst += inc;
+    if (s->cWin < wEst)
+    {
+        s->cWin = wEst;
+    }
+}
+
+void StreamReceiver::
+Cubic::rtt(StreamReceiver* s, TimeSpan rtt)
+{
+    if (minRtt == 0 || rtt < minRtt)
+    {
+        minRtt = rtt;
+    }
+
+    if (!hystart || s->ssThresh <= s->cWin || s->cWin < HYSTART_LOW_WINDOW * s->mss)
+    {
+        return;
+    }
+
+    // Delay increase: this TCP times one segment per RTT, so each round
+    // gets a single sample that is compared against the previous round.
+    if (currRoundMinRtt == 0 || rtt < currRoundMinRtt)
+    {
+        currRoundMinRtt = rtt;
+    }
+    if (lastRoundMinRtt != 0)
+    {
+        TimeSpan eta = lastRoundMinRtt / 8;
+        eta = std::min(std::max(eta, HYSTART_DELAY_MIN), HYSTART_DELAY_MAX);
+        if (lastRoundMinRtt + eta <= currRoundMinRtt)
+        {
+            exitSlowStart(s);
+        }
+    }
+}
+
+void StreamReceiver::
+Cubic::loss(StreamReceiver* s)
+{
+    epoch = 0;
+    hystart = false;
+
+    // Fast convergence: release bandwidth for the new flows if the
+    // window did not reach the last saturation point.
+    if (s->cWin < wLastMax)
+    {
+        wLastMax = s->cWin;
+        wMax = (s32) ((s64) s->cWin * (1024 + BETA) / 2048);
+    }
+    else
+    {
+        wLastMax = wMax = s->cWin;
+    }
+
+    s->ssThresh = (s32) ((s64) s->cWin * BETA / 1024);
+    s->ssThresh = std::max(s->ssThresh, 2 * s->mss);
+}
+
+void StreamReceiver::
+Cubic::timeout(StreamReceiver* s)
+{
+    loss(s);
+    s->cWin = s->mss;
+}
+
+void StreamReceiver::
+Cubic::restart(StreamReceiver* s)
+{
+    CongestionControl::restart(s);
+
+    // Do not count the idle period in the cubic growth.
+    epoch = 0;
+}
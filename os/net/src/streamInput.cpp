@@ -64,6 +64,7 @@ sendReset(InetMessenger* m)
     rst->setLocalPort(m->getLocalPort());
     rst->setRemotePort(m->getRemotePort());
     rst->setType(IPPROTO_TCP);
+    InetStatistics::increment(InetStatistics::TcpOutRsts);
     Visitor v(rst);
     conduit->accept(&v, conduit->getB());
 }
@@ -91,6 +92,7 @@ sendReset()
     rst->setLocalPort(socket->getLocalPort());
     rst->setRemotePort(socket->getRemotePort());
     rst->setType(IPPROTO_TCP);
+    InetStatistics::increment(InetStatistics::TcpOutRsts);
     Visitor v(rst);
     conduit->accept(&v, conduit->getB());
 }
@@ -187,7 +189,7 @@ trim(u16& flag, TCPSeq& seq, u16& urg, long& len, long& offset)
 //
 // The slow start is used when cWin (congestion window) < ssThresh
 // (slow start threshold), while the congestion avoidance is used
-// when cWin >= ssThresh.
+// when cWin >= ssThresh. See streamCongestion.cpp for the algorithms.
 void StreamReceiver::
 openWindow(TCPSeq ack)
 {
@@ -216,28 +218,9 @@ openWindow(TCPSeq ack)
         return;
     }
 
-    if (cWin < ssThresh)
-    {
-        // Slow start (open exponentially): increase cWin by at
-        // most one segment on each ack for new data.
-        cWin += std::min(ack - sendUna, mss);
-        if (ssThresh <= cWin)
-        {
-            // Switching to congestion avoidance
-            cAcked = 0;
-        }
-    }
-    else
-    {
-        // Congestion avoidance (open linearly): increase cWin by
-        // 1 full-sized segment per RTT on each non-duplicate ACK.
-        cAcked += (ack - sendUna);
-        while (cWin <= cAcked)
-        {
-            cAcked -= cWin;
-            cWin += mss;
-        }
-    }
+    // Slow start and congestion avoidance are up to the congestion
+    // control algorithm.
+    cc->ack(this, ack - sendUna);
 
     // Check expand overflow.
     if (65535 < cWin) // [MAY] support window scale option
@@ -300,8 +283,9 @@ ack(TCPSeq seq, TCPSeq ack, s32 win, s32 sent, long len)
                 return true;
             }
 
-            cutThresh();
+            cc->loss(this);
             sendRecover = sendMax;
+            ++recoveries;
 
             // Retransmit the lost segment
             fastRxmit = true;
@@ -406,6 +390,9 @@ ack(TCPSeq seq, TCPSeq ack, s32 win, s32 sent, long len)
         sendFack = sendUna;
         sendAwin = sendNext - sendFack + rxmitData;
     }
+#ifdef TCP_SACK
+    deleteSackHoles(ack);
+#endif  // TCP_SACK
 
     // Update the send buffer (sendPtr and sendLen)
     bool finAcked;
@@ -426,6 +413,7 @@ ack(TCPSeq seq, TCPSeq ack, s32 win, s32 sent, long len)
         sendRing.skip(len);
         sendLen -= len;
         sent -= len;
+        outOctets += len;
 
         notify();
     }
@@ -514,12 +502,32 @@ text(InetMessenger* m, u16& flag, TCPSeq seq,
                 // Trigger sending an acknowledgement [RFC 813]
                 ackNow = true;
             } // Otherwise, postpone sending an ACK
-            recvRing.write(m->fix(adv, m->getPosition() + offset), adv, 0,
-                           asb, TCPHdr::ASB_MAX);
+            recvRing.write(m->fix(adv, m->getPosition() + offset), adv);
 
             // Do not shrink window right edge
             recvNext += adv;
             recvWin -= adv;
+            inOctets += adv;
+
+            // A segment that fills in a gap should be acknowledged at
+            // once. [RFC 5681 4.2]
+            if (!recvBlocks.isEmpty())
+            {
+                s32 pulled = pullRecvBlocks();
+                if (0 < pulled)
+                {
+                    inOctets += pulled;
+                    ackNow = true;
+                }
+            }
+
+            // An ACK should be generated for at least every second
+            // full-sized segment [RFC 1122, RFC 5681]. A segment coalesced
+            // by the network interface is acknowledged at once.
+            if (2 * mss <= recvNext - recvAcked)
+            {
+                ackNow = true;
+            }
 
             notify();
         }
@@ -539,8 +547,11 @@ text(InetMessenger* m, u16& flag, TCPSeq seq,
         // [RFC 1122] While it is not strictly required,
         // a TCP SHOULD be capable of queuing out-of-order
         // TCP segments.
-        recvRing.write(m->fix(adv, m->getPosition() + offset), adv, seq - recvNext,
-                       asb, TCPHdr::ASB_MAX);
+        long count = recvRing.poke(m->fix(adv, m->getPosition() + offset), adv, seq - recvNext);
+        if (0 < count)
+        {
+            addRecvBlock(seq, seq + count);
+        }
 
         // Trun off FIN
         if (flag & TCPHdr::FIN)
@@ -631,8 +642,7 @@ option(TCPHdr* tcphdr)
         // Update mss to the default minimum value (536), if
         // TCPHdr::OPT_MSS option is not specified.
         this->mss = std::min(this->mss, mss);
-        cWin = getInitialCongestionWindowSize();
-        ssThresh = DEF_SSTHRESH;
+        cc->start(this);
     }
 
     return true;
@@ -651,6 +661,67 @@ StateClosed::input(InetMessenger* m, StreamReceiver* s)
     return false;
 }
 
+// Gets the MSS and the SACK permitted options of a SYN segment.
+static bool getSynOptions(TCPHdr* tcphdr, s32& mss, bool& sack)
+{
+    int optlen = tcphdr->getHdrSize() - sizeof(TCPHdr);
+    u8* opt = reinterpret_cast<u8*>(tcphdr) + sizeof(TCPHdr);   // XXX use m->fix
+    while (0 < optlen && *opt != TCPHdr::OPT_EOL)
+    {
+        int len;
+        if (*opt == TCPHdr::OPT_NOP)
+        {
+            len = 1;
+        }
+        else if (optlen < 2)
+        {
+            return false;
+        }
+        else
+        {
+            len = opt[1];
+            if (len < 2 || optlen < len)
+            {
+                return false;
+            }
+        }
+
+        switch (*opt)
+        {
+          case TCPHdr::OPT_MSS:
+            if (len != sizeof(TCPOptMss))
+            {
+                return false;
+            }
+            mss = reinterpret_cast<TCPOptMss*>(opt)->getMSS();
+            if (mss <= 0)
+            {
+                return false;
+            }
+            break;
+#ifdef TCP_SACK
+          case TCPHdr::OPT_SACKP:
+            if (len != sizeof(TCPOptSackPermitted))
+            {
+                return false;
+            }
+            sack = true;
+            break;
+#endif // TCP_SACK
+          default:
+            // Do not process unknown options.
+            break;
+        }
+
+        opt += len;
+        optlen -= len;
+    }
+    return 0 <= optlen;
+}
+
+// A SYN is answered from the listening socket itself. The socket for the
+// connection is created when the ACK for the SYN-ACK arrives, either from
+// the SYN table or from the SYN cookie acknowledged by the peer.
 bool StreamReceiver::
 StateListen::input(InetMessenger* m, StreamReceiver* s)
 {
@@ -658,83 +729,105 @@ StateListen::input(InetMessenger* m, StreamReceiver* s)
     u16 flag = ntohs(tcphdr->flag);
     TCPSeq seq = ntohl(tcphdr->seq);
     TCPSeq ack = ntohl(tcphdr->ack);
-    u16    urg = ntohs(tcphdr->urg);
-    long   offset = tcphdr->getHdrSize();
-    long   len = s->getSegmentLength(m, offset, flag);
+
+    SynEntry** prev = s->lookupSyn(m);
+    SynEntry* entry = prev ? *prev : 0;
 
     if (flag & TCPHdr::RST)
     {
-        return false;   // Ignore RST
+        // Return to the LISTEN state [RFC 793]
+        if (entry && seq == TCPSeq(entry->irs + 1))
+        {
+            s->removeSyn(prev);
+        }
+        return false;
     }
 
-    if (flag & TCPHdr::ACK)
+    if (flag & TCPHdr::SYN)
     {
-        s->sendReset(m);
+        if (flag & TCPHdr::ACK)
+        {
+            s->sendReset(m);
+            return false;
+        }
+
+        // Update mss to the default minimum value (536), if
+        // TCPHdr::OPT_MSS option is not specified.
+        s32 mss = s->getDefaultMSS();
+        bool sack = false;
+        if (!getSynOptions(tcphdr, mss, sack))
+        {
+            return false;
+        }
+
+        // A retransmitted SYN is answered by the same SYN-ACK. There is no
+        // retransmission timer for the table entries; the peer keeps
+        // retransmitting its SYN until the SYN-ACK arrives.
+        if (!entry)
+        {
+            entry = s->addSyn(m);
+            if (!entry)
+            {
+                // The table is full; send a SYN cookie.
+                s->sendSynAck(m, s->makeCookie(m, seq, mss, sack), seq, sack);
+                return false;
+            }
+            entry->irs = seq;
+            entry->iss = s->isn(m);
+        }
+        else if (entry->irs != seq)
+        {
+            entry->irs = seq;
+            entry->iss = s->isn(m);
+        }
+        entry->mss = mss;
+        entry->sack = sack;
+        s->sendSynAck(m, entry->iss, entry->irs, sack);
         return false;
     }
 
-    if (!(flag & TCPHdr::SYN))
+    if (!(flag & TCPHdr::ACK))
     {
         // Unlikely to get here, but drop the segment and return
         return false;
     }
 
-    Handle<Address> local = m->getLocal();
-
-    // Clone new socket
-    ASSERT(s->socket);
-    Socket* socket = new Socket(s->socket->getAddressFamily(), es::Socket::Stream);
-    socket->setLocal(local);
-    socket->setLocalPort(m->getLocalPort());
-    socket->setRemote(Handle<Address>(m->getRemote()));
-    socket->setRemotePort(m->getRemotePort());
-
-    SocketInstaller installer(socket);
-    socket->getProtocol()->accept(&installer);
-
-    StreamReceiver* accepted = dynamic_cast<StreamReceiver*>(socket->getReceiver());
-    ASSERT(accepted);
-
-    // Initialize ISS and sequence number variables
-    accepted->mss = accepted->getDefaultMSS(local->getPathMTU());
-    accepted->cWin = accepted->getInitialCongestionWindowSize();
-    accepted->ssThresh = DEF_SSTHRESH;
-    accepted->iss = accepted->isn(m);
-    accepted->recvAcked = accepted->irs = accepted->irs = seq;
-    accepted->recvNext = seq + 1;       // just for SYN. Segment will be trimmed later.
-    accepted->recvUp = accepted->recvNext;
-
-    accepted->sendUna = accepted->iss;
-    accepted->sendNext = accepted->iss; // Updated (i.e. +1 for SYN) later by TCPOutput().
-    accepted->sendMax = accepted->iss;  // Updated (i.e. +1 for SYN) later by TCPOutput().
-    accepted->sendUp = accepted->iss;
-
-    accepted->lastSack = accepted->sendFack = accepted->sendRecover = accepted->sendUna;
-    accepted->rxmitData = 0;
-    accepted->sendAwin = 0;
-
-    if (!accepted->option(tcphdr))
+    TCPSeq iss;
+    TCPSeq irs;
+    s32 mss;
+    bool sack;
+    if (entry && ack == TCPSeq(entry->iss + 1))
+    {
+        iss = entry->iss;
+        irs = entry->irs;
+        mss = entry->mss;
+        sack = entry->sack;
+    }
+    else if (!entry && s->checkCookie(m, ack - 1, seq - 1, mss, sack))
     {
-        accepted->abort();
+        iss = ack - 1;
+        irs = seq - 1;
+    }
+    else
+    {
+        s->sendReset(m);
         return false;
     }
 
-    accepted->listening = s;
-
-    if (s->parConn + s->pendingConn >= s->backLogCount)
+    if (s->backLogCount <= s->pendingConn)
     {
-        accepted->abort();
-        return false; // Ignore SYN when full
+        // Drop the ACK while the accepted-queue is full. The peer will
+        // retransmit it together with its data.
+        return false;
     }
-    else
+    if (entry)
     {
-        s->parConn++; // count partial connection
+        s->removeSyn(prev);
     }
-    //++interface->tcpStat.passiveOpens;
-    accepted->setState(stateSynReceived);
 
-    // To send <SEQ=ISS><ACK=RCV.NXT><CTL=SYN,ACK>,
-    // move on to URG bit check in TCPIn()
+    StreamReceiver* accepted = s->createAccepted(m, iss, irs, mss, sack);
+
+    // Complete the handshake in StateSynReceived::input()
     Visitor v(m);
     accepted->conduit->accept(&v);
 
@@ -953,8 +1046,6 @@ StateSynReceived::input(InetMessenger* m, StreamReceiver* s)
                 StreamReceiver* listening = s->listening;
                 Synchronized<es::Monitor*> method(listening->monitor);
 
-                listening->parConn--; 
-                ASSERT(listening->parConn >= 0);
                 listening->pendingConn++;
                 listening->accepted.addLast(s);
                 listening->notify();
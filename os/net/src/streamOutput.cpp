@@ -30,19 +30,10 @@ countOptionSize(u16 flag)
 #endif  // TCP_SACK
     }
 #ifdef TCP_SACK
-    else if (sack && !(flag & TCPHdr::RST) && (flag & TCPHdr::ACK) && asb[0].data)
+    else if (sack && !(flag & TCPHdr::RST) && (flag & TCPHdr::ACK) && !recvBlocks.isEmpty())
     {
-        Ring::Vec* block;
-
         optlen += 2;
-        for (block = &asb[TCPHdr::ASB_MAX - 1]; asb <= block; --block)
-        {
-            if (block->data)
-            {
-                break;
-            }
-        }
-        optlen += (block + 1 - asb) * (2 * sizeof(s32));
+        optlen += countSackBlocks() * (2 * sizeof(s32));
     }
 #endif  // TCP_SACK
     return (optlen + 3) & ~3;
@@ -62,14 +53,15 @@ fillOptions(u8* opt, u16 flag)
 #endif
     }
 #ifdef TCP_SACK
-    else if (sack && !(flag & TCPHdr::RST) && (flag & TCPHdr::ACK) && asb[0].data)
+    else if (sack && !(flag & TCPHdr::RST) && (flag & TCPHdr::ACK) && !recvBlocks.isEmpty())
     {
         while (((ptr - opt) & 3) != 2)
         {
             new(ptr) TCPOptNop;
             ptr += sizeof(TCPOptNop);
         }
-        TCPOptSack* optSack = new(ptr) TCPOptSack(recvRing.getHead(), recvRing.getSize(), asb, recvNext - recvRing.getUsed());
+        TCPOptSack* optSack = new(ptr) TCPOptSack;
+        fillSackOption(optSack);
         ptr += optSack->len;
     }
 #endif  // TCP_SACK
@@ -115,8 +107,7 @@ getSendable()
         sendRecover = sendMax;
         dupAcks = 0;
 
-        hole = 0;
-        sendHoles = 0;
+        clearScoreboard();
         sendFack = sendUna;
         rxmitData = 0;
         sendAwin = 0;
@@ -240,9 +231,32 @@ canSend(s32 len, s32 mss, u16 flag)
     return false;
 }
 
+// Returns true if a large send super-segment can be sent. Only new data
+// is sent in super-segments; retransmissions, window probes, urgent data,
+// and the segments sent during the loss recovery are sent one by one.
+bool StreamReceiver::
+canLargeSend(InetMessenger* m, u16 flag)
+{
+    return socket->getAddressFamily() == AF_INET &&     // XXX v4 only
+           !(flag & (TCPHdr::SYN | TCPHdr::RST)) &&
+           m->getFlag() != es::Socket::MsgOob &&
+           sendUp <= sendNext &&
+           sendMax <= sendNext &&
+           !hole && !fastRxmit && !persist &&
+           dupAcks < LIMITED_THRESH;
+}
+
 bool StreamReceiver::
 send(InetMessenger* m, s32 sendable, u16 flag)
 {
+    // Restart the connection that has been idle for more than one
+    // retransmission timeout. [RFC 2581 4.1]
+    if (sendUna == sendMax && 0 < sendable && !(flag & TCPHdr::SYN) &&
+        lastSend != 0 && rto < DateTime::getNow() - lastSend)
+    {
+        cc->restart(this);
+    }
+
     // If the window size is zero and the persist timer has been expired,
     // send a window probe.
     int win = std::min(sendWin, cWin);
@@ -306,6 +320,20 @@ send(InetMessenger* m, s32 sendable, u16 flag)
     // Calculate send length
     int optlen = countOptionSize(flag);
     s32 len = std::min(mss - optlen, std::min(sendable, useable));
+#ifdef TCP_LARGE_SEND
+    if (len == mss - optlen && canLargeSend(m, flag))
+    {
+        // Send a super-segment of the whole segments at once. It is split
+        // into segments of (mss - optlen) by the network interface.
+        s32 large = std::min(LARGE_SEND_MAX, (s32) m->getPosition() - (14 + 60 + 60));
+        large = std::min(large, std::min(sendable, useable));
+        if (large < sendable)
+        {
+            large -= large % (mss - optlen);
+        }
+        len = std::max(len, large);
+    }
+#endif  // TCP_LARGE_SEND
     if (0 < len && len == sendable && !hole &&
         (flag & (TCPHdr::SYN | TCPHdr::RST | TCPHdr::FIN)) == 0)
     {
@@ -356,10 +384,18 @@ send(InetMessenger* m, s32 sendable, u16 flag)
         {
             --count;
         }
+        m->setSegmentSize((mss - optlen < count) ? mss - optlen : 0);
         if (0 < count)
         {
             m->movePosition(-count);
-            sendRing.peek(m->fix(count), count, sendNext - sendUna);
+            sendRing.peek(m->fix(count), count, sendNext - sendUna, reader);
+            if (m->getSegmentSize() == 0 && reader->isEmpty())
+            {
+                // Sum up the payload while it is still in the cache. The
+                // payload read from the streams later is summed up by the
+                // TCP layer.
+                m->setPayloadSum(m->sumUp(count), count);
+            }
         }
     }
 
@@ -416,6 +452,13 @@ send(InetMessenger* m, s32 sendable, u16 flag)
     // Make TCP option(s)
     fillOptions(reinterpret_cast<u8*>(tcphdr) + sizeof(TCPHdr), flag);
 
+    // A large send super-segment goes out as multiple segments.
+    int segments = 1;
+    if (0 < m->getSegmentSize())
+    {
+        segments = (len + m->getSegmentSize() - 1) / m->getSegmentSize();
+    }
+
     sendNext += len;
     if (sendMax < sendNext) // Not a retransmission?
     {
@@ -423,16 +466,12 @@ send(InetMessenger* m, s32 sendable, u16 flag)
         // must not be reflected to sendMax.
         if (sendNext <= TCPSeq(sendUna + sendWin))
         {
-            // ++interface->tcpStat.outSegs;
             sendMax = sendNext;
         }
-        else
-        {
-            // ++interface->tcpStat.retransSegs;
-        }
+        InetStatistics::increment(InetStatistics::TcpOutSegs, segments);
 
         // If round trip timer isn't running, start it
-        if (rttTiming != 0)
+        if (rttTiming == 0)
         {
             rttTiming = DateTime::getNow();
             rttSeq = seq;
@@ -440,7 +479,12 @@ send(InetMessenger* m, s32 sendable, u16 flag)
     }
     else if (0 < len)
     {
-        // ++interface->tcpStat.retransSegs;
+        InetStatistics::increment(InetStatistics::TcpRetransSegs, segments);
+        retransmits += segments;
+    }
+    else
+    {
+        InetStatistics::increment(InetStatistics::TcpOutSegs);
     }
 
     // Start retransmission timer
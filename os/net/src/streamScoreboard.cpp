@@ -22,24 +22,190 @@
 
 const int StreamReceiver::RXMIT_THRESH = 3;
 
+//
+// Receiver side
+//
+
+// Records the out-of-order data [start, end) written in recvRing, merging
+// it with the blocks it overlaps or adjoins.
+void StreamReceiver::
+addRecvBlock(TCPSeq start, TCPSeq end)
+{
+    BlockTree::Node* node;
+
+    node = recvBlocks.getFloor(start);
+    if (node && start <= node->getValue())
+    {
+        start = node->getKey();
+        end = std::max(end, node->getValue());
+        recvBlocks.remove(start);
+    }
+    while ((node = recvBlocks.getCeiling(start)) && node->getKey() <= end)
+    {
+        end = std::max(end, node->getValue());
+        recvBlocks.remove(node->getKey());
+    }
+    recvBlocks.add(start, end);
+    recvLast = start;
+}
+
+// Fills in recvRing the blocks that have become in-order, and returns the
+// number of bytes recvNext advanced.
+s32 StreamReceiver::
+pullRecvBlocks()
+{
+    BlockTree::Node* node;
+    s32 pulled = 0;
+
+    while ((node = recvBlocks.getFirst()) && node->getKey() <= recvNext)
+    {
+        TCPSeq end = node->getValue();
+        recvBlocks.remove(node->getKey());
+        if (recvNext < end)
+        {
+            s32 count = recvRing.fill(end - recvNext);
+            recvNext += count;
+            recvWin -= count;
+            pulled += count;
+        }
+    }
+    return pulled;
+}
+
+void StreamReceiver::
+clearRecvBlocks()
+{
+    BlockTree::Node* node;
+
+    while ((node = recvBlocks.getFirst()))
+    {
+        recvBlocks.remove(node->getKey());
+    }
+}
+
+// Returns the number of the blocks to be reported in the SACK option.
+int StreamReceiver::
+countSackBlocks()
+{
+    BlockTree::Node* node;
+    int count = 0;
+
+    for (node = recvBlocks.getFirst();
+         node && count < TCPHdr::ASB_MAX;
+         node = recvBlocks.getNext(node))
+    {
+        ++count;
+    }
+    return count;
+}
+
+// The first block reports the segment received last [RFC 2018]. The rest
+// are taken from the left so that the sender learns the oldest holes first.
+void StreamReceiver::
+fillSackOption(TCPOptSack* optSack)
+{
+    BlockTree::Node* last;
+    BlockTree::Node* node;
+
+    last = recvBlocks.getFloor(recvLast);
+    if (last && recvLast < last->getValue())
+    {
+        optSack->add(last->getKey(), last->getValue());
+    }
+    else
+    {
+        last = 0;
+    }
+    for (node = recvBlocks.getFirst();
+         node && optSack->getCount() < TCPHdr::ASB_MAX;
+         node = recvBlocks.getNext(node))
+    {
+        if (node != last)
+        {
+            optSack->add(node->getKey(), node->getValue());
+        }
+    }
+}
+
+//
+// Sender side
+//
+
+StreamReceiver::SackHole* StreamReceiver::
+addSackHole(TCPSeq start, TCPSeq end, int dupAcks, TCPSeq rxmit)
+{
+    ASSERT(start < end);
+    SackHole* hole = new SackHole;
+    hole->start = start;
+    hole->end = end;
+    hole->dupAcks = dupAcks;
+    hole->rxmit = rxmit;
+    scoreboard.add(start, hole);
+    ++sendHoles;
+    rxmitData += hole->rxmit - hole->start;
+    return hole;
+}
+
+// Shrinks the hole to [start, end) keeping rxmit within the hole. The
+// order of the holes does not change.
+void StreamReceiver::
+trimSackHole(HoleTree::Node* node, TCPSeq start, TCPSeq end)
+{
+    SackHole* hole = node->getValue();
+
+    ASSERT(hole->start <= start && start < end && end <= hole->end);
+    rxmitData -= hole->rxmit - hole->start;
+    hole->start = start;
+    hole->end = end;
+    hole->rxmit = std::min(std::max(hole->rxmit, start), end);
+    node->getKey() = start;
+    rxmitData += hole->rxmit - hole->start;
+}
+
+void StreamReceiver::
+removeSackHole(HoleTree::Node* node)
+{
+    SackHole* hole = node->getValue();
+
+    rxmitData -= hole->rxmit - hole->start;
+    scoreboard.remove(node->getKey());
+    --sendHoles;
+    delete hole;
+}
+
+void StreamReceiver::
+clearScoreboard()
+{
+    HoleTree::Node* node;
+
+    while ((node = scoreboard.getFirst()))
+    {
+        removeSackHole(node);
+    }
+    hole = 0;
+    lastSack = sendUna;
+}
+
 // Returns SackHole for the oldest pending retransmission.
 StreamReceiver::SackHole* StreamReceiver::
 getSackHole()
 {
-    const SackHole* hole;
-    const SackHole* holeEnd;
+    HoleTree::Node* node;
+    SackHole* hole;
 
     ASSERT(RXMIT_THRESH <= dupAcks);
-    holeEnd = &scoreboard[sendHoles];
-    for (hole = scoreboard; hole < holeEnd; ++hole)
+    for (node = scoreboard.getCeiling(rxmitHole); node; node = scoreboard.getNext(node))
     {
-        if (hole->rxmit < hole->end && (fastRxmit || RXMIT_THRESH <= hole->dupAcks))
+        hole = node->getValue();
+        rxmitHole = hole->start;
+        if (hole->rxmit < hole->end)
         {
             if (hole->rxmit < sendUna)    // Stale SACK hole
             {
                 continue;
             }
-            return (SackHole*) hole;
+            // The holes to the right have got no more dup acks.
+            return (fastRxmit || RXMIT_THRESH <= hole->dupAcks) ? hole : 0;
         }
     }
     return 0;
@@ -49,48 +215,36 @@ getSackHole()
 void StreamReceiver::
 deleteSackHoles(TCPSeq ack)
 {
-    TCPSeq      lastAck;
-    SackHole*   hole;
-    SackHole*   holeEnd;
+    HoleTree::Node* node;
+    TCPSeq          lastAck;
 
     if (!sack || state == &stateListen || sendMax < ack)
     {
         return;
     }
     lastAck = std::max(sendUna, ack);
-    holeEnd = &scoreboard[sendHoles];
-    for (hole = scoreboard; hole < holeEnd; ++hole)
+    while ((node = scoreboard.getFirst()))
     {
+        SackHole* hole = node->getValue();
         if (lastAck < hole->end)
         {
-            break;
-        }
-    }
-    if (scoreboard < hole)
-    {
-        sendHoles = holeEnd - hole;
-        memmove(scoreboard, hole, (size_t) ((u8*) holeEnd - (u8*) hole));
-    }
-    if (0 < sendHoles)
-    {
-        hole = scoreboard;
-        if (hole->start < lastAck)
-        {
-            hole->start = lastAck;
-            if (hole->rxmit < hole->start)
+            if (hole->start < lastAck)
             {
-                hole->rxmit = hole->start;
+                trimSackHole(node, lastAck, hole->end);
             }
+            break;
         }
+        removeSackHole(node);
     }
+    sendAwin = (sendNext - sendFack) + rxmitData;
 }
 
 // Update the SACK scoreboard parsing the TCP SACK option.
 void StreamReceiver::
 updateScoreboard(TCPSeq ack, TCPOptSack* optSack)
 {
+    HoleTree::Node* node;
     SackHole*   hole;
-    SackHole*   holeEnd;
     TCPSeq      start; // left edge
     TCPSeq      end;   // right edge
 
@@ -99,7 +253,7 @@ updateScoreboard(TCPSeq ack, TCPOptSack* optSack)
         return;
     }
 
-    for (int i = 0; i < (optSack->len - 2) / 8; ++i)
+    for (int i = 0; i < optSack->getCount(); ++i)
     {
         start = ntohl(optSack->edge[i].left);
         end = ntohl(optSack->edge[i].right);
@@ -118,138 +272,80 @@ updateScoreboard(TCPSeq ack, TCPOptSack* optSack)
             sendFack = end;
         }
 
-        if (sendHoles == 0)   // Scoreboard is empty.
+        if (scoreboard.isEmpty())
         {
-            sendHoles = 1;
-
-            hole = &scoreboard[0];
-            hole->start = ack;
-            hole->end = start;
-            ASSERT(hole->start < hole->end);
-            hole->rxmit = hole->start;
-            hole->dupAcks = std::min(RXMIT_THRESH, (end - hole->end) / mss);
-            if (hole->dupAcks < 1)
+            rxmitHole = ack;
+            if (lastSack < ack)
             {
-                hole->dupAcks = 1;
+                lastSack = ack;
             }
-            lastSack = end;
-            continue;
         }
 
-        holeEnd = &scoreboard[sendHoles];
-        for (hole = scoreboard; hole < holeEnd; ++hole)
+        // Cut the block out of the holes. As the holes do not overlap,
+        // only the one found by getFloor() can begin to the left of start.
+        node = scoreboard.getFloor(start);
+        if (!node || node->getValue()->end <= start)
         {
-            if (end <= hole->start)     // Left side
-            {
-                break;
-            }
-            if (hole->end <= start)     // Right side
-            {
-                ++hole->dupAcks;
-                if (RXMIT_THRESH <= (end - hole->end) / mss)
-                {
-                    hole->dupAcks = RXMIT_THRESH;
-                }
-            }
-            else if (start <= hole->start)  // Left edge
+            node = scoreboard.getCeiling(start);
+        }
+        while (node && node->getKey() < end)
+        {
+            hole = node->getValue();
+            if (start <= hole->start)       // Left edge
             {
-                rxmitData -= std::min(hole->rxmit, end) - hole->start;
                 if (hole->end <= end)       // Cover
                 {
-                    memmove(hole, hole + 1, (size_t) ((u8*) holeEnd - (u8*) (hole + 1)));
-                    --holeEnd;
-                    --sendHoles;
-                    --hole;
+                    removeSackHole(node);
                 }
                 else
                 {
-                    hole->start = end;
-                    hole->rxmit = std::max(hole->rxmit, hole->start);
+                    trimSackHole(node, end, hole->end);
+                    break;
                 }
             }
             else if (hole->end <= end)      // Right edge
             {
-                if (start < hole->rxmit)
-                {
-                    rxmitData -= hole->rxmit - start;
-                }
-                hole->end = start;
-                hole->rxmit = std::min(hole->rxmit, hole->end);
-                ++hole->dupAcks;
-                if (RXMIT_THRESH <= (end - hole->end) / mss)
-                {
-                    hole->dupAcks = RXMIT_THRESH;
-                }
+                trimSackHole(node, hole->start, start);
             }
-            else                // In the middle
+            else                            // In the middle
             {
-                ASSERT(hole->start < start);
-                ASSERT(end < hole->end);
-                if (sendHoles < TCPHdr::ASB_MAX)
-                {
-                    memmove(hole + 1, hole, (size_t) ((u8*) holeEnd - (u8*) hole));
-                    ++holeEnd;
-                    ++sendHoles;
-                }
-                else if (hole < holeEnd - 1)
-                {
-                    lastSack = (holeEnd - 1)->start;
-                    memmove(hole + 1, hole, (size_t) ((u8*) (holeEnd - 1) - (u8*) hole));
-                }
-                else
-                {
-                    lastSack = end;
-                }
-                if (end < hole->rxmit)
-                {
-                    rxmitData -= end - start;
-                }
-                else if (start < hole->rxmit)
-                {
-                    rxmitData -= hole->rxmit - start;
-                }
-                hole->end = start;
-                hole->rxmit = std::min(hole->rxmit, hole->end);
-                ++hole->dupAcks;
-                if (RXMIT_THRESH <= (end - hole->end) / mss)
-                {
-                    hole->dupAcks = RXMIT_THRESH;
-                }
-                ++hole;
-                if (hole < holeEnd)
-                {
-                    hole->start = end;
-                    hole->rxmit = std::max(hole->rxmit, hole->start);
-                }
-                // else XXX rxmitData would no longer be correct... timeout should recover this...
+                TCPSeq holeEnd = hole->end;
+                TCPSeq rxmit = std::max(hole->rxmit, end);
+                trimSackHole(node, hole->start, start);
+                addSackHole(end, holeEnd, hole->dupAcks, rxmit);
+                break;
             }
+            node = scoreboard.getCeiling(start);
         }
-        if (lastSack < start)   // Append new hole at end.
+
+        // Count a dup ack for each hole to the left of the block. A hole
+        // never has fewer dup acks than the holes to its right, so the
+        // walk stops at the first hole that has reached the threshold.
+        for (node = scoreboard.getFloor(start); node; node = scoreboard.getPrevious(node))
         {
-            if (TCPHdr::ASB_MAX <= sendHoles)
+            hole = node->getValue();
+            if (RXMIT_THRESH <= hole->dupAcks)
             {
-                continue;
+                break;
             }
-            hole = &scoreboard[sendHoles];
-            ++sendHoles;
-            hole->start = lastSack;
-            hole->end = start;
-            hole->dupAcks = std::min(RXMIT_THRESH, (end - start) / mss);
-            if (hole->dupAcks < 1)
+            ++hole->dupAcks;
+            if (RXMIT_THRESH <= (end - hole->end) / mss)
             {
-                hole->dupAcks = 1;
+                hole->dupAcks = RXMIT_THRESH;
             }
-            hole->rxmit = hole->start;
+        }
+
+        if (lastSack < start)   // Append new hole at end.
+        {
+            addSackHole(lastSack, start,
+                        std::max(1, std::min(RXMIT_THRESH, (end - start) / mss)),
+                        lastSack);
+        }
+        if (lastSack < end)
+        {
             lastSack = end;
         }
     }
 
-    // Update rxmitData and sendAwin.
-    rxmitData = 0;
-    holeEnd = &scoreboard[sendHoles];
-    for (hole = scoreboard; hole < holeEnd; ++hole)
-    {
-        rxmitData += hole->rxmit - hole->start;
-    }
     sendAwin = (sendNext - sendFack) + rxmitData;
 }
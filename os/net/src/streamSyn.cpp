@@ -0,0 +1,432 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <new>
+#ifndef __es__
+#include <fcntl.h>
+#include <unistd.h>
+#endif  // __es__
+#include <es/handle.h>
+#include <es/md5.h>
+#include "stream.h"
+
+namespace
+{
+    // The peer MSS values that can be encoded in a SYN cookie.
+    const s32 cookieMss[] = { 536, 1300, 1460, 8960 };
+
+    u8   cookieSecret[16];
+    bool cookieSecretReady;
+
+    // Fills the SYN cookie secret from /dev/urandom. Without it, the jitter
+    // of the time stamp counter sampled across the clock is hashed instead.
+    void initCookieSecret()
+    {
+#ifndef __es__
+        int fd = ::open("/dev/urandom", O_RDONLY);
+        if (0 <= fd)
+        {
+            ssize_t len = ::read(fd, cookieSecret, sizeof cookieSecret);
+            ::close(fd);
+            if (len == sizeof cookieSecret)
+            {
+                return;
+            }
+        }
+#endif  // __es__
+        MD5Context context;
+        MD5Init(&context);
+        for (int i = 0; i < 64; ++i)
+        {
+            s64 ticks = DateTime::getNow().getTicks();
+            MD5Update(&context, &ticks, sizeof ticks);
+#if defined(__i386__) || defined(__x86_64__)
+            u32 lo;
+            u32 hi;
+            __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+            MD5Update(&context, &lo, sizeof lo);
+            MD5Update(&context, &hi, sizeof hi);
+#endif
+        }
+        MD5Final(cookieSecret, &context);
+    }
+
+    int hashSyn(Address* remote, u16 remotePort, int size)
+    {
+        u32 h = (u32) (reinterpret_cast<unsigned long>(remote) >> 4);
+        h ^= remotePort * 2654435761u;
+        h ^= h >> 16;
+        return h & (size - 1);
+    }
+
+    u32 hashCookie(InetMessenger* m, TCPSeq irs, u32 bits)
+    {
+        MD5Context      context;
+        u8              bytes[16];
+        Handle<Address> address;
+        int             len;
+        u16             port;
+        s32             seq;
+
+        MD5Init(&context);
+        MD5Update(&context, cookieSecret, sizeof cookieSecret);
+
+        address = m->getRemote();
+        len = address->getAddress(bytes, sizeof bytes);
+        MD5Update(&context, bytes, len);
+        port = htons(m->getRemotePort());
+        MD5Update(&context, &port, 2);
+
+        address = m->getLocal();
+        len = address->getAddress(bytes, sizeof bytes);
+        MD5Update(&context, bytes, len);
+        port = htons(m->getLocalPort());
+        MD5Update(&context, &port, 2);
+
+        seq = htonl(irs);
+        MD5Update(&context, &seq, 4);
+        MD5Update(&context, &bits, 4);
+
+        MD5Final(bytes, &context);
+        return *(u32*) &bytes[0];
+    }
+}
+
+void StreamReceiver::
+setBackLogCount(int len)
+{
+    Synchronized<es::Monitor*> method(monitor);
+
+    backLogCount = (len <= 0) ? 1 : std::min(len, MaxConn);
+    initSynTable(backLogCount);
+}
+
+// Sizes the table of the half-open connections for the backlog. The ones
+// of the previous listen() are carried over as far as they fit.
+void StreamReceiver::
+initSynTable(int size)
+{
+    if (!cookieSecretReady)
+    {
+        initCookieSecret();
+        cookieSecretReady = true;
+    }
+
+    SynEntry* oldTable = synTable;
+    SynEntry** oldHash = synHash;
+    int oldHashSize = synHashSize;
+
+    synTable = new SynEntry[size];
+    for (synHashSize = 1; synHashSize < size; synHashSize <<= 1)
+    {
+    }
+    synHash = new SynEntry*[synHashSize];
+    for (int i = 0; i < synHashSize; ++i)
+    {
+        synHash[i] = 0;
+    }
+    synFree = 0;
+    for (int i = size - 1; 0 <= i; --i)
+    {
+        synTable[i].next = synFree;
+        synFree = &synTable[i];
+    }
+    synCount = 0;
+
+    if (oldHash)
+    {
+        for (int i = 0; i < oldHashSize; ++i)
+        {
+            while (SynEntry* entry = oldHash[i])
+            {
+                oldHash[i] = entry->next;
+                SynEntry* copy = synFree;
+                if (!copy)
+                {
+                    entry->remote->release();
+                    entry->local->release();
+                    continue;
+                }
+                synFree = copy->next;
+                *copy = *entry;
+                SynEntry** head = &synHash[hashSyn(copy->remote, copy->remotePort, synHashSize)];
+                copy->next = *head;
+                *head = copy;
+                ++synCount;
+            }
+        }
+        delete[] oldHash;
+    }
+    if (oldTable)
+    {
+        delete[] oldTable;
+    }
+}
+
+void StreamReceiver::
+clearSynTable()
+{
+    if (!synHash)
+    {
+        return;
+    }
+    for (int i = 0; i < synHashSize; ++i)
+    {
+        while (synHash[i])
+        {
+            removeSyn(&synHash[i]);
+        }
+    }
+}
+
+// Returns the link to the entry of the connection, if any. The expired
+// entries found on the way are removed.
+StreamReceiver::SynEntry** StreamReceiver::
+lookupSyn(InetMessenger* m)
+{
+    if (!synHash)
+    {
+        return 0;
+    }
+
+    Handle<Address> remote = m->getRemote();
+    Handle<Address> local = m->getLocal();
+    u16 remotePort = m->getRemotePort();
+    DateTime now = DateTime::getNow();
+    SynEntry** prev = &synHash[hashSyn(remote, remotePort, synHashSize)];
+    while (SynEntry* entry = *prev)
+    {
+        if (entry->expiration <= now)
+        {
+            removeSyn(prev);
+            continue;
+        }
+        if (entry->remote == remote && entry->remotePort == remotePort &&
+            entry->local == local && entry->localPort == m->getLocalPort())
+        {
+            return prev;
+        }
+        prev = &entry->next;
+    }
+    return 0;
+}
+
+// Returns a new entry for the connection, or zero if the table is full.
+StreamReceiver::SynEntry* StreamReceiver::
+addSyn(InetMessenger* m)
+{
+    if (!synFree && synHash)
+    {
+        // Purge the expired entries.
+        DateTime now = DateTime::getNow();
+        for (int i = 0; i < synHashSize; ++i)
+        {
+            SynEntry** prev = &synHash[i];
+            while (SynEntry* entry = *prev)
+            {
+                if (entry->expiration <= now)
+                {
+                    removeSyn(prev);
+                }
+                else
+                {
+                    prev = &entry->next;
+                }
+            }
+        }
+    }
+
+    SynEntry* entry = synFree;
+    if (!entry)
+    {
+        return 0;
+    }
+    synFree = entry->next;
+
+    entry->remote = m->getRemote();
+    entry->local = m->getLocal();
+    entry->remotePort = m->getRemotePort();
+    entry->localPort = m->getLocalPort();
+    entry->expiration = DateTime::getNow() + SYN_TIMEOUT;
+
+    SynEntry** head = &synHash[hashSyn(entry->remote, entry->remotePort, synHashSize)];
+    entry->next = *head;
+    *head = entry;
+    ++synCount;
+    return entry;
+}
+
+void StreamReceiver::
+removeSyn(SynEntry** prev)
+{
+    SynEntry* entry = *prev;
+    *prev = entry->next;
+    entry->remote->release();
+    entry->local->release();
+    entry->remote = entry->local = 0;
+    entry->next = synFree;
+    synFree = entry;
+    --synCount;
+}
+
+// Send <SEQ=ISS><ACK=IRS+1><CTL=SYN,ACK> from the listening socket.
+void StreamReceiver::
+sendSynAck(InetMessenger* m, TCPSeq iss, TCPSeq irs, bool sack)
+{
+    int optlen = sizeof(TCPOptMss);
+#ifdef TCP_SACK
+    if (sack)
+    {
+        optlen += sizeof(TCPOptSackPermitted);
+    }
+#endif  // TCP_SACK
+    optlen = (optlen + 3) & ~3;
+
+    int size = 14 + 60 + sizeof(TCPHdr) + optlen;   // XXX Assume MAC, IPv4
+    Handle<InetMessenger> seg = new InetMessenger(&InetReceiver::output, size, size - sizeof(TCPHdr) - optlen);
+
+    Handle<Address> local = m->getLocal();
+    TCPHdr* tcphdr = static_cast<TCPHdr*>(seg->fix(sizeof(TCPHdr) + optlen));
+    tcphdr->src = htons(m->getLocalPort());
+    tcphdr->dst = htons(m->getRemotePort());
+    tcphdr->seq = htonl(iss);
+    tcphdr->ack = htonl(irs + 1);
+    tcphdr->flag = htons(TCPHdr::SYN | TCPHdr::ACK);
+    tcphdr->win = htons(std::min(socket->getReceiveBufferSize(), 65535));
+    tcphdr->sum = 0;
+    tcphdr->urg = 0;
+    tcphdr->setHdrSize(sizeof(TCPHdr) + optlen);
+
+    u8* opt = reinterpret_cast<u8*>(tcphdr) + sizeof(TCPHdr);
+    u8* ptr = opt;
+    new(ptr) TCPOptMss(getDefaultMSS(local->getPathMTU()));
+    ptr += sizeof(TCPOptMss);
+#ifdef TCP_SACK
+    if (sack)
+    {
+        new(ptr) TCPOptSackPermitted();
+        ptr += sizeof(TCPOptSackPermitted);
+    }
+#endif  // TCP_SACK
+    while (ptr - opt < optlen)
+    {
+        new(ptr) TCPOptEol;
+        ptr += sizeof(TCPOptEol);
+    }
+
+    seg->setLocal(local);
+    seg->setRemote(Handle<Address>(m->getRemote()));
+    seg->setLocalPort(m->getLocalPort());
+    seg->setRemotePort(m->getRemotePort());
+    seg->setType(IPPROTO_TCP);
+    InetStatistics::increment(InetStatistics::TcpOutSegs);
+    Visitor v(seg);
+    conduit->accept(&v, conduit->getB());
+}
+
+// Encodes the connection into the ISS. The cookie consists of the
+// counter of COOKIE_PERIOD (5 bits), the index to cookieMss (2 bits),
+// the SACK permitted bit, and the MAC of the connection (24 bits).
+TCPSeq StreamReceiver::
+makeCookie(InetMessenger* m, TCPSeq irs, s32 mss, bool sack)
+{
+    u32 index = sizeof cookieMss / sizeof cookieMss[0] - 1;
+    while (0 < index && mss < cookieMss[index])
+    {
+        --index;
+    }
+    u32 counter = (u32) (DateTime::getNow().getTicks() / COOKIE_PERIOD.getTicks());
+    u32 bits = (counter & 31) << 27 | index << 25 | (sack ? 1 : 0) << 24;
+
+    ++cookiesSent;
+    cookieExpiration = DateTime::getNow() + TimeSpan(2 * COOKIE_PERIOD.getTicks());
+    return TCPSeq((s32) (bits | (hashCookie(m, irs, bits) & 0xffffff)));
+}
+
+// Checks the ISS acknowledged by the peer is a cookie issued during the
+// current or the previous COOKIE_PERIOD.
+bool StreamReceiver::
+checkCookie(InetMessenger* m, TCPSeq iss, TCPSeq irs, s32& mss, bool& sack)
+{
+    if (cookieExpiration <= DateTime::getNow())
+    {
+        return false;   // No cookies have been sent recently.
+    }
+
+    u32 cookie = (u32) (s32) iss;
+    u32 bits = cookie & 0xff000000;
+    u32 counter = (u32) (DateTime::getNow().getTicks() / COOKIE_PERIOD.getTicks());
+    if ((bits >> 27) != (counter & 31) && (bits >> 27) != ((counter - 1) & 31))
+    {
+        return false;
+    }
+    if ((cookie & 0xffffff) != (hashCookie(m, irs, bits) & 0xffffff))
+    {
+        return false;
+    }
+    mss = cookieMss[(bits >> 25) & 3];
+    sack = (bits >> 24) & 1;
+    return true;
+}
+
+// Creates the socket for the connection whose handshake has just been
+// completed, in the SYN-RECEIVED state with the SYN-ACK sent.
+StreamReceiver* StreamReceiver::
+createAccepted(InetMessenger* m, TCPSeq iss, TCPSeq irs, s32 mss, bool sack)
+{
+    Handle<Address> local = m->getLocal();
+
+    // Clone new socket
+    ASSERT(socket);
+    Socket* clone = new Socket(socket->getAddressFamily(), es::Socket::Stream);
+    clone->setCongestionControl(socket->getCongestionControl());
+    clone->setReceiveBufferSize(socket->getReceiveBufferSize());
+    clone->setSendBufferSize(socket->getSendBufferSize());
+    clone->setLocal(local);
+    clone->setLocalPort(m->getLocalPort());
+    clone->setRemote(Handle<Address>(m->getRemote()));
+    clone->setRemotePort(m->getRemotePort());
+
+    SocketInstaller installer(clone);
+    clone->getProtocol()->accept(&installer);
+
+    StreamReceiver* accepted = dynamic_cast<StreamReceiver*>(clone->getReceiver());
+    ASSERT(accepted);
+
+    // Initialize sequence number variables as of the SYN-ACK
+    accepted->mss = std::min(accepted->getDefaultMSS(local->getPathMTU()), mss);
+    accepted->sack = sack;
+    accepted->cc->start(accepted);
+    accepted->iss = iss;
+    accepted->irs = irs;
+    accepted->recvAcked = accepted->recvNext = irs + 1;
+    accepted->recvUp = accepted->recvNext;
+
+    accepted->sendUna = iss;
+    accepted->sendNext = iss + 1;
+    accepted->sendMax = iss + 1;
+    accepted->sendUp = iss;
+
+    accepted->lastSack = accepted->sendFack = accepted->sendRecover = accepted->sendUna;
+    accepted->rxmitData = 0;
+    accepted->sendAwin = 0;
+
+    accepted->listening = this;
+    InetStatistics::increment(InetStatistics::TcpPassiveOpens);
+    accepted->setState(stateSynReceived);
+    return accepted;
+}
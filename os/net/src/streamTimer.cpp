@@ -51,6 +51,8 @@ void StreamReceiver::updateRto(TimeSpan rtt)
     rxmitCount = 0;
     rto = srtt + 4 * rttDe;
     rto = std::min(std::max(RTT_MIN, rto), RTT_MAX);
+
+    cc->rtt(this, rtt);
 }
 
 void StreamReceiver::startRxmitTimer()
@@ -119,6 +121,8 @@ expired()
 
     if (!isPersist())
     {
+        ++timeouts;
+
         // Path MTU discovery blackhole detection [RFC 2923]
         if (PMTUD_BACKOFF == rxmitCount && state->hasBeenEstablished())
         {
@@ -163,8 +167,7 @@ expired()
     rttTiming = 0;
 
     // Goes back to slow start
-    cutThresh();
-
+    //
     // RFC 2581 3.1 Slow Start and Congestion Avoidance
     //
     //  Furthermore, upon a timeout cwnd MUST be set to no more than the loss
@@ -175,7 +178,7 @@ expired()
     //  point congestion avoidance again takes over.
     //
     // We must *NOT* set cWin to IW(info).
-    cWin = mss;
+    cc->timeout(this);
 
     // RFC 3782
     // After a retransmit timeout, record the highest sequence number
@@ -193,7 +196,7 @@ expired()
 
     // After a retransmit timeout the data sender SHOULD turn off all of
     // the SACKed bits [RFC 2018]
-    sendHoles = 0;
+    clearScoreboard();
 #endif
     sendFack = sendUna;
     rxmitData = 0;
@@ -17,13 +17,14 @@
 
 #include <es/handle.h>
 #include <es/net/inet4.h>
+#include "inetStatistics.h"
 #include "tcp.h"
 
 s16 TCPReceiver::
 checksum(InetMessenger* m)
 {
     int len = m->getLength();
-    s32 sum = m->sumUp(len);
+    s32 sum = m->sumUp(len - m->getPayloadSize()) + m->getPayloadSum();
     Handle<Address> addr;
     addr = m->getRemote();
     sum += addr->sumUp();
@@ -43,11 +44,13 @@ bool TCPReceiver::input(InetMessenger* m, Conduit* c)
     TCPHdr* tcphdr = static_cast<TCPHdr*>(m->fix(sizeof(TCPHdr)));
     if (!tcphdr)
     {
+        InetStatistics::increment(InetStatistics::TcpInErrs);
         return false;
     }
     int hlen = tcphdr->getHdrSize();
     if (hlen < sizeof(TCPHdr) || m->getLength() < hlen)
     {
+        InetStatistics::increment(InetStatistics::TcpInErrs);
         return false;
     }
 
@@ -63,8 +66,10 @@ bool TCPReceiver::input(InetMessenger* m, Conduit* c)
     // Verify the sum
     if (checksum(m) != 0)
     {
+        InetStatistics::increment(InetStatistics::TcpInErrs);
         return false;
     }
+    InetStatistics::increment(InetStatistics::TcpInSegs);
 
     m->setRemotePort(ntohs(tcphdr->src));
     m->setLocalPort(ntohs(tcphdr->dst));
@@ -79,7 +84,11 @@ bool TCPReceiver::output(InetMessenger* m, Conduit* c)
     tcphdr->src = htons(m->getLocalPort());
     tcphdr->dst = htons(m->getRemotePort());
     tcphdr->sum = 0;
-    tcphdr->sum = checksum(m);
+    if (m->getSegmentSize() == 0)
+    {
+        tcphdr->sum = checksum(m);
+    }
+    // else the sum of each segment is calculated by the network interface.
     m->setType(IPPROTO_TCP);
 
     return true;
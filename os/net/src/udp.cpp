@@ -19,6 +19,7 @@
 #include <es/net/inet4.h>
 #include <es/net/icmp.h>
 #include "inet4address.h"
+#include "inetStatistics.h"
 #include "socket.h"
 #include "udp.h"
 
@@ -47,17 +48,20 @@ input(InetMessenger* m, Conduit* c)
     UDPHdr* udphdr = static_cast<UDPHdr*>(m->fix(sizeof(UDPHdr)));
     if (!udphdr)
     {
+        InetStatistics::increment(InetStatistics::UdpInErrors);
         return false;   // XXX
     }
     int len = ntohs(udphdr->len);
     if (len < sizeof(UDPHdr) || m->getLength() < len)
     {
+        InetStatistics::increment(InetStatistics::UdpInErrors);
         return false;   // XXX
     }
 
     // Verify the sum
     if (udphdr->sum && checksum(m) != 0)
     {
+        InetStatistics::increment(InetStatistics::UdpInErrors);
         return false;
     }
 
@@ -108,6 +112,7 @@ output(InetMessenger* m, Conduit* c)
     s16 sum = checksum(m);
     udphdr->sum = (sum == 0) ? 0xffff : sum;
     m->setType(IPPROTO_UDP);
+    InetStatistics::increment(InetStatistics::UdpOutDatagrams);
 
     return true;
 }
@@ -127,6 +132,8 @@ error(InetMessenger* m, Conduit* c)
 bool UDPUnreachReceiver::
 input(InetMessenger* m, Conduit* c)
 {
+    InetStatistics::increment(InetStatistics::UdpNoPorts);
+
     // Now we need to access the original IP header.
     m->restorePosition();
     IPHdr* iphdr = static_cast<IPHdr*>(m->fix(sizeof(IPHdr)));
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Opens connections to a listening socket over the loopback interface as
+// fast as possible and reports the connections per second. Then opens more
+// connections at once than the backlog, so that the handshakes have to be
+// completed with SYN cookies.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+#include "stream.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int CONNECTIONS = 500;
+    const int BURST = 16;
+
+    Handle<Inet4Address> localhost;
+
+    struct Server
+    {
+        Socket*     listening;
+        int         count;      // Number of connections to accept
+        int         received;
+    };
+}
+
+static void* serve(void* param)
+{
+    Server* server = static_cast<Server*>(param);
+
+    for (int i = 0; i < server->count; ++i)
+    {
+        es::Socket* socket;
+        while ((socket = server->listening->accept()) == 0)
+        {
+        }
+        u8 byte;
+        if (socket->read(&byte, 1) == 1 && byte == (u8) 'x')
+        {
+            ++server->received;
+        }
+        socket->close();
+        socket->release();
+    }
+    return 0;
+}
+
+static void* dial(void* param)
+{
+    Socket client(AF_INET, es::Socket::Stream);
+    client.connect(localhost, reinterpret_cast<long>(param));
+    u8 byte = 'x';
+    TEST(client.write(&byte, 1) == 1);
+    client.close();
+    return 0;
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    // Connections one after another
+    Server server;
+    server.listening = new Socket(AF_INET, es::Socket::Stream);
+    server.listening->bind(localhost, 80);
+    server.listening->listen(128);
+    server.count = CONNECTIONS;
+    server.received = 0;
+    es::Thread* thread = esCreateThread(serve, &server);
+    thread->start();
+
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        dial(reinterpret_cast<void*>(80));
+    }
+    thread->join();
+    thread->release();
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    ASSERT(server.received == CONNECTIONS);
+    esReport("%d connections: %lld connections/sec\n",
+             CONNECTIONS, CONNECTIONS * 1000LL / std::max(1LL, ms));
+
+    StreamReceiver* receiver = dynamic_cast<StreamReceiver*>(server.listening->getReceiver());
+    ASSERT(receiver);
+    ASSERT(receiver->getCookiesSent() == 0);
+    server.listening->close();
+    server.listening->release();
+
+    // More connections at once than the backlog. The connections that do
+    // not fit in the SYN table are completed with SYN cookies once the
+    // accepted-queue is drained.
+    server.listening = new Socket(AF_INET, es::Socket::Stream);
+    server.listening->bind(localhost, 81);
+    server.listening->listen(2);
+    server.count = BURST;
+    server.received = 0;
+
+    es::Thread* clients[BURST];
+    for (int i = 0; i < BURST; ++i)
+    {
+        clients[i] = esCreateThread(dial, reinterpret_cast<void*>(81));
+        clients[i]->start();
+    }
+    esSleep(10000000);  // Let the accepted-queue fill up.
+
+    start = DateTime::getNow();
+    thread = esCreateThread(serve, &server);
+    thread->start();
+    for (int i = 0; i < BURST; ++i)
+    {
+        clients[i]->join();
+        clients[i]->release();
+    }
+    thread->join();
+    thread->release();
+    ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    ASSERT(server.received == BURST);
+
+    receiver = dynamic_cast<StreamReceiver*>(server.listening->getReceiver());
+    ASSERT(receiver);
+    esReport("%d connections with backlog 2: %lld msec, %ld SYN cookies\n",
+             BURST, ms, receiver->getCookiesSent());
+    ASSERT(0 < receiver->getCookiesSent());
+    server.listening->close();
+    server.listening->release();
+
+    esReport("done.\n");
+}
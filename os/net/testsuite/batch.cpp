@@ -0,0 +1,160 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sends small UDP datagrams over the loopback interface one by one with
+// sendTo and recvFrom, and then in batches with sendBatch and recvBatch,
+// and reports the datagrams per second of each. The server echoes the
+// batches back to their sources.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+
+namespace
+{
+    const int COUNT = 4096;
+    const int LEN = 64;
+    const int BATCH = 16;
+
+    u8 output[BATCH * LEN];
+    u8 input[es::Socket::BatchMax * LEN];
+}
+
+static long long rate(int count, const DateTime& start)
+{
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    return count * 1000LL / std::max(1LL, ms);
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+
+    // Register localhost address
+    Handle<Inet4Address> localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID, 8);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    Socket server(AF_INET, es::Socket::Datagram);
+    server.setReceiveBufferSize(64 * 1024);
+    server.bind(localhost, 53);
+    server.setTimeout(10000000);    // 1 sec
+    Socket client(AF_INET, es::Socket::Datagram);
+    client.setReceiveBufferSize(64 * 1024);
+    client.connect(localhost, 53);
+    client.setTimeout(10000000);    // 1 sec
+
+    for (int i = 0; i < BATCH; ++i)
+    {
+        memset(output + i * LEN, i, LEN);
+    }
+
+    // One datagram per call
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < COUNT; ++i)
+    {
+        TEST(client.write(output, LEN) == LEN);
+        TEST(server.recvFrom(input, sizeof input, 0) == LEN);
+        Handle<es::InternetAddress> addr = server.getRecvFromAddress();
+        TEST(server.sendTo(input, LEN, 0, addr, server.getRecvFromPort()) == LEN);
+        TEST(client.read(input, sizeof input) == LEN);
+    }
+    long long single = rate(COUNT, start);
+    esReport("sendTo/recvFrom: %lld datagrams/sec\n", single);
+
+    // BATCH datagrams per call
+    int lengths[BATCH];
+    for (int i = 0; i < BATCH; ++i)
+    {
+        lengths[i] = LEN;
+    }
+    start = DateTime::getNow();
+    for (int i = 0; i < COUNT; i += BATCH)
+    {
+        TEST(client.sendBatch(output, sizeof output, lengths, BATCH, 0) == BATCH);
+
+        int received = 0;
+        while (received < BATCH)
+        {
+            int len = server.recvBatch(input, sizeof input, BATCH - received, 0);
+            ASSERT(0 < len);
+            int count = server.getBatchCount();
+            ASSERT(len == count * LEN);
+            for (int j = 0; j < count; ++j)
+            {
+                ASSERT(server.getBatchLength(j) == LEN);
+                ASSERT(server.getBatchPort(j) == client.getLocalPort());
+                ASSERT(input[j * LEN] == received + j);
+            }
+
+            // Echo back to the sources recorded by recvBatch.
+            TEST(server.sendBatch(input, len, lengths, count, 0) == count);
+            received += count;
+        }
+
+        received = 0;
+        while (received < BATCH)
+        {
+            int len = client.recvBatch(input, sizeof input, es::Socket::BatchMax, 0);
+            ASSERT(0 < len);
+            int count = client.getBatchCount();
+            for (int j = 0; j < count; ++j)
+            {
+                ASSERT(input[j * LEN] == received + j);
+            }
+            received += count;
+        }
+        ASSERT(received == BATCH);
+    }
+    long long batched = rate(COUNT, start);
+    esReport("sendBatch/recvBatch: %lld datagrams/sec (%d per call)\n", batched, BATCH);
+
+    // The first datagram is truncated to the buffer, and the rest are left
+    // queued if they do not fit.
+    TEST(client.sendBatch(output, sizeof output, lengths, 2, 0) == 2);
+    TEST(server.recvBatch(input, LEN / 2, BATCH, 0) == LEN / 2);
+    ASSERT(server.getBatchCount() == 1);
+    TEST(server.recvBatch(input, sizeof input, BATCH, 0) == LEN);
+    ASSERT(server.getBatchCount() == 1);
+    ASSERT(input[0] == 1);
+
+    client.close();
+    server.close();
+
+    esReport("done.\n");
+}
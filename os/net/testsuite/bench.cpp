@@ -0,0 +1,366 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the network stack over the emulated loopback link: TCP bulk
+// throughput, TCP request/response latency, TCP connection setup rate,
+// and UDP datagrams per second. The time spent in each layer is reported
+// for each of them.
+//
+// usage: bench [-d delay(usec)] [-l loss(ppm)] [-r reorder(ppm)] [-b rate(bytes/sec)]
+//              [-c coalescing(0/1)]
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "inetProfile.h"
+#include "socket.h"
+#include "netem.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int BULK = 4 * 1024 * 1024;
+    const int CHUNK = 8192;
+    const int ROUNDS = 1000;
+    const int REQUEST = 64;
+    const int CONNECTIONS = 200;
+    const int DATAGRAMS = 10000;
+    const int DATAGRAM = 64;
+    const int BUFFER_SIZE = 64 * 1024;
+
+    Handle<Inet4Address> localhost;
+
+    long long latency[ROUNDS];
+}
+
+static long long elapsed(const DateTime& start)
+{
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    return std::max(1LL, ms);
+}
+
+static void begin(const char* name)
+{
+    esReport("\n%s\n", name);
+    InetProfile::reset();
+    InetProfile::enable(true);
+}
+
+static void end()
+{
+    InetProfile::enable(false);
+    InetProfile::report();
+}
+
+static Socket* openListening(int port)
+{
+    Socket* listening = new Socket(AF_INET, es::Socket::Stream);
+    listening->setReceiveBufferSize(BUFFER_SIZE);
+    listening->setSendBufferSize(BUFFER_SIZE);
+    listening->bind(localhost, port);
+    listening->listen(128);
+    return listening;
+}
+
+static es::Socket* acceptOne(Socket* listening)
+{
+    es::Socket* socket;
+    while ((socket = listening->accept()) == 0)
+    {
+    }
+    return socket;
+}
+
+static bool readFully(es::Socket* socket, u8* buf, int len)
+{
+    while (0 < len)
+    {
+        int count = socket->read(buf, len);
+        if (count <= 0)
+        {
+            return false;
+        }
+        buf += count;
+        len -= count;
+    }
+    return true;
+}
+
+// Receives the bulk data until the peer closes the connection.
+static void* sink(void* param)
+{
+    Socket* listening = static_cast<Socket*>(param);
+    es::Socket* socket = acceptOne(listening);
+    static u8 buf[CHUNK];
+    long total = 0;
+    int count;
+    while (0 < (count = socket->read(buf, sizeof buf)))
+    {
+        total += count;
+    }
+    socket->close();
+    socket->release();
+    return reinterpret_cast<void*>(total);
+}
+
+// Echoes the requests until the peer closes the connection.
+static void* echo(void* param)
+{
+    Socket* listening = static_cast<Socket*>(param);
+    es::Socket* socket = acceptOne(listening);
+    u8 buf[REQUEST];
+    while (readFully(socket, buf, sizeof buf))
+    {
+        socket->write(buf, sizeof buf);
+    }
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static void* acceptAll(void* param)
+{
+    Socket* listening = static_cast<Socket*>(param);
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        es::Socket* socket = acceptOne(listening);
+        u8 byte;
+        socket->read(&byte, 1);
+        socket->close();
+        socket->release();
+    }
+    return 0;
+}
+
+static void* flood(void* param)
+{
+    Socket* client = static_cast<Socket*>(param);
+    u8 buf[DATAGRAM];
+    memset(buf, 0, sizeof buf);
+    for (int i = 0; i < DATAGRAMS; ++i)
+    {
+        client->write(buf, sizeof buf);
+    }
+    return 0;
+}
+
+static void bulk()
+{
+    begin("TCP bulk throughput");
+
+    Socket* listening = openListening(80);
+    es::Thread* thread = esCreateThread(sink, listening);
+    thread->start();
+
+    static u8 buf[CHUNK];
+    memset(buf, 'x', sizeof buf);
+    DateTime start = DateTime::getNow();
+    Socket client(AF_INET, es::Socket::Stream);
+    client.setReceiveBufferSize(BUFFER_SIZE);
+    client.setSendBufferSize(BUFFER_SIZE);
+    client.connect(localhost, 80);
+    for (int sent = 0; sent < BULK; sent += sizeof buf)
+    {
+        TEST(client.write(buf, sizeof buf) == sizeof buf);
+    }
+    client.close();
+    long total = reinterpret_cast<long>(thread->join());
+    thread->release();
+    long long ms = elapsed(start);
+    end();
+
+    ASSERT(total == BULK);
+    esReport("%d bytes: %lld kbps\n", BULK, BULK * 8LL / ms);
+    listening->close();
+    listening->release();
+}
+
+static void requestResponse()
+{
+    begin("TCP request/response latency");
+
+    Socket* listening = openListening(81);
+    es::Thread* thread = esCreateThread(echo, listening);
+    thread->start();
+
+    Socket client(AF_INET, es::Socket::Stream);
+    client.connect(localhost, 81);
+    u8 buf[REQUEST];
+    memset(buf, 'x', sizeof buf);
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        DateTime start = DateTime::getNow();
+        TEST(client.write(buf, sizeof buf) == sizeof buf);
+        TEST(readFully(&client, buf, sizeof buf));
+        latency[i] = (DateTime::getNow() - start).getTicks();
+    }
+    client.close();
+    thread->join();
+    thread->release();
+    end();
+
+    std::sort(latency, latency + ROUNDS);
+    long long usec = TimeSpan::TICKS_PER_MILLISECOND / 1000;
+    esReport("%d rounds of %d bytes: p50 %lld usec, p90 %lld usec, p99 %lld usec, max %lld usec\n",
+             ROUNDS, REQUEST,
+             latency[ROUNDS * 50 / 100] / usec,
+             latency[ROUNDS * 90 / 100] / usec,
+             latency[ROUNDS * 99 / 100] / usec,
+             latency[ROUNDS - 1] / usec);
+    listening->close();
+    listening->release();
+}
+
+static void connectionRate()
+{
+    begin("TCP connection setup rate");
+
+    Socket* listening = openListening(82);
+    es::Thread* thread = esCreateThread(acceptAll, listening);
+    thread->start();
+
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        Socket client(AF_INET, es::Socket::Stream);
+        client.connect(localhost, 82);
+        u8 byte = 'x';
+        TEST(client.write(&byte, 1) == 1);
+        client.close();
+    }
+    thread->join();
+    thread->release();
+    long long ms = elapsed(start);
+    end();
+
+    esReport("%d connections: %lld connections/sec\n",
+             CONNECTIONS, CONNECTIONS * 1000LL / ms);
+    listening->close();
+    listening->release();
+}
+
+static void datagramRate()
+{
+    begin("UDP datagrams per second");
+
+    Socket server(AF_INET, es::Socket::Datagram);
+    server.setReceiveBufferSize(BUFFER_SIZE);
+    server.bind(localhost, 53);
+    server.setTimeout(10000000);    // 1 sec
+    Socket client(AF_INET, es::Socket::Datagram);
+    client.connect(localhost, 53);
+
+    DateTime start = DateTime::getNow();
+    es::Thread* thread = esCreateThread(flood, &client);
+    thread->start();
+    int received = 0;
+    u8 buf[DATAGRAM];
+    while (received < DATAGRAMS && server.read(buf, sizeof buf) == DATAGRAM)
+    {
+        ++received;
+    }
+    long long ms = elapsed(start);
+    thread->join();
+    thread->release();
+    end();
+
+    ASSERT(0 < received);
+    esReport("%d/%d datagrams of %d bytes: %lld datagrams/sec\n",
+             received, DATAGRAMS, DATAGRAM, received * 1000LL / ms);
+    client.close();
+    server.close();
+}
+
+int main(int argc, char* argv[])
+{
+    long long delay = 0;    // [usec]
+    int loss = 0;           // [ppm]
+    int reorder = 0;        // [ppm]
+    long long rate = 0;     // [bytes/sec]
+    bool coalescing = false;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+        {
+            delay = atoll(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            loss = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            reorder = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            rate = atoll(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-c") == 0)
+        {
+            coalescing = atoi(argv[i + 1]);
+        }
+    }
+
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup the emulated loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    Netem* netem = new Netem(loopbackInterface);
+    netem->setLink(TimeSpan(delay * (TimeSpan::TICKS_PER_MILLISECOND / 1000)), rate, 256, loss);
+    netem->setReorder(reorder);
+    int scopeID = Socket::addInterface(netem);
+    Socket::getInterface(scopeID)->setCoalescing(coalescing);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID, 8);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    esReport("delay: %lld usec, loss: %d ppm, reorder: %d ppm, rate: %lld bytes/sec, coalescing: %s\n",
+             delay, loss, reorder, rate, coalescing ? "on" : "off");
+
+    bulk();
+    requestResponse();
+    connectionRate();
+    datagramRate();
+
+    esReport("\nframes: %u, dropped: %u, lost: %u, reordered: %u, coalesced: %u\n",
+             netem->getSent(), netem->getDropped(), netem->getLost(), netem->getReordered(),
+             Socket::getInterface(scopeID)->getCoalesced());
+
+    esReport("done.\n");
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs a single bulk transfer over the loopback interface without and with
+// the coalescing of the received TCP segments, checks the received bytes,
+// and reports the throughput and the number of the segments merged.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int TRANSFER_SIZE = 4 * 1024 * 1024;
+    const int CHUNK_SIZE = 8192;
+
+    Handle<Inet4Address> localhost;
+
+    struct Flow
+    {
+        Socket*     listening;
+        long        received;
+        bool        intact;
+    };
+}
+
+static u8 pattern(long offset)
+{
+    return (u8) (offset % 251);
+}
+
+static void* serve(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    es::Socket* socket;
+    while ((socket = flow->listening->accept()) == 0)
+    {
+    }
+
+    u8 buf[CHUNK_SIZE];
+    int len;
+    while (0 < (len = socket->read(buf, sizeof buf)))
+    {
+        for (int i = 0; i < len; ++i)
+        {
+            if (buf[i] != pattern(flow->received + i))
+            {
+                flow->intact = false;
+            }
+        }
+        flow->received += len;
+    }
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static long long run(int port)
+{
+    Flow flow;
+    flow.listening = new Socket(AF_INET, es::Socket::Stream);
+    flow.listening->setReceiveBufferSize(64 * 1024);
+    flow.listening->bind(localhost, port);
+    flow.listening->listen(1);
+    flow.received = 0;
+    flow.intact = true;
+
+    es::Thread* thread = esCreateThread(serve, &flow);
+    thread->start();
+
+    DateTime start = DateTime::getNow();
+    Socket client(AF_INET, es::Socket::Stream);
+    client.setSendBufferSize(64 * 1024);
+    client.connect(localhost, port);
+    u8 buf[CHUNK_SIZE];
+    for (long sent = 0; sent < TRANSFER_SIZE; sent += sizeof buf)
+    {
+        for (int i = 0; i < sizeof buf; ++i)
+        {
+            buf[i] = pattern(sent + i);
+        }
+        TEST(client.write(buf, sizeof buf) == sizeof buf);
+    }
+    client.close();
+    thread->join();
+    thread->release();
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+
+    ASSERT(flow.received == TRANSFER_SIZE);
+    ASSERT(flow.intact);
+    flow.listening->close();
+    flow.listening->release();
+    return TRANSFER_SIZE * 8LL / std::max(1LL, ms);
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+    NetworkInterface* interface = Socket::getInterface(scopeID);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    ASSERT(!interface->isCoalescing());
+    long long base = run(100);
+    ASSERT(interface->getCoalesced() == 0);
+    esReport("without coalescing: %lld kbps\n", base);
+
+    // The loopback interface has no large send offload, so each large send
+    // super-segment is split into back-to-back segments of the MSS without
+    // PSH but the last. As the segments clocked out by an ACK are sent from
+    // the receive queue thread processing the ACK, they are all queued by
+    // the time the thread takes the next batch, and must be merged.
+    interface->setCoalescing(true);
+    ASSERT(interface->isCoalescing());
+    long long kbps = run(101);
+    ASSERT(0 < interface->getCoalesced());
+    esReport("with coalescing: %lld kbps (%lld%%), %u segments merged\n",
+             kbps, 100 * kbps / std::max(1LL, base), interface->getCoalesced());
+
+    esReport("done.\n");
+}
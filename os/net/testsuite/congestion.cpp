@@ -0,0 +1,203 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs Reno and CUBIC bulk transfers through an emulated bottleneck link
+// with delay and random loss, and reports the throughput of each flow
+// together with Jain's fairness index.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "netem.h"
+#include "socket.h"
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int TRANSFER_SIZE = 512 * 1024;
+    const int CHUNK_SIZE = 1024;
+
+    Handle<Inet4Address> localhost;
+
+    struct Flow
+    {
+        int         algorithm;
+        int         port;
+        Socket*     listening;
+        long        received;
+        TimeSpan    elapsed;
+    };
+}
+
+static void* serve(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    es::Socket* socket;
+    while ((socket = flow->listening->accept()) == 0)
+    {
+    }
+    // An accepted socket inherits the algorithm of the listening socket.
+    ASSERT(socket->getCongestionControl() == flow->algorithm);
+
+    DateTime start = DateTime::getNow();
+    u8 buf[CHUNK_SIZE];
+    int len;
+    while (0 < (len = socket->read(buf, sizeof buf)))
+    {
+        for (int i = 0; i < len; ++i)
+        {
+            ASSERT(buf[i] == (u8) (flow->received + i));
+        }
+        flow->received += len;
+    }
+    flow->elapsed = DateTime::getNow() - start;
+
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static void* transmit(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    Socket client(AF_INET, es::Socket::Stream);
+    client.setCongestionControl(flow->algorithm);
+    ASSERT(client.getCongestionControl() == flow->algorithm);
+    client.connect(localhost, flow->port);
+
+    u8 buf[CHUNK_SIZE];
+    for (long sent = 0; sent < TRANSFER_SIZE; sent += CHUNK_SIZE)
+    {
+        for (int i = 0; i < CHUNK_SIZE; ++i)
+        {
+            buf[i] = (u8) (sent + i);
+        }
+        int len = client.write(buf, CHUNK_SIZE);
+        ASSERT(len == CHUNK_SIZE);
+    }
+    client.close();
+    return 0;
+}
+
+// Runs the specified flows at the same time, and returns Jain's
+// fairness index of their throughputs in percent.
+static int run(Flow* flows, int count)
+{
+    es::Thread* receivers[2];
+    es::Thread* senders[2];
+    ASSERT(count <= 2);
+
+    for (int i = 0; i < count; ++i)
+    {
+        flows[i].received = 0;
+        flows[i].listening = new Socket(AF_INET, es::Socket::Stream);
+        flows[i].listening->setCongestionControl(flows[i].algorithm);
+        flows[i].listening->bind(localhost, flows[i].port);
+        flows[i].listening->listen(5);
+        receivers[i] = esCreateThread(serve, &flows[i]);
+        receivers[i]->start();
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        senders[i] = esCreateThread(transmit, &flows[i]);
+        senders[i]->start();
+    }
+
+    long long sum = 0;
+    long long squares = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        senders[i]->join();
+        receivers[i]->join();
+        ASSERT(flows[i].received == TRANSFER_SIZE);
+
+        long long ms = flows[i].elapsed / TimeSpan::TICKS_PER_MILLISECOND;
+        long long kbps = flows[i].received * 8 / std::max(1LL, ms);
+        esReport("%s: %ld bytes in %lld ms, %lld kbps\n",
+                 (flows[i].algorithm == es::Socket::Reno) ? "Reno" : "Cubic",
+                 flows[i].received, ms, kbps);
+        sum += kbps;
+        squares += kbps * kbps;
+
+        flows[i].listening->close();
+        flows[i].listening->release();
+    }
+    return (int) (100 * sum * sum / std::max(1LL, count * squares));
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup the emulated link over the loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    Netem* netem = new Netem(loopbackInterface);
+    int scopeID = Socket::addInterface(netem);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    // Default algorithm
+    Socket socket(AF_INET, es::Socket::Stream);
+    ASSERT(socket.getCongestionControl() == es::Socket::Reno);
+
+    // 20 msec RTT, 1 MB/sec bottleneck with a 32 frame queue.
+    netem->setLink(100000, 1000000, 32, 0);
+    for (int algorithm = es::Socket::Reno; algorithm <= es::Socket::Cubic; ++algorithm)
+    {
+        Flow flow = { algorithm, 60 + algorithm };
+        run(&flow, 1);
+    }
+
+    // The same link with 1% random loss.
+    netem->setLink(100000, 1000000, 32, 10000);
+    for (int algorithm = es::Socket::Reno; algorithm <= es::Socket::Cubic; ++algorithm)
+    {
+        Flow flow = { algorithm, 70 + algorithm };
+        run(&flow, 1);
+    }
+
+    // Reno and CUBIC sharing the bottleneck.
+    netem->setLink(100000, 1000000, 32, 0);
+    Flow flows[2] = {
+        { es::Socket::Reno, 80 },
+        { es::Socket::Cubic, 81 }
+    };
+    int fairness = run(flows, 2);
+    esReport("Jain's fairness index: %d%%\n", fairness);
+    esReport("sent: %u, dropped: %u, lost: %u\n",
+             netem->getSent(), netem->getDropped(), netem->getLost());
+    ASSERT(50 <= fairness);
+
+    esReport("done.\n");
+}
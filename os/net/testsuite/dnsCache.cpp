@@ -0,0 +1,375 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests the resolver cache against a stub name server on the loopback
+// interface, which answers each query after a fixed delay.
+
+#include <string.h>
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/endian.h>
+#include <es/handle.h>
+#include <es/interlocked.h>
+#include <es/naming/IContext.h>
+#include <es/net/dns.h>
+#include <es/net/ISocket.h>
+#include <es/net/IInternetConfig.h>
+#include <es/net/IResolver.h>
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern void esRegisterInternetProtocol(es::Context* context);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const long long DELAY = 2000000;    // 200 msec
+    const int THREADS = 8;
+    const int PENDING_MAX = 16;
+
+    struct Record
+    {
+        const char* name;
+        u32         ttl;
+        u8          addr[4];
+    };
+
+    const Record records[] =
+    {
+        { "www.example.com", 3600, { 10, 0, 0, 1 } },
+        { "short.example.com", 1, { 10, 0, 0, 2 } },
+        { "host0.example.com", 3600, { 10, 0, 1, 0 } },
+        { "host1.example.com", 3600, { 10, 0, 1, 1 } },
+        { "host2.example.com", 3600, { 10, 0, 1, 2 } },
+        { "host3.example.com", 3600, { 10, 0, 1, 3 } },
+        { "host4.example.com", 3600, { 10, 0, 1, 4 } },
+        { "host5.example.com", 3600, { 10, 0, 1, 5 } },
+        { "host6.example.com", 3600, { 10, 0, 1, 6 } },
+        { "host7.example.com", 3600, { 10, 0, 1, 7 } },
+    };
+
+    struct Reply
+    {
+        DateTime                due;
+        es::InternetAddress*    address;
+        int                     port;
+        int                     len;
+        u8                      data[DNSHdr::UDPMax];
+    };
+
+    Handle<es::Resolver> resolver;
+    Handle<es::InternetAddress> localhost;
+    Interlocked queries;
+    volatile bool done;
+}
+
+static u8* put16(u8* ptr, u16 value)
+{
+    *ptr++ = (u8) (value >> 8);
+    *ptr++ = (u8) value;
+    return ptr;
+}
+
+static u8* put32(u8* ptr, u32 value)
+{
+    ptr = put16(ptr, (u16) (value >> 16));
+    return put16(ptr, (u16) value);
+}
+
+static u8* putName(u8* ptr, const char* name)
+{
+    while (*name)
+    {
+        const char* dot = strchr(name, '.');
+        int len = dot ? dot - name : strlen(name);
+        *ptr++ = (u8) len;
+        memmove(ptr, name, len);
+        ptr += len;
+        name += len;
+        if (*name == '.')
+        {
+            ++name;
+        }
+    }
+    *ptr++ = 0;
+    return ptr;
+}
+
+// Makes the response to the query, and returns its length.
+static int answer(const u8* query, int len, u8* response)
+{
+    if (len <= sizeof(DNSHdr))
+    {
+        return 0;
+    }
+
+    // Get the name in the question section.
+    char name[DNSHdr::NameMax];
+    char* dst = name;
+    const u8* ptr = query + sizeof(DNSHdr);
+    while (*ptr && ptr < query + len)
+    {
+        if (dst != name)
+        {
+            *dst++ = '.';
+        }
+        memmove(dst, ptr + 1, *ptr);
+        dst += *ptr;
+        ptr += 1 + *ptr;
+    }
+    *dst = '\0';
+    ++ptr;
+    u16 type = (ptr[0] << 8) | ptr[1];
+    ptr += 4;
+
+    memmove(response, query, ptr - query);
+    DNSHdr* dns = reinterpret_cast<DNSHdr*>(response);
+    dns->flags = htons(DNSHdr::Response | DNSHdr::StandardQuery | DNSHdr::RD | DNSHdr::RA);
+    dns->ancount = 0;
+    dns->nscount = 0;
+    dns->arcount = 0;
+    u8* opt = response + (ptr - query);
+
+    if (type == DNSType::A)
+    {
+        for (int i = 0; i < sizeof records / sizeof records[0]; ++i)
+        {
+            if (strcmp(name, records[i].name) == 0)
+            {
+                dns->ancount = htons(1);
+                opt = put16(opt, 0xc000 | sizeof(DNSHdr));
+                opt = put16(opt, DNSType::A);
+                opt = put16(opt, DNSClass::IN);
+                opt = put32(opt, records[i].ttl);
+                opt = put16(opt, 4);
+                memmove(opt, records[i].addr, 4);
+                return opt + 4 - response;
+            }
+        }
+    }
+    else if (type == DNSType::PTR && strcmp(name, "1.0.0.10.in-addr.arpa") == 0)
+    {
+        dns->ancount = htons(1);
+        opt = put16(opt, 0xc000 | sizeof(DNSHdr));
+        opt = put16(opt, DNSType::PTR);
+        opt = put16(opt, DNSClass::IN);
+        opt = put32(opt, 3600);
+        u8* rdlength = opt;
+        opt = putName(opt + 2, "www.example.com");
+        put16(rdlength, opt - rdlength - 2);
+        return opt - response;
+    }
+
+    dns->setResponseCode(DNSHdr::NameError);
+    if (strcmp(name, "nosoa.example.com") != 0)
+    {
+        // A negative answer is cached for the SOA minimum [RFC 2308].
+        dns->nscount = htons(1);
+        opt = putName(opt, "example.com");
+        opt = put16(opt, DNSType::SOA);
+        opt = put16(opt, DNSClass::IN);
+        opt = put32(opt, 3600);
+        u8* rdlength = opt;
+        opt = putName(opt + 2, "ns.example.com");
+        opt = putName(opt, "admin.example.com");
+        opt = put32(opt, 1);        // SERIAL
+        opt = put32(opt, 3600);     // REFRESH
+        opt = put32(opt, 600);      // RETRY
+        opt = put32(opt, 86400);    // EXPIRE
+        opt = put32(opt, 30);       // MINIMUM
+        put16(rdlength, opt - rdlength - 2);
+    }
+    return opt - response;
+}
+
+// Answers each query DELAY after it arrives, so that the queries in
+// progress overlap.
+static void* serve(void* param)
+{
+    Handle<es::Socket> socket = localhost->socket(AF_INET, es::Socket::Datagram, DNSHdr::Port);
+    socket->setTimeout(100000);     // 10 msec
+
+    Reply* pending = new Reply[PENDING_MAX];
+    int count = 0;
+    u8 query[DNSHdr::UDPMax];
+    while (!done)
+    {
+        int len = socket->recvFrom(query, sizeof query, 0);
+        if (0 < len && count < PENDING_MAX)
+        {
+            Reply* reply = &pending[count];
+            reply->len = answer(query, len, reply->data);
+            reply->address = socket->getRecvFromAddress();
+            reply->port = socket->getRecvFromPort();
+            if (0 < reply->len && reply->address)
+            {
+                reply->due = DateTime::getNow() + TimeSpan(DELAY);
+                queries.increment();
+                ++count;
+            }
+            else if (reply->address)
+            {
+                reply->address->release();
+            }
+        }
+
+        DateTime now = DateTime::getNow();
+        for (int i = 0; i < count; )
+        {
+            Reply* reply = &pending[i];
+            if (now < reply->due)
+            {
+                ++i;
+                continue;
+            }
+            socket->sendTo(reply->data, reply->len, 0, reply->address, reply->port);
+            reply->address->release();
+            pending[i] = pending[--count];
+        }
+    }
+    socket->close();
+    delete[] pending;
+    return 0;
+}
+
+static void* lookup(void* param)
+{
+    es::InternetAddress* address = resolver->getHostByName(static_cast<const char*>(param), AF_INET);
+    InAddr addr = InAddrAny;
+    if (address)
+    {
+        address->getAddress(&addr, sizeof addr);
+        address->release();
+    }
+    return reinterpret_cast<void*>(ntohl(addr.addr));
+}
+
+static u32 resolve(const char* name)
+{
+    return reinterpret_cast<long>(lookup(const_cast<char*>(name)));
+}
+
+// Looks up the names at the same time, and returns the elapsed time.
+static long long resolveAll(const char** names, u32* addrs)
+{
+    es::Thread* threads[THREADS];
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < THREADS; ++i)
+    {
+        threads[i] = esCreateThread(lookup, const_cast<char*>(names[i]));
+        threads[i]->start();
+    }
+    for (int i = 0; i < THREADS; ++i)
+    {
+        addrs[i] = reinterpret_cast<long>(threads[i]->join());
+        threads[i]->release();
+    }
+    return DateTime::getNow() - start;
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    esRegisterInternetProtocol(context);
+
+    resolver = context->lookup("network/resolver");
+    Handle<es::InternetConfig> config = context->lookup("network/config");
+
+    localhost = resolver->getHostByAddress(&InAddrLoopback.addr, sizeof(InAddr), 1);
+    config->addNameServer(localhost);
+
+    es::Thread* server = esCreateThread(serve, 0);
+    server->start();
+
+    const char* names[THREADS];
+    u32 addrs[THREADS];
+
+    // The lookups for the same name share a single query.
+    for (int i = 0; i < THREADS; ++i)
+    {
+        names[i] = "www.example.com";
+    }
+    resolveAll(names, addrs);
+    for (int i = 0; i < THREADS; ++i)
+    {
+        ASSERT(addrs[i] == (10 << 24 | 1));
+    }
+    ASSERT(queries == 1);
+    ASSERT(resolver->getCacheMisses() == 1);
+    ASSERT(resolver->getCacheHits() == THREADS - 1);
+
+    // The name is cached regardless of the case.
+    TEST(resolve("WWW.Example.COM") == (10 << 24 | 1));
+    ASSERT(queries == 1);
+
+    // The lookups for the different names run in parallel.
+    char hostNames[THREADS][DNSHdr::NameMax];
+    for (int i = 0; i < THREADS; ++i)
+    {
+        sprintf(hostNames[i], "host%d.example.com", i);
+        names[i] = hostNames[i];
+    }
+    long long elapsed = resolveAll(names, addrs);
+    for (int i = 0; i < THREADS; ++i)
+    {
+        ASSERT(addrs[i] == (10 << 24 | 1 << 8 | i));
+    }
+    ASSERT(queries == 1 + THREADS);
+    esReport("%d lookups in parallel: %lld msec\n",
+             THREADS, elapsed / TimeSpan::TICKS_PER_MILLISECOND);
+    ASSERT(elapsed < THREADS * DELAY / 2);
+
+    // An answer expires after its TTL.
+    TEST(resolve("short.example.com") == (10 << 24 | 2));
+    TEST(resolve("short.example.com") == (10 << 24 | 2));
+    ASSERT(queries == 2 + THREADS);
+    esSleep(15000000);
+    TEST(resolve("short.example.com") == (10 << 24 | 2));
+    ASSERT(queries == 3 + THREADS);
+
+    // A negative answer is cached only if it comes with an SOA record.
+    TEST(resolve("missing.example.com") == 0);
+    TEST(resolve("missing.example.com") == 0);
+    ASSERT(queries == 4 + THREADS);
+    TEST(resolve("nosoa.example.com") == 0);
+    TEST(resolve("nosoa.example.com") == 0);
+    ASSERT(queries == 6 + THREADS);
+
+    // Reverse lookups are cached as well.
+    InAddr addr = { htonl(10 << 24 | 1) };
+    Handle<es::InternetAddress> www = resolver->getHostByAddress(&addr.addr, sizeof addr, 0);
+    char hostName[DNSHdr::NameMax];
+    TEST(resolver->getHostName(hostName, sizeof hostName, www));
+    ASSERT(strcmp(hostName, "www.example.com") == 0);
+    TEST(resolver->getHostName(hostName, sizeof hostName, www));
+    ASSERT(queries == 7 + THREADS);
+
+    esReport("hits: %lld, misses: %lld\n",
+             resolver->getCacheHits(), resolver->getCacheMisses());
+
+    done = true;
+    server->join();
+    server->release();
+
+    esReport("done.\n");
+}
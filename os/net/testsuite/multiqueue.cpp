@@ -0,0 +1,193 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs concurrent bulk transfers over the loopback interface with one,
+// two, and four receive queues, and reports the aggregate throughput.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int FLOWS = 8;
+    const int TRANSFER_SIZE = 1024 * 1024;
+    const int CHUNK_SIZE = 4096;
+
+    Handle<Inet4Address> localhost;
+
+    struct Flow
+    {
+        int         port;
+        Socket*     listening;
+        long        received;
+    };
+}
+
+static void* serve(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    es::Socket* socket;
+    while ((socket = flow->listening->accept()) == 0)
+    {
+    }
+
+    u8 buf[CHUNK_SIZE];
+    int len;
+    while (0 < (len = socket->read(buf, sizeof buf)))
+    {
+        // Each flow must be received in order.
+        for (int i = 0; i < len; ++i)
+        {
+            ASSERT(buf[i] == (u8) (flow->received + i));
+        }
+        flow->received += len;
+    }
+
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static void* transmit(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    Socket client(AF_INET, es::Socket::Stream);
+    client.connect(localhost, flow->port);
+
+    u8 buf[CHUNK_SIZE];
+    for (long sent = 0; sent < TRANSFER_SIZE; sent += CHUNK_SIZE)
+    {
+        for (int i = 0; i < CHUNK_SIZE; ++i)
+        {
+            buf[i] = (u8) (sent + i);
+        }
+        int len = client.write(buf, CHUNK_SIZE);
+        ASSERT(len == CHUNK_SIZE);
+    }
+    client.close();
+    return 0;
+}
+
+// Runs FLOWS transfers at the same time, and returns the aggregate
+// throughput in kbps.
+static long long run(int basePort)
+{
+    Flow flows[FLOWS];
+    es::Thread* receivers[FLOWS];
+    es::Thread* senders[FLOWS];
+
+    for (int i = 0; i < FLOWS; ++i)
+    {
+        flows[i].port = basePort + i;
+        flows[i].received = 0;
+        flows[i].listening = new Socket(AF_INET, es::Socket::Stream);
+        flows[i].listening->bind(localhost, flows[i].port);
+        flows[i].listening->listen(5);
+        receivers[i] = esCreateThread(serve, &flows[i]);
+        receivers[i]->start();
+    }
+
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < FLOWS; ++i)
+    {
+        senders[i] = esCreateThread(transmit, &flows[i]);
+        senders[i]->start();
+    }
+    long long total = 0;
+    for (int i = 0; i < FLOWS; ++i)
+    {
+        senders[i]->join();
+        receivers[i]->join();
+        ASSERT(flows[i].received == TRANSFER_SIZE);
+        total += flows[i].received;
+
+        flows[i].listening->close();
+        flows[i].listening->release();
+    }
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    return total * 8 / std::max(1LL, ms);
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+    NetworkInterface* interface = Socket::getInterface(scopeID);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    // The frames of the different flows have to be spread over the queues.
+    int count = 0;
+    for (int port = 100; port < 100 + FLOWS; ++port)
+    {
+        u8 frame[sizeof(int) + sizeof(IPHdr) + 4];
+        memset(frame, 0, sizeof frame);
+        int af = AF_INET;
+        memmove(frame, &af, sizeof(int));
+        IPHdr* iphdr = reinterpret_cast<IPHdr*>(frame + sizeof(int));
+        iphdr->verlen = 0x45;
+        iphdr->proto = IPPROTO_TCP;
+        iphdr->src = iphdr->dst = InAddrLoopback;
+        u16 ports[2] = { htons(port), htons(49152) };
+        memmove(frame + sizeof(int) + sizeof(IPHdr), ports, sizeof ports);
+        if (interface->hash(frame, sizeof frame) % 4 == 0)
+        {
+            ++count;
+        }
+    }
+    ASSERT(count < FLOWS);
+
+    long long base = 0;
+    for (int queues = 1; queues <= 4; queues *= 2)
+    {
+        interface->setQueueCount(queues);
+        ASSERT(interface->getQueueCount() == queues);
+        long long kbps = run(100 + 10 * queues);
+        if (queues == 1)
+        {
+            base = kbps;
+        }
+        esReport("%d queue(s): %lld kbps (%lld%%)\n",
+                 queues, kbps, 100 * kbps / std::max(1LL, base));
+    }
+    esReport("dropped: %u\n", interface->getQueueDropped());
+
+    esReport("done.\n");
+}
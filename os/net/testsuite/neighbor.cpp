@@ -0,0 +1,134 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the lookups, the bounded pending queues and the batched timer of
+// the neighbor cache.
+
+#include <es.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "neighbor.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+
+namespace
+{
+    const int NEIGHBORS = 500;
+    const int SCOPE_ID = 2;
+
+    Inet4Address* neighbors[NEIGHBORS];
+}
+
+static InAddr address(int i)
+{
+    InAddr addr = { htonl(10 << 24 | 1 << 16 | i) };
+    return addr;
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    InFamily* inFamily = new InFamily;
+    NeighborCache* cache = inFamily->getNeighborCache();
+
+    for (int i = 0; i < NEIGHBORS; ++i)
+    {
+        neighbors[i] = new Inet4Address(address(i), Inet4Address::stateInit, SCOPE_ID);
+        cache->add(neighbors[i]);
+    }
+    cache->add(neighbors[0]);   // Ignored
+    ASSERT(cache->getSize() == NEIGHBORS);
+
+    // Lookups
+    for (int i = 0; i < NEIGHBORS; ++i)
+    {
+        Handle<Inet4Address> found = cache->lookup(address(i), SCOPE_ID);
+        ASSERT(found == neighbors[i]);
+    }
+    Handle<Inet4Address> none = cache->lookup(address(NEIGHBORS), SCOPE_ID);
+    ASSERT(!none);
+    none = cache->lookup(address(0), SCOPE_ID + 1);
+    ASSERT(!none);
+    ASSERT(cache->getLookups() == NEIGHBORS + 2);
+    ASSERT(cache->getMisses() == 2);
+
+    // Only the last PENDING_MAX packets are kept while resolving.
+    InetMessenger* packets[NeighborCache::PENDING_MAX + 2];
+    for (int i = 0; i < NeighborCache::PENDING_MAX + 2; ++i)
+    {
+        packets[i] = new InetMessenger;
+        TEST(cache->hold(neighbors[1], packets[i]));
+    }
+    ASSERT(cache->getHeld() == NeighborCache::PENDING_MAX + 2);
+    ASSERT(cache->getDropped() == 2);
+    for (int i = 2; i < NeighborCache::PENDING_MAX + 2; ++i)
+    {
+        InetMessenger* m = cache->retrieve(neighbors[1]);
+        ASSERT(m == packets[i]);
+        m->release();
+    }
+    TEST(cache->retrieve(neighbors[1]) == 0);
+
+    // The packets are discarded if the resolution fails.
+    TEST(cache->hold(neighbors[2], packets[0]));
+    TEST(cache->hold(neighbors[2], packets[1]));
+    cache->purge(neighbors[2]);
+    TEST(cache->retrieve(neighbors[2]) == 0);
+    ASSERT(cache->getDropped() == 4);
+    for (int i = 0; i < NeighborCache::PENDING_MAX + 2; ++i)
+    {
+        packets[i]->release();
+    }
+
+    // The deferred entries due close together are handled in a single run.
+    for (int i = 0; i < NEIGHBORS; ++i)
+    {
+        cache->defer(neighbors[i], TimeSpan(i * 1000LL));    // 0.1 msec apart
+    }
+    cache->cancel(neighbors[0]);
+    esSleep(30000000);  // 3 sec
+    esReport("runs: %u\n", cache->getRuns());
+    ASSERT(cache->getRuns() == 1);
+
+    for (int i = 0; i < NEIGHBORS; ++i)
+    {
+        cache->remove(neighbors[i]);
+    }
+    ASSERT(cache->getSize() == 0);
+    none = cache->lookup(address(1), SCOPE_ID);
+    ASSERT(!none);
+    Handle<InetMessenger> m = new InetMessenger;
+    TEST(!cache->hold(neighbors[1], m));
+    for (int i = 0; i < NEIGHBORS; ++i)
+    {
+        neighbors[i]->release();
+    }
+
+    esReport("done.\n");
+}
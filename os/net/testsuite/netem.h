@@ -0,0 +1,408 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NETEM_H_INCLUDED
+#define NETEM_H_INCLUDED
+
+#include <string.h>
+#include <algorithm>
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/ref.h>
+#include <es/base/IMonitor.h>
+#include <es/base/IStream.h>
+#include <es/base/IThread.h>
+#include <es/device/INetworkInterface.h>
+
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+/** A network emulator which wraps the loopback device. Frames written
+ *  to this interface go through a bottleneck link of the specified rate
+ *  with a drop-tail queue, are delayed, and are randomly dropped or
+ *  reordered before they are written to the loopback device.
+ */
+class Netem : public es::NetworkInterface, public es::Stream
+{
+    static const int MRU = 1518;
+    static const int QUEUE_MAX = 256;
+
+    struct Frame
+    {
+        DateTime    due;
+        int         len;
+        u8          data[MRU];
+    };
+
+    Ref                         ref;
+    Handle<es::NetworkInterface>   loopback;
+    es::Monitor*                monitor;
+    es::Thread*                 thread;
+
+    Frame                       queue[QUEUE_MAX];
+    int                         head;
+    int                         used;
+    DateTime                    lastDeparture;
+    Frame                       held;       // The frame to be sent after the next one
+    bool                        holding;
+
+    // Link parameters
+    TimeSpan                    delay;      // One way delay
+    long long                   rate;       // Bottleneck rate [bytes/sec]. Zero for unlimited.
+    int                         limit;      // Queue length [frames]
+    int                         loss;       // Loss rate [x/1000000]
+    int                         reorder;    // Reordering rate [x/1000000]
+
+    // Statistics
+    unsigned int                sent;
+    unsigned int                dropped;
+    unsigned int                lost;
+    unsigned int                reordered;
+
+    void* deliver()
+    {
+        Handle<es::Stream> stream = loopback;
+        monitor->lock();
+        for (;;)
+        {
+            while (used == 0)
+            {
+                monitor->wait();
+            }
+            DateTime now = DateTime::getNow();
+            Frame* frame = &queue[head];
+            if (now < frame->due)
+            {
+                monitor->wait(frame->due - now);
+                continue;
+            }
+            monitor->unlock();
+            stream->write(frame->data, frame->len);
+            monitor->lock();
+            head = (head + 1) % QUEUE_MAX;
+            --used;
+        }
+        monitor->unlock();
+        return 0;
+    }
+
+    // Appends the frame to the queue with the monitor locked.
+    void enqueue(const void* src, int count)
+    {
+        if (limit <= used)
+        {
+            ++dropped;  // Drop tail
+            return;
+        }
+
+        // The frame leaves the bottleneck after the frames ahead
+        // of it, and then arrives after the propagation delay.
+        DateTime now = DateTime::getNow();
+        DateTime departure = (lastDeparture < now) ? now : lastDeparture;
+        if (0 < rate)
+        {
+            departure += TimeSpan(count * TimeSpan::TICKS_PER_SECOND / rate);
+        }
+        lastDeparture = departure;
+
+        Frame* frame = &queue[(head + used) % QUEUE_MAX];
+        frame->due = departure + delay;
+        frame->len = count;
+        memmove(frame->data, src, count);
+        ++used;
+        monitor->notifyAll();
+    }
+
+    static void* run(void* param)
+    {
+        Netem* netem = static_cast<Netem*>(param);
+        return netem->deliver();
+    }
+
+public:
+    Netem(es::NetworkInterface* loopback) :
+        loopback(loopback, true),
+        thread(0),
+        head(0),
+        used(0),
+        holding(false),
+        delay(0),
+        rate(0),
+        limit(QUEUE_MAX),
+        loss(0),
+        reorder(0),
+        sent(0),
+        dropped(0),
+        lost(0),
+        reordered(0)
+    {
+        monitor = es::Monitor::createInstance();
+        thread = esCreateThread(run, this);
+        thread->start();
+    }
+
+    ~Netem()
+    {
+        if (monitor)
+        {
+            monitor->release();
+        }
+    }
+
+    /** Sets the link parameters.
+     * @param delay the one way delay.
+     * @param rate the bottleneck rate in bytes per second, or zero for unlimited.
+     * @param limit the bottleneck queue length in frames.
+     * @param loss the random loss rate in parts per million.
+     */
+    void setLink(TimeSpan delay, long long rate, int limit, int loss)
+    {
+        monitor->lock();
+        this->delay = delay;
+        this->rate = rate;
+        this->limit = std::min(std::max(1, limit), static_cast<int>(QUEUE_MAX));
+        this->loss = loss;
+        monitor->unlock();
+    }
+
+    /** Sets the reordering rate. A reordered frame is held back and sent
+     *  right after the next frame; it stays held until another frame is
+     *  written.
+     * @param reorder the reordering rate in parts per million.
+     */
+    void setReorder(int reorder)
+    {
+        monitor->lock();
+        this->reorder = reorder;
+        monitor->unlock();
+    }
+
+    unsigned int getSent()
+    {
+        return sent;
+    }
+    unsigned int getDropped()
+    {
+        return dropped;
+    }
+    unsigned int getLost()
+    {
+        return lost;
+    }
+    unsigned int getReordered()
+    {
+        return reordered;
+    }
+
+    // INetworkInterface
+    int addMulticastAddress(const unsigned char* mac)
+    {
+        return loopback->addMulticastAddress(mac);
+    }
+    int getMacAddress(unsigned char* mac)
+    {
+        return loopback->getMacAddress(mac);
+    }
+    int getMTU()
+    {
+        return loopback->getMTU();
+    }
+    bool getLinkState()
+    {
+        return loopback->getLinkState();
+    }
+    bool getPromiscuousMode()
+    {
+        return loopback->getPromiscuousMode();
+    }
+    unsigned long long getInOctets()
+    {
+        return 0;
+    }
+    unsigned int getInUcastPkts()
+    {
+        return 0;
+    }
+    unsigned int getInNUcastPkts()
+    {
+        return 0;
+    }
+    unsigned int getInDiscards()
+    {
+        return 0;
+    }
+    unsigned int getInErrors()
+    {
+        return 0;
+    }
+    unsigned int getInUnknownProtos()
+    {
+        return 0;
+    }
+    unsigned long long getOutOctets()
+    {
+        return 0;
+    }
+    unsigned int getOutUcastPkts()
+    {
+        return sent;
+    }
+    unsigned int getOutNUcastPkts()
+    {
+        return 0;
+    }
+    unsigned int getOutDiscards()
+    {
+        return dropped + lost;
+    }
+    unsigned int getOutErrors()
+    {
+        return 0;
+    }
+    unsigned int getOutCollisions()
+    {
+        return 0;
+    }
+    int getType()
+    {
+        return es::NetworkInterface::Loopback;
+    }
+    int getCapabilities()
+    {
+        return 0;
+    }
+    int removeMulticastAddress(const unsigned char* mac)
+    {
+        return loopback->removeMulticastAddress(mac);
+    }
+    void setPromiscuousMode(bool on)
+    {
+        loopback->setPromiscuousMode(on);
+    }
+    int start()
+    {
+        return loopback->start();
+    }
+    int stop()
+    {
+        return loopback->stop();
+    }
+
+    // IStream
+    long long getPosition()
+    {
+        return 0;
+    }
+    void setPosition(long long pos)
+    {
+    }
+    long long getSize()
+    {
+        return 0;
+    }
+    void setSize(long long size)
+    {
+    }
+    int read(void* dst, int count)
+    {
+        Handle<es::Stream> stream = loopback;
+        return stream->read(dst, count);
+    }
+    int read(void* dst, int count, long long offset)
+    {
+        return -1;
+    }
+    int write(const void* src, int count)
+    {
+        if (count <= 0 || MRU < count)
+        {
+            return -1;
+        }
+
+        monitor->lock();
+        ++sent;
+        if (0 < loss && (rand48() % 1000000) < loss)
+        {
+            ++lost;
+        }
+        else if (0 < reorder && !holding && (rand48() % 1000000) < reorder)
+        {
+            held.len = count;
+            memmove(held.data, src, count);
+            holding = true;
+            ++reordered;
+        }
+        else
+        {
+            enqueue(src, count);
+            if (holding)
+            {
+                enqueue(held.data, held.len);
+                holding = false;
+            }
+        }
+        monitor->unlock();
+        return count;
+    }
+    int write(const void* src, int count, long long offset)
+    {
+        return -1;
+    }
+    void flush()
+    {
+    }
+
+    // IInterface
+    Object* queryInterface(const char* riid)
+    {
+        Object* objectPtr;
+        if (strcmp(riid, es::Stream::iid()) == 0)
+        {
+            objectPtr = static_cast<es::Stream*>(this);
+        }
+        else if (strcmp(riid, es::NetworkInterface::iid()) == 0)
+        {
+            objectPtr = static_cast<es::NetworkInterface*>(this);
+        }
+        else if (strcmp(riid, Object::iid()) == 0)
+        {
+            objectPtr = static_cast<es::NetworkInterface*>(this);
+        }
+        else
+        {
+            return NULL;
+        }
+        objectPtr->addRef();
+        return objectPtr;
+    }
+    unsigned int addRef()
+    {
+        return ref.addRef();
+    }
+    unsigned int release()
+    {
+        unsigned int count = ref.release();
+        if (count == 0)
+        {
+            delete this;
+            return 0;
+        }
+        return count;
+    }
+};
+
+#endif  // NETEM_H_INCLUDED
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sends UDP datagrams larger than the MTU over the emulated loopback link,
+// and checks that they are reassembled. Then drops some of the fragments,
+// and checks that the memory held by the incomplete datagrams is bounded.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+#include "netem.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+
+namespace
+{
+    const int DATAGRAM_MAX = 65535 - sizeof(IPHdr) - sizeof(UDPHdr);
+    const int COUNT = 100;
+
+    u8 output[DATAGRAM_MAX];
+    u8 input[DATAGRAM_MAX];
+}
+
+static void fill(u8* buf, int len, int seed)
+{
+    for (int i = 0; i < len; ++i)
+    {
+        buf[i] = (u8) (seed + i % 251);
+    }
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+    ReassReceiver* reass = inFamily->getReassReceiver();
+
+    // Setup the emulated loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    Netem* netem = new Netem(loopbackInterface);
+    int scopeID = Socket::addInterface(netem);
+
+    // Register localhost address
+    Handle<Inet4Address> localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID, 8);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    Socket server(AF_INET, es::Socket::Datagram);
+    server.bind(localhost, 53);
+    server.setTimeout(1000000);     // 100 msec
+    Socket client(AF_INET, es::Socket::Datagram);
+    client.connect(localhost, 53);
+
+    // The datagrams of the various sizes are reassembled.
+    int count = 0;
+    for (int len = 1473; len <= DATAGRAM_MAX; len += 4093)
+    {
+        fill(output, len, len);
+        TEST(client.write(output, len) == len);
+        TEST(server.read(input, sizeof input) == len);
+        ASSERT(memcmp(output, input, len) == 0);
+        ++count;
+    }
+    ASSERT(reass->getReassembled() == count);
+    ASSERT(reass->getMemoryUsed() == 0);
+
+    int len = 32000;
+    fill(output, len, 0);
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < COUNT; ++i)
+    {
+        TEST(client.write(output, len) == len);
+        TEST(server.read(input, sizeof input) == len);
+    }
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    esReport("%d datagrams of %d bytes: %lld kbps\n",
+             COUNT, len, (long long) COUNT * len * 8 / std::max(1LL, ms));
+
+    // Lose some of the fragments. The incomplete datagrams must not hold
+    // more memory than the limit.
+    reass->setMemoryMax(64 * 1024);
+    netem->setLink(0, 0, 256, 100000);
+    int received = 0;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        TEST(client.write(output, len) == len);
+        if (server.read(input, sizeof input) == len)
+        {
+            ASSERT(memcmp(output, input, len) == 0);
+            ++received;
+        }
+        ASSERT(reass->getMemoryUsed() <= reass->getMemoryMax());
+    }
+    esReport("received: %d/%d, evicted: %u, lost: %u\n",
+             received, COUNT, reass->getEvicted(), netem->getLost());
+    ASSERT(received < COUNT);
+    ASSERT(0 < reass->getEvicted());
+
+    netem->setLink(0, 0, 256, 0);
+    reass->setMemoryMax(ReassReceiver::MEMORY_MAX);
+    TEST(client.write(output, len) == len);
+    TEST(server.read(input, sizeof input) == len);
+
+    client.close();
+    server.close();
+
+    esReport("done.\n");
+}
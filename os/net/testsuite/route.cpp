@@ -0,0 +1,259 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the longest prefix match of the forwarding table against a
+// linear search while the routes are added and removed at random, checks
+// the next hop and the source address selection of InFamily, and
+// measures the lookups per second with 100k routes.
+
+#include <algorithm>
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "route.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+
+namespace
+{
+    const int ROUTES = 2000;
+    const int BENCH_ROUTES = 100000;
+    const int BENCH_LOOKUPS = 10000000;
+
+    struct Entry
+    {
+        u32             addr;
+        int             prefix;
+        bool            live;
+        Inet4Address*   gateway;
+    };
+
+    Entry entries[ROUTES];
+    int count;
+    u32 seed = 1;
+}
+
+static u32 rand32()
+{
+    seed = seed * 1103515245 + 12345;
+    u32 high = seed >> 8;
+    seed = seed * 1103515245 + 12345;
+    return high << 16 ^ seed >> 8;
+}
+
+static u32 mask(int prefix)
+{
+    return prefix ? 0xffffffffu << (32 - prefix) : 0;
+}
+
+static InAddr inAddr(u32 addr)
+{
+    InAddr a = { htonl(addr) };
+    return a;
+}
+
+// Addresses clustered in 10.0.0.0/8 so that the prefixes overlap.
+static u32 clustered()
+{
+    return 0x0a000000 | (rand32() & 0x000f0fff);
+}
+
+static int search(u32 addr)
+{
+    int found = -1;
+    for (int i = 0; i < count; ++i)
+    {
+        if (entries[i].live && (addr & mask(entries[i].prefix)) == entries[i].addr &&
+            (found < 0 || entries[found].prefix < entries[i].prefix))
+        {
+            found = i;
+        }
+    }
+    return found;
+}
+
+static void check()
+{
+    RouteTable table;
+    for (int n = 0; n < 3 * ROUTES; ++n)
+    {
+        if (count < ROUTES && rand32() % 3)
+        {
+            int prefix = rand32() % 33;
+            u32 addr = clustered() & mask(prefix);
+            bool exists = false;
+            for (int i = 0; i < count; ++i)
+            {
+                if (entries[i].live && entries[i].addr == addr && entries[i].prefix == prefix)
+                {
+                    exists = true;
+                }
+            }
+            Inet4Address* tag = new Inet4Address(inAddr(addr), Inet4Address::stateInit, 2);
+            TEST(table.add(inAddr(addr), prefix, tag, 0) == !exists);
+            if (!exists)
+            {
+                entries[count].addr = addr;
+                entries[count].prefix = prefix;
+                entries[count].live = true;
+                entries[count].gateway = tag;
+                ++count;
+            }
+            else
+            {
+                tag->release();
+            }
+        }
+        else if (0 < count)
+        {
+            Entry* entry = &entries[rand32() % count];
+            if (entry->live)
+            {
+                TEST(table.remove(inAddr(entry->addr), entry->prefix));
+                entry->live = false;
+            }
+        }
+
+        for (int i = 0; i < 20; ++i)
+        {
+            u32 addr = clustered();
+            Route* route = table.lookup(inAddr(addr));
+            int found = search(addr);
+            if (found < 0)
+            {
+                ASSERT(!route);
+            }
+            else
+            {
+                ASSERT(route && route->gateway == entries[found].gateway);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (entries[i].live)
+        {
+            TEST(table.remove(inAddr(entries[i].addr), entries[i].prefix));
+        }
+        entries[i].gateway->release();
+    }
+    ASSERT(table.getSize() == 0);
+    ASSERT(table.getChunks() == 0);
+}
+
+static void bench()
+{
+    RouteTable table;
+    Handle<Inet4Address> gateway = new Inet4Address(inAddr(0x0a000001), Inet4Address::stateInit, 2);
+
+    // Mostly /24 and longer prefixes under 64 /8 blocks as in the Internet.
+    u32 blocks[64];
+    for (int i = 0; i < 64; ++i)
+    {
+        blocks[i] = (1 + rand32() % 223) << 24;
+    }
+    DateTime start = DateTime::getNow();
+    int added = 0;
+    while (added < BENCH_ROUTES)
+    {
+        static const int prefixes[] = { 8, 12, 16, 19, 20, 22, 23, 24, 24, 24, 24, 24, 28, 32 };
+        int prefix = prefixes[rand32() % (sizeof prefixes / sizeof prefixes[0])];
+        u32 addr = (blocks[rand32() % 64] | (rand32() & 0x00ffffff)) & mask(prefix);
+        if (table.add(inAddr(addr), prefix, gateway, 0))
+        {
+            ++added;
+        }
+    }
+    long long ms = std::max(1LL, (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND);
+    esReport("%d routes added in %lld ms, %d chunks\n", table.getSize(), ms, table.getChunks());
+
+    start = DateTime::getNow();
+    int hits = 0;
+    u32 addr = 1;
+    for (int i = 0; i < BENCH_LOOKUPS; ++i)
+    {
+        addr = addr * 1664525 + 1013904223;
+        if (table.lookup(inAddr(addr)))
+        {
+            ++hits;
+        }
+    }
+    ms = std::max(1LL, (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND);
+    esReport("%d lookups in %lld ms: %lld lookups/sec, %d hits\n",
+             BENCH_LOOKUPS, ms, BENCH_LOOKUPS * 1000LL / ms, hits);
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    check();
+    bench();
+
+    // Next hop and source address selection
+    InFamily* inFamily = new InFamily;
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+
+    Handle<Inet4Address> localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID, 8);
+    inFamily->addAddress(localhost);
+    localhost->start();
+    ASSERT(inFamily->getRouteCount() == 1);   // The connected route to 127.0.0.0/8
+
+    Handle<Inet4Address> router = new Inet4Address(inAddr(0x7f000002), Inet4Address::stateInit, scopeID);
+    inFamily->addAddress(router);
+    Handle<Inet4Address> offLink = new Inet4Address(inAddr(0x0a000001), Inet4Address::stateInit, scopeID);
+    TEST(!inFamily->addRoute(inAddr(0x0a000000), 8, offLink));
+    TEST(inFamily->addRoute(inAddr(0x0a000000), 8, router));
+    TEST(!inFamily->addRoute(inAddr(0x0a000000), 8, router));
+
+    Handle<Inet4Address> dst = new Inet4Address(inAddr(0x0a010203), Inet4Address::stateDestination, scopeID);
+    inFamily->addAddress(dst);
+    Handle<Inet4Address> nextHop = inFamily->getNextHop(dst);
+    ASSERT(nextHop == router);
+    nextHop = inFamily->getNextHop(dst);      // Cached
+    ASSERT(nextHop == router);
+    Handle<Inet4Address> src = inFamily->selectSourceAddress(dst);
+    ASSERT(src == localhost);
+
+    Handle<Inet4Address> local = new Inet4Address(inAddr(0x7f000003), Inet4Address::stateInit, scopeID);
+    nextHop = inFamily->getNextHop(local);
+    ASSERT(nextHop == local);
+    nextHop = 0;
+
+    TEST(inFamily->removeRoute(inAddr(0x0a000000), 8));
+    nextHop = inFamily->getNextHop(dst);      // The cache is invalidated.
+    ASSERT(nextHop == dst);
+    nextHop = 0;
+    src = inFamily->selectSourceAddress(dst);
+    ASSERT(src == localhost);   // The preferred address of the scope
+
+    esReport("done.\n");
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs bulk transfers with the largest windows through an emulated link
+// with random loss and reordering, so that many out-of-order blocks and
+// SACK holes are outstanding at once, and checks the received bytes.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "netem.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int TRANSFER_SIZE = 1024 * 1024;
+    const int CHUNK_SIZE = 4096;
+    const int BUFFER_SIZE = 65535;  // The largest window without window scaling
+
+    Handle<Inet4Address> localhost;
+
+    struct Flow
+    {
+        Socket*     listening;
+        long        received;
+        bool        intact;
+    };
+}
+
+static u8 pattern(long offset)
+{
+    return (u8) (offset % 251);
+}
+
+static void* serve(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    es::Socket* socket;
+    while ((socket = flow->listening->accept()) == 0)
+    {
+    }
+
+    u8 buf[CHUNK_SIZE];
+    int len;
+    while (0 < (len = socket->read(buf, sizeof buf)))
+    {
+        for (int i = 0; i < len; ++i)
+        {
+            if (buf[i] != pattern(flow->received + i))
+            {
+                flow->intact = false;
+            }
+        }
+        flow->received += len;
+    }
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static void run(int port)
+{
+    Flow flow;
+    flow.listening = new Socket(AF_INET, es::Socket::Stream);
+    flow.listening->setReceiveBufferSize(BUFFER_SIZE);
+    flow.listening->setSendBufferSize(BUFFER_SIZE);
+    flow.listening->bind(localhost, port);
+    flow.listening->listen(1);
+    flow.received = 0;
+    flow.intact = true;
+
+    es::Thread* thread = esCreateThread(serve, &flow);
+    thread->start();
+
+    DateTime start = DateTime::getNow();
+    Socket client(AF_INET, es::Socket::Stream);
+    client.setReceiveBufferSize(BUFFER_SIZE);
+    client.setSendBufferSize(BUFFER_SIZE);
+    client.connect(localhost, port);
+    u8 buf[CHUNK_SIZE];
+    for (long sent = 0; sent < TRANSFER_SIZE; sent += sizeof buf)
+    {
+        for (int i = 0; i < sizeof buf; ++i)
+        {
+            buf[i] = pattern(sent + i);
+        }
+        TEST(client.write(buf, sizeof buf) == sizeof buf);
+    }
+    client.close();
+    thread->join();
+    thread->release();
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+
+    esReport("%ld bytes in %lld ms, %lld kbps\n",
+             flow.received, ms, flow.received * 8LL / std::max(1LL, ms));
+    ASSERT(flow.received == TRANSFER_SIZE);
+    ASSERT(flow.intact);
+    flow.listening->close();
+    flow.listening->release();
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup the emulated link over the loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    Netem* netem = new Netem(loopbackInterface);
+    int scopeID = Socket::addInterface(netem);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    // 20 msec RTT with 1%, 5% and 10% random loss. The loss of more than
+    // one segment in a window leaves several holes to be recovered at once.
+    static const int losses[] = { 10000, 50000, 100000 };
+    for (int i = 0; i < sizeof losses / sizeof losses[0]; ++i)
+    {
+        netem->setLink(100000, 0, 256, losses[i]);
+        netem->setReorder(losses[i]);
+        esReport("loss: %d ppm, reorder: %d ppm\n", losses[i], losses[i]);
+        run(90 + i);
+    }
+
+    esReport("sent: %u, dropped: %u, lost: %u, reordered: %u\n",
+             netem->getSent(), netem->getDropped(), netem->getLost(), netem->getReordered());
+
+    esReport("done.\n");
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Splits large send super-segments of a few MSS in software, and checks
+// the IP and TCP sums, the IP length and identification, the TCP sequence
+// number, and the payload of each segment, and that FIN and PSH are only
+// set to the last segment.
+
+#include <string.h>
+#include <vector>
+#include <es.h>
+#include <es/endian.h>
+#include <es/ref.h>
+#include <es/base/IStream.h>
+#include <es/net/dix.h>
+#include <es/net/inet4.h>
+#include <es/net/tcp.h>
+#include "inet.h"
+#include "interface.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+namespace
+{
+    const int MSS = 1460;
+    const u16 ID = 0xfffe;          // Wraps around within a super-segment
+    const u32 SEQ = 0xfffff000;     // Wraps around within a super-segment
+    const u8 SRC[4] = { 192, 168, 0, 1 };
+    const u8 DST[4] = { 192, 168, 0, 2 };
+}
+
+// Keeps the frames written to it.
+class Capture : public es::Stream
+{
+    Ref ref;
+
+public:
+    std::vector<std::vector<u8> > frames;
+
+    // IStream
+    long long getPosition()
+    {
+        return 0;
+    }
+    void setPosition(long long pos)
+    {
+    }
+    long long getSize()
+    {
+        return 0;
+    }
+    void setSize(long long size)
+    {
+    }
+    int read(void* dst, int count)
+    {
+        return -1;
+    }
+    int read(void* dst, int count, long long offset)
+    {
+        return -1;
+    }
+    int write(const void* src, int count)
+    {
+        const u8* ptr = static_cast<const u8*>(src);
+        frames.push_back(std::vector<u8>(ptr, ptr + count));
+        return count;
+    }
+    int write(const void* src, int count, long long offset)
+    {
+        return -1;
+    }
+    void flush()
+    {
+    }
+
+    // IInterface
+    Object* queryInterface(const char* riid)
+    {
+        Object* objectPtr;
+        if (strcmp(riid, es::Stream::iid()) == 0)
+        {
+            objectPtr = static_cast<es::Stream*>(this);
+        }
+        else if (strcmp(riid, Object::iid()) == 0)
+        {
+            objectPtr = static_cast<es::Stream*>(this);
+        }
+        else
+        {
+            return NULL;
+        }
+        objectPtr->addRef();
+        return objectPtr;
+    }
+    unsigned int addRef()
+    {
+        return ref.addRef();
+    }
+    unsigned int release()
+    {
+        return ref.release();
+    }
+};
+
+static u8 pattern(long offset)
+{
+    return (u8) (offset % 251);
+}
+
+// Returns the one's complement sum of the bytes in network byte order.
+static u32 sum(const u8* ptr, long len, u32 sum = 0)
+{
+    for (long i = 0; i + 1 < len; i += 2)
+    {
+        sum += (ptr[i] << 8) | ptr[i + 1];
+    }
+    if (len & 1)
+    {
+        sum += ptr[len - 1] << 8;
+    }
+    return sum;
+}
+
+static u16 fold(u32 sum)
+{
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+
+// Splits the super-segment of payload bytes carrying flag, and checks the
+// segments.
+static void test(long payload, u16 flag)
+{
+    long hdrlen = sizeof(DIXHdr) + sizeof(IPHdr) + sizeof(TCPHdr);
+    long len = hdrlen + payload;
+    InetMessenger m(0, len);
+    u8* frame = static_cast<u8*>(m.fix(len));
+    memset(frame, 0, hdrlen);
+
+    DIXHdr* dixhdr = reinterpret_cast<DIXHdr*>(frame);
+    dixhdr->type = htons(DIXHdr::DIX_IP);
+
+    IPHdr* iphdr = reinterpret_cast<IPHdr*>(frame + sizeof(DIXHdr));
+    iphdr->setVersion();
+    iphdr->setHdrSize(sizeof(IPHdr));
+    iphdr->setSize(sizeof(IPHdr) + sizeof(TCPHdr) + payload);
+    iphdr->id = htons(ID);
+    iphdr->frag = htons(IPHdr::DontFragment);
+    iphdr->ttl = 64;
+    iphdr->proto = IPPROTO_TCP;
+    memmove(&iphdr->src, SRC, 4);
+    memmove(&iphdr->dst, DST, 4);
+
+    TCPHdr* tcphdr = reinterpret_cast<TCPHdr*>(frame + sizeof(DIXHdr) + sizeof(IPHdr));
+    tcphdr->src = htons(5000);
+    tcphdr->dst = htons(80);
+    tcphdr->seq = htonl(SEQ);
+    tcphdr->ack = htonl(1);
+    tcphdr->flag = htons(flag);
+    tcphdr->setHdrSize(sizeof(TCPHdr));
+    tcphdr->win = htons(65535);
+
+    u8* data = frame + hdrlen;
+    for (long i = 0; i < payload; ++i)
+    {
+        data[i] = pattern(i);
+    }
+    m.setSegmentSize(MSS);
+
+    Capture capture;
+    int count = NetworkInterface::segment(&m, sizeof(DIXHdr), &capture);
+    TEST(count == len);
+    TEST(capture.frames.size() == static_cast<size_t>((payload + MSS - 1) / MSS));
+
+    long offset = 0;
+    for (size_t n = 0; n < capture.frames.size(); ++n)
+    {
+        const std::vector<u8>& f(capture.frames[n]);
+        long size = std::min(static_cast<long>(MSS), payload - offset);
+        TEST(f.size() == static_cast<size_t>(hdrlen + size));
+        TEST(memcmp(&f[0], frame, sizeof(DIXHdr)) == 0);
+
+        const IPHdr* ip = reinterpret_cast<const IPHdr*>(&f[sizeof(DIXHdr)]);
+        TEST(ip->getSize() == static_cast<int>(sizeof(IPHdr) + sizeof(TCPHdr) + size));
+        TEST(ntohs(ip->id) == static_cast<u16>(ID + n));
+        TEST(ntohs(ip->frag) == IPHdr::DontFragment);
+        TEST(fold(sum(&f[sizeof(DIXHdr)], sizeof(IPHdr))) == 0xffff);
+
+        const TCPHdr* tcp = reinterpret_cast<const TCPHdr*>(&f[sizeof(DIXHdr) + sizeof(IPHdr)]);
+        TEST(static_cast<u32>(ntohl(tcp->seq)) == static_cast<u32>(SEQ + offset));
+        TEST(tcp->getHdrSize() == static_cast<int>(sizeof(TCPHdr)));
+        u16 expected = flag;
+        if (n + 1 < capture.frames.size())
+        {
+            expected &= ~(TCPHdr::FIN | TCPHdr::PSH);
+        }
+        TEST((ntohs(tcp->flag) & 0x0fff) == expected);
+
+        // The TCP sum over the pseudo header, the header, and the payload
+        u32 s = sum(SRC, 4, sum(DST, 4));
+        s += IPPROTO_TCP;
+        s += sizeof(TCPHdr) + size;
+        s = sum(reinterpret_cast<const u8*>(tcp), sizeof(TCPHdr) + size, s);
+        TEST(fold(s) == 0xffff);
+
+        for (long i = 0; i < size; ++i)
+        {
+            TEST(f[hdrlen + i] == pattern(offset + i));
+        }
+        offset += size;
+    }
+    TEST(offset == payload);
+}
+
+int main()
+{
+    test(MSS + 1, TCPHdr::ACK | TCPHdr::PSH);
+    test(2 * MSS, TCPHdr::ACK | TCPHdr::PSH | TCPHdr::FIN);
+    test(3 * MSS + 7, TCPHdr::ACK | TCPHdr::PSH | TCPHdr::FIN);   // Odd length of the last segment
+    test(44 * MSS + 1, TCPHdr::ACK);                                // Up to 64 KiB
+    test(MSS, TCPHdr::ACK | TCPHdr::FIN);                           // A single segment
+
+    esReport("done.\n");
+}
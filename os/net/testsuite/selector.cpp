@@ -0,0 +1,273 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Opens 10000 idle and 100 active connections over the loopback
+// interface, and measures how fast the receiver collects the messages
+// sent over the active connections, first by scanning every socket each
+// time the shared monitor is notified, and then with a selector.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/base/ISelector.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int IDLE = 10000;
+    const int ACTIVE = 100;
+    const int CONNECTIONS = IDLE + ACTIVE;
+    const int BUFFER_SIZE = 512;
+    const int MESSAGE_SIZE = 64;
+    const int ROUNDS = 100;
+    const int BATCH = 64;
+    const int PORT = 90;
+
+    Handle<Inet4Address> localhost;
+
+    Socket* listening;
+    es::Socket* accepted[CONNECTIONS];
+    es::Socket* servers[CONNECTIONS];   // servers[i] is connected to clients[i]
+    Socket* clients[CONNECTIONS];
+}
+
+static void* serve(void* param)
+{
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        while ((accepted[i] = listening->accept()) == 0)
+        {
+        }
+        accepted[i]->setBlocking(false);
+    }
+    return 0;
+}
+
+// Sends ROUNDS messages over each of the active connections. The active
+// connections are the last ACTIVE ones, so that a scan in the order of
+// the connections has to go through the idle ones first.
+static void* transmit(void* param)
+{
+    u8 buf[MESSAGE_SIZE];
+    memset(buf, 'a', sizeof buf);
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        for (int i = IDLE; i < CONNECTIONS; ++i)
+        {
+            int len = clients[i]->write(buf, sizeof buf);
+            ASSERT(len == sizeof buf);
+        }
+    }
+    return 0;
+}
+
+// Reads all the available data from the socket.
+static long drain(es::Socket* socket)
+{
+    u8 buf[BUFFER_SIZE];
+    long total = 0;
+    int len;
+    while (0 < (len = socket->read(buf, sizeof buf)))
+    {
+        total += len;
+    }
+    return total;
+}
+
+static long long report(const char* name, DateTime start, long waits, long events)
+{
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    esReport("%s: %lld ms, %ld waits, %ld events\n", name, ms, waits, events);
+    return ms;
+}
+
+// Waits for the shared monitor, and then scans all the sockets.
+static long long scan()
+{
+    es::Monitor* monitor = es::Monitor::createInstance();
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        Handle<es::Selectable> selectable(servers[i], true);
+        selectable->add(monitor);
+    }
+
+    DateTime start = DateTime::getNow();
+    es::Thread* sender = esCreateThread(transmit, 0);
+    sender->start();
+
+    const long expected = (long) ACTIVE * ROUNDS * MESSAGE_SIZE;
+    long received = 0;
+    long waits = 0;
+    long events = 0;
+    while (received < expected)
+    {
+        monitor->lock();
+        monitor->wait(100000);     // A notification may come before wait().
+        monitor->unlock();
+        ++waits;
+        for (int i = 0; i < CONNECTIONS; ++i)
+        {
+            if (servers[i]->isReadable())
+            {
+                ++events;
+                received += drain(servers[i]);
+            }
+        }
+    }
+    ASSERT(received == expected);
+    sender->join();
+    long long ms = report("scan", start, waits, events);
+
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        Handle<es::Selectable> selectable(servers[i], true);
+        selectable->remove(monitor);
+    }
+    monitor->release();
+    return ms;
+}
+
+static long long multiplex(int flags)
+{
+    es::Selector* selector = es::Selector::createInstance();
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        Handle<es::Selectable> selectable(servers[i], true);
+        int result = selector->add(selectable, es::Selector::Readable | flags, i);
+        ASSERT(result == 0);
+    }
+    // Nothing is ready yet.
+    int ready[2 * BATCH];
+    TEST(selector->wait(ready, 2 * BATCH, 0) == 0);
+
+    DateTime start = DateTime::getNow();
+    es::Thread* sender = esCreateThread(transmit, 0);
+    sender->start();
+
+    const long expected = (long) ACTIVE * ROUNDS * MESSAGE_SIZE;
+    long received = 0;
+    long waits = 0;
+    long events = 0;
+    while (received < expected)
+    {
+        int n = selector->wait(ready, 2 * BATCH, -1);
+        ASSERT(0 < n && n <= 2 * BATCH && n % 2 == 0);
+        ++waits;
+        events += n / 2;
+        for (int i = 0; i < n; i += 2)
+        {
+            int cookie = ready[i];
+            ASSERT(IDLE <= cookie && cookie < CONNECTIONS);
+            ASSERT(ready[i + 1] == es::Selector::Readable);
+            received += drain(servers[cookie]);
+        }
+    }
+    ASSERT(received == expected);
+    sender->join();
+    long long ms = report((flags & es::Selector::EdgeTriggered) ? "edge" : "level", start, waits, events);
+
+    // All the sockets have been drained.
+    TEST(selector->wait(ready, 2 * BATCH, 0) == 0);
+
+    // A level triggered socket is reported as long as it is readable,
+    // while an edge triggered one is reported once.
+    u8 buf[MESSAGE_SIZE];
+    clients[0]->write(buf, sizeof buf);
+    int n = selector->wait(ready, 2 * BATCH, -1);
+    ASSERT(n == 2 && ready[0] == 0 && ready[1] == es::Selector::Readable);
+    n = selector->wait(ready, 2 * BATCH, 0);
+    ASSERT(n == ((flags & es::Selector::EdgeTriggered) ? 0 : 2));
+    TEST(drain(servers[0]) == sizeof buf);
+
+    Handle<es::Selectable> selectable(servers[0], true);
+    TEST(selector->remove(selectable) == 0);
+    TEST(selector->remove(selectable) == -1);
+
+    selector->release();
+    return ms;
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    listening = new Socket(AF_INET, es::Socket::Stream);
+    listening->bind(localhost, PORT);
+    listening->listen(128);
+
+    es::Thread* server = esCreateThread(serve, 0);
+    server->start();
+
+    DateTime start = DateTime::getNow();
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        // Small buffers keep the memory used by the idle connections low.
+        clients[i] = new Socket(AF_INET, es::Socket::Stream);
+        clients[i]->setReceiveBufferSize(BUFFER_SIZE);
+        clients[i]->setSendBufferSize(BUFFER_SIZE);
+        clients[i]->connect(localhost, PORT);
+        ASSERT(clients[i]->isConnected());
+    }
+    server->join();
+    report("connect", start, 0, CONNECTIONS);
+
+    // Match the accepted sockets with the clients by the port numbers.
+    static es::Socket* ports[65536];
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        ports[accepted[i]->getRemotePort()] = accepted[i];
+    }
+    for (int i = 0; i < CONNECTIONS; ++i)
+    {
+        servers[i] = ports[clients[i]->getLocalPort()];
+        ASSERT(servers[i]);
+    }
+
+    long long scanned = scan();
+    long long level = multiplex(0);
+    long long edge = multiplex(es::Selector::EdgeTriggered);
+    esReport("scan/level: %lld/%lld ms, scan/edge: %lld/%lld ms\n",
+             scanned, level, scanned, edge);
+
+    esReport("done.\n");
+}
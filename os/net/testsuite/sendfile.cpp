@@ -0,0 +1,270 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Serves a file over the loopback interface, first by reading it into a
+// buffer and writing the buffer to the socket, and then with sendFile(),
+// and reports the throughput of each.
+
+#include <es.h>
+#include <es/dateTime.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "socket.h"
+#include "../../kernel/testsuite/memoryStream.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int FILE_SIZE = 4 * 1024 * 1024;
+    const int CHUNK_SIZE = 4096;
+
+    Handle<Inet4Address> localhost;
+    MemoryStream* file;
+
+    struct Peer
+    {
+        Socket*     listening;
+        long        received;
+        long long   timeout;
+    };
+
+    // A stream that reads nothing once it has been truncated, as a file
+    // cut down by another process.
+    class TruncatableStream : public MemoryStream
+    {
+        volatile bool truncated;
+
+    public:
+        TruncatableStream(size_t size) :
+            MemoryStream(size),
+            truncated(false)
+        {
+        }
+
+        void truncate()
+        {
+            truncated = true;
+        }
+
+        int read(void* dst, int count, long long offset)
+        {
+            if (truncated)
+            {
+                return 0;
+            }
+            return MemoryStream::read(dst, count, offset);
+        }
+    };
+}
+
+static void* serve(void* param)
+{
+    Peer* peer = static_cast<Peer*>(param);
+
+    es::Socket* socket;
+    while ((socket = peer->listening->accept()) == 0)
+    {
+    }
+    if (peer->timeout)
+    {
+        socket->setTimeout(peer->timeout);
+    }
+
+    u8 buf[CHUNK_SIZE];
+    int len;
+    while (0 < (len = socket->read(buf, sizeof buf)))
+    {
+        for (int i = 0; i < len; ++i)
+        {
+            ASSERT(buf[i] == (u8) ((peer->received + i) % 251));
+        }
+        peer->received += len;
+    }
+
+    if (peer->timeout)
+    {
+        // The sender has given up the connection; close it at once.
+        socket->setTimeout(0);
+        socket->setBlocking(false);
+    }
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static unsigned int countReferences(Object* object)
+{
+    object->addRef();
+    return object->release();
+}
+
+// Sends the file to the port, and returns the throughput in kbps.
+static long long run(int port, bool zeroCopy)
+{
+    Peer peer;
+    peer.received = 0;
+    peer.timeout = 0;
+    peer.listening = new Socket(AF_INET, es::Socket::Stream);
+    peer.listening->bind(localhost, port);
+    peer.listening->listen(5);
+    es::Thread* receiver = esCreateThread(serve, &peer);
+    receiver->start();
+
+    DateTime start = DateTime::getNow();
+    {
+        Socket client(AF_INET, es::Socket::Stream);
+        client.connect(localhost, port);
+
+        if (zeroCopy)
+        {
+            for (long sent = 0; sent < FILE_SIZE; )
+            {
+                int len = client.sendFile(file, sent, FILE_SIZE - sent);
+                ASSERT(0 < len);
+                sent += len;
+            }
+        }
+        else
+        {
+            u8 buf[CHUNK_SIZE];
+            for (long sent = 0; sent < FILE_SIZE; sent += CHUNK_SIZE)
+            {
+                int len = file->read(buf, CHUNK_SIZE, sent);
+                ASSERT(len == CHUNK_SIZE);
+                for (u8* ptr = buf; 0 < len; )
+                {
+                    int count = client.write(ptr, len);
+                    ASSERT(0 < count);
+                    ptr += count;
+                    len -= count;
+                }
+            }
+        }
+        client.close();
+        receiver->join();
+    }
+    long long ms = (DateTime::getNow() - start) / TimeSpan::TICKS_PER_MILLISECOND;
+    ASSERT(peer.received == FILE_SIZE);
+
+    // The file must be released once all of the bytes have been acknowledged.
+    for (int i = 0; i < 20 && 1 < countReferences(file); ++i)
+    {
+        esSleep(1000000);
+    }
+    TEST(countReferences(file) == 1);
+
+    peer.listening->close();
+    peer.listening->release();
+    return (long long) FILE_SIZE * 8 / std::max(1LL, ms);
+}
+
+// Truncates the stream while its range is queued. The bytes that can no
+// longer be read must not be sent in place of the stream, e.g., as zeros;
+// the connection is given up instead.
+static void runTruncated(int port)
+{
+    TruncatableStream* stream = new TruncatableStream(FILE_SIZE);
+    u8 buf[CHUNK_SIZE];
+    for (long offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE)
+    {
+        file->read(buf, CHUNK_SIZE, offset);
+        stream->write(buf, CHUNK_SIZE, offset);
+    }
+
+    Peer peer;
+    peer.received = 0;
+    peer.timeout = 10000000;    // 1 sec
+    peer.listening = new Socket(AF_INET, es::Socket::Stream);
+    peer.listening->bind(localhost, port);
+    peer.listening->listen(5);
+    {
+        Socket client(AF_INET, es::Socket::Stream);
+        client.connect(localhost, port);
+
+        // The connection is not accepted yet, so that at most a receive
+        // buffer of the range can be sent before the stream is truncated.
+        int len = client.sendFile(stream, 0, FILE_SIZE);
+        TEST(0 < len);
+        stream->truncate();
+
+        es::Thread* receiver = esCreateThread(serve, &peer);
+        receiver->start();
+        receiver->join();
+        TEST(peer.received < len);
+        client.close();
+    }
+    peer.listening->close();
+    peer.listening->release();
+    stream->release();
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    // Setup internet protocol family
+    InFamily* inFamily = new InFamily;
+
+    // Setup loopback interface
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+
+    // Register localhost address
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    file = new MemoryStream(FILE_SIZE);
+    u8 buf[CHUNK_SIZE];
+    for (long offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE)
+    {
+        for (int i = 0; i < CHUNK_SIZE; ++i)
+        {
+            buf[i] = (u8) ((offset + i) % 251);
+        }
+        file->write(buf, CHUNK_SIZE, offset);
+    }
+
+    long long copied = run(80, false);
+    long long sent = run(81, true);
+    esReport("read/write: %lld kbps, sendFile: %lld kbps (%lld%%)\n",
+             copied, sent, 100 * sent / std::max(1LL, copied));
+
+    // sendFile() is for stream sockets only.
+    Socket datagram(AF_INET, es::Socket::Datagram);
+    datagram.bind(localhost, 82);
+    TEST(datagram.sendFile(file, 0, CHUNK_SIZE) == -EOPNOTSUPP);
+    datagram.close();
+
+    runTruncated(83);
+
+    file->release();
+
+    esReport("done.\n");
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ * Copyright 2006, 2007 Nintendo Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs a TCP transfer and sends UDP datagrams over the loopback interface,
+// and checks the statistics of the sockets and of the protocols.
+
+#include <string.h>
+#include <es.h>
+#include <es/handle.h>
+#include <es/naming/IContext.h>
+#include "inet4.h"
+#include "inet4address.h"
+#include "inetConfig.h"
+#include "socket.h"
+
+#define TEST(exp)                           \
+    (void) ((exp) ||                        \
+            (esPanic(__FILE__, __LINE__, "\nFailed test " #exp), 0))
+
+extern int esInit(Object** nameSpace);
+extern es::Thread* esCreateThread(void* (*start)(void* param), void* param);
+
+namespace
+{
+    const int TRANSFER_SIZE = 1024 * 1024;
+    const int CHUNK_SIZE = 8192;
+
+    Handle<Inet4Address> localhost;
+
+    struct Flow
+    {
+        Socket*                 listening;
+        es::SocketStatistics  statistics;
+    };
+}
+
+static void* serve(void* param)
+{
+    Flow* flow = static_cast<Flow*>(param);
+
+    es::Socket* socket;
+    while ((socket = flow->listening->accept()) == 0)
+    {
+    }
+
+    u8 buf[CHUNK_SIZE];
+    while (0 < socket->read(buf, sizeof buf))
+    {
+    }
+    socket->getStatistics(&flow->statistics);
+    socket->close();
+    socket->release();
+    return 0;
+}
+
+static void report(const char* name, const es::SocketStatistics& s)
+{
+    esReport("%s: rtt %lld var %lld rto %lld cwnd %d ssthresh %d mss %d\n",
+             name, s.roundTripTime, s.roundTripTimeVariance, s.retransmissionTimeout,
+             s.congestionWindow, s.slowStartThreshold, s.maxSegmentSize);
+    esReport("%s: rxmit %u recoveries %u timeouts %u in %llu out %llu queued %d/%d\n",
+             name, s.retransmits, s.recoveries, s.timeouts, s.inOctets, s.outOctets,
+             s.receiveQueued, s.sendQueued);
+}
+
+int main()
+{
+    Object* root = NULL;
+    esInit(&root);
+    Handle<es::Context> context(root);
+
+    Socket::initialize();
+
+    InFamily* inFamily = new InFamily;
+
+    Handle<es::NetworkInterface> loopbackInterface = context->lookup("device/loopback");
+    int scopeID = Socket::addInterface(loopbackInterface);
+
+    localhost = new Inet4Address(InAddrLoopback, Inet4Address::statePreferred, scopeID);
+    inFamily->addAddress(localhost);
+    localhost->start();
+
+    Handle<InternetConfig> config = new InternetConfig;
+    es::InternetStatistics before;
+    config->getStatistics(&before);
+
+    // TCP
+    Flow flow;
+    flow.listening = new Socket(AF_INET, es::Socket::Stream);
+    flow.listening->bind(localhost, 100);
+    flow.listening->listen(1);
+
+    es::Thread* thread = esCreateThread(serve, &flow);
+    thread->start();
+
+    Socket client(AF_INET, es::Socket::Stream);
+    client.connect(localhost, 100);
+    u8 buf[CHUNK_SIZE];
+    memset(buf, 0, sizeof buf);
+    for (long sent = 0; sent < TRANSFER_SIZE; sent += sizeof buf)
+    {
+        TEST(client.write(buf, sizeof buf) == sizeof buf);
+    }
+    client.shutdownOutput();
+    thread->join();
+    thread->release();
+    esSleep(10000000);  // Wait for the last ACK.
+
+    es::SocketStatistics statistics;
+    client.getStatistics(&statistics);
+    report("client", statistics);
+    report("server", flow.statistics);
+    ASSERT(statistics.outOctets == TRANSFER_SIZE);
+    ASSERT(statistics.sendQueued == 0);
+    ASSERT(0 < statistics.retransmissionTimeout);
+    ASSERT(0 < statistics.congestionWindow);
+    ASSERT(0 < statistics.maxSegmentSize);
+    ASSERT(flow.statistics.inOctets == TRANSFER_SIZE);
+    ASSERT(flow.statistics.receiveQueued == 0);
+    client.close();
+    flow.listening->close();
+    flow.listening->release();
+
+    // UDP
+    Socket receiver(AF_INET, es::Socket::Datagram);
+    receiver.bind(localhost, 200);
+    Socket sender(AF_INET, es::Socket::Datagram);
+    sender.bind(localhost, 201);
+    TEST(sender.sendTo("hello", 5, 0, localhost, 200) == 5);
+    TEST(sender.sendTo("hello", 5, 0, localhost, 202) == 5);  // No socket
+    TEST(receiver.recvFrom(buf, sizeof buf, 0) == 5);
+    sender.getStatistics(&statistics);
+    ASSERT(statistics.outOctets == 10);
+    ASSERT(statistics.roundTripTime == 0);
+    receiver.getStatistics(&statistics);
+    ASSERT(statistics.inOctets == 5);
+    ASSERT(statistics.receiveQueued == 0);
+    esSleep(10000000);  // Wait for the unreachable port.
+
+    es::InternetStatistics after;
+    config->getStatistics(&after);
+    esReport("ip: in %llu hdrErrors %llu discards %llu delivers %llu out %llu discards %llu\n",
+             after.ipInReceives, after.ipInHdrErrors, after.ipInDiscards, after.ipInDelivers,
+             after.ipOutRequests, after.ipOutDiscards);
+    esReport("tcp: active %llu passive %llu in %llu errs %llu out %llu rxmit %llu rsts %llu\n",
+             after.tcpActiveOpens, after.tcpPassiveOpens, after.tcpInSegs, after.tcpInErrs,
+             after.tcpOutSegs, after.tcpRetransSegs, after.tcpOutRsts);
+    esReport("udp: in %llu noPorts %llu errors %llu out %llu\n",
+             after.udpInDatagrams, after.udpNoPorts, after.udpInErrors, after.udpOutDatagrams);
+    ASSERT(after.tcpActiveOpens - before.tcpActiveOpens == 1);
+    ASSERT(after.tcpPassiveOpens - before.tcpPassiveOpens == 1);
+    ASSERT(TRANSFER_SIZE / CHUNK_SIZE <= after.tcpOutSegs - before.tcpOutSegs);
+    ASSERT(after.tcpInSegs - before.tcpInSegs <= after.ipInDelivers - before.ipInDelivers);
+    ASSERT(after.udpOutDatagrams - before.udpOutDatagrams == 2);
+    ASSERT(after.udpInDatagrams - before.udpInDatagrams == 1);
+    ASSERT(after.udpNoPorts - before.udpNoPorts == 1);
+    ASSERT(after.ipInDelivers <= after.ipInReceives);
+    receiver.close();
+    sender.close();
+
+    esReport("done.\n");
+}
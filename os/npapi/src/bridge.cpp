@@ -15,6 +15,7 @@
  */
 
 #include <sys/epoll.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 
 #include <ctype.h>
@@ -289,6 +290,14 @@ start(const char* path, int argc, char* argn[], char* argv[])
 void Process::
 accept(es::CmdChanReq* req)
 {
+    // The shared memory rings are not supported; let the client fall back to the socket.
+    if (0 <= req->ringfd)
+    {
+        close(req->ringfd);
+        es::CmdChanRes res = { es::CMD_CHAN_RES, getpid(), req->tc, 0 };
+        send(req->sockfd, &res, sizeof res, 0);
+    }
+
     // Check ThreadCredential and if the thread is created already, just ad fd to its socketMap.
     std::map<es::ThreadCredential, Thread*>::iterator it = threadMap.find(req->tc);
     if (it == threadMap.end())
@@ -323,7 +332,8 @@ focus(void* param)
         es::RpcHdr* hdr = es::receiveMessage(currentThread->epfd, fdv, fdmax, &s);
         switch (hdr->cmd)
         {
-        case es::RPC_REQ: {
+        case es::RPC_REQ:
+        case es::RPC_ONEWAY: {  // TODO: do not reply to one-way requests
             es::RpcReq* req = reinterpret_cast<es::RpcReq*>(hdr);
             ExportedObject* exported = currentThread->process->getExported(req->capability);
             if (!exported)
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Passes a stream to bulkClient as its standard output, and lets it write
+// and read the sequences around RPC_BULK_SIZE bytes, the larger of which
+// are passed out of line. Checks what the client has left in the stream.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <es.h>
+#include <es/handle.h>
+#include <es/rpc.h>
+#include <es/base/IProcess.h>
+#include <es/naming/IContext.h>
+#include "store.h"
+
+extern es::CurrentProcess* System();
+
+int main()
+{
+    Handle<es::Context> nameSpace = System()->getRoot();
+    Store* store = new Store(4 * es::RPC_BULK_SIZE);
+
+    Handle<es::File> elfFile = nameSpace->lookup("file/bulkClient");
+    ASSERT(elfFile);
+
+    Handle<es::Process> process = es::Process::createInstance();
+    ASSERT(process);
+
+    process->setRoot(nameSpace);
+    process->setCurrent(nameSpace);
+    process->setOutput(store);
+    process->start(elfFile);
+    int result = process->wait();
+    ASSERT(result == 0);
+
+    // bulkClient leaves the largest sequence it has written.
+    ASSERT(store->getSize() == static_cast<long long>(4 * es::RPC_BULK_SIZE));
+    ASSERT(store->getFlushed() == 1);
+    const char* data = store->getData();
+    for (size_t i = 0; i < 4 * es::RPC_BULK_SIZE; ++i)
+    {
+        ASSERT(data[i] == static_cast<char>(i % 251));
+    }
+
+    store->release();
+    printf("done.\n");
+    return 0;
+}
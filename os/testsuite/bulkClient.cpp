@@ -0,0 +1,124 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Started by bulk. Writes and reads the sequences around RPC_BULK_SIZE bytes
+// through the standard output passed by bulk, and reports the bytes per
+// second passed out of line. None of the interfaces takes both a sequence
+// and an object, so the calls returning the objects are made between the
+// calls passing the sequences to check the file descriptors passed with the
+// messages are taken in order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <es.h>
+#include <es/rpc.h>
+#include <es/base/IProcess.h>
+#include <es/base/IStream.h>
+
+extern es::CurrentProcess* System();
+
+namespace
+{
+    const int SIZE = 4 * es::RPC_BULK_SIZE;
+    const int ROUNDS = 100;
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void check(es::Stream* stream, const char* data, char* copy, int size)
+{
+    stream->setSize(0);
+    int count = stream->write(data, size);
+    ASSERT(count == size);
+    ASSERT(stream->getSize() == size);
+
+    // An object returned between the sequences
+    es::Stream* other = static_cast<es::Stream*>(stream->queryInterface(es::Stream::iid()));
+    ASSERT(other);
+
+    memset(copy, 0, size);
+    count = other->read(copy, size, 0);
+    ASSERT(count == size);
+    ASSERT(memcmp(copy, data, size) == 0);
+
+    // Written at an offset and read from the position
+    count = other->write(data, size / 2, size / 2);
+    ASSERT(count == size / 2);
+    other->setPosition(0);
+    memset(copy, 0, size);
+    count = stream->read(copy, size);
+    ASSERT(count == size);
+    ASSERT(memcmp(copy, data, size / 2) == 0);
+    ASSERT(memcmp(copy + size / 2, data, size / 2) == 0);
+    ASSERT(stream->getPosition() == size);
+
+    other->release();
+}
+
+static long long measure(es::Stream* stream, const char* data, char* copy)
+{
+    long long start = now();
+    for (int i = 0; i < ROUNDS; ++i)
+    {
+        stream->write(data, SIZE, 0);
+        int count = stream->read(copy, SIZE, 0);
+        ASSERT(count == SIZE);
+        ASSERT(memcmp(copy, data, SIZE) == 0);
+    }
+    return now() - start;
+}
+
+int main()
+{
+    es::Stream* stream = System()->getOutput();
+    ASSERT(stream);
+
+    char* data = static_cast<char*>(malloc(SIZE));
+    char* copy = static_cast<char*>(malloc(SIZE));
+    for (int i = 0; i < SIZE; ++i)
+    {
+        data[i] = static_cast<char>(i % 251);
+    }
+
+    // In line, just out of line, and far out of line
+    check(stream, data, copy, es::RPC_BULK_SIZE - 1);
+    check(stream, data, copy, es::RPC_BULK_SIZE);
+    check(stream, data, copy, SIZE);
+
+    long long elapsed = measure(stream, data, copy);
+    printf("bulkClient: %d rounds of %d bytes written and read in %lld us (%lld MB/s)\n",
+           ROUNDS, SIZE, elapsed / 1000, (2 * ROUNDS * (long long) SIZE * 1000) / (elapsed ? elapsed : 1));
+
+    // Leave the data for bulk.
+    stream->setSize(0);
+    stream->write(data, SIZE);
+    stream->flush();
+    stream->release();
+
+    free(copy);
+    free(data);
+    return 0;
+}
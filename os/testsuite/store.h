@@ -0,0 +1,191 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GOOGLE_ES_TESTSUITE_STORE_H_INCLUDED
+#define GOOGLE_ES_TESTSUITE_STORE_H_INCLUDED
+
+#include <errno.h>
+#include <string.h>
+
+#include <es.h>
+#include <es/ref.h>
+#include <es/base/IStream.h>
+
+// A stream kept in memory of up to capacity bytes, which the tests pass to
+// the child processes as their standard output.
+class Store : public es::Stream
+{
+    Ref         ref;
+    long long   capacity;
+    long long   position;
+    long long   size;
+    unsigned    flushed;
+    char*       data;
+
+public:
+    Store(long long capacity) :
+        capacity(capacity),
+        position(0),
+        size(0),
+        flushed(0),
+        data(new char[capacity])
+    {
+    }
+
+    ~Store()
+    {
+        delete[] data;
+    }
+
+    long long getPosition()
+    {
+        return position;
+    }
+
+    void setPosition(long long position)
+    {
+        if (position < 0 || size < position)
+        {
+            esThrow(EINVAL);
+        }
+        this->position = position;
+    }
+
+    long long getSize()
+    {
+        return size;
+    }
+
+    void setSize(long long size)
+    {
+        if (size < 0 || capacity < size)
+        {
+            esThrow(ENOSPC);
+        }
+        this->size = size;
+        if (size < position)
+        {
+            position = size;
+        }
+    }
+
+    int read(void* dst, int count)
+    {
+        count = read(dst, count, position);
+        position += count;
+        return count;
+    }
+
+    int read(void* dst, int count, long long offset)
+    {
+        if (count < 0 || offset < 0)
+        {
+            esThrow(EINVAL);
+        }
+        if (size <= offset)
+        {
+            return 0;
+        }
+        if (size - offset < count)
+        {
+            count = size - offset;
+        }
+        memmove(dst, data + offset, count);
+        return count;
+    }
+
+    int write(const void* src, int count)
+    {
+        count = write(src, count, position);
+        position += count;
+        return count;
+    }
+
+    int write(const void* src, int count, long long offset)
+    {
+        if (count < 0 || offset < 0)
+        {
+            esThrow(EINVAL);
+        }
+        if (capacity < offset + count)
+        {
+            esThrow(ENOSPC);
+        }
+        memmove(data + offset, src, count);
+        if (size < offset + count)
+        {
+            size = offset + count;
+        }
+        return count;
+    }
+
+    void flush()
+    {
+        ++flushed;
+    }
+
+    unsigned getFlushed() const
+    {
+        return flushed;
+    }
+
+    const char* getData() const
+    {
+        return data;
+    }
+
+    bool contains(const char* s) const
+    {
+        return size == static_cast<long long>(strlen(s)) && memcmp(data, s, size) == 0;
+    }
+
+    Object* queryInterface(const char* riid)
+    {
+        Object* objectPtr;
+        if (strcmp(riid, es::Stream::iid()) == 0)
+        {
+            objectPtr = static_cast<es::Stream*>(this);
+        }
+        else if (strcmp(riid, Object::iid()) == 0)
+        {
+            objectPtr = static_cast<es::Stream*>(this);
+        }
+        else
+        {
+            return 0;
+        }
+        objectPtr->addRef();
+        return objectPtr;
+    }
+
+    unsigned int addRef()
+    {
+        return ref.addRef();
+    }
+
+    unsigned int release()
+    {
+        unsigned int count = ref.release();
+        if (count == 0)
+        {
+            delete this;
+            return 0;
+        }
+        return count;
+    }
+};
+
+#endif  // GOOGLE_ES_TESTSUITE_STORE_H_INCLUDED
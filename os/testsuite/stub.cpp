@@ -0,0 +1,72 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Passes a stream to stubClient as its standard output, and lets it call
+// the stream through the typed proxy generated by esidl -stub, and then
+// through the reflective proxy with ES_RPC_STUB set to "0". The requests
+// are served by the skeleton in either case. Checks what the client has
+// left in the stream after each run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <es.h>
+#include <es/handle.h>
+#include <es/base/IProcess.h>
+#include <es/naming/IContext.h>
+#include "store.h"
+
+extern es::CurrentProcess* System();
+
+static int run(es::Context* nameSpace, Store* store, const char* stub)
+{
+    // The child process inherits the environment.
+    setenv("ES_RPC_STUB", stub, 1);
+
+    Handle<es::File> elfFile = nameSpace->lookup("file/stubClient");
+    ASSERT(elfFile);
+
+    Handle<es::Process> process = es::Process::createInstance();
+    ASSERT(process);
+
+    process->setRoot(nameSpace);
+    process->setCurrent(nameSpace);
+    process->setOutput(store);
+    process->start(elfFile);
+    return process->wait();
+}
+
+int main()
+{
+    Handle<es::Context> nameSpace = System()->getRoot();
+    Store* store = new Store(1024);
+
+    int result = run(nameSpace, store, "1");
+    ASSERT(result == 0);
+    ASSERT(store->contains("typed"));
+    ASSERT(store->getFlushed() == 1);
+
+    result = run(nameSpace, store, "0");
+    ASSERT(result == 0);
+    ASSERT(store->contains("reflect"));
+    ASSERT(store->getFlushed() == 2);
+
+    store->release();
+    printf("done.\n");
+    return 0;
+}
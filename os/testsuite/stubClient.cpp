@@ -0,0 +1,163 @@
+/*
+ * Copyright 2008, 2009 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Started by stub. Calls the standard output passed by stub, which is
+// imported with the typed proxy generated by esidl -stub unless ES_RPC_STUB
+// is set to "0", and reports the calls per second.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <es.h>
+#include <es/exception.h>
+#include <es/rpcStub.h>
+#include <es/base/IProcess.h>
+#include <es/base/IStream.stub.h>
+
+extern es::CurrentProcess* System();
+
+typedef es::Stream_Proxy<es::RpcProxy<es::Stream> > StreamProxy;
+
+namespace
+{
+    const int CALLS = 100000;
+}
+
+static long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Checks if stream is a typed proxy. The typed proxies of Stream share the
+// vtable of StreamProxy, while the broker has a table of its own.
+static bool isTyped(es::Stream* stream)
+{
+    StreamProxy probe(0);
+    return *reinterpret_cast<void**>(stream) == *reinterpret_cast<void**>(static_cast<es::Stream*>(&probe));
+}
+
+static void check(es::Stream* stream)
+{
+    stream->setSize(0);
+    ASSERT(stream->getSize() == 0);
+    ASSERT(stream->getPosition() == 0);
+
+    // write and read take sequences, which are left to the reflective path.
+    int count = stream->write("stub", 4);
+    ASSERT(count == 4);
+    ASSERT(stream->getPosition() == 4);
+    ASSERT(stream->getSize() == 4);
+    stream->setPosition(1);
+    char buf[8];
+    count = stream->read(buf, sizeof buf);
+    ASSERT(count == 3);
+    ASSERT(memcmp(buf, "tub", 3) == 0);
+    count = stream->read(buf, sizeof buf, 0);
+    ASSERT(count == 4);
+    ASSERT(memcmp(buf, "stub", 4) == 0);
+
+    // The exception raised by the method is thrown by the proxy.
+    try
+    {
+        stream->setPosition(5);
+        ASSERT(false);
+    }
+    catch (SystemException<EINVAL>& e)
+    {
+    }
+}
+
+static void checkAsync(StreamProxy* proxy)
+{
+    es::RpcFuture size;
+    es::RpcFuture position;
+    es::RpcFuture invalid;
+
+    proxy->setPosition(&invalid, 5);
+    proxy->getSize(&size);
+    proxy->getPosition(&position);
+    ASSERT(static_cast<int64_t>(position.get()) == 4);
+    ASSERT(static_cast<int64_t>(size.get()) == 4);
+    try
+    {
+        invalid.get();
+        ASSERT(false);
+    }
+    catch (SystemException<EINVAL>& e)
+    {
+    }
+
+    // A future in flight takes its reply as it goes away while an exception
+    // is unwinding the stack, without throwing the exception raised by the
+    // method. The replies sent later are still matched to their calls.
+    try
+    {
+        es::RpcFuture dropped;
+        proxy->setPosition(&dropped, 5);
+        es::RpcFuture pending;
+        proxy->getSize(&pending);
+        esThrow(EINTR);
+    }
+    catch (SystemException<EINTR>& e)
+    {
+    }
+    ASSERT(proxy->getSize() == 4);
+}
+
+static long long measure(es::Stream* stream)
+{
+    long long start = now();
+    for (int i = 0; i < CALLS; ++i)
+    {
+        stream->getPosition();
+    }
+    return now() - start;
+}
+
+int main()
+{
+    const char* env = getenv("ES_RPC_STUB");
+    bool typed = !env || strcmp(env, "0") != 0;
+
+    es::Stream* stream = System()->getOutput();
+    ASSERT(stream);
+    ASSERT(isTyped(stream) == typed);
+
+    check(stream);
+    if (typed)
+    {
+        checkAsync(static_cast<StreamProxy*>(stream));
+    }
+
+    long long elapsed = measure(stream);
+    printf("stubClient: %s proxy %lld calls/s\n",
+           typed ? "typed" : "reflective", CALLS * 1000000000LL / elapsed);
+
+    // Leave the result for stub.
+    const char* result = typed ? "typed" : "reflect";
+    stream->setSize(0);
+    stream->write(result, strlen(result));
+    stream->flush();
+    stream->release();
+    return 0;
+}